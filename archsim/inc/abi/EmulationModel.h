@@ -113,6 +113,12 @@ namespace archsim
 			virtual ExceptionAction HandleMemoryFault(archsim::core::thread::ThreadInstance &thread, archsim::MemoryInterface &interface, archsim::Address address);
 			virtual void HandleInterrupt(archsim::core::thread::ThreadInstance* thread, archsim::abi::devices::CPUIRQLine *irq);
 
+			// Called when a thread starts waiting for an interrupt, and
+			// again once it has been woken up by one. Returns true if the
+			// thread should sleep until it is sent a message, or false if it
+			// should carry on executing.
+			virtual bool SetThreadIdle(archsim::core::thread::ThreadInstance* thread, bool idle);
+
 			virtual bool LookupSymbol(Address address, bool exact_match, const BinarySymbol *& symbol) const;
 			virtual bool ResolveSymbol(std::string name, Address& value);
 
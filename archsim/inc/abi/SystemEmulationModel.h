@@ -17,6 +17,8 @@
 #include "loader/BinaryLoader.h"
 
 #include <memory>
+#include <mutex>
+#include <unordered_set>
 
 namespace archsim
 {
@@ -49,6 +51,7 @@ namespace archsim
 			void Destroy() override;
 
 			void HaltCores() override;
+			bool SetThreadIdle(archsim::core::thread::ThreadInstance* thread, bool idle) override;
 
 			bool PrepareBoot(System& system) override;
 
@@ -98,6 +101,9 @@ namespace archsim
 			archsim::core::execution::ExecutionEngine *execution_engine_;
 			std::shared_ptr<archsim::core::MemoryMonitor> monitor_;
 
+			std::mutex idle_lock_;
+			std::unordered_set<archsim::core::thread::ThreadInstance*> idle_threads_;
+
 			bool InstallAtags(archsim::abi::memory::guest_addr_t base_address, std::string kernel_args);
 			bool InstallStartupCode(unsigned int entry_point, archsim::abi::memory::guest_addr_t atags_loc, uint32_t device_id);
 			bool InstallDeviceTree(std::string device_tree_file);
@@ -389,7 +389,12 @@ namespace archsim
 				}
 
 			protected:
-				MemoryRegister *GetRegister(uint32_t offset);
+				MemoryRegister *GetRegister(uint32_t offset)
+				{
+					if (offset >= registers.size())
+						return NULL;
+					return registers[offset];
+				}
 				void AddRegister(MemoryRegister& rg);
 
 				virtual uint32_t ReadRegister(MemoryRegister& reg);
@@ -397,8 +402,11 @@ namespace archsim
 
 			private:
 				std::string name;
-				typedef std::unordered_map<uint32_t, MemoryRegister *> register_map_t;
-				register_map_t registers;
+
+				// Registers indexed by their offset, up to the highest
+				// register offset, so that an access finds its register
+				// without searching
+				std::vector<MemoryRegister *> registers;
 			};
 
 		}
@@ -13,8 +13,8 @@
 #include "abi/memory/MemoryModel.h"
 #include "translate/profile/RegionArch.h"
 
-#include <bitset>
-#include <map>
+#include <array>
+#include <memory>
 #include <set>
 
 namespace archsim
@@ -27,6 +27,13 @@ namespace archsim
 		{
 			class MemoryComponent;
 
+			/*
+			 * Maps physical pages to the devices installed on them. Devices
+			 * are looked up on every MMIO access, so the table is indexed
+			 * directly by page number. It has two levels, so that only the
+			 * parts of the physical address space which contain devices
+			 * take up any memory.
+			 */
 			class DeviceManager
 			{
 			public:
@@ -34,22 +41,43 @@ namespace archsim
 				~DeviceManager();
 
 				bool InstallDevice(memory::guest_addr_t base_address, memory::guest_size_t device_size, MemoryComponent& device);
-				bool LookupDevice(memory::guest_addr_t device_address, MemoryComponent*& device);
+				bool LookupDevice(memory::guest_addr_t device_address, MemoryComponent*& device)
+				{
+					device = GetDevice(device_address);
+					return device != nullptr;
+				}
 				bool HasDevice(memory::guest_addr_t device_address)
 				{
-					return device_bitmap.test(device_address.GetPageIndex());
+					return GetDevice(device_address) != nullptr;
+				}
+
+				// Get the device on the page containing the given address,
+				// or null if the page is not MMIO
+				MemoryComponent *GetDevice(memory::guest_addr_t device_address) const
+				{
+					uint64_t page = device_address.GetPageIndex();
+					if(page >= kPageCount) {
+						return nullptr;
+					}
+
+					const auto &leaf = device_table_[page >> kLeafBits];
+					if(leaf == nullptr) {
+						return nullptr;
+					}
+					return leaf[page & (kLeafSize - 1)];
 				}
 
 			private:
-				memory::guest_addr_t min_device_address;
+				static const uint32_t kPageCount = archsim::translate::profile::RegionArch::PageCount;
+				static const uint32_t kLeafBits = 10;
+				static const uint32_t kLeafSize = 1 << kLeafBits;
 
-				typedef std::map<memory::guest_addr_t, MemoryComponent*> device_map_t;
-				device_map_t devices;
+				memory::guest_addr_t min_device_address;
 
 				//Keep also a set of registered devices, since some devices may be multiply registered
 				std::set<MemoryComponent*> device_set;
 
-				std::bitset<archsim::translate::profile::RegionArch::PageCount> device_bitmap;
+				std::array<std::unique_ptr<MemoryComponent*[]>, kPageCount / kLeafSize> device_table_;
 			};
 		}
 	}
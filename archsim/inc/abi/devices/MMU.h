@@ -13,6 +13,8 @@
 #include "define.h"
 #include "abi/devices/Device.h"
 #include "abi/devices/PeripheralManager.h"
+#include "abi/devices/SoftwareTLB.h"
+#include "util/PubSubSync.h"
 
 namespace archsim
 {
@@ -88,6 +90,24 @@ namespace archsim
 				virtual void FlushCaches();
 				virtual void Evict(Address virt_addr);
 
+				// Precise TLB maintenance, for one side of the TLB
+				void FlushTLB(bool instruction, bool data);
+				void EvictTLB(Address virt_addr, bool instruction, bool data);
+				void EvictTLBASID(uint32_t asid, bool instruction, bool data);
+
+				// Flush the TLB before it is next used. Unlike the functions
+				// above, this is safe to call from any thread.
+				void RequestTLBFlush(bool instruction, bool data);
+
+				// The ASID of the address space which is currently mapped.
+				// Architectures set it when the guest switches address space,
+				// and the TLB tags translations with it.
+				uint32_t GetASID() const
+				{
+					return asid_;
+				}
+				void SetASID(uint32_t asid);
+
 				Address TranslateUnsafe(archsim::core::thread::ThreadInstance *cpu, Address virt_addr);
 
 				void set_enabled(bool enabled);
@@ -107,10 +127,25 @@ namespace archsim
 					return phys_mem;
 				}
 
+				// Start listening for TLB flushes published by the rest of
+				// the system. Called by each MMU from Initialise.
+				void InitialiseTLB();
+
+				// Look up a completed translation in the TLB, or record one
+				// after a successful page walk. Translations are tagged with
+				// the current ASID, and the ring of the access.
+				bool LookupTLB(archsim::core::thread::ThreadInstance *cpu, Address virt_addr, Address &phys_addr, const struct AccessInfo &info);
+				void InsertTLB(Address virt_addr, Address phys_addr, const struct AccessInfo &info);
+
 			private:
 				bool should_be_enabled;
 
 				memory::MemoryModel *phys_mem;
+
+				SoftwareTLB itlb_;
+				SoftwareTLB dtlb_;
+				uint32_t asid_;
+				util::PubSubscriber *tlb_subscriber_;
 			};
 
 		}
@@ -0,0 +1,107 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * SoftwareTLB.h
+ *
+ * A set associative cache of completed MMU translations.
+ */
+
+#ifndef INC_ABI_DEVICES_SOFTWARETLB_H_
+#define INC_ABI_DEVICES_SOFTWARETLB_H_
+
+#include "abi/Address.h"
+
+#include <atomic>
+
+namespace archsim
+{
+	namespace abi
+	{
+		namespace devices
+		{
+
+			/*
+			 * Caches the results of successful page walks at 4KB granularity.
+			 * Each entry is tagged with the ASID and the privilege ring it was
+			 * walked for, and records which kinds of access have been allowed
+			 * so far: a page first read and then written needs a second walk
+			 * before the write is allowed, so that dirty bits and write
+			 * permissions are still checked by the MMU.
+			 *
+			 * A TLB belongs to one MMU, and is only looked up and filled by
+			 * the thread which owns it. Other threads may only request a full
+			 * flush, which is performed at the next lookup.
+			 */
+			class SoftwareTLB
+			{
+			public:
+				static const uint32_t kSetBits = 6;
+				static const uint32_t kSets = 1 << kSetBits;
+				static const uint32_t kWays = 4;
+
+				enum Permission : uint8_t {
+					PermRead = 1,
+					PermWrite = 2,
+					PermFetch = 4
+				};
+
+				SoftwareTLB();
+
+				bool Lookup(Address virt_addr, uint32_t asid, uint32_t ring, uint8_t perm, Address &phys_addr)
+				{
+					if(flush_pending_.load(std::memory_order_relaxed)) {
+						Flush();
+						return false;
+					}
+
+					auto page = virt_addr.GetPageBase();
+					for(const auto &entry : sets_[GetSetIndex(virt_addr)]) {
+						if(entry.VirtPage == page && entry.ASID == asid && entry.Ring == ring && (entry.Permissions & perm)) {
+							phys_addr = Address(entry.PhysPage | virt_addr.GetPageOffset());
+							return true;
+						}
+					}
+
+					return false;
+				}
+
+				void Insert(Address virt_addr, Address phys_addr, uint32_t asid, uint32_t ring, uint8_t perm);
+
+				void Flush();
+				void Evict(Address virt_addr);
+				void EvictASID(uint32_t asid);
+
+				// Flush the TLB before its next lookup. Safe to call from any
+				// thread.
+				void RequestFlush()
+				{
+					flush_pending_.store(true, std::memory_order_relaxed);
+				}
+
+				static uint32_t GetSetIndex(Address virt_addr)
+				{
+					return (virt_addr.Get() >> 12) & (kSets - 1);
+				}
+
+			private:
+				struct Entry {
+					Address::underlying_t VirtPage;
+					Address::underlying_t PhysPage;
+					uint32_t ASID;
+					uint8_t Ring;
+
+					// An entry with no permissions is invalid
+					uint8_t Permissions;
+				};
+
+				Entry sets_[kSets][kWays];
+				uint8_t next_victim_[kSets];
+
+				std::atomic<bool> flush_pending_;
+			};
+
+		}
+	}
+}
+
+#endif /* INC_ABI_DEVICES_SOFTWARETLB_H_ */
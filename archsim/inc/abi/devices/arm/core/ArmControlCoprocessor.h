@@ -118,6 +118,7 @@ namespace archsim
 //				const gensim::RegisterDescriptor *V_descriptor;
 
 				MMU *get_mmu();
+				void invalidate_tlb(bool instruction, bool data, bool single_entry, uint32_t mva);
 			};
 
 		}
@@ -126,6 +126,7 @@ namespace archsim
 				uint8_t *V_ptr;
 
 				MMU *get_mmu();
+				void invalidate_tlb(bool instruction, bool data, bool single_entry, uint32_t mva);
 			};
 
 		}
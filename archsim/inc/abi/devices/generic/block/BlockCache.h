@@ -53,6 +53,13 @@ namespace archsim
 							return true;
 						}
 
+						void InvalidateBlock(size_t block_idx)
+						{
+							if(HasBlock(block_idx)) {
+								block_idxs[block_idx % kCacheNumEntries] = kInvalidIdx;
+							}
+						}
+
 						BlockCache()
 						{
 							block_idxs = new size_t[kCacheNumEntries];
@@ -13,6 +13,8 @@
 #include "define.h"
 #include "util/Counter.h"
 
+#include <sys/uio.h>
+
 namespace archsim
 {
 	namespace abi
@@ -34,6 +36,17 @@ namespace archsim
 						virtual bool WriteBlock(uint64_t block_idx, const uint8_t *buffer) = 0;
 						virtual bool WriteBlocks(uint64_t block_idx, uint32_t count, const uint8_t *buffer) = 0;
 
+						// Transfer a run of blocks to or from a list of buffers,
+						// which together must hold a whole number of blocks
+						virtual bool ReadBlocksV(uint64_t block_idx, const struct iovec *iov, int iovcnt);
+						virtual bool WriteBlocksV(uint64_t block_idx, const struct iovec *iov, int iovcnt);
+
+						// Make every write which has completed durable
+						virtual bool Flush()
+						{
+							return true;
+						}
+
 						virtual uint64_t GetBlockSize() const = 0;
 						virtual uint64_t GetBlockCount() const = 0;
 
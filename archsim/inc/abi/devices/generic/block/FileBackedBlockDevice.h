@@ -39,6 +39,9 @@ namespace archsim
 						bool ReadBlocks(uint64_t block_idx, uint32_t count, uint8_t* buffer) override;
 						bool WriteBlock(uint64_t block_idx, const uint8_t* buffer) override;
 						bool WriteBlocks(uint64_t block_idx, uint32_t count, const uint8_t* buffer) override;
+						bool ReadBlocksV(uint64_t block_idx, const struct iovec *iov, int iovcnt) override;
+						bool WriteBlocksV(uint64_t block_idx, const struct iovec *iov, int iovcnt) override;
+						bool Flush() override;
 
 						bool Open(std::string filename, bool read_only = false);
 						void Close();
@@ -50,7 +53,7 @@ namespace archsim
 
 						bool IsOpen() const override
 						{
-							return file_data != NULL;
+							return use_mmap ? file_data != NULL : file_descr >= 0;
 						}
 
 					private:
@@ -61,6 +64,8 @@ namespace archsim
 							return (void *)((unsigned long)file_data + CalculateByteOffset(block_idx));
 						}
 
+						bool TransferBlocksV(uint64_t block_idx, const struct iovec *iov, int iovcnt, bool write);
+
 						int file_descr;
 						void *file_data;
 						uint64_t file_size;
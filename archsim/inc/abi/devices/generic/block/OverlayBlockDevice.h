@@ -0,0 +1,118 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * OverlayBlockDevice.h
+ *
+ * A copy-on-write block device which keeps its changes in a sparse
+ * overlay file, on top of a (usually read only) backing device.
+ */
+
+#ifndef INC_ABI_DEVICES_GENERIC_BLOCK_OVERLAYBLOCKDEVICE_H_
+#define INC_ABI_DEVICES_GENERIC_BLOCK_OVERLAYBLOCKDEVICE_H_
+
+#include "abi/devices/generic/block/BlockDevice.h"
+
+#include <string>
+#include <vector>
+
+namespace archsim
+{
+	namespace abi
+	{
+		namespace devices
+		{
+			namespace generic
+			{
+				namespace block
+				{
+					/*
+					 * The overlay is stored in clusters. The first cluster holds
+					 * the header and the L1 table, and is mapped into memory. Each
+					 * L1 entry is the file offset of an L2 table, which takes up a
+					 * whole cluster and holds the file offsets of the data clusters
+					 * for a run of the device. An offset of zero means the data is
+					 * still in the backing device. Clusters are only ever added to
+					 * the end of the file, so the overlay only takes up as much
+					 * space as the guest has written.
+					 */
+					class OverlayBlockDevice : public BlockDevice
+					{
+					public:
+						static const uint32_t kClusterBits = 16;
+						static const uint32_t kClusterSize = 1 << kClusterBits;
+						static const uint32_t kL2Bits = kClusterBits - 3;
+						static const uint32_t kL2Entries = 1 << kL2Bits;
+
+						static const uint64_t kMagic = 0x59414c5245564f41ULL; // "AOVERLAY"
+						static const uint32_t kVersion = 1;
+
+						OverlayBlockDevice();
+						~OverlayBlockDevice();
+
+						uint64_t GetBlockCount() const override;
+						uint64_t GetBlockSize() const override;
+
+						bool IsReadOnly() const override
+						{
+							return false;
+						}
+
+						bool IsOpen() const override
+						{
+							return header != nullptr;
+						}
+
+						bool ReadBlock(uint64_t block_idx, uint8_t* buffer) override;
+						bool ReadBlocks(uint64_t block_idx, uint32_t count, uint8_t* buffer) override;
+						bool WriteBlock(uint64_t block_idx, const uint8_t* buffer) override;
+						bool WriteBlocks(uint64_t block_idx, uint32_t count, const uint8_t* buffer) override;
+						bool Flush() override;
+
+						// Open the overlay file, creating an empty overlay if the file
+						// is empty or does not exist. An existing overlay must have
+						// been made for a backing device of the same geometry. The
+						// file is locked while it is open, so that two simulations
+						// can't use the same overlay at once.
+						bool Open(BlockDevice& backing, std::string filename);
+						void Close();
+
+						// Write every cluster in the overlay back into the backing
+						// device, which must be writable, and empty the overlay
+						bool Commit();
+
+						uint64_t GetAllocatedClusterCount() const;
+
+					private:
+						struct Header {
+							uint64_t magic;
+							uint32_t version;
+							uint32_t cluster_bits;
+							uint64_t block_size;
+							uint64_t block_count;
+							uint64_t l1_entries;
+							uint64_t next_free;
+							uint64_t l1[];
+						};
+
+						// Check that every offset in an existing overlay's header and
+						// tables is a cluster within the file
+						static bool CheckTables(int fd, const Header *hdr, uint64_t file_size);
+
+						uint64_t *GetL2Table(uint64_t l1_idx, bool allocate);
+						uint64_t GetCluster(uint64_t cluster, bool allocate, bool fill);
+						uint64_t AllocateCluster();
+						bool FillCluster(uint64_t cluster, uint64_t offset);
+						void Reset();
+
+						BlockDevice *backing;
+						int file_descr;
+						Header *header;
+						std::vector<uint64_t *> l2_tables;
+					};
+				}
+			}
+		}
+	}
+}
+
+#endif /* INC_ABI_DEVICES_GENERIC_BLOCK_OVERLAYBLOCKDEVICE_H_ */
@@ -12,7 +12,11 @@
 
 #include "concurrent/Thread.h"
 #include "util/PubSubSync.h"
+#include "util/TimerWheel.h"
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
 #include <mutex>
 #include <unordered_set>
@@ -27,6 +31,16 @@ namespace archsim
 			{
 				class TickConsumer;
 
+				// A timer which expires once the tick counter reaches its
+				// deadline. Expiry happens on whichever thread drives the
+				// tick source.
+				typedef util::timing::TimerWheel::Timer TickTimer;
+
+				/*
+				 * Drives device timers. Devices either schedule a TickTimer for
+				 * the tick at which they next have something to do, or register
+				 * as a TickConsumer and are called on every tick.
+				 */
 				class TickSource
 				{
 				public:
@@ -36,42 +50,126 @@ namespace archsim
 					void AddConsumer(TickConsumer &consumer);
 					void RemoveConsumer(TickConsumer &consumer);
 
+					// Schedule the timer to expire at the given tick count, or
+					// move it if it is already scheduled
+					void ScheduleTimer(TickTimer &timer, uint64_t deadline);
+					void CancelTimer(TickTimer &timer);
+
 					void Start();
 					void Stop();
 
-					inline uint64_t GetCounter()
+					virtual uint64_t GetCounter()
 					{
 						return tick_count_;
 					}
 
+					// Called when every hart is waiting for an interrupt. A
+					// source of virtual time can move straight on to the next
+					// deadline, but one which follows the host clock can't.
+					virtual void SkipToNextDeadline();
+
 				protected:
 					void Tick(uint32_t tick_periods);
+
+					// Called when a timer has been scheduled earlier than any
+					// other, so a source which sleeps between deadlines can wake
+					virtual void DeadlinesChanged();
+
+					bool HasConsumers();
+					uint64_t GetNextDeadline();
+
+					uint64_t GetTicksForPeriods(uint64_t periods) const;
+					uint64_t GetPeriodsForTicks(uint64_t ticks) const;
+
 				private:
 					uint64_t tick_count_;
-					float microticks_;
-					float microtick_scale_;
+					uint64_t tick_periods_;
+					double tick_scale_;
 					bool running_;
 
 				private:
-					std::mutex consumers_lock_;
+					std::recursive_mutex consumers_lock_;
 					std::unordered_set<TickConsumer*> consumers;
+
+					util::timing::TimerWheel timers_;
+					uint64_t next_deadline_;
 				};
 
+				/*
+				 * Ticks in host time. Rather than waking every period, the
+				 * thread sleeps until the next timer deadline and then catches
+				 * the counter up to the host clock. It only wakes every period
+				 * if there are consumers which want every tick.
+				 */
 				class MicrosecondTickSource : public archsim::concurrent::LoopThread, public TickSource
 				{
 				public:
 					MicrosecondTickSource(uint32_t useconds);
 					~MicrosecondTickSource() override;
 
+					uint64_t GetCounter() override;
+
 				protected:
 					void tick() override;
+					void interrupt() override;
+					void DeadlinesChanged() override;
 
 				private:
-					uint32_t ticks;
-					uint32_t recalibrate;
-					uint32_t total_overshoot;
-					uint32_t overshoot_samples;
-					uint32_t calibrated_ticks;
+					typedef std::chrono::steady_clock host_clock_t;
+
+					uint64_t GetElapsedPeriods() const;
+					void Wake();
+
+					host_clock_t::time_point start_;
+					std::chrono::microseconds period_;
+					uint64_t periods_done_;
+
+					std::mutex wait_lock_;
+					std::condition_variable wait_cond_;
+					bool woken_;
+				};
+
+				/*
+				 * Ticks in virtual time, one period per guest instruction.
+				 * Translated code reports the instructions of a whole block at
+				 * once, and the interpreter reports each instruction through
+				 * the InstructionExecute event. Counting is a single atomic
+				 * add: the source only catches up the tick counter once the
+				 * count passes the next deadline, or on every period if there
+				 * are consumers which want every tick.
+				 */
+				class InstructionTickSource : public TickSource
+				{
+				public:
+					InstructionTickSource(util::PubSubContext &context);
+					~InstructionTickSource() override;
+
+					void AddInstructions(uint32_t count)
+					{
+						uint64_t total = instructions_.fetch_add(count) + count;
+						if(total >= catch_up_at_.load(std::memory_order_relaxed)) {
+							CatchUp();
+						}
+					}
+
+					uint64_t GetCounter() override;
+					void SkipToNextDeadline() override;
+
+				protected:
+					void DeadlinesChanged() override;
+
+				private:
+					void CatchUp();
+					void CatchUpLocked();
+
+					const util::PubSubscription *subscription_;
+
+					std::atomic<uint64_t> instructions_;
+					std::atomic<uint64_t> catch_up_at_;
+					std::atomic<uint32_t> deadline_changes_;
+
+					std::mutex lock_;
+					uint64_t periods_done_;
 				};
 
 				class CallbackTickSource : public TickSource
@@ -13,7 +13,6 @@
 #include "abi/devices/Component.h"
 #include "abi/devices/IRQController.h"
 #include "abi/devices/SerialPort.h"
-#include "abi/devices/generic/timing/TickConsumer.h"
 #include "abi/devices/generic/timing/TickSource.h"
 #include "system.h"
 
@@ -29,14 +28,16 @@ namespace archsim
 
 				/*
 				 * Class which manages mtimecmp and the associated interrupt
-				 * for a single hart.
+				 * for a single hart. The timer is scheduled for the tick at
+				 * which mtime passes mtimecmp.
 				 */
-				class CLINTTimer : public archsim::abi::devices::timing::TickConsumer
+				class CLINTTimer : public archsim::abi::devices::timing::TickTimer
 				{
 				public:
 					CLINTTimer(archsim::core::thread::ThreadInstance *hart, SifiveCLINT *clint);
+					~CLINTTimer();
 
-					void Tick(uint32_t tick_periods) override;
+					void Expired(uint64_t now) override;
 					void SetCmp(uint64_t cmp);
 					uint64_t GetCmp() const;
 
@@ -61,6 +62,11 @@ namespace archsim
 					uint64_t GetTimer();
 					CLINTTimer *GetHartTimer(int i);
 
+					archsim::abi::devices::timing::TickSource *GetTickSource()
+					{
+						return tick_source_;
+					}
+
 					archsim::core::thread::ThreadInstance *GetHart(int i);
 					archsim::arch::riscv::RiscVSystemCoprocessor *GetCoprocessor(int i);
 				private:
@@ -16,6 +16,7 @@
 
 #include <vector>
 #include <array>
+#include <mutex>
 
 #define VRING_DESC_F_INDIRECT 4
 
@@ -109,8 +110,11 @@ namespace archsim
 						else return queues[index];
 					}
 
+					// Devices may complete requests from their own threads, so
+					// the interrupt status is only changed under the lock
 					inline void AssertInterrupt(uint32_t i)
 					{
+						std::lock_guard<std::mutex> lg(interrupt_lock);
 						InterruptStatus.Set(InterruptStatus.Get() | i);
 
 						if(InterruptStatus.Get()) {
@@ -130,6 +134,7 @@ namespace archsim
 					std::vector<VirtQueue *> queues;
 
 					IRQLine& irq;
+					std::mutex interrupt_lock;
 
 					MemoryRegister MagicValue;
 					MemoryRegister Version;
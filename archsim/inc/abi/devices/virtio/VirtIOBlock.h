@@ -12,6 +12,11 @@
 
 #include "abi/devices/virtio/VirtIO.h"
 
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
 namespace archsim
 {
 	namespace abi
@@ -51,9 +56,26 @@ namespace archsim
 						uint64_t sector;
 					};
 
+					// Requests are queued by the vCPU which notifies the device,
+					// and carried out and completed by the I/O worker
 					void ProcessEvent(VirtIOQueueEvent* evt) override;
-					bool HandleRead(uint64_t sector, uint8_t *buffer, uint32_t len);
-					bool HandleWrite(uint64_t sector, uint8_t *buffer, uint32_t len);
+					void WaitForIdle();
+
+					void worker_thread_proc();
+					uint32_t ProcessRequests(std::deque<VirtIOQueueEvent*>& requests);
+					uint32_t ProcessRequest(VirtIOQueueEvent* evt);
+					uint32_t ProcessTransfer(std::deque<VirtIOQueueEvent*>& requests);
+					void CompleteRequest(VirtIOQueueEvent* evt, uint8_t status);
+
+					bool GetTransfer(VirtIOQueueEvent& evt, uint32_t& type, uint64_t& sector, uint64_t& len) const;
+
+					std::thread worker;
+					std::mutex request_lock;
+					std::condition_variable request_cond;
+					std::condition_variable idle_cond;
+					std::deque<VirtIOQueueEvent*> pending_requests;
+					bool worker_busy;
+					bool terminate;
 
 					struct {
 						uint64_t capacity; // 0
@@ -13,6 +13,8 @@
 #include "define.h"
 #include "util/LogContext.h"
 
+#include <atomic>
+
 UseLogContext(LogVirtIO);
 
 namespace archsim
@@ -153,6 +155,10 @@ namespace archsim
 						ring.GetUsed()->ring[idx].id = elem_idx;
 						ring.GetUsed()->ring[idx].len = len;
 
+						// The element must be visible to the guest before the
+						// index which publishes it
+						std::atomic_thread_fence(std::memory_order_release);
+
 						uint16_t old = ring.GetUsed()->idx;
 						ring.GetUsed()->idx = old + 1;
 					}
@@ -16,6 +16,7 @@
 #include "abi/devices/Component.h"
 
 #include <string.h>
+#include <sys/uio.h>
 #include <string>
 #include <map>
 #include <vector>
@@ -70,6 +71,7 @@ namespace archsim
 			typedef Address guest_addr_t;
 			typedef uint64_t guest_size_t;
 			typedef const void *host_const_addr_t;
+			typedef std::vector<struct iovec> host_span_list_t;
 
 			class MemoryTranslationModel;
 
@@ -176,6 +178,16 @@ namespace archsim
 
 				virtual bool LockRegions(guest_addr_t guest_addr, guest_size_t guest_size, LockedMemoryRegion &regions);
 
+				/**
+				 * Obtain host pointers covering a region of guest memory, so that it can be copied directly (e.g.
+				 * with memcpy or readv/writev). The region is split into spans at page boundaries, and adjacent
+				 * pages which are also adjacent in host memory share a span. lock_type is a mask of RegionLockType
+				 * values. Returns FALSE if any part of the region cannot be accessed directly, or does not allow
+				 * the requested access, in which case the caller should fall back to Read and Write. The spans
+				 * remain valid until the region is unmapped.
+				 */
+				virtual bool LockSpans(guest_addr_t guest_addr, guest_size_t guest_size, uint32_t lock_type, host_span_list_t &spans);
+
 				/**
 				 * Unlock a region of memory previously locked by a LockRegion call.
 				 */
@@ -12,10 +12,8 @@
 
 #include "abi/memory/MemoryModel.h"
 #include "abi/memory/MemoryTranslationModel.h"
-#include "concurrent/LWLock.h"
-#include "util/Cache.h"
-#include <map>
-#include <mutex>
+#include "util/RadixPageTable.h"
+#include <atomic>
 #include <string>
 
 namespace archsim
@@ -68,19 +66,24 @@ namespace archsim
 				bool DeallocateVMA(GuestVMA &vma);
 				bool ResizeVMA(GuestVMA &vma, guest_size_t new_size);
 			private:
-				char *GetPage(Address addr);
-				char *GetPageUncached(Address addr);
-
-				archsim::util::Cache<Address::underlying_t, char*> cache_;
-
-				Address prev_page_base_;
-				char *prev_page_data_;
-				std::mutex map_lock_;
-
-				uint64_t pages_remaining_;
+				char *GetPage(Address addr)
+				{
+					char *page = pages_.Lookup(addr.Get());
+					if(page == nullptr) {
+						page = AllocatePage(addr);
+					}
+					return page;
+				}
+				char *AllocatePage(Address addr);
+
+				std::atomic<uint64_t> pages_remaining_;
 
 				SparseMemoryTranslationModel* translation_model;
-				std::map<Address, char*> data_;
+
+				// Pages are allocated on first touch, and are never freed
+				// while the model is in use, so that they can be looked up
+				// without taking a lock
+				archsim::util::RadixPageTable pages_;
 			};
 		}
 	}
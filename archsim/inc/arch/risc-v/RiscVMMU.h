@@ -94,7 +94,6 @@ namespace archsim
 
 				Mode mode_;
 				uint64_t page_table_ppn_;
-				uint64_t asid_;
 
 			};
 		}
@@ -17,6 +17,9 @@
 
 #include <array>
 #include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 
 namespace archsim
 {
@@ -25,6 +28,11 @@ namespace archsim
 	namespace blockjit
 	{
 
+		// Set in a thread's PendingFlush state block entry by translated code
+		// which has used up the thread's ProfileBudget, so that the thread
+		// returns to the dispatch loop to process its profile
+		static const uint32_t kPendingProfile = 4;
+
 		struct BlockCacheEntry {
 			uint64_t virt_tag;
 			block_txln_fn ptr;
@@ -33,14 +41,42 @@ namespace archsim
 // Need BlockCacheEntry to be 16 bytes to be compatible with block trampoline assembly and dispatch logic
 		static_assert(sizeof(struct BlockCacheEntry) == 16, "Block Cache Entry must be 16 bytes!");
 
+		/*
+		 * A small ring of predicted guest return addresses, pushed by
+		 * translated calls and checked by translated returns. Entries refer
+		 * to translations in the owning cache, so the stack is reset
+		 * whenever the cache is.
+		 */
+		struct BlockReturnStackEntry {
+			uint64_t guest_pc;
+			block_txln_fn host_fn;
+		};
+
+		struct BlockReturnStack {
+			static const uint32_t kSize = 16;
+
+			uint64_t top;
+			BlockReturnStackEntry entries[kSize];
+		};
+
 // don't care how big the features set is though
 		class BlockFeaturesEntry
 		{
 		public:
-			BlockFeaturesEntry() : feature_required_mask(0), feature_level(0) {}
+			BlockFeaturesEntry() : virt_tag(1), feature_required_mask(0), feature_level(0), alt_ptr(nullptr), alt_required_mask(0), alt_level(0) {}
 
+			// The block which the entry's translations belong to. Unlike the
+			// cache entry's tag, this is kept when the entry is invalidated
+			// because of a feature change.
+			uint64_t virt_tag;
 			uint64_t feature_required_mask;
 			uint64_t feature_level;
+
+			// A translation of the same block for other feature levels, which
+			// is swapped in if the processor's features change to match it
+			block_txln_fn alt_ptr;
+			uint64_t alt_required_mask;
+			uint64_t alt_level;
 		};
 
 		class BlockCache
@@ -67,32 +103,85 @@ namespace archsim
 			void Insert(Address address, block_txln_fn ptr, const archsim::ProcessorFeatureSet &required_features)
 			{
 				auto &entry = GetEntry(address);
+				auto &features = GetFeatures(address);
+
+				if(features.virt_tag != address.Get()) {
+					untrackSlot(features.virt_tag, GetSlot(address));
+					trackSlot(address.Get(), GetSlot(address));
+				}
+
+				// Keep the feature dependent translation being replaced, so
+				// that it can be swapped back in when the features change back
+				if(features.virt_tag == address.Get()) {
+					if(entry.ptr != ptr && features.feature_required_mask != 0) {
+						features.alt_ptr = entry.ptr;
+						features.alt_required_mask = features.feature_required_mask;
+						features.alt_level = features.feature_level;
+					}
+				} else {
+					features.alt_ptr = nullptr;
+				}
+
 				entry.virt_tag = address.Get();
 				entry.ptr = ptr;
 
-				auto &features = GetFeatures(address);
+				features.virt_tag = address.Get();
 				features.feature_required_mask = required_features.GetRequiredMask();
 				features.feature_level = required_features.GetLevelMask();
+
+				if(features.alt_ptr == ptr) {
+					features.alt_ptr = nullptr;
+				}
+			}
+
+			bool HasFeatureRequirements(Address address) const
+			{
+				return GetFeatures(address).feature_required_mask != 0;
 			}
 
 			void Invalidate();
+			// Drop the blocks which start on the given virtual page
+			void InvalidatePage(Address page_base);
+			// Drop every reference to the given translations, e.g. because
+			// they have been freed
+			void InvalidateCode(const std::unordered_set<block_txln_fn> &txlns);
 
 			void InvalidateFeatures(uint64_t current_mask)
 			{
 				for(unsigned i = 0; i < kCacheSize; ++i) {
-					const auto &features = feature_cache_[i];
+					auto &entry = cache_[i];
+					auto &features = feature_cache_[i];
 					__builtin_prefetch((void*)&(cache_[i+1]));
 					__builtin_prefetch((void*)&(feature_cache_[i+1]));
-					if((current_mask & features.feature_required_mask) != features.feature_level) {
-						cache_[i].virt_tag = 1;
+					if((current_mask & features.feature_required_mask) == features.feature_level) {
+						// Entries dropped by an earlier feature change are
+						// valid again if the features have changed back
+						if(entry.virt_tag == 1) entry.virt_tag = features.virt_tag;
+					} else if(features.alt_ptr != nullptr && (current_mask & features.alt_required_mask) == features.alt_level) {
+						// The other version of the block matches the new
+						// features, so swap it in
+						std::swap(entry.ptr, features.alt_ptr);
+						std::swap(features.feature_required_mask, features.alt_required_mask);
+						std::swap(features.feature_level, features.alt_level);
+						entry.virt_tag = features.virt_tag;
+					} else {
+						entry.virt_tag = 1;
 					}
 				}
+
+				InvalidateReturnStack();
 			}
 
+			void InvalidateReturnStack();
+
 			struct BlockCacheEntry *GetPtr()
 			{
 				return cache_.data();
 			}
+			struct BlockReturnStack *GetReturnStackPtr()
+			{
+				return &return_stack_;
+			}
 
 			static const uint32_t kCacheBits = BLOCKCACHE_SIZE_BITS;
 			static const uint32_t kCacheSize = BLOCKCACHE_SIZE;
@@ -102,28 +191,43 @@ namespace archsim
 
 
 
+			static unsigned GetSlot(Address address)
+			{
+				return (address.Get() >> kInstructionShift) % kCacheSize;
+			}
 			const BlockCacheEntry &GetEntry(Address address) const
 			{
-				return cache_[(address.Get() >> kInstructionShift) % kCacheSize];
+				return cache_[GetSlot(address)];
 			}
 			BlockCacheEntry &GetEntry(Address address)
 			{
-				return cache_[(address.Get() >> kInstructionShift) % kCacheSize];
+				return cache_[GetSlot(address)];
 			}
 		private:
 			const BlockFeaturesEntry &GetFeatures(Address address) const
 			{
-				return feature_cache_[(address.Get() >> kInstructionShift) % kCacheSize];
+				return feature_cache_[GetSlot(address)];
 			}
 			BlockFeaturesEntry &GetFeatures(Address address)
 			{
-				return feature_cache_[(address.Get() >> kInstructionShift) % kCacheSize];
+				return feature_cache_[GetSlot(address)];
 			}
 
+			// Record which slots hold blocks on each virtual page, so that a
+			// page can be flushed without scanning the whole cache
+			void trackSlot(uint64_t virt_tag, unsigned slot);
+			void untrackSlot(uint64_t virt_tag, unsigned slot);
+
 			// We really want the BlockCacheEntry struct to be 16 bytes
 
 			std::array<BlockCacheEntry, kCacheSize> cache_;
 			std::array<BlockFeaturesEntry, kCacheSize> feature_cache_;
+
+			BlockReturnStack return_stack_;
+
+			static_assert(kCacheSize % 64 == 0, "Block cache size must be a multiple of 64");
+			typedef std::array<uint64_t, kCacheSize / 64> slot_set_t;
+			std::unordered_map<uint64_t, slot_set_t> page_slots_;
 		};
 
 	}
@@ -18,8 +18,11 @@
 
 #include "arch/arm/ARMDecodeContext.h"
 
+#include <functional>
 #include <unordered_set>
 #include <set>
+#include <utility>
+#include <vector>
 
 namespace captive
 {
@@ -53,6 +56,11 @@ namespace gensim
 		class BaseBlockJITTranslate
 		{
 		public:
+			// Called for each block emitted while profiling is enabled, to get
+			// the counter which the block should increment each time it is
+			// executed. May return null to leave the block unprofiled.
+			using block_profiler_t = std::function<uint64_t*(archsim::Address virt_pc, archsim::Address phys_pc, uint8_t isa_mode)>;
+
 			BaseBlockJITTranslate();
 			virtual ~BaseBlockJITTranslate();
 
@@ -60,6 +68,7 @@ namespace gensim
 
 			void setSupportChaining(bool enable);
 			void setSupportProfiling(bool enable);
+			void setBlockProfiler(const block_profiler_t &profiler);
 			void setTranslationMgr(archsim::translate::TranslationManager *txln_mgr);
 
 			void InitialiseFeatures(const archsim::core::thread::ThreadInstance *cpu);
@@ -85,6 +94,22 @@ namespace gensim
 				_decode_ctx = dec;
 			}
 
+			// Relocation information for the most recently translated block.
+			// A translation is only relocatable if it doesn't embed the
+			// addresses of any host data (e.g. profiling counters).
+			bool IsRelocatable() const
+			{
+				return _relocatable;
+			}
+			const std::vector<uint32_t> &GetHostRelocations() const
+			{
+				return _host_relocations;
+			}
+			const std::vector<std::pair<uint32_t, uint32_t>> &GetChainSlots() const
+			{
+				return _chain_slots;
+			}
+
 		private:
 
 			std::map<uint32_t, uint32_t> _feature_levels;
@@ -105,13 +130,22 @@ namespace gensim
 
 			archsim::translate::TranslationManager *_txln_mgr;
 			bool _supportProfiling;
+			block_profiler_t _block_profiler;
 
 			bool _should_be_dumped;
 
+			// The lines of the block's page which hold the translated code
+			uint64_t _code_lines;
+
+			bool _relocatable;
+			std::vector<uint32_t> _host_relocations;
+			std::vector<std::pair<uint32_t, uint32_t>> _chain_slots;
+
 			bool compile_block(archsim::core::thread::ThreadInstance *cpu, archsim::Address block_address, captive::arch::jit::TranslationContext &ctx, archsim::blockjit::BlockTranslation &fn, wulib::MemAllocator &allocator);
 
 			bool emit_block(archsim::core::thread::ThreadInstance *cpu, archsim::Address block_address, captive::shared::IRBuilder &ctx, std::unordered_set<archsim::Address> &block_heads);
 			bool emit_chain(archsim::core::thread::ThreadInstance *cpu, archsim::Address block_address, gensim::BaseDecode *insn, captive::shared::IRBuilder &ctx);
+			void emit_instruction_tick(archsim::core::thread::ThreadInstance *cpu, uint32_t count, captive::shared::IRBuilder &builder);
 
 			bool can_merge_jump(archsim::core::thread::ThreadInstance *cpu, gensim::BaseDecode *decode, archsim::Address pc);
 			archsim::Address get_jump_target(archsim::core::thread::ThreadInstance *cpu, gensim::BaseDecode *decode, archsim::Address pc);
@@ -0,0 +1,101 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * BlockLinker.h
+ *
+ * Keeps track of direct links (chains) between translated blocks.
+ */
+
+#ifndef INC_BLOCKJIT_BLOCKLINKER_H_
+#define INC_BLOCKJIT_BLOCKLINKER_H_
+
+#include "abi/Address.h"
+#include "blockjit/ir.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace archsim
+{
+	using captive::shared::block_txln_fn;
+
+	namespace blockjit
+	{
+
+		// The kinds of exit which can be passed to the dispatch instruction.
+		// Direct exits (same or cross page) are patched by the linker.
+		// Indirect exits and returns are looked up in the thread's block
+		// cache by the translated code itself. A call is not an exit, but
+		// pushes the fallthrough PC onto the return stack.
+		enum BlockChainExitKind {
+			ChainNone = 0,
+			ChainSamePage = 1,
+			ChainCrossPage = 2,
+			ChainIndirect = 3,
+			ChainReturn = 4,
+			ChainCall = 5
+		};
+
+		/*
+		 * A patchable exit, emitted inline in the translated code by the
+		 * dispatch lowering. The translated code leaves through an indirect
+		 * jump via Target, which initially points at a stub (Unlinked) that
+		 * reports the slot to the execution engine and returns. Linking the
+		 * exit to a translation is a single aligned 8 byte store to Target.
+		 */
+		struct BlockChainSlot {
+			enum SlotFlags {
+				CrossPage = 1
+			};
+
+			uint64_t Target;
+			uint64_t Unlinked;
+			uint64_t Source;
+			uint64_t GuestPC;
+			uint64_t Flags;
+		};
+
+		static_assert(sizeof(struct BlockChainSlot) == 40, "Block chain slot layout is shared with the dispatch lowering");
+
+		/*
+		 * Records which exit slots have been linked to which translations, so
+		 * that links can be undone before the translations they lead to are
+		 * invalidated. Not thread safe: callers must hold the lock protecting
+		 * the block profile which owns the linker.
+		 */
+		class BlockLinker
+		{
+		public:
+			void Link(BlockChainSlot *slot, block_txln_fn target, bool feature_dependent);
+
+			// Undo all links into the given translation
+			void UnlinkTarget(block_txln_fn target);
+			// Undo all links into and out of the given translation, since it
+			// is about to be freed
+			void Remove(block_txln_fn txln);
+
+			void UnlinkCrossPage();
+			// Undo cross page links to blocks on the given virtual page
+			void UnlinkCrossPageInto(Address page_base);
+			void UnlinkFeatureDependent();
+			void UnlinkAll();
+
+		private:
+			struct LinkInfo {
+				block_txln_fn Target;
+				bool FeatureDependent;
+			};
+
+			template<typename Pred> void unlinkIf(Pred pred);
+			void unlink(BlockChainSlot *slot);
+
+			std::unordered_map<BlockChainSlot*, LinkInfo> links_;
+			std::unordered_map<block_txln_fn, std::vector<BlockChainSlot*>> incoming_;
+			std::unordered_map<block_txln_fn, std::vector<BlockChainSlot*>> outgoing_;
+		};
+
+	}
+}
+
+#endif /* INC_BLOCKJIT_BLOCKLINKER_H_ */
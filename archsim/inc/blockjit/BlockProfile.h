@@ -11,6 +11,7 @@
 #define INC_BLOCKJIT_BLOCKPROFILE_H_
 
 #include "blockjit/ir.h"
+#include "blockjit/BlockLinker.h"
 #include "abi/Address.h"
 #include "util/MemAllocator.h"
 #include "util/LogContext.h"
@@ -22,6 +23,7 @@
 #include <map>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 UseLogContext(LogBlockProfile);
 
@@ -36,11 +38,12 @@ namespace archsim
 		class BlockTranslation
 		{
 		public:
-			BlockTranslation() : fn_(nullptr), features_required_(nullptr), size_(0) {}
+			BlockTranslation() : fn_(nullptr), features_required_(nullptr), size_(0), code_lines_(~0ULL) {}
 			BlockTranslation(const BlockTranslation &other) :
 				fn_(other.fn_),
 				features_required_(nullptr),
-				size_(other.size_)
+				size_(other.size_),
+				code_lines_(other.code_lines_)
 			{
 				if(other.features_required_ != nullptr) {
 					features_required_ = new ProcessorFeatureSet(*other.features_required_);
@@ -52,9 +55,13 @@ namespace archsim
 				Invalidate();
 			}
 
-			void operator=(const BlockTranslation &other)
+			BlockTranslation &operator=(const BlockTranslation &other)
 			{
-				new(this) BlockTranslation(other);
+				if(this != &other) {
+					Invalidate();
+					new(this) BlockTranslation(other);
+				}
+				return *this;
 			}
 
 			void AddRequiredFeature(uint32_t feature_id, uint32_t feature_level)
@@ -79,6 +86,9 @@ namespace archsim
 				return FeaturesValid(features);
 			}
 			bool FeaturesValid(const archsim::ProcessorFeatureSet &features) const;
+			// Whether this translation depends on exactly the same feature
+			// levels as another
+			bool HasSameFeatures(const BlockTranslation &other) const;
 
 			void Invalidate()
 			{
@@ -89,7 +99,7 @@ namespace archsim
 				}
 			}
 
-			archsim::ProcessorFeatureSet GetFeatures()
+			archsim::ProcessorFeatureSet GetFeatures() const
 			{
 				if(features_required_)
 					return *features_required_;
@@ -105,39 +115,146 @@ namespace archsim
 				return size_;
 			}
 
+			// The lines of the page (see CodeRegionTracker) which hold the
+			// guest code of this translation. Translations which don't know
+			// where their code came from cover the whole page.
+			void SetCodeLines(uint64_t lines)
+			{
+				code_lines_ = lines;
+			}
+			uint64_t GetCodeLines() const
+			{
+				return code_lines_;
+			}
+
 			void Dump(const std::string &filename);
 
 		private:
 			block_txln_fn fn_;
 			archsim::ProcessorFeatureSet *features_required_;
 			size_t size_;
+			uint64_t code_lines_;
 		};
 
 		class BlockPageProfile
 		{
 		public:
-			BlockPageProfile(wulib::MemAllocator &allocator);
+			BlockPageProfile(wulib::MemAllocator &allocator, BlockLinker &linker);
 			~BlockPageProfile();
 
+			// Add a translation of the block at the given address. Existing
+			// translations of the block which depend on different feature
+			// levels are kept, up to kMaxVersions of them.
 			void Insert(Address address, const BlockTranslation &txln);
+			// Invalidate every translation of the block at the given address
 			void InvalidateTxln(Address address);
 			void Invalidate();
 
-			BlockTranslation &Get(Address address)
+			// Invalidate the translations whose code overlaps a dirty line,
+			// and return how many were invalidated
+			size_t InvalidateDirty();
+
+			// Undo any chains into translations on this page
+			void Unlink();
+			// Undo any chains into translations which overlap the given lines
+			void Unlink(uint64_t lines);
+
+			// Get the page offsets of every block translated on this page
+			void GetBlockOffsets(std::vector<uint32_t> &offsets) const;
+
+			size_t GetCodeSize() const
 			{
-				return getChunk(address)[(address.GetPageOffset() >> kInstructionAlignment) % kBlocksPerChunk];
+				return _code_size;
+			}
+			size_t GetTxlnCount() const
+			{
+				return _txlns.size();
+			}
+
+			// Find the translation of the block at the given address which
+			// is valid for the given features, if there is one
+			BlockTranslation *Find(Address address, const archsim::ProcessorFeatureSet &features)
+			{
+				for(auto &txln : getVersions(address)) {
+					if(txln.IsValid(features)) return &txln;
+				}
+				return nullptr;
+			}
+
+			// Get the lines covered by every translation of the block at the
+			// given address
+			uint64_t GetCodeLines(Address address)
+			{
+				uint64_t lines = 0;
+				for(const auto &txln : getVersions(address)) {
+					lines |= txln.GetCodeLines();
+				}
+				return lines;
 			}
 
 			static const size_t kInstructionAlignment = 0;
 			static const uint32_t kInstructionSize = 1 << kInstructionAlignment;
 
+			// The most translations kept of a single block, for different
+			// feature levels
+			static const size_t kMaxVersions = 4;
+
 			bool IsDirty() const
 			{
-				return _dirty;
+				return _dirty_lines != 0;
 			}
 			void MakeDirty()
 			{
-				_dirty = true;
+				MakeDirty(~0ULL);
+			}
+			void MakeDirty(uint64_t lines)
+			{
+				_dirty_lines |= lines;
+			}
+			uint64_t GetDirtyLines() const
+			{
+				return _dirty_lines;
+			}
+
+			// The union of the lines covered by every translation on the page
+			uint64_t GetCodeLines() const
+			{
+				return _code_lines;
+			}
+
+			// Whether any translation on this page has been used since the
+			// page was last aged
+			bool IsReferenced() const
+			{
+				return _referenced;
+			}
+			void Touch()
+			{
+				_referenced = true;
+			}
+
+			// Shift the referenced bit into the top of the page's usage
+			// history, so that pages used in many recent periods are older
+			// than pages used only in the last one
+			void Age()
+			{
+				_age = (_age >> 1) | (_referenced ? 0x80 : 0);
+				_referenced = false;
+			}
+			uint8_t GetAge() const
+			{
+				return _age;
+			}
+
+			// Whether this page is in the set of pages considered for eviction
+			bool IsResident() const
+			{
+				return _resident;
+			}
+			void SetResident(bool resident)
+			{
+				_resident = resident;
+				_age = 0;
 			}
 
 		private:
@@ -146,7 +263,8 @@ namespace archsim
 			static const uint32_t kMaxBlocksPerPage = kPageSize / kInstructionSize;
 			static const uint32_t kBlocksPerChunk = 128;
 
-			typedef std::unordered_map<uint32_t, BlockTranslation> table_chunk_t;
+			typedef std::vector<BlockTranslation> txln_versions_t;
+			typedef std::unordered_map<uint32_t, txln_versions_t> table_chunk_t;
 
 			table_chunk_t *&getChunkPtr(Address address)
 			{
@@ -159,14 +277,45 @@ namespace archsim
 				return *ptr;
 			}
 
+			txln_versions_t &getVersions(Address address)
+			{
+				return getChunk(address)[(address.GetPageOffset() >> kInstructionAlignment) % kBlocksPerChunk];
+			}
+
+			// Free the code of a single translation, but leave it in the table
+			void freeTxln(BlockTranslation &txln);
+
 			std::array<table_chunk_t*, kMaxBlocksPerPage/kBlocksPerChunk> _table;
 
 			std::unordered_set<block_txln_fn> _txlns;
+			size_t _code_size;
+			uint64_t _code_lines;
+			uint64_t _dirty_lines;
 
 			wulib::MemAllocator &_allocator;
+			BlockLinker &_linker;
 
-			bool _dirty:1;
+			uint8_t _age;
 			bool _valid:1;
+			bool _referenced:1;
+			bool _resident:1;
+		};
+
+		struct BlockEvictionStats {
+			BlockEvictionStats() : Pages(0), Txlns(0), Bytes(0) {}
+
+			uint64_t Pages;
+			uint64_t Txlns;
+			uint64_t Bytes;
+		};
+
+		// Counts of translations on modified pages which were thrown away,
+		// and of those which were kept because their code was not modified
+		struct BlockCollectionStats {
+			BlockCollectionStats() : InvalidatedTxlns(0), PreservedTxlns(0) {}
+
+			uint64_t InvalidatedTxlns;
+			uint64_t PreservedTxlns;
 		};
 
 
@@ -175,10 +324,20 @@ namespace archsim
 		public:
 			BlockProfile(wulib::MemAllocator &allocator);
 
-			void Insert(Address address, const BlockTranslation &txln);
+			// Returns true if the block had previously been evicted
+			bool Insert(Address address, const BlockTranslation &txln);
 			void InvalidatePage(Address address);
 			void Invalidate();
 
+			// Free translations on pages which have not been used recently,
+			// until no more than target_size bytes of code remain
+			void Evict(uint64_t target_size, BlockEvictionStats &stats);
+
+			void Touch(Address address)
+			{
+				if(hasProfile(address)) getProfile(address).Touch();
+			}
+
 			uint64_t GetTotalCodeSize()
 			{
 				return code_size_;
@@ -188,28 +347,67 @@ namespace archsim
 			{
 				return getProfile(addr).IsDirty();
 			}
+			// Whether the translation at the given address overlaps code which
+			// has been modified
+			bool IsTxlnDirty(Address addr)
+			{
+				auto &profile = getProfile(addr);
+				return (profile.GetCodeLines(addr) & profile.GetDirtyLines()) != 0;
+			}
 			void MarkPageDirty(Address addr)
 			{
-				LC_DEBUG1(LogBlockProfile) << "Marking page " << std::hex << addr.GetPageBase() << " as dirty";
-				getProfile(addr).MakeDirty();
-				_dirty_pages.push_back({addr.PageBase(), &getProfile(addr)});
+				MarkLinesDirty(addr, ~0ULL);
+			}
+			void MarkLinesDirty(Address addr, uint64_t lines)
+			{
+				auto &profile = getProfile(addr);
+
+				// Writes which miss every translation on the page can be
+				// ignored, and several threads may report the same lines, so
+				// only handle each line once
+				lines &= profile.GetCodeLines() & ~profile.GetDirtyLines();
+				if(!lines) return;
+
+				LC_DEBUG1(LogBlockProfile) << "Marking lines " << std::hex << lines << " of page " << addr.GetPageBase() << " as dirty";
+				bool queued = profile.IsDirty();
+				profile.MakeDirty(lines);
+				// Chained code must stop entering the modified translations
+				// straight away, even though they are not freed until the
+				// next collection
+				profile.Unlink(lines);
+				if(!queued) _dirty_pages.push_back({addr.PageBase(), &profile});
+			}
+
+			// Undo all links into translations on the given page, so that
+			// the page is entered through the dispatcher again
+			void UnlinkPage(Address addr)
+			{
+				if(hasProfile(addr)) getProfile(addr).Unlink();
 			}
 
-			void GarbageCollect();
+			void GarbageCollect(BlockCollectionStats &stats);
+
+			BlockLinker &GetLinker()
+			{
+				return _linker;
+			}
 
 			// XXX ARM HAX
 			static const size_t kInstructionSize = BlockPageProfile::kInstructionSize;
 
+			// Get the translation of the block which is valid for the given
+			// features. Translations for other feature levels are kept, so
+			// that switching back to them doesn't need a retranslation.
 			BlockTranslation Get(Address address, const archsim::ProcessorFeatureSet &features)
 			{
-				auto txln = getProfile(address).Get(address);
+				auto &profile = getProfile(address);
+				auto txln = profile.Find(address, features);
 
-				if(txln.IsValid(features)) {
-					return txln;
-				} else {
-					getProfile(address).InvalidateTxln(address);
-					return txln;
+				if(txln != nullptr) {
+					profile.Touch();
+					return *txln;
 				}
+				return BlockTranslation();
 			}
 
 		private:
@@ -223,7 +421,7 @@ namespace archsim
 			BlockPageProfile &getProfile(Address address)
 			{
 				if(!hasProfile(address)) {
-					_page_profiles[address.GetPageIndex()] = new BlockPageProfile(_allocator);
+					_page_profiles[address.GetPageIndex()] = new BlockPageProfile(_allocator, _linker);
 				}
 				return *_page_profiles[address.GetPageIndex()];
 			}
@@ -236,10 +434,23 @@ namespace archsim
 
 			std::vector<std::pair<Address, BlockPageProfile *> > _dirty_pages;
 
+			// Pages which contain code, in the order they were translated
+			std::vector<Address> _resident_pages;
+			// Physical addresses of blocks which were evicted by the latest
+			// eviction (and the one before it) and not yet retranslated.
+			// Older evictions are forgotten, so that blocks which are never
+			// retranslated do not build up over a long run.
+			std::unordered_set<uint64_t> _evicted_blocks;
+			std::unordered_set<uint64_t> _older_evicted_blocks;
+
 			uint64_t code_size_;
+			// Translations collected early because their page was
+			// retranslated before the next garbage collection
+			BlockCollectionStats _early_collection;
 
 			BlockPageProfile *_page_profiles[kProfileCount];
 			wulib::MemAllocator &_allocator;
+			BlockLinker _linker;
 		};
 
 	}
@@ -0,0 +1,121 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * BlockTranslationStore.h
+ *
+ * Keeps block translations between simulation runs.
+ */
+
+#ifndef INC_BLOCKJIT_BLOCKTRANSLATIONSTORE_H_
+#define INC_BLOCKJIT_BLOCKTRANSLATIONSTORE_H_
+
+#include "blockjit/BlockProfile.h"
+#include "core/thread/ProcessorFeatures.h"
+#include "util/MemAllocator.h"
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace archsim
+{
+	namespace blockjit
+	{
+
+		struct BlockTranslationKey {
+			uint64_t PhysicalPC;
+			uint64_t VirtualPC;
+			uint32_t IsaMode;
+
+			bool operator==(const BlockTranslationKey &other) const
+			{
+				return PhysicalPC == other.PhysicalPC && VirtualPC == other.VirtualPC && IsaMode == other.IsaMode;
+			}
+		};
+
+		struct BlockTranslationKeyHash {
+			size_t operator()(const BlockTranslationKey &key) const
+			{
+				return std::hash<uint64_t>()(key.PhysicalPC ^ (key.VirtualPC << 1) ^ ((uint64_t)key.IsaMode << 56));
+			}
+		};
+
+		/*
+		 * A store of relocatable block translations, which can be saved to
+		 * and loaded from a file.
+		 *
+		 * Each translation is stored with the checksum of the guest page it
+		 * was translated from, and with the feature levels it depends on.
+		 * Embedded host addresses are stored relative to the host module
+		 * (executable or shared library) which contains them, and are
+		 * relocated when a translation is restored. A file is only loaded if
+		 * its signature matches, which should cover everything else the
+		 * translated code depends on (e.g. the state block layout).
+		 *
+		 * Translations are validated lazily, as they are looked up.
+		 */
+		class BlockTranslationStore
+		{
+		public:
+			typedef std::vector<std::pair<uint32_t, uint32_t>> chain_slot_list_t;
+
+			BlockTranslationStore(uint64_t signature);
+
+			bool Load(const std::string &filename);
+			bool Save(const std::string &filename);
+
+			// Keep a copy of a newly lowered translation
+			void Record(const BlockTranslationKey &key, uint64_t page_checksum, const BlockTranslation &txln, const std::vector<uint32_t> &host_relocations, const chain_slot_list_t &chain_slots);
+
+			// Whether there are any stored translations for the given block,
+			// so that callers can avoid checksumming pages unnecessarily
+			bool Has(const BlockTranslationKey &key);
+
+			// Copy a stored translation into newly allocated code memory, if
+			// there is one which is valid for the given page contents and
+			// features
+			bool Restore(const BlockTranslationKey &key, uint64_t page_checksum, const archsim::ProcessorFeatureSet &features, wulib::MemAllocator &allocator, BlockTranslation &txln);
+
+			static uint64_t Checksum(const uint8_t *data, size_t size);
+
+		private:
+			struct HostModule {
+				std::string Name;
+				uint64_t FileSize;
+				uint64_t FileTime;
+				// The current load address of the module, or 0 if it is not
+				// loaded (or has changed since the store was saved)
+				uint64_t Base;
+			};
+
+			struct Relocation {
+				uint32_t Offset;
+				uint32_t Module;
+				uint64_t ModuleOffset;
+			};
+
+			struct Entry {
+				uint64_t PageChecksum;
+				std::vector<std::pair<uint32_t, uint32_t>> Features;
+				std::vector<uint8_t> Code;
+				std::vector<Relocation> Relocations;
+				chain_slot_list_t ChainSlots;
+			};
+
+			bool getModuleFor(uint64_t address, uint32_t &module, uint64_t &module_offset);
+			void addEntry(const BlockTranslationKey &key, Entry &&entry);
+
+			uint64_t signature_;
+			std::vector<HostModule> modules_;
+			std::unordered_map<BlockTranslationKey, std::vector<Entry>, BlockTranslationKeyHash> entries_;
+
+			std::mutex lock_;
+		};
+
+	}
+}
+
+#endif /* INC_BLOCKJIT_BLOCKTRANSLATIONSTORE_H_ */
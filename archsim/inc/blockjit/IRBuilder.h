@@ -10,6 +10,8 @@
 #ifndef IRBUILDER_H
 #define IRBUILDER_H
 
+#include "libtrace/RecordTypes.h"
+
 #include <cassert>
 
 namespace captive
@@ -80,7 +82,21 @@ namespace captive
 			INSN3(cmov, CMOV);
 
 			INSN2(count, COUNT);
-//			INSN2(profile);
+			INSN1(profile, PROFILE);
+
+			// Write a record straight into the thread's trace buffer. An 8
+			// byte value also writes a data extension record holding its
+			// top half.
+			void trace(libtrace::TraceRecordType type, uint16_t data16, const IROperand &value)
+			{
+				trace(type, data16, IROperand::const8(0), value);
+			}
+			// As above, but with the bottom byte of the record's 16 bit data
+			// field taken from an operand (e.g. a register index)
+			void trace(libtrace::TraceRecordType type, uint16_t data16, const IROperand &index, const IROperand &value)
+			{
+				add_instruction(IRInstruction::trace(IROperand::const32(((uint32_t)type << 24) | data16), index, value));
+			}
 //			INSN1(verify);
 			INSN1(ldpc, LDPC);
 
@@ -115,6 +115,7 @@ namespace captive
 
 				TAKE_EXCEPTION,
 				PROFILE,
+				TRACE,
 
 				CMPSGT,
 				CMPSGTE,
@@ -221,9 +222,14 @@ namespace captive
 			{
 				return IRInstruction(COUNT, pointer, count);
 			}
-			static IRInstruction profile(const IROperand &pointer, const IROperand &block_offset)
+			static IRInstruction profile(const IROperand &counter)
 			{
-				return IRInstruction(PROFILE, pointer, block_offset);
+				return IRInstruction(PROFILE, counter);
+			}
+			static IRInstruction trace(const IROperand &header, const IROperand &index, const IROperand &value)
+			{
+				assert(header.is_constant());
+				return IRInstruction(TRACE, header, index, value);
 			}
 
 			static IRInstruction ldpc(const IROperand &dst)
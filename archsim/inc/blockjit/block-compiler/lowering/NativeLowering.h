@@ -17,6 +17,8 @@
 #include "util/MemAllocator.h"
 
 #include <string.h>
+#include <utility>
+#include <vector>
 
 namespace captive
 {
@@ -35,6 +37,11 @@ namespace captive
 
 					captive::shared::block_txln_fn Function;
 					size_t Size;
+
+					// Offsets of 64-bit host addresses embedded in the code
+					std::vector<uint32_t> HostRelocations;
+					// Offsets of block chain slots, and of their exit stubs
+					std::vector<std::pair<uint32_t, uint32_t>> ChainSlots;
 				};
 
 				LoweringResult NativeLowering(TranslationContext &ctx, wulib::MemAllocator &allocator, const archsim::ArchDescriptor &arch, const archsim::StateBlockDescriptor &state, const CompileResult &compile_result);
@@ -50,6 +50,8 @@ LowerType(ZNFlags)
 LowerType(TakeException)
 LowerType(Verify)
 LowerType(Count)
+LowerType(Profile)
+LowerType(Trace)
 
 LowerType(ReadMemGeneric)
 LowerType(WriteMemGeneric)
@@ -13,6 +13,7 @@
 #include "define.h"
 #include "util/MemAllocator.h"
 #include <malloc.h>
+#include <vector>
 
 namespace captive
 {
@@ -216,6 +217,10 @@ namespace captive
 						void mov(const X86Memory& src, const X86Register& dst);
 						void mov(const X86Register& src, const X86Memory& dst);
 						void mov(uint64_t src, const X86Register& dst);
+						// Load the address of a host function or object, and
+						// record where it was emitted so that the code can be
+						// relocated
+						void mov_host_ptr(const void *src, const X86Register& dst);
 
 						void movfs(uint32_t off, const X86Register& dst);
 
@@ -308,6 +313,11 @@ namespace captive
 						void jmp_reloc(uint32_t& reloc_offset);
 						void jmp_short_reloc(uint32_t& reloc_offset);
 
+						// RIP relative forms, where the displacement is filled in later
+						// relative to the end of the instruction (reloc_offset + 4)
+						void jmp_rip_reloc(uint32_t& reloc_offset);
+						void lea_rip_reloc(const X86Register& dst, uint32_t& reloc_offset);
+
 						void jcc_reloc(uint8_t v, uint32_t& reloc_offset);
 						void jcc_short_reloc(uint8_t v, uint32_t& reloc_offset);
 
@@ -670,7 +680,11 @@ namespace captive
 						void nop(uint8_t bytes);
 						void nop(const X86Memory& mem);
 
+						// Prefix the next instruction with LOCK
+						void lock();
+
 						void align_up(uint8_t amount_to_align);
+						void data64(uint64_t value);
 
 						uint32_t current_offset() const
 						{
@@ -687,6 +701,13 @@ namespace captive
 							_support_relocation = enabled;
 						}
 
+						// The offsets of every 64-bit host address emitted
+						// by mov_host_ptr
+						const std::vector<uint32_t> &get_host_relocations() const
+						{
+							return _host_relocations;
+						}
+
 					private:
 						uint8_t *_buffer;
 						uint32_t _buffer_size;
@@ -695,6 +716,7 @@ namespace captive
 						wulib::MemAllocator &_allocator;
 
 						bool _support_relocation;
+						std::vector<uint32_t> _host_relocations;
 
 						inline void ensure_buffer(int extra=0)
 						{
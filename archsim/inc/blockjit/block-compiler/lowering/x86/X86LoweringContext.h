@@ -155,6 +155,19 @@ namespace captive
 						void EmitEpilogue();
 
 						bool ABICalleeSave(const X86Register &reg);
+
+						// Patchable block exits emitted by the dispatch lowering.
+						// These need fixing up once the code has reached its final
+						// location.
+						typedef std::pair<offset_t, offset_t> chain_slot_t;
+						void RegisterChainSlot(offset_t slot_offset, offset_t stub_offset)
+						{
+							_chain_slots.push_back({slot_offset, stub_offset});
+						}
+						const std::vector<chain_slot_t> &GetChainSlots() const
+						{
+							return _chain_slots;
+						}
 					protected:
 						virtual bool LowerHeader(const TranslationContext &ctx) override;
 						virtual bool PerformRelocations(const TranslationContext &ctx) override;
@@ -172,6 +185,8 @@ namespace captive
 						};
 						std::vector<struct reg_assignment> register_assignments;
 
+						std::vector<chain_slot_t> _chain_slots;
+
 					};
 
 				}
@@ -104,7 +104,10 @@ namespace archsim
 			virtual ~LoopThread();
 
 			void stop();
-			void interrupt();
+
+			// Wake the thread if it is blocked in tick(), so that it notices
+			// it should terminate
+			virtual void interrupt();
 
 			virtual void run() override;
 
@@ -100,6 +100,10 @@ namespace archsim
 
 		virtual void Lock() = 0;
 		virtual void Unlock() = 0;
+
+		// Get host pointers covering a range of addresses, if the device
+		// can be accessed directly
+		virtual bool LockSpans(Address address, size_t size, bool is_write, archsim::abi::memory::host_span_list_t &spans);
 	};
 
 	class LegacyMemoryInterface : public MemoryDevice
@@ -126,6 +130,10 @@ namespace archsim
 		{
 			mem_model_.Unlock();
 		}
+		bool LockSpans(Address address, size_t size, bool is_write, archsim::abi::memory::host_span_list_t &spans) override
+		{
+			return mem_model_.LockSpans(address, size, is_write ? archsim::abi::memory::LockWrite : archsim::abi::memory::LockRead, spans);
+		}
 
 	private:
 		archsim::abi::memory::MemoryModel &mem_model_;
@@ -166,6 +174,10 @@ namespace archsim
 		{
 			mem_model_.Unlock();
 		}
+		bool LockSpans(Address address, size_t size, bool is_write, archsim::abi::memory::host_span_list_t &spans) override
+		{
+			return mem_model_.LockSpans(address, size, is_write ? archsim::abi::memory::LockWrite : archsim::abi::memory::LockRead, spans);
+		}
 
 		void Invalidate();
 
@@ -274,6 +286,15 @@ namespace archsim
 		MemoryResult Read(Address address, unsigned char *data, size_t size);
 		MemoryResult Write(Address address, const unsigned char *data, size_t size);
 
+		// Get host pointers covering a range of guest memory, so that it can
+		// be copied without going through the device one access at a time.
+		// Returns false if the range can't be accessed directly, in which
+		// case the caller should fall back to Read and Write.
+		bool LockSpans(Address address, size_t size, bool is_write, archsim::abi::memory::host_span_list_t &spans)
+		{
+			return device_->LockSpans(address, size, is_write, spans);
+		}
+
 		TranslationResult PerformTranslation(Address virtual_address, Address &physical_address, bool is_write, bool is_fetch, bool side_effects)
 		{
 			return provider_->Translate(virtual_address, physical_address, is_write, is_fetch, side_effects);
@@ -306,6 +327,14 @@ namespace archsim
 			monitor_ = new_monitor;
 		}
 
+		// Plain stores clear other threads' reservations on the written line
+		void NotifyWrite(archsim::core::thread::ThreadInstance *thread, Address address)
+		{
+			if(monitor_ != nullptr && monitor_->HasReservations(address)) {
+				monitor_->Notify(thread, address);
+			}
+		}
+
 	private:
 		const MemoryInterfaceDescriptor &descriptor_;
 		MemoryTranslationProvider *provider_;
@@ -4,8 +4,9 @@
 
 #include "core/thread/ThreadInstance.h"
 
-#include <map>
+#include <atomic>
 #include <mutex>
+#include <vector>
 
 namespace archsim
 {
@@ -18,6 +19,10 @@ namespace archsim
 		class MemoryMonitor
 		{
 		public:
+			static const uint32_t kLineBits = 6;
+			static const uint32_t kBucketCount = 256;
+
+			MemoryMonitor();
 			virtual ~MemoryMonitor() = default;
 
 			// Inform the monitor that given thread wants to acquire a monitor on the given address
@@ -34,11 +39,44 @@ namespace archsim
 
 			virtual void Lock(archsim::core::thread::ThreadInstance *thread) = 0;
 			virtual void Unlock(archsim::core::thread::ThreadInstance *thread) = 0;
+
+			static uint32_t GetBucketIndex(Address addr)
+			{
+				return (addr.Get() >> kLineBits) % kBucketCount;
+			}
+
+			// Whether any thread might hold a reservation on a line in the
+			// same bucket as the given address. Plain stores check this
+			// before calling Notify, so stores to unreserved lines are cheap.
+			bool HasReservations(Address addr) const
+			{
+				uint32_t bucket = GetBucketIndex(addr);
+				return (reserved_[bucket / 64].load(std::memory_order_relaxed) >> (bucket % 64)) & 1;
+			}
+
+		protected:
+			// Implementations must set the bit for each bucket holding a
+			// reservation, or Notify will not be called for plain stores
+			std::atomic<uint64_t> reserved_[kBucketCount / 64];
 		};
 
+		/*
+		 * Reservations are hashed by cache line into buckets, each with its
+		 * own lock, so exclusive accesses to different lines never contend.
+		 * A bitmap records which buckets hold reservations, so that a write
+		 * to a line nobody has reserved does not need to take any lock.
+		 *
+		 * Lock and Unlock still exclude every other thread, for locked
+		 * read-modify-write sequences: a thread holding the lock waits for
+		 * any exclusive stores in flight, and new ones wait for it.
+		 */
 		class BaseMemoryMonitor : public MemoryMonitor
 		{
 		public:
+			static const uint32_t kMaxThreads = 256;
+
+			BaseMemoryMonitor();
+
 			virtual void AcquireMonitor(archsim::core::thread::ThreadInstance *thread, Address addr);
 			virtual bool LockMonitor(archsim::core::thread::ThreadInstance *thread, Address addr);
 			virtual void UnlockMonitor(archsim::core::thread::ThreadInstance *thread, Address addr);
@@ -48,12 +86,44 @@ namespace archsim
 			virtual void Unlock(archsim::core::thread::ThreadInstance *thread);
 
 		private:
-			// Map of thread ID to monitored address
-			std::map<int, Address> monitors_;
+			struct ThreadState;
+
+			struct alignas(64) Bucket {
+				std::atomic<bool> Locked;
+
+				// Threads with a reservation on a line in this bucket
+				std::vector<ThreadState*> Reservations;
+			};
+
+			struct ThreadState {
+				int ThreadID;
+
+				// Only valid while the bucket for the reserved address is
+				// locked, since other threads clear reservations
+				Address Reservation;
+				bool HasReservation;
+
+				// Only used by the owning thread
+				Bucket *HeldBucket;
+				bool HoldsExclusive;
+			};
+
+			ThreadState &getThreadState(archsim::core::thread::ThreadInstance *thread);
+
+			void lockBucket(Bucket &bucket);
+			void lockBucketForStore(Bucket &bucket, const ThreadState &state);
+			void unlockBucket(Bucket &bucket);
+
+			void addReservation(uint32_t bucket_index, ThreadState &state);
+			void removeReservation(uint32_t bucket_index, ThreadState &state);
+			void releaseAll(ThreadState &state);
+
+			Bucket buckets_[kBucketCount];
+			ThreadState threads_[kMaxThreads];
 
-			std::mutex lock_;
-			archsim::core::thread::ThreadInstance *locked_thread_;
+			std::mutex exclusive_lock_;
+			std::atomic<bool> exclusive_active_;
 		};
 
 	}
-}
\ No newline at end of file
+}
@@ -13,6 +13,14 @@
 #include "ExecutionEngine.h"
 #include "blockjit/BlockCache.h"
 #include "blockjit/BlockProfile.h"
+#include "blockjit/BlockLinker.h"
+#include "blockjit/BlockTranslationStore.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
 
 namespace archsim
 {
@@ -21,6 +29,121 @@ namespace archsim
 		namespace execution
 		{
 
+			/*
+			 * Per-thread state for the basic JIT engines. Each thread gets a
+			 * private dispatch cache (virtual PC -> translation) which is only
+			 * ever touched by the thread itself, so the dispatch path needs
+			 * no synchronisation. Other threads request flushes of this cache
+			 * by setting bits in the pending flush mask.
+			 */
+			class BasicJITExecutionEngineThreadContext : public ExecutionEngineThreadContext
+			{
+			public:
+				enum PendingFlush {
+					FlushNone = 0,
+					FlushCache = 1,
+					FlushFeatures = 2,
+					// Set by translated code once the thread's profiling
+					// budget has run out
+					ProfileDue = archsim::blockjit::kPendingProfile,
+					// Only the pages queued with RequestPageFlush need to
+					// be dropped
+					FlushPages = 8
+				};
+
+				BasicJITExecutionEngineThreadContext(ExecutionEngine *engine, thread::ThreadInstance *thread);
+				virtual ~BasicJITExecutionEngineThreadContext();
+
+				archsim::blockjit::BlockCache &GetBlockCache()
+				{
+					return block_cache_;
+				}
+
+				void RequestFlush(PendingFlush flush)
+				{
+					__atomic_fetch_or(pending_flush_, flush, __ATOMIC_RELEASE);
+				}
+				bool HasPendingFlush() const
+				{
+					return __atomic_load_n(pending_flush_, __ATOMIC_RELAXED) != FlushNone;
+				}
+				void RequestPageFlush(Address page_base)
+				{
+					{
+						std::lock_guard<std::mutex> lg(pending_pages_lock_);
+						pending_pages_.push_back(page_base.PageBase());
+					}
+					RequestFlush(FlushPages);
+				}
+				std::vector<Address> TakePendingPages()
+				{
+					std::lock_guard<std::mutex> lg(pending_pages_lock_);
+					std::vector<Address> pages;
+					pages.swap(pending_pages_);
+					return pages;
+				}
+				uint32_t TakePendingFlush()
+				{
+					return __atomic_exchange_n(pending_flush_, (uint32_t)FlushNone, __ATOMIC_ACQ_REL);
+				}
+				void SetPendingFlush(uint32_t *pending_flush)
+				{
+					pending_flush_ = pending_flush;
+				}
+
+				uint64_t GetCodeEpoch() const
+				{
+					return code_epoch_;
+				}
+				void SetCodeEpoch(uint64_t epoch)
+				{
+					code_epoch_ = epoch;
+				}
+
+				wulib::EpochMemAllocator::reader_slot_t &GetReaderSlot()
+				{
+					return reader_slot_;
+				}
+
+				// The state block entry through which unlinked block exits
+				// are reported, or null if the engine doesn't chain blocks
+				archsim::blockjit::BlockChainSlot **GetChainExit()
+				{
+					return chain_exit_;
+				}
+				void SetChainExit(archsim::blockjit::BlockChainSlot **chain_exit)
+				{
+					chain_exit_ = chain_exit;
+				}
+
+			private:
+				archsim::blockjit::BlockCache block_cache_;
+				uint32_t *pending_flush_;
+
+				std::mutex pending_pages_lock_;
+				std::vector<Address> pending_pages_;
+
+				uint64_t code_epoch_;
+				wulib::EpochMemAllocator::reader_slot_t reader_slot_;
+
+				archsim::blockjit::BlockChainSlot **chain_exit_;
+			};
+
+			/*
+			 * Base class for JIT engines which translate and execute one block
+			 * at a time. Translations are shared between all attached threads
+			 * and are indexed by physical address in the block profile, which
+			 * is protected by the profile lock. Translated code is allocated
+			 * from an epoch allocator, so code invalidated by one thread is
+			 * not reused until every other thread has dropped its dispatch
+			 * cache references to it. Each thread only drops the entries
+			 * for the code which has actually been freed.
+			 *
+			 * Engines which support chaining emit patchable exits in their
+			 * translations. When a block leaves through an unlinked exit, the
+			 * exit is linked directly to the next block, and links are undone
+			 * (under the profile lock) whenever their target is invalidated.
+			 */
 			class BasicJITExecutionEngine : public ExecutionEngine
 			{
 			public:
@@ -28,42 +151,80 @@ namespace archsim
 
 				ExecutionResult Execute(ExecutionEngineThreadContext* thread) override;
 
-				virtual ExecutionEngineThreadContext* GetNewContext(thread::ThreadInstance* thread) = 0;
+				ExecutionEngineThreadContext* GetNewContext(thread::ThreadInstance* thread) override;
 
 				void FlushTxlns();
-				void FlushTxlnsFeature();
-				void FlushTxlnCache();
 				void FlushAllTxlns();
 				void InvalidateRegion(Address addr);
+				void InvalidateLines(Address page_base, uint64_t lines);
+				void UnlinkCrossPage();
+				void UnlinkCrossPageInto(Address page_base);
+				void UnlinkFeatureDependent();
 
 			protected:
-				virtual bool translateBlock(thread::ThreadInstance *thread, archsim::Address block_pc, bool support_chaining, bool support_profiling) = 0;
-				virtual bool lookupBlock(thread::ThreadInstance *thread, Address addr, captive::shared::block_txln_fn &);
+				virtual bool translateBlock(BasicJITExecutionEngineThreadContext *ctx, archsim::Address block_pc, bool support_chaining, bool support_profiling) = 0;
+				virtual bool lookupBlock(BasicJITExecutionEngineThreadContext *ctx, Address addr, captive::shared::block_txln_fn &);
+				virtual bool supportsChaining() const
+				{
+					return false;
+				}
+				virtual bool supportsTranslationStore() const
+				{
+					return false;
+				}
 
-				void checkFlushTxlns();
-				void checkCodeSize();
-				void registerTranslation(Address phys_addr, Address virt_addr, archsim::blockjit::BlockTranslation &txln);
+				// Called at a safepoint when translated code has requested
+				// that profiling data be collected
+				virtual void profileTranslations(BasicJITExecutionEngineThreadContext *ctx) { }
+				// Whether an exit may be linked directly to the given target
+				virtual bool canLinkBlock(BasicJITExecutionEngineThreadContext *ctx, captive::shared::block_txln_fn target)
+				{
+					return true;
+				}
+				// Drop every entry in the thread's dispatch caches
+				virtual void flushDispatchCache(BasicJITExecutionEngineThreadContext *ctx);
+				// Drop the entries for a single virtual page from the
+				// thread's dispatch caches
+				virtual void flushDispatchPage(BasicJITExecutionEngineThreadContext *ctx, Address page_base);
+				// Drop the entries for the given translations from the
+				// thread's dispatch caches, since they have been freed
+				virtual void flushDispatchCode(BasicJITExecutionEngineThreadContext *ctx, const std::unordered_set<captive::shared::block_txln_fn> &txlns);
+
+				void checkFlushTxlns(BasicJITExecutionEngineThreadContext *ctx);
+				// Called once after a batch of translations has been freed
+				void retireFreedCode();
+				void checkCodeSize(BasicJITExecutionEngineThreadContext *ctx);
+				void registerTranslation(BasicJITExecutionEngineThreadContext *ctx, Address phys_addr, Address virt_addr, archsim::blockjit::BlockTranslation &txln);
+				void linkBlock(BasicJITExecutionEngineThreadContext *ctx, archsim::blockjit::BlockChainSlot *slot, Address target_pc, captive::shared::block_txln_fn target);
+				void unlinkPage(Address phys_addr);
+				void storeTranslation(BasicJITExecutionEngineThreadContext *ctx, Address phys_addr, Address virt_addr, const archsim::blockjit::BlockTranslation &txln, const std::vector<uint32_t> &host_relocations, const archsim::blockjit::BlockTranslationStore::chain_slot_list_t &chain_slots);
 
 				wulib::MemAllocator &GetMemAllocator()
 				{
-					return mem_allocator_;
+					return code_allocator_;
 				}
 
 			private:
-				template<typename PC_t> ExecutionResult ExecuteLoop(ExecutionEngineThreadContext *ctx, PC_t* pc_ptr);
-				template<typename PC_t> void ExecuteInnerLoop(ExecutionEngineThreadContext *ctx, PC_t* pc_ptr);
+				template<typename PC_t> ExecutionResult ExecuteLoop(BasicJITExecutionEngineThreadContext *ctx, PC_t* pc_ptr);
+				template<typename PC_t> void ExecuteInnerLoop(BasicJITExecutionEngineThreadContext *ctx, PC_t* pc_ptr);
+
+				void openTranslationStore(BasicJITExecutionEngineThreadContext *ctx);
+				bool restoreTranslation(BasicJITExecutionEngineThreadContext *ctx, Address phys_addr, Address virt_addr, captive::shared::block_txln_fn &fn);
+				bool checksumPage(BasicJITExecutionEngineThreadContext *ctx, Address virt_addr, uint64_t &checksum);
 
-				archsim::blockjit::BlockProfile phys_block_profile_;
-				archsim::blockjit::BlockCache virt_block_cache_;
 				wulib::SimpleZoneMemAllocator mem_allocator_;
+				wulib::EpochMemAllocator code_allocator_;
 
-				uint64_t max_code_size_;
+				std::mutex profile_lock_;
+				archsim::blockjit::BlockProfile phys_block_profile_;
 
-				bool flush_txlns_;
-				bool flush_all_txlns_;
-				bool subscribed_;
+				uint64_t max_code_size_;
 
+				std::atomic<bool> flush_txlns_;
+				std::atomic<bool> flush_all_txlns_;
 
+				std::unique_ptr<archsim::blockjit::BlockTranslationStore> translation_store_;
+				std::atomic<uint32_t> active_threads_;
 			};
 
 		}
@@ -21,34 +21,58 @@
 #include "blockjit/BlockCache.h"
 #include "module/ModuleManager.h"
 
+#include <functional>
+#include <memory>
+
 namespace archsim
 {
 	namespace core
 	{
 		namespace execution
 		{
-			class BlockJITExecutionEngine : public BasicJITExecutionEngine
+			/*
+			 * Each thread owns its own translator, so that different blocks
+			 * can be translated concurrently by different threads.
+			 */
+			class BlockJITExecutionEngineThreadContext : public BasicJITExecutionEngineThreadContext
 			{
 			public:
-
-				BlockJITExecutionEngine(gensim::blockjit::BaseBlockJITTranslate *translator);
-
+				BlockJITExecutionEngineThreadContext(ExecutionEngine *engine, thread::ThreadInstance *thread, gensim::blockjit::BaseBlockJITTranslate *translator);
 
 				gensim::blockjit::BaseBlockJITTranslate *GetTranslator()
 				{
-					return translator_;
+					return translator_.get();
 				}
 
+			private:
+				std::unique_ptr<gensim::blockjit::BaseBlockJITTranslate> translator_;
+			};
+
+			class BlockJITExecutionEngine : public BasicJITExecutionEngine
+			{
+			public:
+				using translator_factory_t = std::function<gensim::blockjit::BaseBlockJITTranslate*()>;
+
+				BlockJITExecutionEngine(translator_factory_t translator_factory);
+
 				ExecutionEngineThreadContext* GetNewContext(thread::ThreadInstance* thread) override;
 
-				virtual bool translateBlock(thread::ThreadInstance *thread, archsim::Address block_pc, bool support_chaining, bool support_profiling);
+				virtual bool translateBlock(BasicJITExecutionEngineThreadContext *ctx, archsim::Address block_pc, bool support_chaining, bool support_profiling);
+				bool supportsChaining() const override
+				{
+					return true;
+				}
+				bool supportsTranslationStore() const override
+				{
+					return true;
+				}
 
 
 				gensim::DecodeContext *decode_context_;
 				gensim::DecodeTranslateContext *decode_translation_context_;
 
 
-				gensim::blockjit::BaseBlockJITTranslate *translator_;
+				translator_factory_t translator_factory_;
 
 				static ExecutionEngine *Factory(const archsim::module::ModuleInfo *module, const std::string &cpu_prefix);
 			};
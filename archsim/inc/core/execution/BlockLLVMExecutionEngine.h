@@ -39,8 +39,6 @@ namespace archsim
 
 				BlockLLVMExecutionEngine(gensim::BaseLLVMTranslate *translator);
 
-				ExecutionEngineThreadContext* GetNewContext(thread::ThreadInstance* thread) override;
-
 				static ExecutionEngine *Factory(const archsim::module::ModuleInfo *module, const std::string &cpu_prefix);
 
 				llvm::LLVMContext &GetContext()
@@ -49,7 +47,7 @@ namespace archsim
 				}
 
 			protected:
-				bool translateBlock(thread::ThreadInstance* thread, archsim::Address block_pc, bool support_chaining, bool support_profiling) override;
+				bool translateBlock(BasicJITExecutionEngineThreadContext *ctx, archsim::Address block_pc, bool support_chaining, bool support_profiling) override;
 
 			private:
 
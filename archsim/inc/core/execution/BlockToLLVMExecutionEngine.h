@@ -38,7 +38,7 @@ namespace archsim
 			{
 			public:
 
-				BlockToLLVMExecutionEngine(gensim::blockjit::BaseBlockJITTranslate *translator);
+				BlockToLLVMExecutionEngine(translator_factory_t translator_factory);
 				virtual ~BlockToLLVMExecutionEngine()
 				{
 
@@ -47,8 +47,8 @@ namespace archsim
 				static ExecutionEngine *Factory(const archsim::module::ModuleInfo *module, const std::string &cpu_prefix);
 
 			private:
-				bool translateBlock(thread::ThreadInstance* thread, archsim::Address block_pc, bool support_chaining, bool support_profiling) override;
-				bool buildBlockJITIR(thread::ThreadInstance *thread, archsim::Address block_pc, captive::arch::jit::TranslationContext &ctx, archsim::blockjit::BlockTranslation &txln);
+				bool translateBlock(BasicJITExecutionEngineThreadContext *ctx, archsim::Address block_pc, bool support_chaining, bool support_profiling) override;
+				bool buildBlockJITIR(BasicJITExecutionEngineThreadContext *ctx, archsim::Address block_pc, captive::arch::jit::TranslationContext &ctx, archsim::blockjit::BlockTranslation &txln);
 
 				llvm::orc::ThreadSafeContext llvm_ctx_;
 				archsim::translate::adapt::BlockJITToLLVMAdaptor adaptor_;
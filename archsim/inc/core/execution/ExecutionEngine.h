@@ -58,6 +58,10 @@ namespace archsim
 				{
 					return thread_;
 				}
+				ExecutionEngine *GetEngine()
+				{
+					return engine_;
+				}
 				ExecutionState GetState()
 				{
 					return state_;
@@ -19,6 +19,10 @@
 #include "module/Module.h"
 #include "gensim/gensim_translate.h"
 
+#include <memory>
+#include <mutex>
+#include <vector>
+
 namespace archsim
 {
 	namespace core
@@ -49,6 +53,15 @@ namespace archsim
 					}
 				}
 
+				void InvalidatePage(Address addr)
+				{
+					auto &entry = GetEntry(addr);
+					if(entry.PageBase == addr.PageBase()) {
+						entry.PageBase = Address(1);
+						entry.Translation = nullptr;
+					}
+				}
+
 				RegionJITCacheEntry &GetEntry(Address addr)
 				{
 					return Cache[addr.GetPageIndex() % kCacheSize];
@@ -77,15 +90,29 @@ namespace archsim
 				LLVMRegionJITExecutionEngineContext(archsim::core::execution::ExecutionEngine *engine, archsim::core::thread::ThreadInstance *thread);
 				~LLVMRegionJITExecutionEngineContext();
 
-				translate::AsynchronousTranslationManager TxlnMgr;
-				LLVMRegionJITCache PageCache;
+				// A block interpreted by this thread, which has not yet been
+				// added to the shared region profile
+				struct TraceEntry {
+					Address PhysPC;
+					Address VirtPC;
+					uint8_t IsaMode;
+					uint32_t Ring;
+				};
 
-				Address PrevRegionBase;
-				Region *CurrentRegion;
+				LLVMRegionJITCache PageCache;
+				std::vector<TraceEntry> Trace;
 
 				int Iterations;
 			};
 
+			/*
+			 * Interprets code and compiles hot pages into LLVM region
+			 * translations. The region profile and the translation workers
+			 * are shared by every thread, so each page is profiled and
+			 * compiled once however many threads execute it. Threads record
+			 * the blocks they interpret locally, and merge them into the
+			 * profile once per epoch.
+			 */
 			class LLVMRegionJITExecutionEngine : public ExecutionEngine
 			{
 			public:
@@ -103,8 +130,16 @@ namespace archsim
 				static ExecutionEngine *Factory(const archsim::module::ModuleInfo *module, const std::string &cpu_prefix);
 
 			private:
+				translate::AsynchronousTranslationManager &GetTxlnMgr(archsim::core::thread::ThreadInstance *thread);
+				void profile(LLVMRegionJITExecutionEngineContext *ctx);
+
 				interpret::Interpreter *interpreter_;
 				gensim::BaseLLVMTranslate *translator_;
+
+				// Created along with the first thread, since it needs the
+				// system's pubsub context
+				std::unique_ptr<translate::AsynchronousTranslationManager> txln_mgr_;
+				std::mutex txln_mgr_init_lock_;
 			};
 		}
 	}
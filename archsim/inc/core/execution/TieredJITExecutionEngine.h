@@ -0,0 +1,128 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * TieredJITExecutionEngine.h
+ *
+ * Executes code with BlockJIT, and promotes hot regions to LLVM.
+ */
+
+#ifndef TIEREDJITEXECUTIONENGINE_H
+#define TIEREDJITEXECUTIONENGINE_H
+
+#include "core/execution/BlockJITExecutionEngine.h"
+#include "core/execution/LLVMRegionJITExecutionEngine.h"
+#include "translate/AsynchronousTranslationManager.h"
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace archsim
+{
+	namespace core
+	{
+		namespace execution
+		{
+			class TieredJITExecutionEngineThreadContext : public BlockJITExecutionEngineThreadContext
+			{
+			public:
+				TieredJITExecutionEngineThreadContext(ExecutionEngine *engine, thread::ThreadInstance *thread, gensim::blockjit::BaseBlockJITTranslate *translator, gensim::BaseLLVMTranslate *region_translator);
+				~TieredJITExecutionEngineThreadContext();
+
+				translate::AsynchronousTranslationManager TxlnMgr;
+				LLVMRegionJITCache PageCache;
+
+				// Regions whose translations have been installed in this
+				// thread's dispatch caches. Each region is held, so that it
+				// can still be checked for validity after being invalidated.
+				std::unordered_map<translate::profile::Region*, captive::shared::block_txln_fn> InstalledRegions;
+				std::unordered_set<captive::shared::block_txln_fn> RegionCode;
+
+				// The next block counter this thread will scan
+				size_t ProfileCursor;
+			};
+
+			/*
+			 * A two tier JIT. Blocks are first translated with BlockJIT, with
+			 * a counter increment at the start of each block. Every
+			 * JitProfilingInterval blocks, the translated code drops back to
+			 * the dispatch loop, where the counters are fed into the region
+			 * profile and hot regions are sent to be compiled with LLVM in the
+			 * background. Completed region translations are installed in the
+			 * thread's dispatch cache in place of the blocks they contain.
+			 *
+			 * Region code is never linked to from BlockJIT code, so that a
+			 * region can be dropped simply by removing it from the dispatch
+			 * caches.
+			 *
+			 * The engine is only used when selected with --mode TieredJIT.
+			 */
+			class TieredJITExecutionEngine : public BlockJITExecutionEngine
+			{
+			public:
+				using region_translator_factory_t = std::function<gensim::BaseLLVMTranslate*()>;
+
+				TieredJITExecutionEngine(translator_factory_t translator_factory, region_translator_factory_t region_translator_factory);
+				~TieredJITExecutionEngine();
+
+				ExecutionEngineThreadContext* GetNewContext(thread::ThreadInstance* thread) override;
+
+				bool translateBlock(BasicJITExecutionEngineThreadContext *ctx, archsim::Address block_pc, bool support_chaining, bool support_profiling) override;
+				bool supportsTranslationStore() const override
+				{
+					// Profiled translations embed pointers to their counters
+					return false;
+				}
+
+				static ExecutionEngine *Factory(const archsim::module::ModuleInfo *module, const std::string &cpu_prefix);
+
+			protected:
+				bool lookupBlock(BasicJITExecutionEngineThreadContext *ctx, Address addr, captive::shared::block_txln_fn &fn) override;
+				void profileTranslations(BasicJITExecutionEngineThreadContext *ctx) override;
+				bool canLinkBlock(BasicJITExecutionEngineThreadContext *ctx, captive::shared::block_txln_fn target) override;
+				void flushDispatchCache(BasicJITExecutionEngineThreadContext *ctx) override;
+				void flushDispatchCode(BasicJITExecutionEngineThreadContext *ctx, const std::unordered_set<captive::shared::block_txln_fn> &txlns) override;
+				void flushDispatchPage(BasicJITExecutionEngineThreadContext *ctx, Address page_base) override;
+
+			private:
+				// Counters are allocated in chunks which never move, so that
+				// they can be scanned without the lock while other threads
+				// add counters
+				static const size_t kProfiledBlocksPerChunk = 1024;
+				static const size_t kMaxProfiledBlockChunks = 4096;
+				// The number of counters scanned at each profiling safepoint
+				static const size_t kProfileScanBatch = 4096;
+
+				struct ProfiledBlock {
+					Address VirtPC;
+					Address PhysPC;
+					uint8_t IsaMode;
+					uint64_t Count;
+				};
+
+				uint64_t *getBlockCounter(Address virt_pc, Address phys_pc, uint8_t isa_mode);
+				ProfiledBlock &getProfiledBlock(size_t index)
+				{
+					return profiled_block_chunks_[index / kProfiledBlocksPerChunk].load(std::memory_order_relaxed)[index % kProfiledBlocksPerChunk];
+				}
+				void installRegion(TieredJITExecutionEngineThreadContext *ctx, translate::profile::Region &region);
+
+				// Each thread compiles regions with its own translator, since
+				// a translator cannot be used by several threads at once
+				region_translator_factory_t region_translator_factory_;
+
+				// Counters are shared by every thread, and live for as long as
+				// the engine, since translations may still refer to them. The
+				// lock is only needed to add a counter.
+				std::mutex profiled_blocks_lock_;
+				std::array<std::atomic<ProfiledBlock*>, kMaxProfiledBlockChunks> profiled_block_chunks_;
+				std::atomic<size_t> profiled_block_count_;
+				std::unordered_map<Address::underlying_t, ProfiledBlock*> profiled_block_index_;
+			};
+		}
+	}
+}
+
+#endif /* TIEREDJITEXECUTIONENGINE_H */
@@ -35,6 +35,10 @@ namespace archsim
 		{
 			return _feature_levels.at(id);
 		}
+		bool HasFeature(uint32_t id) const
+		{
+			return _feature_levels.count(id) != 0;
+		}
 
 		// This mask is made up of the first 7 features (we assume features are 8 bit for now)
 		// It represents the set of features available on a CPU at a given time.
@@ -45,7 +49,7 @@ namespace archsim
 			uint64_t mask = 0;
 			for(const auto &i : _feature_levels) {
 				if(i.first >= 7) continue;
-				mask |= i.second << (i.first*8);
+				mask |= (uint64_t)i.second << (i.first*8);
 			}
 			assert((mask & 0xf000000000000000) == 0);
 			return mask;
@@ -61,8 +65,9 @@ namespace archsim
 			for(const auto &i : _feature_levels) {
 				if(i.first >= 7) {
 					mask |= 0xf000000000000000;
+					continue;
 				}
-				mask |= 0xff << (i.first*8);
+				mask |= (uint64_t)0xff << (i.first*8);
 			}
 
 			return mask;
@@ -78,8 +83,9 @@ namespace archsim
 			for(const auto &i : _feature_levels) {
 				if(i.first >= 7) {
 					mask |= 0xf000000000000000;
+					continue;
 				}
-				mask |= i.second << (i.first*8);
+				mask |= (uint64_t)i.second << (i.first*8);
 			}
 
 			return mask;
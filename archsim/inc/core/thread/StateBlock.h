@@ -45,6 +45,10 @@ namespace archsim
 		{
 			return block_offsets_.count(name);
 		}
+		const std::map<std::string, uint64_t> &GetBlockOffsets() const
+		{
+			return block_offsets_;
+		}
 
 	private:
 		std::map<std::string, uint64_t> block_offsets_;
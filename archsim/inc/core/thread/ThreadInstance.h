@@ -20,10 +20,12 @@
 #include "abi/devices/PeripheralManager.h"
 #include "core/thread/ProcessorFeatures.h"
 #include "core/thread/ThreadMetrics.h"
+#include "core/thread/TraceFilter.h"
 
 #include <libtrace/TraceSource.h>
 
 #include <atomic>
+#include <condition_variable>
 #include <mutex>
 #include <queue>
 #include <setjmp.h>
@@ -272,11 +274,21 @@ namespace archsim
 				{
 					trace_source_ = source;
 				}
+				// Decides which instructions are traced, or nullptr if all of
+				// them are
+				TraceFilter *GetTraceFilter()
+				{
+					return trace_filter_;
+				}
+				void SetTraceFilter(TraceFilter *filter)
+				{
+					trace_filter_ = filter;
+				}
 
 				// External functions. I don't like that these are here.
 				void fn_flush_itlb_entry(Address::underlying_t entry)
 				{
-					pubsub_.Publish(PubSubType::FlushTranslations, 0);
+					pubsub_.Publish(PubSubType::ITlbEntryFlush, (void*)Address(entry).GetPageBase());
 				}
 				void fn_flush_dtlb_entry(Address::underlying_t entry)
 				{
@@ -473,6 +485,11 @@ namespace archsim
 				void PendIRQ();
 				// Acknowledge an IRQ and take an interrupt
 				void HandleIRQ();
+				// The guest has nothing to do until the next interrupt
+				// arrives. The thread sleeps until it is sent a message or
+				// one of its IRQ lines is asserted, unless it is the last
+				// thread still running.
+				void WaitForInterrupt();
 
 				// Functions to do with sending messages to a running thread
 				void SendMessage(ThreadMessage message)
@@ -480,6 +497,7 @@ namespace archsim
 					std::unique_lock<std::mutex> lock(message_lock_);
 					message_queue_.push(message);
 					*(uint32_t*)(((char*)GetStateBlock().GetData()) + message_waiting_offset_) = true;
+					message_arrived_.notify_all();
 				}
 
 				bool HasMessage() const
@@ -537,13 +555,16 @@ namespace archsim
 
 				std::mutex message_lock_;
 				std::queue<ThreadMessage> message_queue_;
+				std::condition_variable message_arrived_;
 				std::atomic<uint32_t> pending_irqs_;
 
 				StateBlock state_block_;
 				libtrace::TraceSource *trace_source_;
+				TraceFilter *trace_filter_;
 
 				std::vector<archsim::abi::devices::CPUIRQLine*> irq_lines_;
 
+				bool hasAssertedIRQ() const;
 			};
 		}
 	}
@@ -42,6 +42,9 @@ namespace archsim
 				archsim::util::Counter64 WriteHits;
 				archsim::util::Counter64 Writes;
 
+				archsim::util::Counter64 MMUTLBHits;
+				archsim::util::Counter64 MMUTLBMisses;
+
 				archsim::util::Counter64 JITInstructionCount;
 				archsim::util::CounterTimer JITTime;
 
@@ -50,6 +53,17 @@ namespace archsim
 				archsim::util::Counter64 JITSuccessfulChains;
 				archsim::util::Counter64 JITFailedChains;
 				archsim::util::Histogram JITExitReasons;
+
+				archsim::util::Counter64 JITEvictedPages;
+				archsim::util::Counter64 JITEvictedTxlns;
+				archsim::util::Counter64 JITEvictedBytes;
+				archsim::util::Counter64 JITRetranslations;
+				archsim::util::Counter64 JITCodeFlushes;
+				archsim::util::Counter64 JITPageFlushes;
+				archsim::util::Counter64 JITRestoredTxlns;
+				archsim::util::Counter64 JITModifiedTxlns;
+				archsim::util::Counter64 JITPreservedTxlns;
+				archsim::util::Counter64 JITPromotedRegions;
 			};
 
 			class ThreadMetricPrinter
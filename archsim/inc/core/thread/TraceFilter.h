@@ -0,0 +1,134 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * TraceFilter.h
+ *
+ * Decides which instructions of a thread are traced. Filters on the PC (by
+ * range or by function symbol) are static, so they are decided when an
+ * instruction is translated. Filters on the execution ring, the ASID and
+ * the end of the trace window can change while the thread runs, so they
+ * are combined into a processor feature: translations which read it are
+ * versioned on it, and are only retranslated the first time a region runs
+ * with a different filter state.
+ *
+ * Translations are shared between every virtual mapping of a physical page,
+ * so the PC filters are decided for the virtual address at which a block was
+ * first translated. Code which is mapped at more than one virtual address is
+ * traced (or not) as it would be at that first mapping.
+ */
+
+#ifndef TRACEFILTER_H
+#define TRACEFILTER_H
+
+#include "abi/Address.h"
+#include "util/PubSubSync.h"
+
+#include <cstdint>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace archsim
+{
+	namespace core
+	{
+		namespace thread
+		{
+			class ThreadInstance;
+
+			class TraceFilter
+			{
+			public:
+				// The ID used for the active feature when every ID which fits
+				// in the feature masks is taken by the architecture. Changes
+				// to a feature outside the masks drop the affected
+				// translations rather than keeping a version for each level,
+				// so the filter state then costs a retranslation every time
+				// it changes.
+				static const uint32_t kFallbackActiveFeature = 0x10000;
+
+				TraceFilter(ThreadInstance &thread);
+
+				// Creates a filter from the tracing options, or returns
+				// nullptr if no filters have been given
+				static TraceFilter *CreateFromOptions(ThreadInstance &thread);
+
+				// Trace the PCs in [start, end)
+				void AddPCRange(Address::underlying_t start, Address::underlying_t end);
+				// Trace the PCs in the given function. The symbol is looked
+				// up when it is first needed, since the symbols are not
+				// loaded until the system is booted.
+				void AddFunction(const std::string &name);
+				void AddRing(uint32_t ring);
+				void AddASID(uint32_t asid);
+
+				// Stop tracing altogether (e.g. at the end of the trace
+				// window)
+				void Stop();
+
+				// Recompute whether the dynamic filters allow tracing
+				void Update();
+
+				// Whether or not the static filters allow the instruction at
+				// the given PC to be traced
+				bool ShouldTracePC(Address pc);
+
+				// Whether or not there are any dynamic filters, in which
+				// case translations must check the active feature
+				bool IsDynamic() const
+				{
+					return !rings_.empty() || !asids_.empty() || may_stop_;
+				}
+				void SetMayStop(bool may_stop)
+				{
+					may_stop_ = may_stop;
+				}
+
+				bool IsActive() const
+				{
+					return active_;
+				}
+
+				// The ID of the feature which holds whether or not the
+				// dynamic filters currently allow tracing
+				uint32_t GetActiveFeature() const
+				{
+					return active_feature_;
+				}
+
+				bool ShouldTrace(Address pc)
+				{
+					return active_ && ShouldTracePC(pc);
+				}
+
+			private:
+				static void PrivilegeLevelChanged(PubSubType::PubSubType type, void *ctx, const void *data);
+				static void ASIDChanged(PubSubType::PubSubType type, void *ctx, const void *data);
+
+				void ResolveFunctions();
+
+				static uint32_t ChooseActiveFeature(ThreadInstance &thread);
+
+				ThreadInstance &thread_;
+				archsim::util::PubSubscriber subscriber_;
+				uint32_t active_feature_;
+
+				std::vector<std::pair<Address::underlying_t, Address::underlying_t>> ranges_;
+				std::vector<std::string> functions_;
+				bool functions_resolved_;
+				bool pc_filtered_;
+
+				std::set<uint32_t> rings_;
+				std::set<uint32_t> asids_;
+				uint32_t asid_;
+
+				bool may_stop_;
+				bool stopped_;
+				bool active_;
+			};
+		}
+	}
+}
+
+#endif /* TRACEFILTER_H */
@@ -69,6 +69,8 @@ namespace gensim
 		void WriteBackState(archsim::core::thread::ThreadInstance* thread) override;
 
 		void Flush();
+		// Drop the cached decodes for a single virtual page
+		void InvalidatePage(archsim::Address page_base);
 
 	private:
 		archsim::util::Cache<archsim::Address, gensim::BaseDecode*> decode_cache_;
@@ -63,11 +63,17 @@ namespace gensim
 	class JumpInfo
 	{
 	public:
-		JumpInfo() : IsJump(false), IsIndirect(false), IsConditional(false), JumpTarget(0) {}
+		JumpInfo() : IsJump(false), IsIndirect(false), IsConditional(false), IsCall(false), IsReturn(false), JumpTarget(0) {}
 
 		bool IsJump;
 		bool IsIndirect;
 		bool IsConditional;
+
+		// Hints used for return address prediction. These are optional, and
+		// are only filled in by providers which know about them.
+		bool IsCall;
+		bool IsReturn;
+
 		archsim::Address JumpTarget;
 	};
 
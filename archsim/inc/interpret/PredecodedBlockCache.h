@@ -0,0 +1,128 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * PredecodedBlockCache.h
+ *
+ * Keeps decoded basic blocks for the interpreter.
+ */
+
+#ifndef INC_INTERPRET_PREDECODEDBLOCKCACHE_H_
+#define INC_INTERPRET_PREDECODEDBLOCKCACHE_H_
+
+#include "abi/Address.h"
+#include "util/PubSubSync.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace gensim
+{
+	class BaseDecode;
+}
+
+namespace archsim
+{
+	namespace interpret
+	{
+
+		/*
+		 * A decoded instruction, bound to the code which executes it. The
+		 * handler is opaque to the cache: the generated interpreter uses the
+		 * address of a label in its dispatch loop.
+		 */
+		struct PredecodedInstruction {
+			const void *Handler;
+			gensim::BaseDecode *Decode;
+		};
+
+		/*
+		 * A decoded basic block, which never crosses a page boundary. The
+		 * last instruction is followed by an entry with no decode, whose
+		 * handler leaves the block.
+		 */
+		class PredecodedBlock
+		{
+		public:
+			PredecodedBlock(Address phys_pc, uint32_t isa_mode) : PhysPC(phys_pc), IsaMode(isa_mode) { }
+			~PredecodedBlock();
+
+			const Address PhysPC;
+			const uint32_t IsaMode;
+			std::vector<PredecodedInstruction> Instructions;
+		};
+
+		/*
+		 * A per-thread cache of decoded blocks, keyed by physical PC.
+		 *
+		 * Flushes and page invalidations may be published by any thread, so
+		 * they are queued and only applied by Collect, which the owning
+		 * thread must call when it is not executing a block. A block whose
+		 * code has been invalidated can still be finished, but the owning
+		 * thread should check IsInvalidated between instructions so that it
+		 * stops executing modified code as soon as possible.
+		 */
+		class PredecodedBlockCache
+		{
+		public:
+			// Blocks are ended after this many instructions, even if they have
+			// not reached the end of a basic block
+			static const uint32_t kMaxBlockInstructions = 256;
+
+			PredecodedBlockCache(util::PubSubContext &pubsub);
+			~PredecodedBlockCache();
+
+			PredecodedBlock *Lookup(Address phys_pc, uint32_t isa_mode)
+			{
+				auto &entry = front_cache_[(phys_pc.Get() >> 1) % kFrontCacheSize];
+				if(entry != nullptr && entry->PhysPC == phys_pc && entry->IsaMode == isa_mode) {
+					return entry;
+				}
+				return lookupSlow(phys_pc, isa_mode);
+			}
+
+			// Create a new, empty block, replacing any existing block at the
+			// same PC
+			PredecodedBlock *Insert(Address phys_pc, uint32_t isa_mode);
+
+			bool IsInvalidated() const
+			{
+				return invalidated_.load(std::memory_order_relaxed);
+			}
+
+			void Collect()
+			{
+				if(IsInvalidated()) {
+					collect();
+				}
+			}
+
+			void Flush();
+			void InvalidatePage(Address phys_page);
+
+		private:
+			static const uint32_t kFrontCacheSize = 1024;
+
+			PredecodedBlock *lookupSlow(Address phys_pc, uint32_t isa_mode);
+			void collect();
+			void erase(PredecodedBlock *block);
+			void clear();
+
+			PredecodedBlock *front_cache_[kFrontCacheSize];
+			std::unordered_map<Address::underlying_t, PredecodedBlock*> blocks_;
+			std::unordered_map<Address::underlying_t, std::vector<PredecodedBlock*>> page_blocks_;
+
+			std::atomic<bool> invalidated_;
+			std::mutex pending_lock_;
+			bool pending_flush_;
+			std::vector<Address> pending_pages_;
+
+			util::PubSubscriber subscriber_;
+		};
+
+	}
+}
+
+#endif /* INC_INTERPRET_PREDECODEDBLOCKCACHE_H_ */
@@ -31,6 +31,7 @@
 #include <mutex>
 #include <queue>
 #include <set>
+#include <vector>
 
 #include <cstring>
 
@@ -130,6 +131,7 @@ namespace archsim
 			bool TryGetRegion(Address phys_addr, profile::Region*& region);
 
 			void TraceBlock(archsim::core::thread::ThreadInstance *thread, profile::Block& block);
+			void TraceBlock(uint32_t ring, profile::Block& block);
 
 			inline void ResetTrace()
 			{
@@ -150,10 +152,23 @@ namespace archsim
 
 			bool MarkTranslationAsComplete(profile::Region &unit, Translation &txln);
 			void RegisterCompletedTranslations();
+			// As above, but also returns the regions which were given new
+			// translations. The caller must release each returned region.
+			void RegisterCompletedTranslations(std::vector<profile::Region*> &registered);
 
 			virtual void PrintStatistics(std::ostream& stream);
 			size_t ApproximateRegionMemoryUsage() const;
 
+			/**
+			 * Protects the region profile when the manager is shared by several
+			 * threads. Callers must hold it while using the manager or any of
+			 * its regions; the invalidation callbacks take it themselves.
+			 */
+			std::mutex &GetLock()
+			{
+				return lock_;
+			}
+
 			profile::CodeRegionTracker &GetCodeRegions()
 			{
 				assert(manager);
@@ -165,6 +180,7 @@ namespace archsim
 			}
 
 		private:
+			std::mutex lock_;
 			bool _needs_leave;
 			profile::RegionTable regions;
 
@@ -72,6 +72,7 @@ namespace archsim
 			DEFINE_LOWERING(CLZ);
 			DEFINE_LOWERING(CMOV);
 			DEFINE_LOWERING(COUNT);
+			DEFINE_LOWERING(TRACE);
 			DEFINE_LOWERING(EXCEPTION);
 			DEFINE_LOWERING(INCPC);
 			DEFINE_LOWERING(JMP);
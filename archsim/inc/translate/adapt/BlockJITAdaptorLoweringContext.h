@@ -38,6 +38,7 @@ namespace archsim
 				llvm::Function *cpuReadDevicePtr;
 				llvm::Function *cpuWriteDevicePtr;
 				llvm::Function *cpuSetFeaturePtr;
+				llvm::Function *cpuTraceReservePtr;
 
 				llvm::Function *cpuSetRoundingModePtr;
 				llvm::Function *cpuGetRoundingModePtr;
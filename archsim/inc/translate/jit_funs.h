@@ -84,7 +84,8 @@ extern "C" {
 
 	void cpuEnterKernelMode(gensim::Processor *cpu);
 	void cpuEnterUserMode(gensim::Processor *cpu);
-	void cpuInstructionTick(archsim::core::thread::ThreadInstance *cpu);
+	void cpuInstructionTick(archsim::core::thread::ThreadInstance *cpu, uint32_t count);
+	void cpuWaitForInterrupt(archsim::core::thread::ThreadInstance *cpu);
 
 	void cpuTraceString(gensim::Processor *cpu, const char* str, uint32_t do_emit);
 
@@ -92,6 +93,8 @@ extern "C" {
 
 	void cpuTraceInsnEnd(archsim::core::thread::ThreadInstance *cpu);
 
+	uint32_t cpuTraceReserve(archsim::core::thread::ThreadInstance *cpu, uint32_t type, uint32_t count);
+
 	void cpuTraceRegWrite(archsim::core::thread::ThreadInstance *cpu, uint8_t reg, uint64_t value);
 
 	void cpuTraceRegRead(archsim::core::thread::ThreadInstance *cpu, uint8_t reg, uint64_t value);
@@ -141,7 +144,7 @@ extern "C" {
 	void tmFlushITlb(gensim::Processor *cpu);
 	void tmFlushDTlb(gensim::Processor *cpu);
 
-	void tmFlushITlbEntry(gensim::Processor *cpu, uint64_t addr);
+	void tmFlushITlbEntry(archsim::core::thread::ThreadInstance *cpu, uint64_t addr);
 	void tmFlushDTlbEntry(gensim::Processor *cpu, uint64_t addr);
 
 #define RETURNTYPE_OF0(x) decltype(std::declval<archsim::core::thread::ThreadInstance>().fn_##x())
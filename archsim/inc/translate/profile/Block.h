@@ -95,6 +95,11 @@ namespace archsim
 					interp_count_++;
 				}
 
+				void AddInterpCount(uint64_t count)
+				{
+					interp_count_ += count;
+				}
+
 				uint64_t GetInterpCount() const
 				{
 					return interp_count_;
@@ -19,7 +19,8 @@
 
 UseLogContext(LogProfile);
 
-#include <bitset>
+#include <algorithm>
+#include <atomic>
 
 namespace archsim
 {
@@ -28,43 +29,172 @@ namespace archsim
 		namespace profile
 		{
 
+			/*
+			 * The lines of a page which have been written, published with
+			 * RegionInvalidatePhysicalLines. Bit n of Lines covers bytes
+			 * [n * LineSize, (n + 1) * LineSize) of the page.
+			 */
+			struct CodeLineInvalidation {
+				Address PageBase;
+				uint64_t Lines;
+			};
+
 			/*
 			 * This class is in charge of keeping track of which pages contain translated code, and generating invalidation events
-			 * when these pages are invalidated.
+			 * when these pages are invalidated. Pages can be marked and invalidated concurrently by several threads, so the
+			 * page bitmap is maintained with atomic word operations.
+			 *
+			 * Each page is further split into 64 byte lines. A write only invalidates the lines it touches, and a page stops
+			 * being code once all of its lines have been written. Writes to lines which have already been written are not
+			 * reported again until the page is next marked as code, so that data which shares a page with code is only
+			 * reported once.
 			 */
 			class CodeRegionTracker
 			{
 			public:
+				static const uint32_t LineBits = 6;
+				static const uint32_t LineSize = 1 << LineBits;
+				static const uint32_t LinesPerPage = RegionArch::PageSize / LineSize;
+
+				static_assert(LinesPerPage == 64, "Each page's lines must fit in one word");
+
+				// Get the mask of lines covered by the given range of a page. The
+				// range is clipped to the end of the page.
+				static uint64_t GetLineMask(uint32_t page_offset, uint32_t size)
+				{
+					if(size == 0) return 0;
+
+					uint32_t first = (page_offset & RegionArch::PageMask) >> LineBits;
+					uint32_t last = std::min<uint64_t>((page_offset & RegionArch::PageMask) + size - 1, RegionArch::PageMask) >> LineBits;
+
+					uint64_t mask = ~0ULL << first;
+					if(last < LinesPerPage - 1) mask &= ~(~0ULL << (last + 1));
+					return mask;
+				}
+
 				CodeRegionTracker(archsim::util::PubSubContext &pubsub) : pubsub(pubsub)
 				{
+					for(auto &i : line_tables) {
+						i.store(nullptr, std::memory_order_relaxed);
+					}
 					Invalidate();
 				}
 
+				~CodeRegionTracker()
+				{
+					for(auto &i : line_tables) {
+						delete[] i.load(std::memory_order_relaxed);
+					}
+				}
+
 				void MarkRegionAsCode(PhysicalAddress region_base)
 				{
-					code_regions.set(region_base.GetPageIndex());
+					// The lines must be marked before the page, so that a
+					// writer which sees the page as code also sees its lines
+					auto index = region_base.GetPageIndex();
+					getLines(index).fetch_or(~0ULL);
+					code_regions[index / kBitsPerWord].fetch_or(1ULL << (index % kBitsPerWord));
 					pubsub.Publish(PubSubType::RegionDispatchedForTranslationPhysical, (void*)(uint64_t)region_base.GetPageBase());
 				}
 				bool IsRegionCode(PhysicalAddress region_base)
 				{
-					return code_regions.test(region_base.GetPageIndex());
+					auto index = region_base.GetPageIndex();
+					return (code_regions[index / kBitsPerWord].load(std::memory_order_relaxed) >> (index % kBitsPerWord)) & 1;
 				}
 
 				void InvalidateRegion(PhysicalAddress region_base)
 				{
-					if(IsRegionCode(region_base)) {
-						LC_DEBUG1(LogProfile) << "Invalidating code region at " << std::hex << region_base.Get();
-						pubsub.Publish(PubSubType::RegionInvalidatePhysical, (void*)(uint64_t)region_base.GetPageBase());
+					invalidateLines(region_base.PageBase(), ~0ULL);
+				}
+
+				// Invalidate the lines covered by a write of size bytes
+				void InvalidateRange(PhysicalAddress addr, uint32_t size)
+				{
+					uint32_t offset = addr.GetPageOffset();
+					invalidateLines(addr.PageBase(), GetLineMask(offset, size));
+
+					// Unaligned writes may spill over onto the next page
+					if(offset + size > RegionArch::PageSize) {
+						PhysicalAddress next = addr.PageBase() + RegionArch::PageSize;
+						if(IsRegionCode(next)) {
+							invalidateLines(next, GetLineMask(0, offset + size - RegionArch::PageSize));
+						}
 					}
-					code_regions.reset(region_base.GetPageIndex());
 				}
+
 				void Invalidate()
 				{
-					code_regions.reset();
+					for(auto &i : code_regions) {
+						i.store(0, std::memory_order_relaxed);
+					}
+					for(auto &table : line_tables) {
+						auto lines = table.load(std::memory_order_relaxed);
+						if(lines == nullptr) continue;
+
+						for(uint32_t i = 0; i < kPagesPerLineTable; ++i) {
+							lines[i].store(0, std::memory_order_relaxed);
+						}
+					}
 				}
 
 			private:
-				std::bitset<RegionArch::PageCount> code_regions;
+				static const uint32_t kBitsPerWord = 64;
+				static const uint32_t kPagesPerLineTable = 1024;
+
+				// Line masks are only allocated for parts of the address space
+				// which actually contain code
+				std::atomic<uint64_t> &getLines(uint64_t page_index)
+				{
+					auto &table = line_tables[page_index / kPagesPerLineTable];
+					auto lines = table.load(std::memory_order_acquire);
+					if(lines == nullptr) {
+						auto new_lines = new std::atomic<uint64_t>[kPagesPerLineTable];
+						for(uint32_t i = 0; i < kPagesPerLineTable; ++i) {
+							new_lines[i].store(0, std::memory_order_relaxed);
+						}
+
+						if(table.compare_exchange_strong(lines, new_lines)) {
+							lines = new_lines;
+						} else {
+							delete[] new_lines;
+						}
+					}
+
+					return lines[page_index % kPagesPerLineTable];
+				}
+
+				void invalidateLines(PhysicalAddress page_base, uint64_t mask)
+				{
+					auto index = page_base.GetPageIndex();
+					auto table = line_tables[index / kPagesPerLineTable].load(std::memory_order_acquire);
+					if(table == nullptr) return;
+
+					// Only the thread which actually clears a line publishes its
+					// invalidation
+					auto &lines = table[index % kPagesPerLineTable];
+					uint64_t prev = lines.fetch_and(~mask);
+					uint64_t cleared = prev & mask;
+					if(!cleared) return;
+
+					if((prev & ~mask) == 0) {
+						// The page may have been marked again since its last line
+						// was cleared, in which case it must stay marked
+						uint64_t bit = 1ULL << (index % kBitsPerWord);
+						code_regions[index / kBitsPerWord].fetch_and(~bit);
+						if(lines.load() != 0) {
+							code_regions[index / kBitsPerWord].fetch_or(bit);
+						}
+					}
+
+					LC_DEBUG1(LogProfile) << "Invalidating code region at " << std::hex << page_base.Get() << " (lines " << cleared << ")";
+
+					CodeLineInvalidation invalidation { Address(page_base.Get()), cleared };
+					pubsub.Publish(PubSubType::RegionInvalidatePhysical, (void*)(uint64_t)page_base.GetPageBase());
+					pubsub.Publish(PubSubType::RegionInvalidatePhysicalLines, &invalidation);
+				}
+
+				std::atomic<uint64_t> code_regions[RegionArch::PageCount / kBitsPerWord];
+				std::atomic<std::atomic<uint64_t>*> line_tables[RegionArch::PageCount / kPagesPerLineTable];
 				archsim::util::PubSubscriber pubsub;
 			};
 
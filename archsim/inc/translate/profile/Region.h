@@ -90,6 +90,18 @@ namespace archsim
 				 * @param virt_addr The virtual address of the block that has been executed.
 				*/
 				void TraceBlock(archsim::core::thread::ThreadInstance *thread, Address virt_addr);
+				/**
+				 * As above, for a block executed earlier in the given ISA mode and
+				 * execution ring.
+				 */
+				void TraceBlock(Address virt_addr, uint8_t isa_mode, uint32_t ring);
+
+				/**
+				 * Records several executions of a block at once, e.g. from counters
+				 * maintained by translated code. Successors are not recorded, so every
+				 * block recorded in this way is treated as a region entry point.
+				 */
+				void ProfileBlock(archsim::core::thread::ThreadInstance *thread, Address virt_addr, uint8_t isa_mode, uint64_t count);
 
 				void Invalidate();
 
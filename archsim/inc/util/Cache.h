@@ -203,10 +203,35 @@ namespace archsim
 
 			inline void invalidate_location(KeyT _addr)
 			{
-				KeyT idx = (_addr) & mask;
+				size_t idx = std::hash<KeyT>()(_addr) & mask;
+
+				entry_t &entry = cache[idx];
+				for (int i = 0; i < 2; ++i) {
+					if (entry.tags[i] == _addr) {
+						on_purge_(entry.ways[i]);
+						entry.tags[i] = KeyT(1);
+					}
+				}
+			}
 
-				entry_t entry = cache[idx];
-				entry.purge();
+			// Invalidate every entry with a key in [base, base + count). Keys
+			// are indexed by their hash, which is the identity for addresses,
+			// so the range occupies consecutive slots and is visited once.
+			inline void invalidate_range(KeyT base, size_t count)
+			{
+				size_t first = std::hash<KeyT>()(base) & mask;
+				size_t slots = count < (size_t)size ? count : (size_t)size;
+				KeyT end = base + count;
+
+				for (size_t slot = 0; slot < slots; ++slot) {
+					entry_t &entry = cache[(first + slot) & mask];
+					for (int i = 0; i < 2; ++i) {
+						if (base <= entry.tags[i] && entry.tags[i] < end) {
+							on_purge_(entry.ways[i]);
+							entry.tags[i] = KeyT(1);
+						}
+					}
+				}
 			}
 
 		private:
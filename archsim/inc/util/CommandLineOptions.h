@@ -53,6 +53,11 @@ DefineRequiredArgument(std::string, TraceMode, 'M', "trace-mode");
 DefineOptionalArgument(std::string, TraceFile, 'U', "trace-file");
 DefineLongRequiredArgument(std::list<std::string> *, Breakpoints, "breakpoints");
 DefineLongFlag(SuppressTracing, "suppress-tracing");
+DefineLongRequiredArgument(uint64_t, TraceStop, "trace-stop");
+DefineLongRequiredArgument(std::string, TracePCRanges, "trace-pc");
+DefineLongRequiredArgument(std::string, TraceFunctions, "trace-functions");
+DefineLongRequiredArgument(std::string, TraceRings, "trace-rings");
+DefineLongRequiredArgument(std::string, TraceASIDs, "trace-asids");
 
 DefineLongFlag(InstructionTick, "instruction-tick");
 
@@ -82,6 +87,8 @@ DefineLongRequiredArgument(std::string, DeviceTreeFile, "device-tree");
 DefineLongRequiredArgument(std::string, RootFS, "root-fs");
 DefineLongRequiredArgument(std::string, BlockDeviceFile, "bdev-file");
 DefineLongFlag(CopyOnWrite, "copy-on-write");
+DefineLongRequiredArgument(std::string, BlockDeviceOverlay, "bdev-overlay");
+DefineLongFlag(CommitOverlay, "commit-overlay");
 DefineLongRequiredArgument(std::string, KernelArgs, "kernel-args");
 DefineLongRequiredArgument(std::string, Bootloader, "bootloader");
 DefineLongRequiredArgument(std::string, SystemMemoryModel, "sys-model");
@@ -91,9 +98,12 @@ DefineLongFlag(SerialGrab, "grab-serial");
 
 DefineLongRequiredArgument(std::string, JitTranslationManager, "txln-mgr");
 DefineLongFlag(JitDisableBranchOpt, "disable-branch-opt");
+DefineLongFlag(JitDisableChaining, "disable-chaining");
+DefineLongFlag(JitMergeBlocks, "merge-blocks");
 
 DefineLongFlag(JitLoadTranslations, "jit-load-txlns");
 DefineLongFlag(JitSaveTranslations, "jit-save-txlns");
+DefineLongRequiredArgument(std::string, JitTranslationFile, "jit-txln-file");
 
 // Special Options
 DefineLongFlag(Doom, "doom");
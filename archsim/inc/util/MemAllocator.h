@@ -16,7 +16,10 @@
 #include <cstring>
 #include <list>
 #include <map>
+#include <mutex>
 #include <set>
+#include <unordered_set>
+#include <vector>
 
 #ifndef NDEBUG
 #ifdef CONFIG_VALGRIND
@@ -215,6 +218,92 @@ namespace wulib
 #endif
 	};
 
+	/*
+	 * An allocator which can be shared between several threads. Allocations
+	 * are serialised onto an underlying allocator, but frees are deferred:
+	 * a freed buffer is retired in the current epoch, and is only returned
+	 * to the underlying allocator once every registered reader has passed a
+	 * quiescent point in a later epoch. This lets one thread release
+	 * translated code which other threads might still be executing.
+	 *
+	 * The epoch is advanced once per batch of frees (see RetireFreed), and
+	 * readers can find out exactly which buffers have been retired since
+	 * they last caught up, so they only need to drop their references to
+	 * those buffers.
+	 */
+	class EpochMemAllocator : public MemAllocator
+	{
+	public:
+		typedef std::atomic<uint64_t> reader_slot_t;
+
+		EpochMemAllocator(MemAllocator &underlying);
+		virtual ~EpochMemAllocator();
+
+		void *Allocate(size_t size_bytes) override;
+		void *Reallocate(void *buffer, size_t new_size_bytes) override;
+		void Free(void *buffer) override;
+
+		uint64_t GetEpoch() const
+		{
+			return _epoch.load(std::memory_order_acquire);
+		}
+
+		// Move to a new epoch, so that the buffers retired so far can be
+		// reclaimed once every reader has quiesced in the new one.
+		uint64_t AdvanceEpoch()
+		{
+			return _epoch.fetch_add(1, std::memory_order_acq_rel) + 1;
+		}
+		// Advance the epoch if anything has been freed in the current one.
+		// Call this once after a batch of frees (e.g. a collection) rather
+		// than after every free. Returns true if the epoch was advanced.
+		bool RetireFreed();
+
+		// Whether the buffer has been freed, but not yet reclaimed
+		bool IsRetired(void *buffer);
+		// Get the buffers retired in or after the given epoch. A reader
+		// which passes the epoch it last quiesced in gets every buffer it
+		// might still hold a reference to.
+		void GetRetiredSince(uint64_t epoch, std::vector<void*> &buffers);
+
+		void RegisterReader(reader_slot_t &slot);
+		void UnregisterReader(reader_slot_t &slot);
+
+		// Called by a reader when it holds no references to any buffer freed
+		// before the given epoch. Reclaims whatever is now unreachable.
+		void Quiesce(reader_slot_t &slot, uint64_t epoch);
+
+		uint64_t GetRetiredCount() const
+		{
+			return _retired_count;
+		}
+		uint64_t GetReclaimedCount() const
+		{
+			return _reclaimed_count;
+		}
+
+	private:
+		void Reclaim();
+
+		struct RetiredBuffer {
+			void *buffer;
+			uint64_t epoch;
+		};
+
+		MemAllocator &_underlying;
+		std::mutex _lock;
+		std::atomic<uint64_t> _epoch;
+		std::atomic<bool> _has_retired;
+
+		std::vector<reader_slot_t*> _readers;
+		std::vector<RetiredBuffer> _retired;
+		std::unordered_set<void*> _retired_buffers;
+		bool _freed_in_epoch;
+
+		uint64_t _retired_count;
+		uint64_t _reclaimed_count;
+	};
+
 }
 
 #endif /* INC_UTIL_MEMALLOCATOR_H_ */
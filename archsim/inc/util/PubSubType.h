@@ -12,6 +12,8 @@
 #endif
 
 DeclarePubType(PrivilegeLevelChange)
+// Published by an MMU (which is passed as the data) when its ASID changes
+DeclarePubType(ASIDChange)
 DeclarePubType(ITlbFullFlush)
 DeclarePubType(ITlbEntryFlush)
 DeclarePubType(DTlbFullFlush)
@@ -22,6 +24,9 @@ DeclarePubType(RegionDispatchedForTranslationVirtual)
 DeclarePubType(RegionTranslationComleted)
 
 DeclarePubType(RegionInvalidatePhysical)
+// Published alongside RegionInvalidatePhysical, with a CodeLineInvalidation
+// describing which lines of the page were written
+DeclarePubType(RegionInvalidatePhysicalLines)
 
 DeclarePubType(L1ICacheFlush)
 DeclarePubType(L1DCacheFlush)
@@ -0,0 +1,82 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * RadixPageTable.h
+ *
+ * A lock free table of host pages, indexed by 64 bit guest address.
+ */
+
+#ifndef INC_UTIL_RADIXPAGETABLE_H_
+#define INC_UTIL_RADIXPAGETABLE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+
+namespace archsim
+{
+	namespace util
+	{
+
+		/*
+		 * Maps guest pages to host pages, across the whole 64 bit address
+		 * space. The page number is split into four 13 bit indices, one for
+		 * each level of the table. Lookups never take a lock: entries are
+		 * only ever filled in, with compare and swap, and nothing is freed
+		 * until the table is destroyed.
+		 */
+		class RadixPageTable
+		{
+		public:
+			static const uint32_t kPageBits = 12;
+			static const uint32_t kLevelBits = 13;
+			static const uint32_t kLevels = 4;
+			static const uint32_t kEntriesPerLevel = 1 << kLevelBits;
+
+			static_assert(kPageBits + kLevels * kLevelBits == 64, "Table must cover the whole address space");
+
+			RadixPageTable();
+			~RadixPageTable();
+
+			// Get the host page containing the given guest address, or null
+			// if no page has been inserted for it
+			char *Lookup(uint64_t addr) const
+			{
+				const Node *node = &root_;
+				for(uint32_t level = 0; level < kLevels - 1; ++level) {
+					node = (const Node*)node->Entries[GetIndex(addr, level)].load(std::memory_order_acquire);
+					if(node == nullptr) return nullptr;
+				}
+
+				return (char*)node->Entries[GetIndex(addr, kLevels - 1)].load(std::memory_order_acquire);
+			}
+
+			// Insert the host page for the given guest address. If another
+			// page has already been inserted for the address, then that page
+			// is returned instead and the table is not changed.
+			char *Insert(uint64_t addr, char *page);
+
+			// Call the given function for every page in the table
+			void ForEachPage(const std::function<void(uint64_t page_base, char *page)> &fn) const;
+
+			static uint32_t GetIndex(uint64_t addr, uint32_t level)
+			{
+				return (addr >> (kPageBits + (kLevels - 1 - level) * kLevelBits)) & (kEntriesPerLevel - 1);
+			}
+
+		private:
+			struct Node {
+				std::atomic<void*> Entries[kEntriesPerLevel];
+			};
+
+			Node *getOrCreateChild(Node *node, uint32_t index);
+			void forEachPage(const Node *node, uint32_t level, uint64_t base, const std::function<void(uint64_t, char*)> &fn) const;
+			void freeNode(Node *node, uint32_t level);
+
+			Node root_;
+		};
+
+	}
+}
+
+#endif /* INC_UTIL_RADIXPAGETABLE_H_ */
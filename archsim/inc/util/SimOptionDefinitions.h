@@ -51,7 +51,12 @@ DefineInt64Setting(Tracing, TraceSkip, "Skip instruction count", 0);
 DefineFlag(Tracing, SimpleTrace, "Simplified tracing", false);
 DefineFlag(Tracing, TraceSymbols, "Enables symbol resolution in tracing output", false);
 DefineFlag(Tracing, SuppressTracing, "Suppress tracing output at system startup", false);
-DefineSetting(Tracing, TraceMode, "Selects tracing output mode", "binary");
+DefineInt64Setting(Tracing, TraceStop, "Stop tracing at instruction count", 0);
+DefineSetting(Tracing, TracePCRanges, "Only trace PCs in the given ranges (start-end,...)", "");
+DefineSetting(Tracing, TraceFunctions, "Only trace the given functions (name,...)", "");
+DefineSetting(Tracing, TraceRings, "Only trace in the given execution rings (ring,...)", "");
+DefineSetting(Tracing, TraceASIDs, "Only trace in the given ASIDs (asid,...)", "");
+DefineSetting(Tracing, TraceMode, "Selects tracing output mode (binary or compressed)", "binary");
 DefineSetting(Tracing, TraceFile, "Redirects tracing output to a file", "trace.out");
 DefineSetting(Tracing, StdOutFile, "Redirects stdout to a file", "stdout");
 DefineSetting(Tracing, StdErrFile, "Redirects stderr to a file", "stderr");
@@ -78,7 +83,7 @@ DefineSetting(System, ZImageSymbolMap, "Symbol Map for a ZIMAGE binary", "");
 
 DefineSetting(System, SCPText, "Text to pass into the simulator cache coprocessor", "");
 
-DefineFlag(System, InstructionTick, "Use an instruction-based clock", false);
+DefineFlag(System, InstructionTick, "Use an instruction-based clock, which skips ahead when every core is idle", false);
 
 DefineListSetting(System, Breakpoints, "List of functions to insert breakpoints on", new std::list<std::string>());
 
@@ -100,12 +105,18 @@ DefineIntSetting(JIT, JitProfilingInterval, "Chooses the number of basic-blocks
 DefineIntSetting(JIT, TransCacheSize, "Sets the size of the translation cache", 8192);
 DefineIntSetting(JIT, JitOptLevel, "Sets the optimisation level for translation", 3);
 DefineFlag(JIT, JitDisableBranchOpt, "Disable branch optimisations", false);
+DefineFlag(JIT, JitMergeBlocks, "Translate the target of a direct jump on the same page as part of the jumping block", false);
+DefineFlag(JIT, JitDisableChaining, "Return to the dispatch loop at the end of every block, rather than chaining translated blocks", false);
+DefineFlag(JIT, JitDisableCrossPageChaining, "Only chain translated blocks which are on the same guest page", false);
+DefineFlag(JIT, JitDisableIndirectChaining, "Return to the dispatch loop after indirect jumps, rather than looking up the target inline", false);
+DefineFlag(JIT, JitFlushFullCodeCache, "Discard every translation when the code cache is full, rather than evicting unused ones", false);
 DefineFlag(JIT, JitExtraCounters, "Enable extra JIT counters", false);
 DefineFlag(JIT, JitDebugAA, "Produce alias-analysis debugging output", false);
 DefineFlag(JIT, JitUseIJ, "Use the instruction JIT to perform non-native execution", false);
 DefineFlag(JIT, JitChecksumPages, "Produce and check checksums of JITed code on generation and execution", false);
 DefineFlag(JIT, JitSaveTranslations, "Keep JIT translations between simulation runs", false);
 DefineFlag(JIT, JitLoadTranslations, "Keep JIT translations between simulation runs", false);
+DefineSetting(JIT, JitTranslationFile, "File in which to keep JIT translations between simulation runs", "archsim-txlns.bin");
 
 DefineFlag(JIT, AggressiveCodeInvalidation, "Invalidate all code on a cache flush, rather than just detected modifications", false);
 
@@ -122,6 +133,8 @@ DefineSetting(Platform, KernelArgs, "Arguments to pass into the linux kernel", "
 DefineSetting(Platform, RootFS, "Path to initrd rootfs", "");
 DefineSetting(Platform, BlockDeviceFile, "Path to block device file", "");
 DefineFlag(Platform, CopyOnWrite, "Copy on write block device", false);
+DefineSetting(Platform, BlockDeviceOverlay, "Path to a copy on write overlay for the block device", "");
+DefineFlag(Platform, CommitOverlay, "Commit the block device overlay into the block device file on exit", false);
 DefineIntSetting(Platform, RootFSLocation, "Physical memory location to write initrd to", 0x800000);
 DefineSetting(Platform, Bootloader, "Bootloader for ELF system emulation", "");
 DefineFlag(Platform, SerialGrab, "Take control of the terminal for use as a serial port", false);
@@ -0,0 +1,102 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * TimerWheel.h
+ *
+ * A hierarchical timer wheel, holding timers with absolute deadlines.
+ */
+
+#ifndef INC_UTIL_TIMERWHEEL_H_
+#define INC_UTIL_TIMERWHEEL_H_
+
+#include <cstdint>
+
+namespace archsim
+{
+	namespace util
+	{
+		namespace timing
+		{
+
+			/*
+			 * Timers are kept on one of several levels of 64 slot wheels. A
+			 * timer goes on the lowest level whose slots are coarse enough to
+			 * tell its deadline apart from the current time, so scheduling
+			 * and cancelling take constant time. As time moves on, timers on
+			 * the slots which have been passed are either expired or moved
+			 * down to a finer level.
+			 *
+			 * The wheel does no locking of its own.
+			 */
+			class TimerWheel
+			{
+			public:
+				static const uint32_t kSlotBits = 6;
+				static const uint32_t kSlots = 1 << kSlotBits;
+				static const uint32_t kLevels = (64 + kSlotBits - 1) / kSlotBits;
+				static const uint64_t kNever = ~0ULL;
+
+				class Timer
+				{
+				public:
+					Timer();
+					virtual ~Timer();
+
+					// Called once the wheel's time reaches the deadline. The
+					// timer may be scheduled again from here.
+					virtual void Expired(uint64_t now) = 0;
+
+					bool IsScheduled() const
+					{
+						return scheduled_;
+					}
+
+					uint64_t GetDeadline() const
+					{
+						return deadline_;
+					}
+
+				private:
+					friend class TimerWheel;
+
+					Timer *prev_, *next_;
+					uint64_t deadline_;
+					uint8_t level_, slot_;
+					bool scheduled_;
+				};
+
+				TimerWheel(uint64_t now = 0);
+				~TimerWheel();
+
+				// Schedule the timer, or move it if it is already scheduled. A
+				// deadline which has already passed expires at the next
+				// advance.
+				void Schedule(Timer &timer, uint64_t deadline);
+				void Cancel(Timer &timer);
+
+				// Move time on, expiring every timer whose deadline is at or
+				// before the new time, in deadline order
+				void Advance(uint64_t now);
+
+				// Get the earliest deadline of any scheduled timer, or kNever
+				uint64_t GetNextDeadline() const;
+
+				uint64_t GetTime() const
+				{
+					return now_;
+				}
+
+			private:
+				void insert(Timer &timer);
+				void unlink(Timer &timer);
+
+				uint64_t now_;
+				uint64_t occupied_[kLevels];
+				Timer *slots_[kLevels][kSlots];
+			};
+
+		}
+	}
+}
+
+#endif /* INC_UTIL_TIMERWHEEL_H_ */
@@ -9,7 +9,7 @@
 #define SP804_H
 
 #include "PrimecellRegisterDevice.h"
-#include "abi/devices/generic/timing/TickConsumer.h"
+#include "abi/devices/generic/timing/TickSource.h"
 #include "abi/devices/IRQController.h"
 #include "util/TimerManager.h"
 #include "concurrent/Thread.h"
@@ -30,7 +30,7 @@ namespace archsim
 		{
 			namespace arm
 			{
-				class SP804 : public PrimecellRegisterDevice, public timing::TickConsumer
+				class SP804 : public PrimecellRegisterDevice
 				{
 				public:
 					SP804(EmulationModel &parent, Address base_address);
@@ -50,7 +50,11 @@ namespace archsim
 						suspended = false;
 					};
 
-					class InternalTimer
+					/*
+					 * The counter is only worked out when it is read. The timer
+					 * is scheduled for the tick on which the counter runs out.
+					 */
+					class InternalTimer : public timing::TickTimer
 					{
 					public:
 						uint8_t id;
@@ -78,7 +82,7 @@ namespace archsim
 							return control_reg.bits.int_en;
 						}
 
-						void Tick(uint32_t ticks);
+						void Expired(uint64_t now) override;
 						void TickFile();
 
 						inline bool IsEnabled() const
@@ -91,6 +95,9 @@ namespace archsim
 					private:
 						void Update();
 						void InitialisePeriod();
+						void StartPeriod();
+						uint32_t GetCurrentValue();
+						timing::TickSource &GetTickSource();
 
 						util::timing::TimerManager *mgr;
 						SP804 *owner;
@@ -102,6 +109,7 @@ namespace archsim
 						uint32_t internal_prescale;
 
 						uint64_t ticker, next_irq;
+						uint64_t period_start;
 
 						volatile uint32_t isr;
 
@@ -119,11 +127,6 @@ namespace archsim
 						} control_reg;
 					};
 
-					void Tick(uint32_t tick_periods) override;
-
-				protected:
-					void tick();
-
 				private:
 					void UpdateIRQ();
 
@@ -26,14 +26,12 @@ SP804::SP804(EmulationModel &parent, Address base_address)
 	timers[1].SetManager(parent.timer_mgr);
 	timers[1].id = 1;
 	timers[1].SetOwner(*this);
-
-	parent.GetSystem().GetTickSource()->AddConsumer(*this);
-
 }
 
 SP804::~SP804()
 {
-	emu_model.GetSystem().GetTickSource()->RemoveConsumer(*this);
+	emu_model.GetSystem().GetTickSource()->CancelTimer(timers[0]);
+	emu_model.GetSystem().GetTickSource()->CancelTimer(timers[1]);
 }
 
 bool SP804::Initialise()
@@ -85,17 +83,6 @@ void SP804::UpdateIRQ()
 	}
 }
 
-void SP804::Tick(uint32_t tick_periods)
-{
-	tick();
-}
-
-void SP804::tick()
-{
-	if (timers[0].IsEnabled()) timers[0].Tick(ticks);
-	if (timers[1].IsEnabled()) timers[1].Tick(ticks);
-}
-
 
 SP804::InternalTimer::InternalTimer() :
 	load_value(0),
@@ -103,7 +90,8 @@ SP804::InternalTimer::InternalTimer() :
 	isr(0),
 	enabled(false),
 	internal_prescale(0),
-	ticker(0)
+	ticker(0),
+	period_start(0)
 {
 	control_reg.value = 0x20;
 }
@@ -116,7 +104,7 @@ bool SP804::InternalTimer::ReadRegister(uint32_t offset, uint64_t& data)
 			data = load_value;
 			return true;
 		case 0x4:						// VALUE
-			data = current_value;
+			data = GetCurrentValue();
 			return true;
 
 		case 0x08:						// CONTROL
@@ -145,6 +133,7 @@ bool SP804::InternalTimer::WriteRegister(uint32_t offset, uint32_t data)
 			load_value = data;
 			current_value = data;
 			internal_prescale = 0;
+			if (enabled) StartPeriod();
 			return true;
 		case 0x08:						// CONTROL
 			control_reg.value = data;
@@ -190,7 +179,12 @@ void SP804::InternalTimer::Update()
 		LC_DEBUG1(LogSP804) << "Timer Enabled with current value=" << current_value;
 
 		enabled = true;
+		StartPeriod();
 	} else if (!control_reg.bits.enable && enabled) {
+		// The counter holds its value while the timer is disabled
+		current_value = GetCurrentValue();
+		GetTickSource().CancelTimer(*this);
+
 		enabled = false;
 		LC_DEBUG1(LogSP804) << "Timer Disabled";
 	}
@@ -212,45 +206,51 @@ void SP804::InternalTimer::TickFile()
 
 }
 
-void SP804::InternalTimer::Tick(uint32_t ticks)
+archsim::abi::devices::timing::TickSource &SP804::InternalTimer::GetTickSource()
+{
+	return *owner->emu_model.GetSystem().GetTickSource();
+}
+
+uint32_t SP804::InternalTimer::GetCurrentValue()
 {
-//	fprintf(stderr, "SP804 Internal Timer Tick\n");
 	if (!enabled)
-		return;
+		return current_value;
 
-	/*
-	//	if(!internal_qemu_hack) {
-	//		internal_qemu_hack = true;
-	//		return;
-	//	}
+	// The counter goes down by the owner's tick rate on every tick
+	uint64_t elapsed = (GetTickSource().GetCounter() - period_start) * owner->ticks;
+	if (elapsed >= current_value)
+		return 0;
 
-		uint32_t prescale_val = 10 * 100;
+	return current_value - elapsed;
+}
 
-		internal_prescale += 1;
-		if(internal_prescale < prescale_val) {
-			return;
-		}
+void SP804::InternalTimer::StartPeriod()
+{
+	// The counter runs out on the first tick which finds it at or below
+	// the tick rate
+	uint64_t ticks_left = (current_value + owner->ticks - 1) / owner->ticks;
+	if (ticks_left == 0)
+		ticks_left = 1;
+
+	period_start = GetTickSource().GetCounter();
+	GetTickSource().ScheduleTimer(*this, period_start + ticks_left);
+}
 
-		internal_prescale = 0;
-	*/
-	// Check to see if we've reached zero.
-	if (current_value <= ticks) {
-		isr |= 1;
+void SP804::InternalTimer::Expired(uint64_t now)
+{
+	if (!enabled)
+		return;
 
-		// If the interrupt is enabled, post it.
-		if (control_reg.bits.int_en)
-			owner->UpdateIRQ();
+	isr |= 1;
 
-		// Recalibrate the timer.
-		InitialisePeriod();
+	// If the interrupt is enabled, post it.
+	if (control_reg.bits.int_en)
+		owner->UpdateIRQ();
 
-		// If this is a one-shot timer, then don't restart it.
-		if (control_reg.bits.one_shot) {
-			return;
-		}
-	} else {
-		current_value -= ticks;
-	}
+	// Reload the counter and start counting again. One-shot timers are
+	// reloaded too, as they always have been.
+	InitialisePeriod();
+	StartPeriod();
 }
 
 void SP804::InternalTimer::InitialisePeriod()
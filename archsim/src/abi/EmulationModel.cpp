@@ -38,6 +38,11 @@ void EmulationModel::HandleInterrupt(archsim::core::thread::ThreadInstance* thre
 	UNIMPLEMENTED;
 }
 
+bool EmulationModel::SetThreadIdle(archsim::core::thread::ThreadInstance* thread, bool idle)
+{
+	return false;
+}
+
 ExceptionAction EmulationModel::HandleMemoryFault(archsim::core::thread::ThreadInstance& thread, archsim::MemoryInterface& interface, archsim::Address address)
 {
 	LC_ERROR(LogEmulationModel) << "A memory fault occurred at address " << address;
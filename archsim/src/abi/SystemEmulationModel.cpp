@@ -9,6 +9,7 @@
 #include "abi/devices/DeviceManager.h"
 #include "abi/devices/Component.h"
 #include "abi/devices/MMU.h"
+#include "abi/devices/generic/timing/TickSource.h"
 #include "abi/memory/MemoryModel.h"
 
 #include "core/execution/ExecutionEngineFactory.h"
@@ -22,6 +23,7 @@
 #include "util/ComponentManager.h"
 #include "util/SimOptions.h"
 #include "util/LogContext.h"
+#include "system.h"
 
 #include <unistd.h>
 #include <fcntl.h>
@@ -150,14 +152,45 @@ void SystemEmulationModel::HaltCores()
 	}
 }
 
+bool SystemEmulationModel::SetThreadIdle(ThreadInstance* thread, bool idle)
+{
+	std::lock_guard<std::mutex> lock(idle_lock_);
+
+	if(!idle) {
+		idle_threads_.erase(thread);
+		return false;
+	}
+
+	// Another thread is still running, so this one can sleep until it is
+	// interrupted
+	idle_threads_.insert(thread);
+	if(idle_threads_.size() < threads_.size()) {
+		return true;
+	}
+
+	// Once every thread is waiting for an interrupt, nothing can happen
+	// until the next timer goes off. The last thread to wait moves the
+	// clock on to it and carries on, so that something is always left
+	// running to drive the clock.
+	if(GetSystem().GetTickSource() != nullptr) {
+		GetSystem().GetTickSource()->SkipToNextDeadline();
+	}
+	idle_threads_.erase(thread);
+	return false;
+}
+
 bool SystemEmulationModel::PrepareBoot(System &system)
 {
 	loader::BinaryLoader *loader;
+
+	// Trace filters on functions need the symbols to find them
+	bool load_symbols = archsim::options::TraceSymbols || !archsim::options::TraceFunctions.GetValue().empty();
+
 	if (archsim::options::TargetBinaryFormat == "elf") {
 		if(Is64Bit()) {
-			loader = new loader::SystemElfBinaryLoader<archsim::abi::loader::ElfClass64>(*this, archsim::options::TraceSymbols);
+			loader = new loader::SystemElfBinaryLoader<archsim::abi::loader::ElfClass64>(*this, load_symbols);
 		} else {
-			loader = new loader::SystemElfBinaryLoader<archsim::abi::loader::ElfClass32>(*this, archsim::options::TraceSymbols);
+			loader = new loader::SystemElfBinaryLoader<archsim::abi::loader::ElfClass32>(*this, load_symbols);
 		}
 	} else if (archsim::options::TargetBinaryFormat == "zimage") {
 		if (!archsim::options::ZImageSymbolMap.IsSpecified()) {
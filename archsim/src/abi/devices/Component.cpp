@@ -259,18 +259,11 @@ bool RegisterBackedMemoryComponent::Write(uint32_t offset, uint8_t size, uint64_
 void RegisterBackedMemoryComponent::AddRegister(MemoryRegister& rg)
 {
 	assert(rg.GetOffset() < GetSize());
+	if (rg.GetOffset() >= registers.size())
+		registers.resize(rg.GetOffset() + 1, nullptr);
 	registers[rg.GetOffset()] = &rg;
 }
 
-MemoryRegister *RegisterBackedMemoryComponent::GetRegister(uint32_t offset)
-{
-	register_map_t::iterator rg;
-	rg = registers.find(offset);
-	if (rg == registers.end())
-		return NULL;
-	return rg->second;
-}
-
 uint32_t RegisterBackedMemoryComponent::ReadRegister(MemoryRegister& reg)
 {
 	return reg.Read();
@@ -34,7 +34,11 @@ bool DeviceManager::InstallDevice(guest_addr_t base_address, guest_size_t device
 
 	// Check first: does this device overlap any others?
 	for(guest_addr_t addr = base_address; addr < base_address+device_size; addr += archsim::translate::profile::RegionArch::PageSize) {
-		if(device_bitmap[addr.GetPageIndex()]) {
+		if(addr.GetPageIndex() >= kPageCount) {
+			LC_ERROR(LogDevice) << "Could not map device on page " << std::hex << addr << ": Page is outside of the device address space.";
+			return false;
+		}
+		if(HasDevice(addr)) {
 			LC_ERROR(LogDevice) << "Could not map device on page " << std::hex << addr << ": Devices overlap.";
 			return false;
 		}
@@ -44,33 +48,16 @@ bool DeviceManager::InstallDevice(guest_addr_t base_address, guest_size_t device
 		min_device_address = base_address;
 
 	device_set.insert(&device);
-	devices[base_address] = &device;
 
 	for(guest_addr_t addr = base_address; addr < base_address+device_size; addr += archsim::translate::profile::RegionArch::PageSize) {
-		device_bitmap.set(addr.GetPageIndex());
-	}
-
-	return true;
-}
+		uint64_t page = addr.GetPageIndex();
 
-bool DeviceManager::LookupDevice(memory::guest_addr_t device_address, MemoryComponent*& device)
-{
-	for(auto device_i : devices) {
-		if((device_address >= device_i.first) && (device_address < (device_i.first + device_i.second->GetSize()))) {
-			device = device_i.second;
-			return true;
+		auto &leaf = device_table_[page >> kLeafBits];
+		if(leaf == nullptr) {
+			leaf.reset(new MemoryComponent*[kLeafSize]());
 		}
+		leaf[page & (kLeafSize - 1)] = &device;
 	}
 
-	return false;
-
-//	device_map_t::iterator i = devices.upper_bound(device_address);
-//	if(i == devices.begin()) return false;
-//
-//	i--;
-//
-//	device = i->second;
-//	if((i->first + device->GetSize()) < device_address) return false;
-//	return true;
-
+	return true;
 }
@@ -11,6 +11,7 @@
 #include "system.h"
 #include "abi/devices/MMU.h"
 #include "abi/EmulationModel.h"
+#include "core/thread/ThreadInstance.h"
 #include "util/LogContext.h"
 
 UseLogContext(LogDevice)
@@ -21,9 +22,12 @@ using archsim::Address;
 
 PageInfo::PageInfo() : phys_addr(0), mask(0), Present(0), UserCanRead(0), UserCanWrite(0), KernelCanRead(0), KernelCanWrite(0) {}
 
-MMU::MMU() : should_be_enabled(false) { }
+MMU::MMU() : should_be_enabled(false), phys_mem(nullptr), asid_(0), tlb_subscriber_(nullptr) { }
 
-MMU::~MMU() {}
+MMU::~MMU()
+{
+	delete tlb_subscriber_;
+}
 
 MMU::TranslateResult MMU::TranslateRegion(archsim::core::thread::ThreadInstance *cpu, Address virt_addr, uint32_t size, Address &phys_addr, const struct AccessInfo info)
 {
@@ -32,12 +36,88 @@ MMU::TranslateResult MMU::TranslateRegion(archsim::core::thread::ThreadInstance
 
 void MMU::FlushCaches()
 {
-
+	FlushTLB(true, true);
 }
 
 void MMU::Evict(Address virt_addr)
 {
+	EvictTLB(virt_addr, true, true);
+}
+
+void MMU::FlushTLB(bool instruction, bool data)
+{
+	if(instruction) itlb_.Flush();
+	if(data) dtlb_.Flush();
+}
+
+void MMU::EvictTLB(Address virt_addr, bool instruction, bool data)
+{
+	if(instruction) itlb_.Evict(virt_addr);
+	if(data) dtlb_.Evict(virt_addr);
+}
+
+void MMU::EvictTLBASID(uint32_t asid, bool instruction, bool data)
+{
+	if(instruction) itlb_.EvictASID(asid);
+	if(data) dtlb_.EvictASID(asid);
+}
+
+void MMU::RequestTLBFlush(bool instruction, bool data)
+{
+	if(instruction) itlb_.RequestFlush();
+	if(data) dtlb_.RequestFlush();
+}
+
+static void tlb_flush_callback(PubSubType::PubSubType type, void *context, const void *data)
+{
+	MMU *mmu = (MMU*)context;
+	mmu->RequestTLBFlush(type == PubSubType::ITlbFullFlush, type == PubSubType::DTlbFullFlush);
+}
 
+void MMU::InitialiseTLB()
+{
+	if(tlb_subscriber_ == nullptr) {
+		tlb_subscriber_ = new util::PubSubscriber(Manager->GetEmulationModel()->GetSystem().GetPubSub());
+		tlb_subscriber_->Subscribe(PubSubType::ITlbFullFlush, tlb_flush_callback, this);
+		tlb_subscriber_->Subscribe(PubSubType::DTlbFullFlush, tlb_flush_callback, this);
+	}
+}
+
+bool MMU::LookupTLB(archsim::core::thread::ThreadInstance* cpu, Address virt_addr, Address& phys_addr, const struct AccessInfo &info)
+{
+	bool hit;
+	if(info.Fetch) {
+		hit = itlb_.Lookup(virt_addr, asid_, info.Ring, SoftwareTLB::PermFetch, phys_addr);
+	} else {
+		hit = dtlb_.Lookup(virt_addr, asid_, info.Ring, info.Write ? SoftwareTLB::PermWrite : SoftwareTLB::PermRead, phys_addr);
+	}
+
+	if(cpu != nullptr) {
+		if(hit) {
+			cpu->GetMetrics().MMUTLBHits++;
+		} else {
+			cpu->GetMetrics().MMUTLBMisses++;
+		}
+	}
+
+	return hit;
+}
+
+void MMU::InsertTLB(Address virt_addr, Address phys_addr, const struct AccessInfo &info)
+{
+	if(info.Fetch) {
+		itlb_.Insert(virt_addr, phys_addr, asid_, info.Ring, SoftwareTLB::PermFetch);
+	} else {
+		dtlb_.Insert(virt_addr, phys_addr, asid_, info.Ring, info.Write ? SoftwareTLB::PermWrite : SoftwareTLB::PermRead);
+	}
+}
+
+void MMU::SetASID(uint32_t asid)
+{
+	if(asid != asid_) {
+		asid_ = asid;
+		Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::ASIDChange, this);
+	}
 }
 
 void MMU::set_enabled(bool enabled)
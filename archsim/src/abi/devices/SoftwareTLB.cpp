@@ -0,0 +1,86 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * SoftwareTLB.cpp
+ */
+
+#include "abi/devices/SoftwareTLB.h"
+
+#include <cstring>
+
+using namespace archsim::abi::devices;
+
+SoftwareTLB::SoftwareTLB() : flush_pending_(false)
+{
+	Flush();
+}
+
+void SoftwareTLB::Insert(Address virt_addr, Address phys_addr, uint32_t asid, uint32_t ring, uint8_t perm)
+{
+	auto virt_page = virt_addr.GetPageBase();
+	auto phys_page = phys_addr.GetPageBase();
+	auto set_index = GetSetIndex(virt_addr);
+	auto &set = sets_[set_index];
+
+	// Add the permission to an existing entry for the page, unless the
+	// page has moved since that entry was filled.
+	for(auto &entry : set) {
+		if(entry.Permissions != 0 && entry.VirtPage == virt_page && entry.ASID == asid && entry.Ring == ring) {
+			if(entry.PhysPage == phys_page) {
+				entry.Permissions |= perm;
+			} else {
+				entry.PhysPage = phys_page;
+				entry.Permissions = perm;
+			}
+			return;
+		}
+	}
+
+	Entry *victim = nullptr;
+	for(auto &entry : set) {
+		if(entry.Permissions == 0) {
+			victim = &entry;
+			break;
+		}
+	}
+
+	if(victim == nullptr) {
+		victim = &set[next_victim_[set_index]];
+		next_victim_[set_index] = (next_victim_[set_index] + 1) % kWays;
+	}
+
+	victim->VirtPage = virt_page;
+	victim->PhysPage = phys_page;
+	victim->ASID = asid;
+	victim->Ring = ring;
+	victim->Permissions = perm;
+}
+
+void SoftwareTLB::Flush()
+{
+	flush_pending_.store(false, std::memory_order_relaxed);
+
+	memset(sets_, 0, sizeof(sets_));
+	memset(next_victim_, 0, sizeof(next_victim_));
+}
+
+void SoftwareTLB::Evict(Address virt_addr)
+{
+	auto virt_page = virt_addr.GetPageBase();
+	for(auto &entry : sets_[GetSetIndex(virt_addr)]) {
+		if(entry.VirtPage == virt_page) {
+			entry.Permissions = 0;
+		}
+	}
+}
+
+void SoftwareTLB::EvictASID(uint32_t asid)
+{
+	for(auto &set : sets_) {
+		for(auto &entry : set) {
+			if(entry.ASID == asid) {
+				entry.Permissions = 0;
+			}
+		}
+	}
+}
@@ -258,22 +258,13 @@ public:
 
 	bool Initialise() override
 	{
+		InitialiseTLB();
 		FlushCaches();
 		cocoprocessor = (ArmControlCoprocessor*)Manager->GetDeviceByName("coprocessor");
 		assert(cocoprocessor);
 		return true;
 	}
 
-	void FlushCaches() override
-	{
-	}
-
-
-	void Evict(Address virt_addr) override
-	{
-		// TODO
-	}
-
 	void handle_result(TranslateResult result, archsim::core::thread::ThreadInstance *cpu, Address mva, const struct AccessInfo info)
 	{
 		uint32_t new_fsr = 0;
@@ -467,6 +458,10 @@ public:
 			return TXLN_OK;
 		}
 
+		if(LookupTLB(cpu, mva, phys_addr, info)) {
+			return TXLN_OK;
+		}
+
 		TranslateResult result = TXLN_FAULT_OTHER;
 
 		tx_l1_descriptor first_level_lookup = get_l1_descriptor(mva);
@@ -646,7 +641,7 @@ private:
 		}
 
 		out_phys_addr = Address(section_base_addr | section_index);
-//		update_tlb_entry(mva, out_phys_addr, kernel_mode, !is_write);
+		InsertTLB(mva, out_phys_addr, info);
 		return TXLN_OK;
 	}
 
@@ -704,7 +699,7 @@ private:
 				assert(false);
 		}
 
-//		update_tlb_entry(mva, out_phys_addr, kernel_mode, !is_write);
+		InsertTLB(mva, out_phys_addr, info);
 
 		return TXLN_OK;
 	}
@@ -295,6 +295,7 @@ namespace archsim
 
 				bool Initialise() override
 				{
+					InitialiseTLB();
 					FlushCaches();
 					cocoprocessor = (ArmControlCoprocessorv6*)Manager->GetDeviceByName("coprocessor");
 					assert(cocoprocessor);
@@ -461,6 +462,10 @@ namespace archsim
 						return TXLN_OK;
 					}
 
+					if(LookupTLB(cpu, va, phys_addr, info)) {
+						return TXLN_OK;
+					}
+
 					TranslateResult result = TXLN_FAULT_OTHER;
 
 					/* First-level descriptor indicates whether the access is to a section or to a page table.
@@ -609,7 +614,7 @@ namespace archsim
 					}
 
 					out_phys_addr = Address(section_base_addr | section_index);
-					//		update_tlb_entry(mva, out_phys_addr, kernel_mode, !is_write);
+					InsertTLB(Address(mva), out_phys_addr, info);
 					return TXLN_OK;
 				}
 
@@ -671,7 +676,7 @@ namespace archsim
 							assert(false);
 					}
 
-					//		update_tlb_entry(mva, out_phys_addr, kernel_mode, !is_write);
+					InsertTLB(Address(mva), out_phys_addr, info);
 
 					return TXLN_OK;
 				}
@@ -183,6 +183,11 @@ bool ArmControlCoprocessor::access_cp1(bool is_read, uint32_t &data)
 		bool A = (data & (1 << 1)) != 0;
 		bool M = (data & (1 << 0)) != 0;
 
+		// The access permission checks depend on S and R
+		if(S != cp1_S || R != cp1_R) {
+			get_mmu()->FlushCaches();
+		}
+
 		cp1_M = M;
 		cp1_S = S;
 		cp1_R = R;
@@ -298,8 +303,10 @@ bool ArmControlCoprocessor::access_cp3(bool is_read, uint32_t &data)
 		data = dacr;
 	} else {
 		LC_DEBUG1(LogArmCoprocessorDomain) << "Write of domain access control register";
+		if(dacr != data) {
+			get_mmu()->FlushCaches();
+		}
 		dacr = data;
-		//		get_mmu()->FlushCaches();
 		//		Manager->cpu.memory_model->FlushCaches();
 	}
 	return true;
@@ -566,8 +573,7 @@ bool ArmControlCoprocessor::access_cp8(bool is_read, uint32_t &data)
 			//TODO: change this to actually produce correct behaviour
 			//		assert(Manager->cpu.in_kernel_mode());
 
-			Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::ITlbFullFlush, 0);
-			Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::DTlbFullFlush, 0);
+			invalidate_tlb(true, true, opc2 == 1, data);
 
 			switch (opc2) {
 				case 0:
@@ -589,7 +595,7 @@ bool ArmControlCoprocessor::access_cp8(bool is_read, uint32_t &data)
 			}
 			break;
 		case 5:
-			Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::ITlbFullFlush, 0);
+			invalidate_tlb(true, false, opc2 == 1, data);
 			switch (opc2) {
 				case 0:
 					LC_DEBUG1(LogArmCoprocessorTlb)
@@ -610,7 +616,7 @@ bool ArmControlCoprocessor::access_cp8(bool is_read, uint32_t &data)
 			}
 			break;
 		case 6:
-			Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::DTlbFullFlush, 0);
+			invalidate_tlb(false, true, opc2 == 1, data);
 			switch (opc2) {
 				case 0:
 					LC_DEBUG1(LogArmCoprocessorTlb) << " Invalidate data tlb";
@@ -636,6 +642,24 @@ bool ArmControlCoprocessor::access_cp8(bool is_read, uint32_t &data)
 	return true;
 }
 
+void ArmControlCoprocessor::invalidate_tlb(bool instruction, bool data, bool single_entry, uint32_t mva)
+{
+	auto &pubsub = Manager->GetEmulationModel()->GetSystem().GetPubSub();
+
+	// Single entries are invalidated precisely. ASID matches are treated
+	// as full invalidations, since nothing else caches by ASID.
+	if(single_entry) {
+		Address page = Address(mva).PageBase();
+		get_mmu()->EvictTLB(page, instruction, data);
+
+		if(instruction) pubsub.Publish(PubSubType::ITlbEntryFlush, (void*)page.Get());
+		if(data) pubsub.Publish(PubSubType::DTlbEntryFlush, (void*)page.Get());
+	} else {
+		if(instruction) pubsub.Publish(PubSubType::ITlbFullFlush, 0);
+		if(data) pubsub.Publish(PubSubType::DTlbFullFlush, 0);
+	}
+}
+
 bool ArmControlCoprocessor::access_cp9(bool is_read, uint32_t &data)
 {
 	if (opc1 != 0)
@@ -570,8 +570,7 @@ bool ArmControlCoprocessorv6::access_cp8(bool is_read, uint32_t &data)
 			//TODO: change this to actually produce correct behaviour
 			//		assert(Manager->cpu.in_kernel_mode());
 
-			Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::ITlbFullFlush, 0);
-			Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::DTlbFullFlush, 0);
+			invalidate_tlb(true, true, opc2 == 1, data);
 
 			switch (opc2) {
 				case 0:
@@ -593,7 +592,7 @@ bool ArmControlCoprocessorv6::access_cp8(bool is_read, uint32_t &data)
 			}
 			break;
 		case 5:
-			Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::ITlbFullFlush, 0);
+			invalidate_tlb(true, false, opc2 == 1, data);
 			switch (opc2) {
 				case 0:
 					LC_DEBUG1(LogArmCoprocessorTlb)
@@ -614,7 +613,7 @@ bool ArmControlCoprocessorv6::access_cp8(bool is_read, uint32_t &data)
 			}
 			break;
 		case 6:
-			Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::DTlbFullFlush, 0);
+			invalidate_tlb(false, true, opc2 == 1, data);
 			switch (opc2) {
 				case 0:
 					LC_DEBUG1(LogArmCoprocessorTlb) << " Invalidate data tlb";
@@ -640,6 +639,24 @@ bool ArmControlCoprocessorv6::access_cp8(bool is_read, uint32_t &data)
 	return true;
 }
 
+void ArmControlCoprocessorv6::invalidate_tlb(bool instruction, bool data, bool single_entry, uint32_t mva)
+{
+	auto &pubsub = Manager->GetEmulationModel()->GetSystem().GetPubSub();
+
+	// Single entries are invalidated precisely. ASID matches are treated
+	// as full invalidations, since nothing else caches by ASID.
+	if(single_entry) {
+		Address page = Address(mva).PageBase();
+		get_mmu()->EvictTLB(page, instruction, data);
+
+		if(instruction) pubsub.Publish(PubSubType::ITlbEntryFlush, (void*)page.Get());
+		if(data) pubsub.Publish(PubSubType::DTlbEntryFlush, (void*)page.Get());
+	} else {
+		if(instruction) pubsub.Publish(PubSubType::ITlbFullFlush, 0);
+		if(data) pubsub.Publish(PubSubType::DTlbFullFlush, 0);
+	}
+}
+
 bool ArmControlCoprocessorv6::access_cp9(bool is_read, uint32_t &data)
 {
 	//	fprintf(stderr, "access c9: rm: %x opc1: %x opc2: %x read?: %d\n", rm, opc1, opc2, is_read);
@@ -758,6 +775,9 @@ bool ArmControlCoprocessorv6::access_cp13(bool is_read, uint32_t &data)
 				Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::ITlbFullFlush, 0);
 				Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::DTlbFullFlush, 0);
 
+				// The ASID is held in the bottom byte of CONTEXTIDR
+				get_mmu()->SetASID(contextidr & 0xff);
+
 //				if(Manager->cpu.HasTraceManager())
 //					Manager->cpu.GetTraceManager()->Trace_Reg_Write(true, 0xf0, contextidr);
 //				fprintf(stderr, "*** *** *** OMG A CONTEXTIDR WRITE %x at %x (%llu)\n", contextidr, Manager->cpu.read_pc(), Manager->cpu.metrics.interp_inst_count.get_value());
@@ -3,6 +3,9 @@
 #include "abi/devices/generic/block/BlockDevice.h"
 #include "util/LogContext.h"
 
+#include <cstring>
+#include <vector>
+
 UseLogContext(LogDevice);
 DeclareChildLogContext(LogBlockDevice, LogDevice, "Block");
 
@@ -17,3 +20,44 @@ BlockDevice::~BlockDevice()
 {
 
 }
+
+// Buffers may split blocks between them, so unless there is only one
+// buffer the transfer goes through a bounce buffer
+bool BlockDevice::ReadBlocksV(uint64_t block_idx, const struct iovec* iov, int iovcnt)
+{
+	if(iovcnt == 1) {
+		return ReadBlocks(block_idx, iov[0].iov_len / GetBlockSize(), (uint8_t *)iov[0].iov_base);
+	}
+
+	size_t size = 0;
+	for(int i = 0; i < iovcnt; ++i) {
+		size += iov[i].iov_len;
+	}
+
+	std::vector<uint8_t> bounce (size);
+	if(!ReadBlocks(block_idx, size / GetBlockSize(), bounce.data())) {
+		return false;
+	}
+
+	const uint8_t *data = bounce.data();
+	for(int i = 0; i < iovcnt; ++i) {
+		memcpy(iov[i].iov_base, data, iov[i].iov_len);
+		data += iov[i].iov_len;
+	}
+
+	return true;
+}
+
+bool BlockDevice::WriteBlocksV(uint64_t block_idx, const struct iovec* iov, int iovcnt)
+{
+	if(iovcnt == 1) {
+		return WriteBlocks(block_idx, iov[0].iov_len / GetBlockSize(), (const uint8_t *)iov[0].iov_base);
+	}
+
+	std::vector<uint8_t> bounce;
+	for(int i = 0; i < iovcnt; ++i) {
+		bounce.insert(bounce.end(), (const uint8_t *)iov[i].iov_base, (const uint8_t *)iov[i].iov_base + iov[i].iov_len);
+	}
+
+	return WriteBlocks(block_idx, bounce.size() / GetBlockSize(), bounce.data());
+}
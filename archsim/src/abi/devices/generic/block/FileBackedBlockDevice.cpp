@@ -11,10 +11,15 @@ UseLogContext(LogBlockDevice);
 #include <unistd.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <limits.h>
+#include <errno.h>
+
+#include <algorithm>
+#include <vector>
 
 using namespace archsim::abi::devices::generic::block;
 
-FileBackedBlockDevice::FileBackedBlockDevice() : BlockDevice(), file_data(NULL), use_mmap(false), file_descr(0)
+FileBackedBlockDevice::FileBackedBlockDevice() : BlockDevice(), file_data(NULL), use_mmap(false), file_descr(-1)
 {
 
 }
@@ -75,7 +80,7 @@ bool FileBackedBlockDevice::Open(std::string filename, bool read_only)
 
 void FileBackedBlockDevice::Close()
 {
-	if(file_data == NULL) {
+	if(!IsOpen()) {
 		LC_WARNING(LogBlockDevice) << "Tried to close a file backed block device, but it wasn't open";
 		return;
 	}
@@ -87,6 +92,7 @@ void FileBackedBlockDevice::Close()
 		file_data = NULL;
 	} else {
 		close(file_descr);
+		file_descr = -1;
 	}
 }
 
@@ -218,3 +224,111 @@ bool FileBackedBlockDevice::WriteBlocks(uint64_t block_idx, uint32_t count, cons
 
 	return true;
 }
+
+bool FileBackedBlockDevice::Flush()
+{
+	// A mapped file is private to the simulation, so there is nothing to
+	// make durable
+	if (use_mmap) {
+		return true;
+	}
+
+	return fdatasync(file_descr) == 0;
+}
+
+bool FileBackedBlockDevice::ReadBlocksV(uint64_t block_idx, const struct iovec* iov, int iovcnt)
+{
+	if (use_mmap) {
+		return BlockDevice::ReadBlocksV(block_idx, iov, iovcnt);
+	}
+
+	return TransferBlocksV(block_idx, iov, iovcnt, false);
+}
+
+bool FileBackedBlockDevice::WriteBlocksV(uint64_t block_idx, const struct iovec* iov, int iovcnt)
+{
+	assert(!read_only);
+
+	if (use_mmap) {
+		return BlockDevice::WriteBlocksV(block_idx, iov, iovcnt);
+	}
+
+	return TransferBlocksV(block_idx, iov, iovcnt, true);
+}
+
+bool FileBackedBlockDevice::TransferBlocksV(uint64_t block_idx, const struct iovec* iov, int iovcnt, bool write)
+{
+	uint64_t size = 0;
+	for (int i = 0; i < iovcnt; ++i) {
+		size += iov[i].iov_len;
+	}
+
+	assert(size % GetBlockSize() == 0);
+	uint64_t count = size / GetBlockSize();
+
+	if (block_idx >= block_count || count > block_count - block_idx) {
+		LC_WARNING(LogBlockDevice) << "Attempted to transfer blocks past end of device";
+		return false;
+	}
+
+	LC_DEBUG1(LogBlockDevice) << (write ? "Writing " : "Reading ") << count << " blocks " << block_idx << " from " << iovcnt << " buffers";
+
+	if (write) {
+		writes.inc(count);
+
+		// Blocks are written straight to the file, so any cached copies
+		// are now stale. Reads always go to the file, which is kept up to
+		// date by every write path.
+		for (uint64_t i = 0; i < count; ++i) {
+			cache->InvalidateBlock(block_idx + i);
+		}
+	} else {
+		reads.inc(count);
+	}
+
+	// The list is consumed as the transfer progresses, to deal with short
+	// transfers and lists longer than the host allows in one call.
+	std::vector<struct iovec> remaining (iov, iov + iovcnt);
+	auto next = remaining.begin();
+	off64_t offset = CalculateByteOffset(block_idx);
+
+	while (next != remaining.end()) {
+		int batch = std::min<ptrdiff_t>(remaining.end() - next, IOV_MAX);
+
+		ssize_t transferred = write ? pwritev64(file_descr, &*next, batch, offset) : preadv64(file_descr, &*next, batch, offset);
+		if (transferred < 0) {
+			if (errno == EINTR) continue;
+
+			LC_ERROR(LogBlockDevice) << "Failed to " << (write ? "write" : "read") << " blocks: " << strerror(errno);
+			return false;
+		}
+
+		if (transferred == 0) {
+			// The last block of the device may extend past the end of the
+			// file, in which case the rest of it reads as zeroes
+			if (write) {
+				LC_ERROR(LogBlockDevice) << "Failed to write blocks: no progress";
+				return false;
+			}
+
+			for (; next != remaining.end(); ++next) {
+				bzero(next->iov_base, next->iov_len);
+			}
+			break;
+		}
+
+		offset += transferred;
+		while (transferred > 0) {
+			size_t step = std::min<size_t>(transferred, next->iov_len);
+			next->iov_base = (uint8_t *)next->iov_base + step;
+			next->iov_len -= step;
+			transferred -= step;
+
+			if (next->iov_len == 0) {
+				++next;
+			}
+		}
+	}
+
+	return true;
+}
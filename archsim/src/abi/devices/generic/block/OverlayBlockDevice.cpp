@@ -0,0 +1,429 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include "abi/devices/generic/block/OverlayBlockDevice.h"
+#include "util/LogContext.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+
+UseLogContext(LogBlockDevice);
+DeclareChildLogContext(LogOverlayBlock, LogBlockDevice, "Overlay");
+
+using namespace archsim::abi::devices::generic::block;
+
+static bool transfer_all(int fd, uint64_t offset, void *data, size_t size, bool write)
+{
+	uint8_t *ptr = (uint8_t *)data;
+
+	while (size > 0) {
+		ssize_t transferred = write ? pwrite64(fd, ptr, size, offset) : pread64(fd, ptr, size, offset);
+		if (transferred < 0) {
+			if (errno == EINTR) continue;
+			return false;
+		}
+
+		// The overlay file never has holes past its end, so a short read
+		// means the file has been truncated
+		if (transferred == 0) {
+			return false;
+		}
+
+		ptr += transferred;
+		offset += transferred;
+		size -= transferred;
+	}
+
+	return true;
+}
+
+OverlayBlockDevice::OverlayBlockDevice() : backing(nullptr), file_descr(-1), header(nullptr)
+{
+
+}
+
+OverlayBlockDevice::~OverlayBlockDevice()
+{
+	if (header) Close();
+}
+
+uint64_t OverlayBlockDevice::GetBlockCount() const
+{
+	return backing->GetBlockCount();
+}
+
+uint64_t OverlayBlockDevice::GetBlockSize() const
+{
+	return backing->GetBlockSize();
+}
+
+bool OverlayBlockDevice::Open(BlockDevice& backing, std::string filename)
+{
+	assert(header == nullptr);
+
+	LC_DEBUG1(LogOverlayBlock) << "Opening overlay " << filename;
+
+	uint64_t block_size = backing.GetBlockSize();
+	uint64_t block_count = backing.GetBlockCount();
+	if (kClusterSize % block_size != 0) {
+		LC_ERROR(LogOverlayBlock) << "Block size " << block_size << " does not divide the cluster size";
+		return false;
+	}
+
+	uint64_t clusters = ((block_count * block_size) + kClusterSize - 1) >> kClusterBits;
+	uint64_t l1_entries = (clusters + kL2Entries - 1) >> kL2Bits;
+	if (sizeof(Header) + l1_entries * sizeof(uint64_t) > kClusterSize) {
+		LC_ERROR(LogOverlayBlock) << "Backing device is too large for an overlay";
+		return false;
+	}
+
+	int fd = open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+	if (fd < 0) {
+		LC_ERROR(LogOverlayBlock) << "Failed to open overlay '" << filename << "': " << strerror(errno);
+		return false;
+	}
+
+	// The lock is dropped when the file is closed
+	if (flock(fd, LOCK_EX | LOCK_NB)) {
+		LC_ERROR(LogOverlayBlock) << "Failed to lock overlay '" << filename << "': " << strerror(errno);
+		close(fd);
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st)) {
+		LC_ERROR(LogOverlayBlock) << "Failed to stat overlay";
+		close(fd);
+		return false;
+	}
+
+	bool create = st.st_size == 0;
+	if (create) {
+		if (ftruncate(fd, kClusterSize)) {
+			LC_ERROR(LogOverlayBlock) << "Failed to size overlay: " << strerror(errno);
+			close(fd);
+			return false;
+		}
+	} else if (st.st_size < kClusterSize) {
+		LC_ERROR(LogOverlayBlock) << "Overlay '" << filename << "' is truncated";
+		close(fd);
+		return false;
+	}
+
+	void *metadata = mmap(NULL, kClusterSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (metadata == MAP_FAILED) {
+		LC_ERROR(LogOverlayBlock) << "Failed to map overlay metadata";
+		close(fd);
+		return false;
+	}
+
+	Header *hdr = (Header *)metadata;
+	if (create) {
+		hdr->magic = kMagic;
+		hdr->version = kVersion;
+		hdr->cluster_bits = kClusterBits;
+		hdr->block_size = block_size;
+		hdr->block_count = block_count;
+		hdr->l1_entries = l1_entries;
+		hdr->next_free = kClusterSize;
+	} else if (hdr->magic != kMagic || hdr->version != kVersion || hdr->cluster_bits != kClusterBits) {
+		LC_ERROR(LogOverlayBlock) << "'" << filename << "' is not a supported overlay";
+		munmap(metadata, kClusterSize);
+		close(fd);
+		return false;
+	} else if (hdr->block_size != block_size || hdr->block_count != block_count || hdr->l1_entries != l1_entries) {
+		LC_ERROR(LogOverlayBlock) << "Overlay '" << filename << "' was made for a different backing device";
+		munmap(metadata, kClusterSize);
+		close(fd);
+		return false;
+	} else if (!CheckTables(fd, hdr, st.st_size)) {
+		LC_ERROR(LogOverlayBlock) << "Overlay '" << filename << "' is corrupt";
+		munmap(metadata, kClusterSize);
+		close(fd);
+		return false;
+	}
+
+	this->backing = &backing;
+	file_descr = fd;
+	header = hdr;
+	l2_tables.assign(l1_entries, nullptr);
+
+	LC_DEBUG1(LogOverlayBlock) << "Overlay opened with " << std::dec << GetAllocatedClusterCount() << " clusters";
+
+	return true;
+}
+
+bool OverlayBlockDevice::CheckTables(int fd, const Header *hdr, uint64_t file_size)
+{
+	// Clusters are allocated from the end of the metadata cluster onwards,
+	// so every table must point at a whole cluster below next_free
+	if (hdr->next_free % kClusterSize != 0 || hdr->next_free < kClusterSize || hdr->next_free > file_size) return false;
+
+	auto valid_offset = [hdr](uint64_t offset) {
+		return offset % kClusterSize == 0 && offset >= kClusterSize && offset < hdr->next_free;
+	};
+
+	std::vector<uint64_t> table (kL2Entries);
+	for (uint64_t l1_idx = 0; l1_idx < hdr->l1_entries; ++l1_idx) {
+		uint64_t offset = hdr->l1[l1_idx];
+		if (offset == 0) continue;
+		if (!valid_offset(offset)) return false;
+
+		if (!transfer_all(fd, offset, table.data(), kClusterSize, false)) return false;
+		for (auto entry : table) {
+			if (entry != 0 && !valid_offset(entry)) return false;
+		}
+	}
+
+	return true;
+}
+
+void OverlayBlockDevice::Close()
+{
+	assert(header != nullptr);
+
+	LC_DEBUG1(LogOverlayBlock) << "Closing overlay";
+
+	Flush();
+
+	for (auto table : l2_tables) {
+		if (table) munmap(table, kClusterSize);
+	}
+	l2_tables.clear();
+
+	munmap(header, kClusterSize);
+	close(file_descr);
+
+	header = nullptr;
+	file_descr = -1;
+	backing = nullptr;
+}
+
+bool OverlayBlockDevice::Flush()
+{
+	assert(header != nullptr);
+
+	// Everything written so far, both the data and the tables which point
+	// at it, must reach the disk before the flush completes
+	for (auto table : l2_tables) {
+		if (table && msync(table, kClusterSize, MS_SYNC)) return false;
+	}
+
+	if (msync(header, kClusterSize, MS_SYNC)) return false;
+
+	return fdatasync(file_descr) == 0;
+}
+
+uint64_t OverlayBlockDevice::GetAllocatedClusterCount() const
+{
+	return (header->next_free >> kClusterBits) - 1;
+}
+
+uint64_t OverlayBlockDevice::AllocateCluster()
+{
+	uint64_t offset = header->next_free;
+	if (ftruncate(file_descr, offset + kClusterSize)) {
+		LC_ERROR(LogOverlayBlock) << "Failed to grow overlay: " << strerror(errno);
+		return 0;
+	}
+
+	header->next_free = offset + kClusterSize;
+	return offset;
+}
+
+uint64_t *OverlayBlockDevice::GetL2Table(uint64_t l1_idx, bool allocate)
+{
+	assert(l1_idx < header->l1_entries);
+
+	uint64_t *&table = l2_tables[l1_idx];
+	if (table) return table;
+
+	uint64_t offset = header->l1[l1_idx];
+	if (offset == 0) {
+		if (!allocate) return nullptr;
+
+		// A new cluster is already zeroed, so every entry starts out
+		// pointing at the backing device
+		offset = AllocateCluster();
+		if (offset == 0) return nullptr;
+	}
+
+	void *mapping = mmap(NULL, kClusterSize, PROT_READ | PROT_WRITE, MAP_SHARED, file_descr, offset);
+	if (mapping == MAP_FAILED) {
+		LC_ERROR(LogOverlayBlock) << "Failed to map L2 table";
+		return nullptr;
+	}
+
+	header->l1[l1_idx] = offset;
+	table = (uint64_t *)mapping;
+	return table;
+}
+
+bool OverlayBlockDevice::FillCluster(uint64_t cluster, uint64_t offset)
+{
+	uint64_t first_block = (cluster << kClusterBits) / GetBlockSize();
+	uint64_t count = std::min<uint64_t>(kClusterSize / GetBlockSize(), GetBlockCount() - first_block);
+
+	std::vector<uint8_t> data (kClusterSize, 0);
+	if (!backing->ReadBlocks(first_block, count, data.data())) return false;
+
+	return transfer_all(file_descr, offset, data.data(), data.size(), true);
+}
+
+uint64_t OverlayBlockDevice::GetCluster(uint64_t cluster, bool allocate, bool fill)
+{
+	uint64_t *table = GetL2Table(cluster >> kL2Bits, allocate);
+	if (table == nullptr) return 0;
+
+	uint64_t &entry = table[cluster & (kL2Entries - 1)];
+	if (entry == 0 && allocate) {
+		uint64_t offset = AllocateCluster();
+		if (offset == 0) return 0;
+
+		// The data is copied up before the table points at it. Writes
+		// which cover the whole cluster don't need the old data at all.
+		if (fill && !FillCluster(cluster, offset)) {
+			LC_ERROR(LogOverlayBlock) << "Failed to copy cluster " << cluster << " into overlay";
+			return 0;
+		}
+
+		LC_DEBUG2(LogOverlayBlock) << "Allocated cluster " << cluster << " at " << std::hex << offset;
+		entry = offset;
+	}
+
+	return entry;
+}
+
+bool OverlayBlockDevice::ReadBlock(uint64_t block_idx, uint8_t* buffer)
+{
+	return ReadBlocks(block_idx, 1, buffer);
+}
+
+bool OverlayBlockDevice::ReadBlocks(uint64_t block_idx, uint32_t count, uint8_t* buffer)
+{
+	assert(header != nullptr);
+
+	if (block_idx >= GetBlockCount() || count > GetBlockCount() - block_idx) {
+		LC_WARNING(LogOverlayBlock) << "Attempted to read blocks past end of device";
+		return false;
+	}
+
+	reads.inc(count);
+
+	uint32_t blocks_per_cluster = kClusterSize / GetBlockSize();
+	while (count > 0) {
+		uint64_t cluster = block_idx / blocks_per_cluster;
+		uint32_t cluster_block = block_idx % blocks_per_cluster;
+		uint32_t run = std::min(count, blocks_per_cluster - cluster_block);
+		size_t size = run * GetBlockSize();
+
+		uint64_t offset = GetCluster(cluster, false, false);
+		if (offset == 0) {
+			if (!backing->ReadBlocks(block_idx, run, buffer)) return false;
+		} else {
+			if (!transfer_all(file_descr, offset + cluster_block * GetBlockSize(), buffer, size, false)) return false;
+		}
+
+		block_idx += run;
+		count -= run;
+		buffer += size;
+	}
+
+	return true;
+}
+
+bool OverlayBlockDevice::WriteBlock(uint64_t block_idx, const uint8_t* buffer)
+{
+	return WriteBlocks(block_idx, 1, buffer);
+}
+
+bool OverlayBlockDevice::WriteBlocks(uint64_t block_idx, uint32_t count, const uint8_t* buffer)
+{
+	assert(header != nullptr);
+
+	if (block_idx >= GetBlockCount() || count > GetBlockCount() - block_idx) {
+		LC_WARNING(LogOverlayBlock) << "Attempted to write blocks past end of device";
+		return false;
+	}
+
+	writes.inc(count);
+
+	uint32_t blocks_per_cluster = kClusterSize / GetBlockSize();
+	while (count > 0) {
+		uint64_t cluster = block_idx / blocks_per_cluster;
+		uint32_t cluster_block = block_idx % blocks_per_cluster;
+		uint32_t run = std::min(count, blocks_per_cluster - cluster_block);
+		size_t size = run * GetBlockSize();
+
+		uint64_t offset = GetCluster(cluster, true, run != blocks_per_cluster);
+		if (offset == 0) return false;
+
+		if (!transfer_all(file_descr, offset + cluster_block * GetBlockSize(), (void *)buffer, size, true)) {
+			LC_ERROR(LogOverlayBlock) << "Failed to write overlay: " << strerror(errno);
+			return false;
+		}
+
+		block_idx += run;
+		count -= run;
+		buffer += size;
+	}
+
+	return true;
+}
+
+bool OverlayBlockDevice::Commit()
+{
+	assert(header != nullptr);
+
+	if (backing->IsReadOnly()) {
+		LC_ERROR(LogOverlayBlock) << "Cannot commit an overlay into a read only device";
+		return false;
+	}
+
+	LC_INFO(LogOverlayBlock) << "Committing " << std::dec << GetAllocatedClusterCount() << " clusters into backing device";
+
+	uint32_t blocks_per_cluster = kClusterSize / GetBlockSize();
+	std::vector<uint8_t> data (kClusterSize);
+
+	for (uint64_t l1_idx = 0; l1_idx < header->l1_entries; ++l1_idx) {
+		uint64_t *table = GetL2Table(l1_idx, false);
+		if (table == nullptr) continue;
+
+		for (uint64_t l2_idx = 0; l2_idx < kL2Entries; ++l2_idx) {
+			if (table[l2_idx] == 0) continue;
+
+			uint64_t first_block = ((l1_idx << kL2Bits) + l2_idx) * blocks_per_cluster;
+			uint64_t count = std::min<uint64_t>(blocks_per_cluster, GetBlockCount() - first_block);
+
+			if (!transfer_all(file_descr, table[l2_idx], data.data(), count * GetBlockSize(), false)) return false;
+			if (!backing->WriteBlocks(first_block, count, data.data())) return false;
+		}
+	}
+
+	// Only once the backing device has everything can the overlay go
+	if (!backing->Flush()) return false;
+
+	Reset();
+	return Flush();
+}
+
+void OverlayBlockDevice::Reset()
+{
+	for (auto &table : l2_tables) {
+		if (table) munmap(table, kClusterSize);
+		table = nullptr;
+	}
+
+	bzero(header->l1, header->l1_entries * sizeof(uint64_t));
+	header->next_free = kClusterSize;
+
+	if (ftruncate(file_descr, kClusterSize)) {
+		LC_WARNING(LogOverlayBlock) << "Failed to shrink overlay: " << strerror(errno);
+	}
+}
@@ -11,59 +11,131 @@
 #include "abi/devices/generic/timing/TickConsumer.h"
 #include "util/SimOptions.h"
 
-#include <unistd.h>
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 
 using namespace archsim::abi::devices::timing;
 
 TickConsumer::~TickConsumer() {}
 
-TickSource::TickSource() : tick_count_(0), microticks_(0), microtick_scale_(1.0f/archsim::options::TickScale), running_(false) {}
+TickSource::TickSource() : tick_count_(0), tick_periods_(0), tick_scale_(1.0/archsim::options::TickScale), running_(false), next_deadline_(util::timing::TimerWheel::kNever) {}
 
 TickSource::~TickSource() {}
 
 void TickSource::AddConsumer(TickConsumer &consumer)
 {
-	std::lock_guard<std::mutex>  lock(consumers_lock_);
+	std::lock_guard<std::recursive_mutex>  lock(consumers_lock_);
 	consumers.insert(&consumer);
 }
 
 void TickSource::RemoveConsumer(TickConsumer &consumer)
 {
-	std::lock_guard<std::mutex>  lock(consumers_lock_);
+	std::lock_guard<std::recursive_mutex>  lock(consumers_lock_);
 	consumers.erase(&consumer);
 }
 
+bool TickSource::HasConsumers()
+{
+	std::lock_guard<std::recursive_mutex>  lock(consumers_lock_);
+	return !consumers.empty();
+}
+
+void TickSource::ScheduleTimer(TickTimer &timer, uint64_t deadline)
+{
+	bool earliest = false;
+	{
+		std::lock_guard<std::recursive_mutex>  lock(consumers_lock_);
+		timers_.Schedule(timer, deadline);
+
+		if(deadline < next_deadline_) {
+			next_deadline_ = deadline;
+			earliest = true;
+		}
+	}
+
+	if(earliest) {
+		DeadlinesChanged();
+	}
+}
+
+void TickSource::CancelTimer(TickTimer &timer)
+{
+	// The cached deadline is left alone, which at worst means the next
+	// deadline is looked for again a little early
+	std::lock_guard<std::recursive_mutex>  lock(consumers_lock_);
+	timers_.Cancel(timer);
+}
+
+uint64_t TickSource::GetNextDeadline()
+{
+	std::lock_guard<std::recursive_mutex>  lock(consumers_lock_);
+	return next_deadline_;
+}
+
+void TickSource::DeadlinesChanged()
+{
+
+}
+
+void TickSource::SkipToNextDeadline()
+{
+
+}
+
+uint64_t TickSource::GetTicksForPeriods(uint64_t periods) const
+{
+	return periods * tick_scale_;
+}
+
+uint64_t TickSource::GetPeriodsForTicks(uint64_t ticks) const
+{
+	uint64_t periods = std::ceil(ticks / tick_scale_);
+	while(GetTicksForPeriods(periods) < ticks) {
+		periods++;
+	}
+	return periods;
+}
+
 void TickSource::Start()
 {
-	std::lock_guard<std::mutex>  lock(consumers_lock_);
+	std::lock_guard<std::recursive_mutex>  lock(consumers_lock_);
 	running_ = true;
 }
 
 void TickSource::Stop()
 {
-	std::lock_guard<std::mutex>  lock(consumers_lock_);
+	std::lock_guard<std::recursive_mutex>  lock(consumers_lock_);
 	running_ = false;
 }
 
 
 void TickSource::Tick(uint32_t tick_periods)
 {
-	microticks_ += tick_periods * microtick_scale_;
+	tick_periods_ += tick_periods;
+
+	uint64_t count = GetTicksForPeriods(tick_periods_);
+	if(count == tick_count_) {
+		return;
+	}
+
+	uint32_t elapsed = count - tick_count_;
+	tick_count_ = count;
 
-	if(microticks_ >= 1.0f) {
-		tick_count_ += microticks_;
-		std::lock_guard<std::mutex>  lock(consumers_lock_);
-		if(running_) {
-			for(auto *consumer : consumers) {
-				consumer->Tick(microticks_);
-			}
+	std::lock_guard<std::recursive_mutex>  lock(consumers_lock_);
+	if(running_) {
+		for(auto *consumer : consumers) {
+			consumer->Tick(elapsed);
+		}
+
+		if(tick_count_ >= next_deadline_) {
+			timers_.Advance(tick_count_);
+			next_deadline_ = timers_.GetNextDeadline();
 		}
 	}
-	microticks_ -= (int)microticks_;
 }
 
-MicrosecondTickSource::MicrosecondTickSource(uint32_t tick) : LoopThread("Microsecond Source"), ticks(tick), recalibrate(0), total_overshoot(0), overshoot_samples(0), calibrated_ticks(0)
+MicrosecondTickSource::MicrosecondTickSource(uint32_t tick) : LoopThread("Microsecond Source"), start_(host_clock_t::now()), period_(tick), periods_done_(0), woken_(false)
 {
 	start();
 }
@@ -73,40 +145,151 @@ MicrosecondTickSource::~MicrosecondTickSource()
 	stop();
 }
 
+uint64_t MicrosecondTickSource::GetElapsedPeriods() const
+{
+	return (host_clock_t::now() - start_) / period_;
+}
+
+uint64_t MicrosecondTickSource::GetCounter()
+{
+	// The thread only catches the counter up when it wakes, so work out
+	// where it would be now
+	return std::max(TickSource::GetCounter(), GetTicksForPeriods(GetElapsedPeriods()));
+}
+
 void MicrosecondTickSource::tick()
 {
-	Tick(1);
+	uint64_t elapsed = GetElapsedPeriods();
+	while(periods_done_ < elapsed) {
+		uint32_t periods = std::min<uint64_t>(elapsed - periods_done_, UINT32_MAX);
+		Tick(periods);
+		periods_done_ += periods;
+	}
 
-	if(recalibrate-- == 0) {
-		recalibrate = 1000;
+	host_clock_t::time_point wake = host_clock_t::time_point::max();
+	if(HasConsumers()) {
+		wake = start_ + period_ * (periods_done_ + 1);
+	} else {
+		uint64_t deadline = GetNextDeadline();
+		if(deadline != util::timing::TimerWheel::kNever) {
+			wake = start_ + period_ * std::max(GetPeriodsForTicks(deadline), periods_done_ + 1);
+		}
+	}
 
-		// Attempt a calibration delay and measure how long it lasts
-		auto before = std::chrono::high_resolution_clock::now();
-		usleep(ticks);
-		auto after = std::chrono::high_resolution_clock::now();
+	std::unique_lock<std::mutex> l(wait_lock_);
+	if(wake == host_clock_t::time_point::max()) {
+		wait_cond_.wait(l, [this]() {
+			return woken_;
+		});
+	} else {
+		wait_cond_.wait_until(l, wake, [this]() {
+			return woken_;
+		});
+	}
+	woken_ = false;
+}
 
-		int64_t delta_ticks = std::chrono::duration_cast<std::chrono::microseconds>(after - before).count();
+void MicrosecondTickSource::Wake()
+{
+	{
+		std::lock_guard<std::mutex> l(wait_lock_);
+		woken_ = true;
+	}
+	wait_cond_.notify_one();
+}
 
-		//Figure out the overshoot. If we have overshot by a large amount then schedule another calibration soon
-		int64_t overshoot = delta_ticks - ticks;
-		if(overshoot > ticks) {
-			overshoot = ticks / 2;
-			recalibrate = 50;
-		}
+void MicrosecondTickSource::interrupt()
+{
+	Wake();
+}
 
-		total_overshoot += overshoot;
-		if(overshoot_samples++ >  1000) {
-			overshoot_samples = 1;
-			total_overshoot = overshoot;
-		}
+void MicrosecondTickSource::DeadlinesChanged()
+{
+	Wake();
+}
+
+static void instruction_callback(PubSubType::PubSubType type, void *context, const void *data)
+{
+	((InstructionTickSource*)context)->AddInstructions(1);
+}
 
-		calibrated_ticks = ticks - (total_overshoot / overshoot_samples);
+InstructionTickSource::InstructionTickSource(util::PubSubContext& context) : instructions_(0), catch_up_at_(0), deadline_changes_(0), periods_done_(0)
+{
+	subscription_ = context.Subscribe(PubSubType::InstructionExecute, instruction_callback, this);
+}
 
+InstructionTickSource::~InstructionTickSource()
+{
+	delete subscription_;
+}
+
+uint64_t InstructionTickSource::GetCounter()
+{
+	// Instructions are counted ahead of the tick counter, so work out
+	// where it would be now
+	return std::max(TickSource::GetCounter(), GetTicksForPeriods(instructions_.load()));
+}
+
+void InstructionTickSource::DeadlinesChanged()
+{
+	deadline_changes_++;
+	catch_up_at_ = 0;
+}
+
+void InstructionTickSource::CatchUp()
+{
+	std::lock_guard<std::mutex> l(lock_);
+	CatchUpLocked();
+}
+
+void InstructionTickSource::CatchUpLocked()
+{
+	uint64_t total = instructions_.load();
+	while(periods_done_ < total) {
+		uint32_t periods = std::min<uint64_t>(total - periods_done_, UINT32_MAX);
+		Tick(periods);
+		periods_done_ += periods;
+	}
+
+	uint32_t changes = deadline_changes_.load();
+
+	uint64_t next = UINT64_MAX;
+	if(HasConsumers()) {
+		next = periods_done_ + 1;
 	} else {
-		usleep(calibrated_ticks);
+		uint64_t deadline = GetNextDeadline();
+		if(deadline != util::timing::TimerWheel::kNever) {
+			next = std::max(GetPeriodsForTicks(deadline), periods_done_ + 1);
+		}
+	}
+	catch_up_at_ = next;
+
+	// A timer may have been scheduled on another thread while working out
+	// the next deadline, in which case catch up again straight away
+	if(deadline_changes_.load() != changes) {
+		catch_up_at_ = 0;
 	}
 }
 
+void InstructionTickSource::SkipToNextDeadline()
+{
+	std::lock_guard<std::mutex> l(lock_);
+
+	uint64_t deadline = GetNextDeadline();
+	if(deadline == util::timing::TimerWheel::kNever) {
+		return;
+	}
+
+	// Pretend that the harts kept executing until the deadline
+	uint64_t periods = GetPeriodsForTicks(deadline);
+	uint64_t total = instructions_.load();
+	if(periods > total) {
+		instructions_ += periods - total;
+	}
+
+	CatchUpLocked();
+}
+
 CallbackTickSource::CallbackTickSource(uint32_t scale) : _scale(scale), _curr_scale(0) {}
 
 CallbackTickSource::~CallbackTickSource()
@@ -17,7 +17,9 @@ SifiveCLINT::SifiveCLINT(EmulationModel& parent, Address base_address) : MemoryC
 
 SifiveCLINT::~SifiveCLINT()
 {
-
+	for(auto i : timers_) {
+		delete i;
+	}
 }
 
 bool SifiveCLINT::Initialise()
@@ -28,10 +30,6 @@ bool SifiveCLINT::Initialise()
 		timers_.push_back(new CLINTTimer(hart, this));
 	}
 
-	for(auto i : timers_) {
-		tick_source_->AddConsumer(*i);
-	}
-
 	return true;
 }
 
@@ -140,10 +138,23 @@ CLINTTimer::CLINTTimer(archsim::core::thread::ThreadInstance* hart, SifiveCLINT*
 
 }
 
+CLINTTimer::~CLINTTimer()
+{
+	clint_->GetTickSource()->CancelTimer(*this);
+}
+
 void CLINTTimer::SetCmp(uint64_t cmp)
 {
 	cmp_ = cmp;
 	CheckTick();
+
+	// mtime is the tick counter scaled by 1000, so the interrupt is due on
+	// the first tick for which it passes mtimecmp
+	if(clint_->GetTimer() <= cmp_ && cmp_ != (uint64_t)-1) {
+		clint_->GetTickSource()->ScheduleTimer(*this, cmp_ / 1000 + 1);
+	} else {
+		clint_->GetTickSource()->CancelTimer(*this);
+	}
 }
 
 uint64_t CLINTTimer::GetCmp() const
@@ -153,20 +164,17 @@ uint64_t CLINTTimer::GetCmp() const
 
 void CLINTTimer::CheckTick()
 {
+	// MTIP follows mtime regardless of MTIE, which only decides whether
+	// the pending interrupt is taken
 	if(clint_->GetTimer() > cmp_) {
-		// pend interrupt if it is enabled
-		if(clint_->GetCoprocessor(hart_->GetThreadID())->GetMTIE()) {
-			clint_->GetCoprocessor(hart_->GetThreadID())->MachinePendInterrupt(1 << 7);
-		}
-
+		clint_->GetCoprocessor(hart_->GetThreadID())->MachinePendInterrupt(1 << 7);
 	} else {
-		// unpend interrupt
 		clint_->GetCoprocessor(hart_->GetThreadID())->MachineUnpendInterrupt(1 << 7);
 	}
 }
 
 
-void CLINTTimer::Tick(uint32_t tick_periods)
+void CLINTTimer::Expired(uint64_t now)
 {
 	CheckTick();
 }
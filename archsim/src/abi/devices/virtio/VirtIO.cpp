@@ -170,6 +170,7 @@ void VirtIO::WriteRegister(MemoryRegister& reg, uint32_t value)
 		ProcessQueue(GetQueue(value));
 		LC_DEBUG1(LogVirtIO) << "[" << GetName() << "] Queue Notification Complete, ISR=" << std::hex << InterruptStatus.Get();
 	} else if (reg == InterruptACK) {
+		std::lock_guard<std::mutex> lg(interrupt_lock);
 		InterruptStatus.Set(InterruptStatus.Get() & ~value);
 		if (value != 0 && irq.IsAsserted()) {
 			LC_DEBUG1(LogVirtIO) << "[" << GetName() << "] Rescinding Interrupt";
@@ -177,12 +178,14 @@ void VirtIO::WriteRegister(MemoryRegister& reg, uint32_t value)
 		}
 	}
 
+	std::unique_lock<std::mutex> interrupt_guard(interrupt_lock);
 	if (InterruptStatus.Get() != 0) {
 		if (!irq.IsAsserted()) {
 			LC_DEBUG1(LogVirtIO) << "[" << GetName() << "] Asserting Interrupt";
 			irq.Assert();
 		}
 	}
+	interrupt_guard.unlock();
 
 	RegisterBackedMemoryComponent::WriteRegister(reg, value);
 }
@@ -193,6 +196,7 @@ void VirtIO::ProcessQueue(VirtQueue *queue)
 
 	uint16_t head_idx;
 	const VirtRing::VirtRingDesc *descr;
+	archsim::abi::memory::host_span_list_t spans;
 	while ((descr = queue->PopDescriptorChainHead(head_idx)) != NULL) {
 		VirtIOQueueEvent *evt = new VirtIOQueueEvent (*queue, head_idx);
 
@@ -202,16 +206,20 @@ void VirtIO::ProcessQueue(VirtQueue *queue)
 
 		do {
 			LC_DEBUG1(LogVirtIO) << "[" << GetName() << "] Processing descriptor " << descr->flags << std::hex << " " << descr->paddr << " " << descr->len;
-			host_addr_t descr_host_addr;
-			if (!GetParentModel().GetMemoryModel().LockRegion(Address(descr->paddr), descr->len, descr_host_addr))
+			// A buffer which isn't contiguous in host memory is added as
+			// several buffers
+			bool is_write = descr->flags & 2;
+			if (!GetParentModel().GetMemoryModel().LockSpans(Address(descr->paddr), descr->len, is_write ? archsim::abi::memory::LockWrite : archsim::abi::memory::LockRead, spans))
 				assert(false);
 
-			if (descr->flags & 2) {
-				LC_DEBUG1(LogVirtIO) << "[" << GetName() << "] Adding WRITE buffer @ " << descr_host_addr << ", size = " << descr->len;
-				evt->AddWriteBuffer(descr_host_addr, descr->len);
-			} else {
-				LC_DEBUG1(LogVirtIO) << "[" << GetName() << "] Adding READ buffer @ " << descr_host_addr << ", size = " << descr->len;
-				evt->AddReadBuffer(descr_host_addr, descr->len);
+			for (const auto &span : spans) {
+				if (is_write) {
+					LC_DEBUG1(LogVirtIO) << "[" << GetName() << "] Adding WRITE buffer @ " << span.iov_base << ", size = " << span.iov_len;
+					evt->AddWriteBuffer(span.iov_base, span.iov_len);
+				} else {
+					LC_DEBUG1(LogVirtIO) << "[" << GetName() << "] Adding READ buffer @ " << span.iov_base << ", size = " << span.iov_len;
+					evt->AddReadBuffer(span.iov_base, span.iov_len);
+				}
 			}
 
 			have_next = (descr->flags & 1) == 1;
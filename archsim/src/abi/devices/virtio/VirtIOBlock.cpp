@@ -7,6 +7,7 @@
 #include "abi/devices/virtio/VirtQueue.h"
 #include "abi/devices/IRQController.h"
 #include <string.h>
+#include <pthread.h>
 
 UseLogContext(LogVirtIO);
 DeclareChildLogContext(LogBlock, LogVirtIO, "Block");
@@ -16,7 +17,7 @@ using namespace archsim::abi::devices;
 
 static ComponentDescriptor virtioblock_descriptor ("VirtioBlock");
 VirtIOBlock::VirtIOBlock(EmulationModel& parent_model, IRQLine& irq, Address base_address, std::string name, generic::block::BlockDevice& bdev)
-	: VirtIO(parent_model, irq, base_address, 0x1000, name, 1, 2, 1), bdev(bdev), Component(virtioblock_descriptor)
+	: VirtIO(parent_model, irq, base_address, 0x1000, name, 1, 2, 1), bdev(bdev), Component(virtioblock_descriptor), worker_busy(false), terminate(false)
 {
 	bzero(&config, sizeof(config));
 	config.capacity = bdev.GetBlockCount();
@@ -25,26 +26,39 @@ VirtIOBlock::VirtIOBlock(EmulationModel& parent_model, IRQLine& irq, Address bas
 	config.seg_max = 128-2;
 	config.wce = 1;
 
-	HostFeatures.Set(1 << 6);
+	// Block size and cache flush
+	HostFeatures.Set((1 << 6) | (1 << 9));
 
 	LC_DEBUG1(LogBlock) << "Configured block device with capacity " << std::hex << config.capacity;
+
+	worker = std::thread([this]() {
+		worker_thread_proc();
+	});
 }
 
 VirtIOBlock::~VirtIOBlock()
 {
+	{
+		std::lock_guard<std::mutex> lg(request_lock);
+		terminate = true;
+	}
 
+	request_cond.notify_all();
+	worker.join();
 }
 
 void VirtIOBlock::ResetDevice()
 {
-
+	// The queues are about to be torn down, so let any requests which are
+	// still in flight complete first
+	WaitForIdle();
 }
 
 void VirtIOBlock::WriteRegister(MemoryRegister& reg, uint32_t value)
 {
 	if(reg == HostFeaturesSel) {
 		if(value == 0) {
-			HostFeatures.Set(0x00000040);
+			HostFeatures.Set(0x00000240);
 		} else {
 			HostFeatures.Set(0);
 		}
@@ -53,96 +67,246 @@ void VirtIOBlock::WriteRegister(MemoryRegister& reg, uint32_t value)
 	}
 }
 
+void VirtIOBlock::ProcessEvent(VirtIOQueueEvent* evt)
+{
+	LC_DEBUG1(LogBlock) << "Queueing Event";
+
+	{
+		std::lock_guard<std::mutex> lg(request_lock);
+		pending_requests.push_back(evt);
+	}
 
-void VirtIOBlock::ProcessEvent(VirtIOQueueEvent* evt_)
+	request_cond.notify_one();
+}
+
+void VirtIOBlock::WaitForIdle()
 {
-	VirtIOQueueEvent &evt = *evt_;
-	LC_DEBUG1(LogBlock) << "Processing Event";
+	std::unique_lock<std::mutex> l(request_lock);
+	idle_cond.wait(l, [this]() {
+		return pending_requests.empty() && !worker_busy;
+	});
+}
 
-	if (evt.read_buffers.size() == 0 && evt.write_buffers.size() == 0)
-		return;
+void VirtIOBlock::worker_thread_proc()
+{
+	pthread_setname_np(pthread_self(), "virtio-block");
+
+	std::deque<VirtIOQueueEvent*> requests;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> l(request_lock);
+			request_cond.wait(l, [this]() {
+				return terminate || !pending_requests.empty();
+			});
+
+			// Requests which are still queued are completed before the
+			// worker exits
+			if (pending_requests.empty()) {
+				break;
+			}
 
-	assert(evt.read_buffers.size() > 0);
-	assert(evt.write_buffers.size() > 0);
+			// Take everything which has been queued, so that requests
+			// for neighbouring sectors can be merged
+			requests.swap(pending_requests);
+			worker_busy = true;
+		}
 
-	if (evt.read_buffers.front().size < sizeof(struct virtio_blk_req)) {
-		LC_DEBUG1(LogBlock) << "Discarding event with invalid header";
-		return;
+		// The guest is only interrupted once for each batch
+		if (ProcessRequests(requests)) {
+			AssertInterrupt(1);
+		}
+
+		{
+			std::lock_guard<std::mutex> lg(request_lock);
+			worker_busy = false;
+		}
+
+		idle_cond.notify_all();
 	}
+}
 
-	struct virtio_blk_req *req = (struct virtio_blk_req *)evt.read_buffers.front().data;
+uint32_t VirtIOBlock::ProcessRequests(std::deque<VirtIOQueueEvent*>& requests)
+{
+	uint32_t completed = 0;
 
-	uint8_t *status = (uint8_t *)evt.write_buffers.back().data;
-	switch (req->type) {
-		case 0: // Read
-			assert(evt.write_buffers.size() == 2);
+	while (!requests.empty()) {
+		uint32_t type;
+		uint64_t sector, len;
 
-			if (HandleRead(req->sector, (uint8_t *)evt.write_buffers.front().data, evt.write_buffers.front().size)) {
-				*status = 0;
-			} else {
-				*status = 1;
-			}
+		if (GetTransfer(*requests.front(), type, sector, len)) {
+			completed += ProcessTransfer(requests);
+		} else {
+			VirtIOQueueEvent *evt = requests.front();
+			requests.pop_front();
 
-			evt.response_size = evt.write_buffers.front().size + 1;
-			break;
+			completed += ProcessRequest(evt);
+		}
+	}
+
+	return completed;
+}
+
+uint32_t VirtIOBlock::ProcessRequest(VirtIOQueueEvent* evt)
+{
+	LC_DEBUG1(LogBlock) << "Processing Event";
+
+	if (evt->read_buffers.size() == 0 || evt->write_buffers.size() == 0 || evt->read_buffers.front().size < sizeof(struct virtio_blk_req)) {
+		LC_DEBUG1(LogBlock) << "Discarding event with invalid header";
+		delete evt;
+		return 0;
+	}
+
+	struct virtio_blk_req *req = (struct virtio_blk_req *)evt->read_buffers.front().data;
 
+	uint8_t status;
+	switch (req->type) {
+		case 0: // Read
 		case 1: // Write
-			assert(evt.read_buffers.size() == 2);
+			// Transfers which are well formed never reach here
+			LC_ERROR(LogBlock) << "Rejecting malformed transfer at sector " << std::hex << req->sector;
 
-			if (HandleWrite(req->sector, (uint8_t *)evt.read_buffers.back().data, evt.read_buffers.back().size)) {
-				*status = 0;
-			} else {
-				*status = 1;
-			}
+			status = 1;
+			evt->response_size = 1;
+			break;
 
-			evt.response_size = 1;
+		case 4: // Flush
+			// Requests are carried out in order, so every write which came
+			// before the flush has already been handed to the device
+			status = bdev.Flush() ? 0 : 1;
+			evt->response_size = 1;
 			break;
+
 		case 8: { // Get ID
-			assert(evt.write_buffers.size() == 2);
+			assert(evt->write_buffers.size() == 2);
 
-			char *serial_number = (char *)evt.write_buffers.front().data;
-			strncpy(serial_number, "virtio", evt.write_buffers.front().size);
+			char *serial_number = (char *)evt->write_buffers.front().data;
+			strncpy(serial_number, "virtio", evt->write_buffers.front().size);
 
-			evt.response_size = 1 + 7;
-			*status = 0;
+			evt->response_size = 1 + 7;
+			status = 0;
 
 			break;
 		}
 		default:
 			LC_ERROR(LogBlock) << "Rejecting event with unsupported type " << (uint32_t)req->type;
 
-			*status = 2;
-			evt.response_size = 1;
+			status = 2;
+			evt->response_size = 1;
 			break;
 	}
 
-	evt.owner.Push(evt.Index(), evt.response_size);
-	LC_DEBUG1(LogVirtIO) << "[" << GetName() << "] Pushed a descriptor chain head " << std::dec << evt.Index() << ", length=" << evt.response_size;
+	CompleteRequest(evt, status);
+	return 1;
+}
+
+uint32_t VirtIOBlock::ProcessTransfer(std::deque<VirtIOQueueEvent*>& requests)
+{
+	uint32_t type;
+	uint64_t sector, len;
+	GetTransfer(*requests.front(), type, sector, len);
+
+	// Requests of the same kind for consecutive sectors are carried out as
+	// one transfer
+	std::vector<VirtIOQueueEvent*> merged;
+	std::vector<struct iovec> iov;
+	uint64_t next_sector = sector;
+
+	while (true) {
+		VirtIOQueueEvent *evt = requests.front();
+		requests.pop_front();
+		merged.push_back(evt);
+
+		if (type == 0) {
+			// The data buffers come before the status byte
+			for (auto i = evt->write_buffers.begin(); i != evt->write_buffers.end() - 1; ++i) {
+				iov.push_back({ i->data, i->size });
+			}
+			evt->response_size = len + 1;
+		} else {
+			// The data buffers come after the header
+			for (auto i = evt->read_buffers.begin() + 1; i != evt->read_buffers.end(); ++i) {
+				iov.push_back({ i->data, i->size });
+			}
+			evt->response_size = 1;
+		}
 
-	AssertInterrupt(1);
+		next_sector += len / bdev.GetBlockSize();
 
-	// We're done with the event descriptor so delete it
-	delete evt_;
+		uint32_t next_type;
+		uint64_t next_start;
+		if (requests.empty() || !GetTransfer(*requests.front(), next_type, next_start, len) || next_type != type || next_start != next_sector) {
+			break;
+		}
+	}
+
+	LC_DEBUG1(LogBlock) << "Handling " << (type == 0 ? "read" : "write") << " sector=" << std::hex << sector << ", blocks=" << std::dec << (next_sector - sector) << ", requests=" << merged.size();
+
+	bool success;
+	if (type == 0) {
+		success = bdev.ReadBlocksV(sector, iov.data(), iov.size());
+	} else if (bdev.IsReadOnly()) {
+		LC_ERROR(LogBlock) << "Rejecting write to read only device";
+		success = false;
+	} else {
+		success = bdev.WriteBlocksV(sector, iov.data(), iov.size());
+	}
+
+	for (auto evt : merged) {
+		CompleteRequest(evt, success ? 0 : 1);
+	}
+
+	return merged.size();
 }
 
-uint8_t *VirtIOBlock::GetConfigArea() const
+void VirtIOBlock::CompleteRequest(VirtIOQueueEvent* evt, uint8_t status)
 {
-	return (uint8_t *)&config;
+	*(uint8_t *)evt->write_buffers.back().data = status;
+
+	evt->owner.Push(evt->Index(), evt->response_size);
+	LC_DEBUG1(LogVirtIO) << "[" << GetName() << "] Pushed a descriptor chain head " << std::dec << evt->Index() << ", length=" << evt->response_size;
+
+	// We're done with the event descriptor so delete it
+	delete evt;
 }
 
-uint32_t VirtIOBlock::GetConfigAreaSize() const
+bool VirtIOBlock::GetTransfer(VirtIOQueueEvent& evt, uint32_t& type, uint64_t& sector, uint64_t& len) const
 {
-	return sizeof(config);
+	if (evt.read_buffers.size() == 0 || evt.write_buffers.size() == 0 || evt.read_buffers.front().size < sizeof(struct virtio_blk_req)) {
+		return false;
+	}
+
+	const struct virtio_blk_req *req = (const struct virtio_blk_req *)evt.read_buffers.front().data;
+
+	std::vector<VirtIOQueueEventBuffer>::const_iterator begin, end;
+	switch (req->type) {
+		case 0:
+			begin = evt.write_buffers.begin();
+			end = evt.write_buffers.end() - 1;
+			break;
+		case 1:
+			begin = evt.read_buffers.begin() + 1;
+			end = evt.read_buffers.end();
+			break;
+		default:
+			return false;
+	}
+
+	type = req->type;
+	sector = req->sector;
+	len = 0;
+	for (auto i = begin; i != end; ++i) {
+		len += i->size;
+	}
+
+	return len != 0 && len % bdev.GetBlockSize() == 0;
 }
 
-bool VirtIOBlock::HandleRead(uint64_t sector, uint8_t* buffer, uint32_t len)
+uint8_t *VirtIOBlock::GetConfigArea() const
 {
-	LC_DEBUG1(LogBlock) << "Handling read sector=" << std::hex << sector << ", len=" << std::dec << len;
-	return bdev.ReadBlocks(sector, len / bdev.GetBlockSize(), buffer);
+	return (uint8_t *)&config;
 }
 
-bool VirtIOBlock::HandleWrite(uint64_t sector, uint8_t* buffer, uint32_t len)
+uint32_t VirtIOBlock::GetConfigAreaSize() const
 {
-	LC_DEBUG1(LogBlock) << "Handling write sector=" << std::hex << sector << ", len=" << std::dec << len;
-	return bdev.WriteBlocks(sector, len / bdev.GetBlockSize(), buffer);
+	return sizeof(config);
 }
@@ -13,9 +13,28 @@
 UseLogContext(LogLoader);
 DeclareChildLogContext(LogElf, LogLoader, "ELF");
 
+#include <cstring>
+
 using namespace archsim::abi::loader;
 using archsim::Address;
 
+// Copy segment data into guest memory, directly if the memory model allows
+// it. Returns zero on success, like MemoryModel::Poke.
+static uint32_t copy_segment_data(archsim::abi::memory::MemoryModel &mem_model, Address target_address, const char *data, size_t size)
+{
+	archsim::abi::memory::host_span_list_t spans;
+	if (!mem_model.LockSpans(target_address, size, archsim::abi::memory::LockWrite | archsim::abi::memory::LockBypassProtection, spans)) {
+		return mem_model.Poke(target_address, (uint8_t *)data, size);
+	}
+
+	for (const auto &span : spans) {
+		memcpy(span.iov_base, data, span.iov_len);
+		data += span.iov_len;
+	}
+
+	return 0;
+}
+
 template<typename elfclass> bool ElfBinaryLoader<elfclass>::ProcessSymbolTable(typename elfclass::SHeader *string_table_section, typename elfclass::SHeader *symbol_table_section)
 {
 	using Sym = typename elfclass::Sym;
@@ -204,7 +223,7 @@ template<typename elfclass> bool UserElfBinaryLoader<elfclass>::LoadSegment(type
 		return false;
 	}
 
-	this->_emulation_model.GetMemoryModel().Poke(target_address, (uint8_t *)((unsigned long)this->_elf_header + segment->p_offset), (size_t)segment->p_filesz);
+	copy_segment_data(this->_emulation_model.GetMemoryModel(), target_address, (const char *)((unsigned long)this->_elf_header + segment->p_offset), (size_t)segment->p_filesz);
 	this->_emulation_model.GetMemoryModel().GetMappingManager()->ProtectRegion(aligned_address, region_size, protection);
 
 	if (aligned_address + region_size > _initial_brk) {
@@ -224,5 +243,5 @@ template<typename elfclass> bool SystemElfBinaryLoader<elfclass>::LoadSegment(ty
 	Address target_address = segment->p_paddr + this->_load_bias;
 
 	LC_DEBUG1(LogElf) << "[ELF] Loading ELF Segment, target address = " << std::hex << target_address << " poffset " << segment->p_offset;
-	return this->_emulation_model.GetMemoryModel().Poke(target_address, (uint8_t *)((unsigned long)this->_elf_header + segment->p_offset), (size_t)segment->p_filesz) == 0;
+	return copy_segment_data(this->_emulation_model.GetMemoryModel(), target_address, (const char *)((unsigned long)this->_elf_header + segment->p_offset), (size_t)segment->p_filesz) == 0;
 }
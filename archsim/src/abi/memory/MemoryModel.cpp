@@ -13,6 +13,7 @@
 #include "util/ComponentManager.h"
 #include "abi/devices/MMU.h"
 
+#include <algorithm>
 #include <stdio.h>
 #include <unistd.h>
 #include <fcntl.h>
@@ -107,6 +108,55 @@ bool MemoryModel::LockRegions(guest_addr_t guest_addr, guest_size_t guest_size,
 	return false;
 }
 
+bool MemoryModel::LockSpans(guest_addr_t guest_addr, guest_size_t guest_size, uint32_t lock_type, host_span_list_t &spans)
+{
+	spans.clear();
+
+	// Accesses through the spans would not be seen by event handlers
+	if(HasEventHandlers()) {
+		return false;
+	}
+
+	uint32_t required = RegFlagNone;
+	if(!(lock_type & LockBypassProtection)) {
+		if(lock_type & LockRead) required |= RegFlagRead;
+		if(lock_type & LockWrite) required |= RegFlagWrite;
+		if(lock_type & LockExecute) required |= RegFlagExecute;
+	}
+
+	MappingManager *mappings = GetMappingManager();
+
+	while(guest_size > 0) {
+		guest_size_t chunk = std::min(guest_size, (guest_size_t)(Address::PageSize - guest_addr.GetPageOffset()));
+
+		if(required != RegFlagNone && mappings != nullptr) {
+			RegionFlags prot;
+			if(!mappings->GetRegionProtection(guest_addr, prot) || (prot & required) != required) {
+				return false;
+			}
+		}
+
+		host_addr_t ptr;
+		if(!LockRegion(guest_addr, chunk, ptr)) {
+			return false;
+		}
+
+		if(!spans.empty() && (char*)spans.back().iov_base + spans.back().iov_len == ptr) {
+			spans.back().iov_len += chunk;
+		} else {
+			struct iovec span;
+			span.iov_base = ptr;
+			span.iov_len = chunk;
+			spans.push_back(span);
+		}
+
+		guest_addr += chunk;
+		guest_size -= chunk;
+	}
+
+	return true;
+}
+
 bool MemoryModel::UnlockRegion(guest_addr_t guest_addr, guest_size_t guest_size, host_addr_t host_addr)
 {
 	return false;
@@ -10,9 +10,6 @@
 #endif
 
 #include <sys/mman.h>
-#include <sys/mman.h>
-
-#define ADDRESS_SPACE_SIZE	(0x100000000)
 
 using namespace archsim::abi::memory;
 
@@ -130,14 +127,16 @@ bool SparseMemoryTranslationModel::EmitMemoryWrite(archsim::internal::translate:
 #endif
 #endif
 
-SparseMemoryModel::SparseMemoryModel() : prev_page_data_(nullptr)
+SparseMemoryModel::SparseMemoryModel() : pages_remaining_(1024*1024)
 {
-	pages_remaining_ = 1024*1024;
+
 }
 
 SparseMemoryModel::~SparseMemoryModel()
 {
-
+	pages_.ForEachPage([](uint64_t page_base, char *page) {
+		munmap(page, Address::PageSize);
+	});
 }
 
 bool SparseMemoryModel::SynchroniseVMAProtection(GuestVMA& vma)
@@ -224,41 +223,30 @@ bool SparseMemoryModel::ResizeVMA(GuestVMA &vma, guest_size_t new_size)
 	return true;
 }
 
-char* SparseMemoryModel::GetPageUncached(Address addr)
+char* SparseMemoryModel::AllocatePage(Address addr)
 {
-	char *ptr = nullptr;
-
-	if(!data_.count(addr.PageBase())) {
-
-		if(pages_remaining_ == 0) {
-			throw std::bad_alloc();
-		}
-		pages_remaining_--;
-		ptr = (char*)mmap(0, 4096, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
-		if(ptr == MAP_FAILED) {
+	uint64_t remaining = pages_remaining_.load(std::memory_order_relaxed);
+	do {
+		if(remaining == 0) {
 			throw std::bad_alloc();
 		}
+	} while(!pages_remaining_.compare_exchange_weak(remaining, remaining - 1, std::memory_order_relaxed));
 
-		bzero(ptr, 4096);
-
-		data_[addr.PageBase()] = ptr;
-	} else {
-		ptr = data_.at(addr.PageBase());
+	// Anonymous mappings are already zeroed
+	char *ptr = (char*)mmap(0, Address::PageSize, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if(ptr == MAP_FAILED) {
+		throw std::bad_alloc();
 	}
 
-	return ptr;
-}
-
-
-char* SparseMemoryModel::GetPage(Address addr)
-{
-	std::lock_guard<std::mutex> lg(map_lock_);
-
-	char **ptr_ptr;
-	if(cache_.try_cache_fetch(addr.GetPageIndex(), ptr_ptr) == archsim::util::CACHE_MISS) {
-		*ptr_ptr = GetPageUncached(addr.PageBase());
+	// Another thread may have touched the same page in the meantime, in
+	// which case its page is used instead
+	char *page = pages_.Insert(addr.PageBase().Get(), ptr);
+	if(page != ptr) {
+		munmap(ptr, Address::PageSize);
+		pages_remaining_.fetch_add(1, std::memory_order_relaxed);
 	}
-	return *ptr_ptr;
+
+	return page;
 }
 
 uint32_t SparseMemoryModel::Read(guest_addr_t addr, uint8_t *data, int size)
@@ -293,7 +281,6 @@ uint32_t SparseMemoryModel::Fetch(guest_addr_t addr, uint8_t *data, int size)
 		UNIMPLEMENTED;
 	}
 
-	auto &page = data_[addr.PageBase()];
 	auto offset = addr.GetPageOffset();
 
 	memcpy(data, GetPage(addr) + offset, size);
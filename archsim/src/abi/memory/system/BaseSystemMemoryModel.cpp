@@ -97,9 +97,8 @@ uint32_t BaseSystemMemoryModel::DoRead(guest_addr_t virt_addr, uint8_t *data, in
 
 	if(fault) return fault;
 
-	if(GetDeviceManager()->HasDevice(phys_addr)) {
-		devices::MemoryComponent *dev;
-		GetDeviceManager()->LookupDevice(phys_addr, dev);
+	devices::MemoryComponent *dev = GetDeviceManager()->GetDevice(phys_addr);
+	if(dev != nullptr) {
 
 		uint64_t device_data;
 		uint32_t mask = dev->GetSize()-1;
@@ -179,9 +178,8 @@ uint32_t BaseSystemMemoryModel::DoWrite(guest_addr_t virt_addr, uint8_t *data, i
 	if(fault) return fault;
 
 
-	if(GetDeviceManager()->HasDevice(phys_addr)) {
-		devices::MemoryComponent *dev;
-		GetDeviceManager()->LookupDevice(phys_addr, dev);
+	devices::MemoryComponent *dev = GetDeviceManager()->GetDevice(phys_addr);
+	if(dev != nullptr) {
 
 		LC_DEBUG2(LogSystemMemoryModel) << "Performing device write to address V" << std::hex << virt_addr << "(P" << phys_addr << ")";
 		LC_DEBUG2(LogSystemMemoryModel) << "Hit device " << std::hex << (uint64_t)dev;
@@ -238,7 +236,7 @@ uint32_t BaseSystemMemoryModel::DoWrite(guest_addr_t virt_addr, uint8_t *data, i
 		}
 
 		if (GetCodeRegions().IsRegionCode(PhysicalAddress(phys_addr.Get()))) {
-			GetCodeRegions().InvalidateRegion(PhysicalAddress(phys_addr.Get()));
+			GetCodeRegions().InvalidateRange(PhysicalAddress(phys_addr.Get()), size);
 		}
 
 		return 0;
@@ -360,7 +360,7 @@ uint32_t CacheBasedSystemMemoryModel::Write(guest_addr_t virt_addr, uint8_t *dat
 	}
 
 	if (GetCodeRegions().IsRegionCode(PhysicalAddress(entry->GetPhysAddr().Get()))) {
-		GetCodeRegions().InvalidateRegion(PhysicalAddress(entry->GetPhysAddr().Get()));
+		GetCodeRegions().InvalidateRange(PhysicalAddress(entry->GetPhysAddr().PageBase().Get() + va.GetPageOffset()), size);
 	}
 
 	uint8_t *page_base = (uint8_t*)entry->GetMemory();
@@ -405,7 +405,7 @@ uint32_t CacheBasedSystemMemoryModel::Poke(guest_addr_t virt_addr, uint8_t *data
 		return rc;
 	} else {
 		if (GetCodeRegions().IsRegionCode(PhysicalAddress(phys_addr.Get()))) {
-			GetCodeRegions().InvalidateRegion(PhysicalAddress(phys_addr.Get()));
+			GetCodeRegions().InvalidateRange(PhysicalAddress(phys_addr.Get()), size);
 		}
 
 		return GetPhysMem()->Poke(phys_addr, data, size);
@@ -438,7 +438,7 @@ uint32_t CacheBasedSystemMemoryModel::Write8User(guest_addr_t guest_addr, uint8_
 	if(UNLIKELY(rc)) return rc;
 	else {
 		if (GetCodeRegions().IsRegionCode(PhysicalAddress(phys_addr.Get()))) {
-			GetCodeRegions().InvalidateRegion(PhysicalAddress(phys_addr.Get()));
+			GetCodeRegions().InvalidateRange(PhysicalAddress(phys_addr.Get()), 1);
 		}
 		return GetPhysMem()->Write8(phys_addr, data);
 	}
@@ -452,7 +452,7 @@ uint32_t CacheBasedSystemMemoryModel::Write32User(guest_addr_t guest_addr, uint3
 	if(UNLIKELY(rc)) return rc;
 	else {
 		if (GetCodeRegions().IsRegionCode(PhysicalAddress(phys_addr.Get()))) {
-			GetCodeRegions().InvalidateRegion(PhysicalAddress(phys_addr.Get()));
+			GetCodeRegions().InvalidateRange(PhysicalAddress(phys_addr.Get()), 4);
 		}
 		return GetPhysMem()->Write32(phys_addr, data);
 	}
@@ -487,11 +487,8 @@ uint32_t CacheBasedSystemMemoryModel::UpdateCacheEntry(guest_addr_t addr, SMMCac
 
 	guest_addr_t virt_page_base = addr.PageBase();
 
-	if(GetDeviceManager()->HasDevice(phys_addr)) {
-		abi::devices::MemoryComponent *device = NULL;
-		GetDeviceManager()->LookupDevice(phys_addr, device);
-		assert(device != NULL);
-
+	abi::devices::MemoryComponent *device = GetDeviceManager()->GetDevice(phys_addr);
+	if(device != nullptr) {
 		*entry = SMMCacheEntry(Address(SMMCacheEntry::kInvalidTag), Address(0), device, SMMCacheEntry::kIsDevice);
 		return 0;
 	} else {
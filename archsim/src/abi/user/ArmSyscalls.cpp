@@ -29,6 +29,9 @@
 #include <sys/fcntl.h>
 #include <sys/ioctl.h>
 #include <time.h>
+#include <limits.h>
+#include <algorithm>
+#include <memory>
 #include <linux/futex.h>
 #include <sys/times.h>
 
@@ -70,6 +73,34 @@ static unsigned int translate_fd(archsim::core::thread::ThreadInstance* cpu, int
 	return -1;
 }
 
+// readv and writev accept at most IOV_MAX vectors, so longer span lists are
+// transferred in batches, stopping after the first short transfer
+static ssize_t transfer_spans(ssize_t (*fn)(int, const struct iovec *, int), int fd, const archsim::abi::memory::host_span_list_t &spans)
+{
+	ssize_t total = 0;
+
+	for(size_t i = 0; i < spans.size(); i += IOV_MAX) {
+		int count = std::min(spans.size() - i, (size_t)IOV_MAX);
+
+		size_t expected = 0;
+		for(int j = 0; j < count; ++j) {
+			expected += spans[i + j].iov_len;
+		}
+
+		ssize_t res = fn(fd, &spans[i], count);
+		if(res < 0) {
+			return total != 0 ? total : res;
+		}
+
+		total += res;
+		if((size_t)res < expected) {
+			break;
+		}
+	}
+
+	return total;
+}
+
 static unsigned int sys_exit(archsim::core::thread::ThreadInstance* cpu, unsigned int exit_code)
 {
 	cpu->SendMessage(archsim::core::thread::ThreadMessage::Halt);
@@ -275,27 +306,35 @@ template<typename guest_iovec> static unsigned long sys_writev(archsim::core::th
 		return -1;
 	}
 
-	struct iovec host_vectors[cnt];
 	guest_iovec arm_vectors[cnt];
 
 	auto interface = cpu->GetMemoryInterface(0);
 	interface.Read(Address(iov_addr), (uint8_t *)&arm_vectors, cnt * sizeof(guest_iovec));
 
+	// Point the host vectors straight at guest memory where possible, and
+	// only copy the buffers which can't be accessed directly
+	archsim::abi::memory::host_span_list_t host_vectors, spans;
+	std::vector<std::unique_ptr<char[]>> copies;
+
 	for (int i = 0; i < cnt; i++) {
-		host_vectors[i].iov_base = new char[arm_vectors[i].iov_len];
-		host_vectors[i].iov_len = arm_vectors[i].iov_len;
-		interface.Read(Address(arm_vectors[i].iov_base), (uint8_t *)host_vectors[i].iov_base, arm_vectors[i].iov_len);
+		if (interface.LockSpans(Address(arm_vectors[i].iov_base), arm_vectors[i].iov_len, false, spans)) {
+			host_vectors.insert(host_vectors.end(), spans.begin(), spans.end());
+		} else {
+			copies.emplace_back(new char[arm_vectors[i].iov_len]);
+			interface.Read(Address(arm_vectors[i].iov_base), (uint8_t *)copies.back().get(), arm_vectors[i].iov_len);
+
+			struct iovec copy;
+			copy.iov_base = copies.back().get();
+			copy.iov_len = arm_vectors[i].iov_len;
+			host_vectors.push_back(copy);
+		}
 	}
 
 	fd = cpu->GetEmulationModel().GetSystem().GetFD(fd);
 	fsync(fd);  // HACK?
-	unsigned int res = (uint32_t)writev(fd, host_vectors, cnt);
+	unsigned int res = (uint32_t)transfer_spans(writev, fd, host_vectors);
 	fsync(fd);  // HACK?
 
-	for (int i = 0; i < cnt; i++) {
-		delete[](char*)host_vectors[i].iov_base;
-	}
-
 	return res;
 }
 
@@ -464,19 +503,25 @@ static unsigned long sys_mprotect(archsim::core::thread::ThreadInstance *cpu, un
 
 static unsigned long sys_read(archsim::core::thread::ThreadInstance* cpu, unsigned int fd, unsigned long addr, unsigned int len)
 {
-	char* rd_buf = new char[len];
 	ssize_t res;
 
 	fd = translate_fd(cpu, fd);
-	res = read(fd, (void*)rd_buf, len);
 
 	auto interface = cpu->GetMemoryInterface(0);
 
-	if (res > 0) {
-		interface.Write(Address(addr), (uint8_t *)rd_buf, res);
-	}
+	archsim::abi::memory::host_span_list_t spans;
+	if (interface.LockSpans(Address(addr), len, true, spans)) {
+		res = transfer_spans(readv, fd, spans);
+	} else {
+		char* rd_buf = new char[len];
+		res = read(fd, (void*)rd_buf, len);
 
-	delete[] rd_buf;
+		if (res > 0) {
+			interface.Write(Address(addr), (uint8_t *)rd_buf, res);
+		}
+
+		delete[] rd_buf;
+	}
 
 	if (res < 0)
 		return -errno;
@@ -495,19 +540,25 @@ static unsigned long sys_write(archsim::core::thread::ThreadInstance* cpu, unsig
 		return -EINVAL;
 	}
 
-	char *buffer = (char *)malloc(len);
-	bzero(buffer, len);
-
 	auto interface = cpu->GetMemoryInterface(0);
-	if (interface.Read(Address(addr), (uint8_t *)buffer, len) != archsim::MemoryResult::OK) {
+	fd = translate_fd(cpu, fd);
+
+	archsim::abi::memory::host_span_list_t spans;
+	if (interface.LockSpans(Address(addr), len, false, spans)) {
+		res = transfer_spans(writev, fd, spans);
+	} else {
+		char *buffer = (char *)malloc(len);
+		bzero(buffer, len);
+
+		if (interface.Read(Address(addr), (uint8_t *)buffer, len) != archsim::MemoryResult::OK) {
+			free(buffer);
+			return -EFAULT;
+		}
+
+		res = write(fd, buffer, len);
 		free(buffer);
-		return -EFAULT;
 	}
 
-	fd = translate_fd(cpu, fd);
-	res = write(fd, buffer, len);
-	free(buffer);
-
 
 
 	if (res < 0) {
@@ -61,6 +61,7 @@ Address::underlying_t RiscVMMU::PTE::GetPPN(Mode mode, int level) const
 bool RiscVMMU::Initialise()
 {
 	mode_ = NoTxln;
+	InitialiseTLB();
 
 	return true;
 }
@@ -97,7 +98,7 @@ uint64_t RiscVMMU::GetSATP() const
 	}
 
 	// construct satp from parts
-	return page_table_ppn_ | (uint64_t)asid_ << 22 | (uint64_t)mode_bits << 60;
+	return page_table_ppn_ | (uint64_t)GetASID() << 44 | (uint64_t)mode_bits << 60;
 }
 
 void RiscVMMU::SetSATP(uint64_t new_satp)
@@ -107,9 +108,7 @@ void RiscVMMU::SetSATP(uint64_t new_satp)
 	uint64_t new_mode = new_satp >> 60;
 
 	page_table_ppn_ = new_pt_ppn;
-
-	// do not implement asid
-	asid_ = 0;
+	SetASID(new_asid);
 
 	switch(new_mode) {
 		case 0:
@@ -169,6 +168,12 @@ MMU::TranslateResult RiscVMMU::Translate(archsim::core::thread::ThreadInstance*
 		return TXLN_OK;
 	}
 
+	// Changes to SUM, MPRV or satp flush the TLB, so a hit means that the
+	// page walk below would succeed
+	if(LookupTLB(cpu, virt_addr, phys_addr, info)) {
+		return TXLN_OK;
+	}
+
 	// TODO: satp.ppn size depends on xlen
 	auto satp_ppn = satp & 0xfffffffffff;
 	auto pt_base = satp_ppn * Address::PageSize;
@@ -276,6 +281,7 @@ MMU::TranslateResult RiscVMMU::Translate(archsim::core::thread::ThreadInstance*
 		return MMU::TXLN_FAULT_PAGE;
 	}
 
+	InsertTLB(virt_addr, phys_addr, info);
 	return MMU::TXLN_OK;
 }
 
@@ -1,6 +1,7 @@
 /* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
 
 #include "abi/devices/IRQController.h"
+#include "abi/devices/MMU.h"
 #include "arch/risc-v/RiscVSystemEmulationModel.h"
 #include "arch/risc-v/RiscVSystemCoprocessor.h"
 #include "arch/risc-v/RiscVDecodeContext.h"
@@ -56,6 +57,14 @@ ExceptionAction RiscVSystemEmulationModel::HandleException(archsim::core::thread
 			cpu->GetPubsub().Publish(PubSubType::DTlbFullFlush, nullptr);
 			return ExceptionAction::ResumeNext;
 		}
+		case 1026: { // fence.vma on a single address
+			auto mmu = (archsim::abi::devices::MMU*)cpu->GetPeripherals().GetDeviceByName("mmu");
+			mmu->Evict(Address(data));
+
+			cpu->GetPubsub().Publish(PubSubType::ITlbEntryFlush, (void*)data);
+			cpu->GetPubsub().Publish(PubSubType::DTlbEntryFlush, (void*)data);
+			return ExceptionAction::ResumeNext;
+		}
 		default: {
 			// trigger exception in CPU
 			if(riscv_handle_exception_ == nullptr) {
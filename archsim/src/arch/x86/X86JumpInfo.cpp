@@ -17,6 +17,8 @@ void X86JumpInfoProvider::GetJumpInfo(const gensim::BaseDecode* instr, archsim::
 	info.IsJump = false;
 	info.IsIndirect = false;
 	info.IsConditional = false;
+	info.IsCall = false;
+	info.IsReturn = false;
 
 	// handle rep instructions ('indirect' jump for now)
 	switch(d->Instr_Code) {
@@ -58,5 +60,8 @@ void X86JumpInfoProvider::GetJumpInfo(const gensim::BaseDecode* instr, archsim::
 		if(d->Instr_Code == INST_x86_jcond || d->Instr_Code == INST_x86_jrcxz) {
 			info.IsConditional = true;
 		}
+
+		info.IsCall = d->Instr_Code == INST_x86_call;
+		info.IsReturn = d->Instr_Code == INST_x86_ret;
 	}
 }
@@ -8,4 +8,99 @@ using namespace archsim::blockjit;
 void BlockCache::Invalidate()
 {
 	memset(cache_.data(), 0xff, sizeof(BlockCacheEntry) * kCacheSize);
+	for(auto &features : feature_cache_) {
+		features = BlockFeaturesEntry();
+	}
+	page_slots_.clear();
+	InvalidateReturnStack();
+}
+
+void BlockCache::InvalidatePage(Address page_base)
+{
+	auto page = page_base.GetPageBase();
+
+	auto slots = page_slots_.find(page);
+	if(slots != page_slots_.end()) {
+		for(unsigned word = 0; word < slots->second.size(); ++word) {
+			for(uint64_t bits = slots->second[word]; bits != 0; bits &= bits - 1) {
+				unsigned i = word * 64 + __builtin_ctzll(bits);
+				auto &entry = cache_[i];
+				auto &features = feature_cache_[i];
+
+				if((entry.virt_tag & ~Address::PageMask) == page) {
+					entry.virt_tag = ~0ULL;
+					entry.ptr = (block_txln_fn)~0ULL;
+				}
+				if((features.virt_tag & ~Address::PageMask) == page) {
+					features = BlockFeaturesEntry();
+				}
+			}
+		}
+		page_slots_.erase(slots);
+	}
+
+	for(auto &entry : return_stack_.entries) {
+		if((entry.guest_pc & ~Address::PageMask) == page) {
+			entry.guest_pc = 1;
+			entry.host_fn = nullptr;
+		}
+	}
+}
+
+void BlockCache::InvalidateCode(const std::unordered_set<block_txln_fn> &txlns)
+{
+	if(txlns.empty()) {
+		return;
+	}
+
+	for(unsigned i = 0; i < kCacheSize; ++i) {
+		auto &entry = cache_[i];
+		auto &features = feature_cache_[i];
+
+		if(txlns.count(entry.ptr)) {
+			untrackSlot(features.virt_tag, i);
+			entry.virt_tag = ~0ULL;
+			entry.ptr = (block_txln_fn)~0ULL;
+			features = BlockFeaturesEntry();
+		} else if(features.alt_ptr != nullptr && txlns.count(features.alt_ptr)) {
+			features.alt_ptr = nullptr;
+		}
+	}
+
+	for(auto &entry : return_stack_.entries) {
+		if(txlns.count(entry.host_fn)) {
+			entry.guest_pc = 1;
+			entry.host_fn = nullptr;
+		}
+	}
+}
+
+void BlockCache::trackSlot(uint64_t virt_tag, unsigned slot)
+{
+	page_slots_[virt_tag & ~Address::PageMask][slot / 64] |= 1ULL << (slot % 64);
+}
+
+void BlockCache::untrackSlot(uint64_t virt_tag, unsigned slot)
+{
+	auto slots = page_slots_.find(virt_tag & ~Address::PageMask);
+	if(slots == page_slots_.end()) {
+		return;
+	}
+
+	slots->second[slot / 64] &= ~(1ULL << (slot % 64));
+	for(auto word : slots->second) {
+		if(word != 0) {
+			return;
+		}
+	}
+	page_slots_.erase(slots);
+}
+
+void BlockCache::InvalidateReturnStack()
+{
+	return_stack_.top = 0;
+	for(auto &entry : return_stack_.entries) {
+		entry.guest_pc = 1;
+		entry.host_fn = nullptr;
+	}
 }
@@ -14,15 +14,20 @@
 
 #include "blockjit/BlockJitTranslate.h"
 #include "blockjit/BlockProfile.h"
+#include "blockjit/BlockLinker.h"
 #include "blockjit/block-compiler/block-compiler.h"
 #include "blockjit/block-compiler/lowering/NativeLowering.h"
 #include "blockjit/translation-context.h"
 
 #include "translate/jit_funs.h"
+#include "translate/profile/CodeRegionTracker.h"
 #include "translate/profile/Region.h"
 
 #include "util/LogContext.h"
 #include "abi/devices/MMU.h"
+#include "abi/devices/generic/timing/TickSource.h"
+#include "abi/EmulationModel.h"
+#include "system.h"
 #include <wutils/tick-timer.h>
 #include "blockjit/PerfMap.h"
 #include "blockjit/IRPrinter.h"
@@ -40,7 +45,7 @@ using namespace captive::shared;
 
 using archsim::Address;
 
-BaseBlockJITTranslate::BaseBlockJITTranslate() : _supportChaining(!archsim::options::JitDisableBranchOpt), _supportProfiling(false), _txln_mgr(NULL), _jumpinfo(NULL), _decode(NULL), _should_be_dumped(false), decode_txlt_ctx(nullptr)
+BaseBlockJITTranslate::BaseBlockJITTranslate() : _supportChaining(!archsim::options::JitDisableChaining), _supportProfiling(false), _txln_mgr(NULL), _jumpinfo(NULL), _decode(NULL), _should_be_dumped(false), decode_txlt_ctx(nullptr), _code_lines(0), _relocatable(false)
 {
 
 }
@@ -55,6 +60,7 @@ bool BaseBlockJITTranslate::translate_block(archsim::core::thread::ThreadInstanc
 {
 	// Initialise the translation context
 	_should_be_dumped = false;
+	_code_lines = 0;
 
 	SetDecodeContext(processor->GetEmulationModel().GetNewDecodeContext(*processor));
 
@@ -95,6 +101,7 @@ bool BaseBlockJITTranslate::translate_block(archsim::core::thread::ThreadInstanc
 	// Fill in the output translation data structure with the translated
 	// function and feature vector
 	AttachFeaturesTo(out_txln);
+	out_txln.SetCodeLines(_code_lines);
 
 	timer.tick("compile");
 
@@ -111,6 +118,10 @@ void BaseBlockJITTranslate::setSupportProfiling(bool enable)
 {
 	_supportProfiling = enable;
 }
+void BaseBlockJITTranslate::setBlockProfiler(const block_profiler_t &profiler)
+{
+	_block_profiler = profiler;
+}
 void BaseBlockJITTranslate::setTranslationMgr(archsim::translate::TranslationManager *txln_mgr)
 {
 	_txln_mgr = txln_mgr;
@@ -213,6 +224,8 @@ bool BaseBlockJITTranslate::emit_instruction(archsim::core::thread::ThreadInstan
 	_decode_ctx->WriteBackState(cpu);
 	assert(!fault);
 
+	_code_lines |= archsim::translate::profile::CodeRegionTracker::GetLineMask(pc.GetPageOffset(), insn->Instr_Length);
+
 	if(insn->Instr_Code == 65535) {
 		LC_DEBUG1(LogBlockJit) << "Invalid instruction! 0x" << std::hex << insn->ir;
 		std::cout << "Invalid instruction! PC:" << std::hex << pc.Get() << ": IR:" << std::hex << insn->ir << " ISAMODE:" << (uint32_t)insn->isa_mode << "\n";
@@ -232,10 +245,6 @@ bool BaseBlockJITTranslate::emit_instruction_decoded(archsim::core::thread::Thre
 		builder.count(IROperand::const64((uint64_t)processor->GetMetrics().JITInstructionCount.get_ptr()), IROperand::const64(1));
 	}
 
-	if(archsim::options::InstructionTick) {
-		builder.call(IROperand::func((void*)cpuInstructionTick), IROperand::const64((uint64_t)(void*)processor));
-	}
-
 	if(archsim::options::Profile) {
 		builder.count(IROperand::const64((uint64_t)processor->GetMetrics().OpcodeHistogram.get_value_ptr_at_index(decode->Instr_Code)), IROperand::const64(1));
 	}
@@ -246,15 +255,28 @@ bool BaseBlockJITTranslate::emit_instruction_decoded(archsim::core::thread::Thre
 		builder.count(IROperand::const64((uint64_t)processor->GetMetrics().InstructionIRHistogram.get_value_ptr_at_index(decode->ir)), IROperand::const64(1));
 	}
 
-	if(processor->GetTraceSource()) {
+	// PC filters are decided now, for the virtual PC this block is being
+	// translated at, but the other filters can change while the translation
+	// is live, so the translation is versioned on them
+	bool trace = processor->GetTraceSource() != nullptr;
+	auto filter = processor->GetTraceFilter();
+	if(trace && filter != nullptr) {
+		trace = filter->ShouldTracePC(pc);
+		if(trace && filter->IsDynamic()) {
+			trace = GetFeatureLevel(filter->GetActiveFeature()) != 0;
+		}
+	}
+
+	if(trace) {
 		IRRegId pc_reg = builder.alloc_reg(8);
 		builder.ldpc(IROperand::vreg(pc_reg, 8));
 		builder.bitwise_and(IROperand::const64(0xfffffffffffff000), IROperand::vreg(pc_reg, 8));
 		builder.bitwise_or(IROperand::const64(pc.GetPageOffset()), IROperand::vreg(pc_reg, 8));
-		builder.call(IROperand::const32(0), IROperand::func((void*)cpuTraceInstruction), IROperand::vreg(pc_reg, 8), IROperand::const32(decode->GetIR()), IROperand::const8(decode->isa_mode), IROperand::const8(0));
+		builder.trace(libtrace::InstructionHeader, decode->isa_mode, IROperand::vreg(pc_reg, 8));
+		builder.trace(libtrace::InstructionCode, 0, IROperand::const32(decode->GetIR()));
 	}
 
-	translate_instruction(decode, builder, processor->GetTraceSource() != nullptr);
+	translate_instruction(decode, builder, trace);
 
 	if(decode_txlt_ctx == nullptr) {
 		if(!GetComponentInstance(processor->GetArch().GetName(), decode_txlt_ctx)) {
@@ -264,10 +286,6 @@ bool BaseBlockJITTranslate::emit_instruction_decoded(archsim::core::thread::Thre
 
 	decode_txlt_ctx->Translate(processor, *decode, *_decode_ctx, builder);
 
-	if(processor->GetTraceSource()) {
-		builder.call(IROperand::const32(0), IROperand::func((void*)cpuTraceInsnEnd));
-	}
-
 	return true;
 }
 
@@ -276,7 +294,9 @@ bool BaseBlockJITTranslate::can_merge_jump(archsim::core::thread::ThreadInstance
 	// only end of block instructions are jumps
 	assert(decode->GetEndOfBlock());
 
-	if(!_supportChaining) {
+	// Merging changes which instructions a translation covers, so it is
+	// only done when asked for
+	if(!_supportChaining || !archsim::options::JitMergeBlocks || archsim::options::JitDisableBranchOpt) {
 		return false;
 	}
 
@@ -313,18 +333,19 @@ bool BaseBlockJITTranslate::emit_block(archsim::core::thread::ThreadInstance *pr
 	uint32_t pc_page = block_address.GetPageBase();
 
 	uint32_t phys_page = 0;
-	if(archsim::options::ProfilePcFreq || _supportProfiling) {
+	if(archsim::options::ProfilePcFreq) {
 		UNIMPLEMENTED;
 		//		processor->GetFetchMI().PerformTranslation(pc.GetPageBase(), phys_page, MMUACCESSINFO(processor->in_kernel_mode(), false, true));
 	}
 
-	if(_supportProfiling) {
-		UNIMPLEMENTED;
-
-//		_txln_mgr->GetRegion(phys_page).TraceBlock(*processor, pc.Get());
-//		auto &rgn = _txln_mgr->GetRegion(phys_page);
-//
-//		builder.profile(IROperand::const64((uint64_t)&rgn), IROperand::const32(block_address.GetPageOffset()));
+	if(_supportProfiling && _block_profiler) {
+		Address phys_pc;
+		if(processor->GetFetchMI().PerformTranslation(pc, phys_pc, false, true, false) == archsim::TranslationResult::OK) {
+			uint64_t *counter = _block_profiler(pc, phys_pc, GetIsaMode());
+			if(counter != nullptr) {
+				builder.profile(IROperand::const64((uint64_t)counter));
+			}
+		}
 	}
 
 	LC_DEBUG3(LogBlockJit) << "Translating block " << std::hex << pc.Get() << " " << _decode->Instr_Code << " " << _decode->ir;
@@ -357,6 +378,7 @@ bool BaseBlockJITTranslate::emit_block(archsim::core::thread::ThreadInstance *pr
 				Address target = get_jump_target(processor, _decode, pc);
 				if(!block_heads.count(target)) {
 					block_heads.insert(target);
+					emit_instruction_tick(processor, count, builder);
 //					if(archsim::options::Verify && archsim::options::VerifyBlocks) builder.verify(IROperand::pc(pc.Get()));
 					return emit_block(processor, target, builder, block_heads);
 				}
@@ -370,81 +392,90 @@ bool BaseBlockJITTranslate::emit_block(archsim::core::thread::ThreadInstance *pr
 
 //	if(archsim::options::Verify && archsim::options::VerifyBlocks) builder.verify(IROperand::pc(pc.Get()));
 
+	emit_instruction_tick(processor, count, builder);
+
 	// attempt to chain (otherwise return)
 	emit_chain(processor, pc, _decode, builder);
 
 	return success;
 }
 
+void BaseBlockJITTranslate::emit_instruction_tick(archsim::core::thread::ThreadInstance *processor, uint32_t count, captive::shared::IRBuilder &builder)
+{
+	// Advance the clock once for each run of instructions, rather than on
+	// every instruction. Instructions which fault part way through a block
+	// don't count. cpuInstructionTick relies on the tick source type being
+	// checked here.
+	auto tick_source = processor->GetEmulationModel().GetSystem().GetTickSource();
+	if(archsim::options::InstructionTick && count && dynamic_cast<archsim::abi::devices::timing::InstructionTickSource*>(tick_source) != nullptr) {
+		builder.call(IROperand::const32(0), IROperand::func((void*)cpuInstructionTick), IROperand::const32(count));
+	}
+}
+
 bool BaseBlockJITTranslate::emit_chain(archsim::core::thread::ThreadInstance *processor, archsim::Address pc, gensim::BaseDecode *decode, captive::shared::IRBuilder &builder)
 {
-	// If this instruction is an end of block (rather than the start of the next page)
-	// then we might be able to chain
+	// Chaining emits exits for the successors of this block. Exits to
+	// statically known successors are linked to their targets by the
+	// execution engine once both blocks have been translated, and exits to
+	// computed targets look the target up in the block cache.
 
 	// First, figure out if we should try to chain. We should only try to chain
-	// if we are at the end of a block, if chaining is enabled, and if the
-	// context is valid (isa mode and features).)
-	if(decode->GetEndOfBlock() && _supportChaining && _isa_mode_valid && _features_valid) {
-		Address target_pc = 0_ga, fallthrough_pc = 0_ga;
-
-		JumpInfo jump_info;
-		// TODO: change target_pc_naked to actually be an Address instead of a uint32
-		_jumpinfo->GetJumpInfo(decode, pc, jump_info);
-		fallthrough_pc = pc + decode->Instr_Length;
-
-		// Can only chain on a direct jump
-		if(!jump_info.IsIndirect) {
-			auto target_page = jump_info.JumpTarget.GetPageBase();
-			auto fallthrough_page = fallthrough_pc.GetPageBase();
-
-			// Can only chain if the target of the jump is on the same page as the rest of the block
-			if(target_page == pc.GetPageBase()) {
-				// If instruction is not predicated, don't use a fallthrough pc
-				// XXX ARM HAX
-				if(!decode->GetIsPredicated()) {
-					fallthrough_pc = 0_ga;
-				}
-
-				//need to translate target and fallthrough PCs
-
-				Address target_ppc(0), fallthrough_ppc(0);
-				if(target_pc != Address::NullPtr) processor->GetFetchMI().PerformTranslation(target_pc, target_ppc, false, true, false);
-				if(fallthrough_pc != Address::NullPtr) processor->GetFetchMI().PerformTranslation(fallthrough_pc, fallthrough_ppc, false, true, false);
+	// if chaining is enabled, and if the context is valid (isa mode and features).
+	if(!_supportChaining || !_isa_mode_valid || !_features_valid) {
+		builder.ret();
+		return true;
+	}
 
-				archsim::blockjit::BlockTranslation target_fn;
-				archsim::blockjit::BlockTranslation fallthrough_fn;
+	// Figure out what kind of exit a direct jump to the given PC needs
+	auto direct_kind = [&](Address exit_pc) -> uint8_t {
+		if(exit_pc.GetPageBase() == pc.GetPageBase()) return archsim::blockjit::ChainSamePage;
+		if(archsim::options::JitDisableCrossPageChaining) return archsim::blockjit::ChainNone;
+		return archsim::blockjit::ChainCrossPage;
+	};
 
-				block_txln_fn target_fn_ptr = nullptr, fallthrough_fn_ptr = nullptr;
+	Address target_pc = 0_ga, fallthrough_pc = 0_ga;
+	uint8_t target_kind = archsim::blockjit::ChainNone, fallthrough_kind = archsim::blockjit::ChainNone;
 
-				if(target_ppc.Get() != 0) {
-//					processor->GetTranslatedBlock(target_ppc, GetProcessorFeatures(), target_fn);
-				}
-				if(fallthrough_ppc.Get() != 0) {
-//					processor->GetTranslatedBlock(fallthrough_ppc, GetProcessorFeatures(), fallthrough_fn);
-				}
-
-				// actually get functions
-				if(fallthrough_fn.IsValid(GetProcessorFeatures())) {
-					fallthrough_fn_ptr = fallthrough_fn.GetFn();
-				}
+	if(decode->GetEndOfBlock()) {
+		JumpInfo jump_info;
+		_jumpinfo->GetJumpInfo(decode, pc, jump_info);
 
-				if(target_fn.IsValid(GetProcessorFeatures())) {
-					target_fn_ptr = target_fn.GetFn();
-				}
+		if(jump_info.IsJump && !jump_info.IsIndirect) {
+			target_pc = jump_info.JumpTarget;
+			target_kind = direct_kind(target_pc);
 
-				if(fallthrough_fn_ptr != nullptr || target_fn_ptr != nullptr) {
-					builder.dispatch(IROperand::const32(target_pc.Get()), IROperand::const32(fallthrough_pc.Get()), IROperand::const64((uint64_t)target_fn_ptr), IROperand::const64((uint64_t)fallthrough_fn_ptr));
-					return true;
-				}
-			} else {
-//				fprintf(stderr, "*** Couldn't chain due to cross page jump\n");
+			// XXX ARM HAX
+			if(jump_info.IsConditional || decode->GetIsPredicated()) {
+				fallthrough_pc = pc + decode->Instr_Length;
+				fallthrough_kind = direct_kind(fallthrough_pc);
 			}
-		} else {
-//			fprintf(stderr, "*** Couldn't chain due to indirect jump\n");
+		} else if(jump_info.IsJump && !archsim::options::JitDisableIndirectChaining) {
+			// Any PC could follow an indirect jump (including the fallthrough
+			// of a conditional one), so just look it up at run time
+			target_kind = jump_info.IsReturn ? archsim::blockjit::ChainReturn : archsim::blockjit::ChainIndirect;
 		}
+
+		// Predict that an unconditional call will return to the instruction
+		// after it. ARM marks every BL as conditional, so go by whether this
+		// particular instruction is predicated.
+		if(jump_info.IsJump && jump_info.IsCall && !decode->GetIsPredicated()) {
+			fallthrough_pc = pc + decode->Instr_Length;
+			fallthrough_kind = archsim::blockjit::ChainCall;
+		}
+	} else {
+		// The block was split because it reached the end of the page, or
+		// the instruction limit, so pc is the next instruction to execute
+		target_pc = pc;
+		target_kind = direct_kind(target_pc);
 	}
-	// If we couldn't find any way to chain, then just return
-	builder.ret();
+
+	if(target_kind == archsim::blockjit::ChainNone && fallthrough_kind == archsim::blockjit::ChainNone) {
+		// If we couldn't find any way to chain, then just return
+		builder.ret();
+	} else {
+		builder.dispatch(IROperand::const64(target_pc.Get()), IROperand::const64(fallthrough_pc.Get()), IROperand::const8(target_kind), IROperand::const8(fallthrough_kind));
+	}
+
 	return true;
 }
 
@@ -463,6 +494,11 @@ bool BaseBlockJITTranslate::compile_block(archsim::core::thread::ThreadInstance
 	auto lowering = captive::arch::jit::lowering::NativeLowering(ctx, allocator, cpu->GetArch(), cpu->GetStateBlock().GetDescriptor(), result);
 	fn.SetFn(lowering.Function);
 
+	// These options embed pointers to per-run counters in the code
+	_relocatable = !(_supportProfiling || archsim::options::Verbose || archsim::options::Profile || archsim::options::ProfilePcFreq || archsim::options::ProfileIrFreq);
+	_host_relocations = std::move(lowering.HostRelocations);
+	_chain_slots = std::move(lowering.ChainSlots);
+
 	if(dump) {
 		ctx.trim();
 
@@ -0,0 +1,118 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * BlockLinker.cpp
+ */
+
+#include "blockjit/BlockLinker.h"
+#include "util/LogContext.h"
+
+UseLogContext(LogBlockProfile);
+
+using namespace archsim::blockjit;
+
+void BlockLinker::Link(BlockChainSlot* slot, block_txln_fn target, bool feature_dependent)
+{
+	auto existing = links_.find(slot);
+	if(existing != links_.end()) {
+		// Another thread may have linked this exit already
+		if(existing->second.Target == target) return;
+		unlink(slot);
+	}
+
+	LC_DEBUG2(LogBlockProfile) << "Linking exit " << (void*)slot << " of " << (void*)slot->Source << " to " << (void*)target;
+
+	links_[slot] = {target, feature_dependent};
+	incoming_[target].push_back(slot);
+	outgoing_[(block_txln_fn)slot->Source].push_back(slot);
+
+	// An aligned 8 byte store is atomic with respect to the indirect jump
+	// which reads the slot
+	__atomic_store_n(&slot->Target, (uint64_t)target, __ATOMIC_RELEASE);
+}
+
+void BlockLinker::unlink(BlockChainSlot* slot)
+{
+	__atomic_store_n(&slot->Target, slot->Unlinked, __ATOMIC_RELEASE);
+	links_.erase(slot);
+}
+
+void BlockLinker::UnlinkTarget(block_txln_fn target)
+{
+	auto incoming = incoming_.find(target);
+	if(incoming == incoming_.end()) return;
+
+	// The incoming list may contain slots which have since been relinked
+	// elsewhere, or whose translations have been removed
+	for(auto slot : incoming->second) {
+		auto link = links_.find(slot);
+		if(link != links_.end() && link->second.Target == target) {
+			unlink(slot);
+		}
+	}
+
+	incoming_.erase(incoming);
+}
+
+void BlockLinker::Remove(block_txln_fn txln)
+{
+	UnlinkTarget(txln);
+
+	auto outgoing = outgoing_.find(txln);
+	if(outgoing == outgoing_.end()) return;
+
+	// The code containing these slots is about to be freed, so just forget
+	// about them rather than writing to them
+	for(auto slot : outgoing->second) {
+		auto link = links_.find(slot);
+		if(link != links_.end() && (block_txln_fn)slot->Source == txln) {
+			links_.erase(link);
+		}
+	}
+
+	outgoing_.erase(outgoing);
+}
+
+template<typename Pred> void BlockLinker::unlinkIf(Pred pred)
+{
+	for(auto i = links_.begin(); i != links_.end();) {
+		if(pred(i->first, i->second)) {
+			__atomic_store_n(&i->first->Target, i->first->Unlinked, __ATOMIC_RELEASE);
+			i = links_.erase(i);
+		} else {
+			++i;
+		}
+	}
+}
+
+void BlockLinker::UnlinkCrossPage()
+{
+	unlinkIf([](const BlockChainSlot *slot, const LinkInfo &) {
+		return (slot->Flags & BlockChainSlot::CrossPage) != 0;
+	});
+}
+
+void BlockLinker::UnlinkCrossPageInto(Address page_base)
+{
+	auto page = page_base.GetPageBase();
+	unlinkIf([page](const BlockChainSlot *slot, const LinkInfo &) {
+		return (slot->Flags & BlockChainSlot::CrossPage) != 0 && (slot->GuestPC & ~Address::PageMask) == page;
+	});
+}
+
+void BlockLinker::UnlinkFeatureDependent()
+{
+	unlinkIf([](const BlockChainSlot *, const LinkInfo &info) {
+		return info.FeatureDependent;
+	});
+}
+
+void BlockLinker::UnlinkAll()
+{
+	unlinkIf([](const BlockChainSlot *, const LinkInfo &) {
+		return true;
+	});
+
+	incoming_.clear();
+	outgoing_.clear();
+}
@@ -7,6 +7,7 @@
  *      Author: harry
  */
 
+#include <algorithm>
 #include <vector>
 
 #include "blockjit/BlockProfile.h"
@@ -32,6 +33,20 @@ bool BlockTranslation::FeaturesValid(const archsim::ProcessorFeatureSet& feature
 	return true;
 }
 
+bool BlockTranslation::HasSameFeatures(const BlockTranslation& other) const
+{
+	if(features_required_ == nullptr || other.features_required_ == nullptr) {
+		return features_required_ == other.features_required_;
+	}
+
+	auto i = features_required_->begin(), j = other.features_required_->begin();
+	for(; i != features_required_->end() && j != other.features_required_->end(); ++i, ++j) {
+		if(*i != *j) return false;
+	}
+
+	return i == features_required_->end() && j == other.features_required_->end();
+}
+
 void BlockTranslation::Dump(const std::string &filename)
 {
 	std::ofstream f(filename);
@@ -39,10 +54,11 @@ void BlockTranslation::Dump(const std::string &filename)
 }
 
 
-BlockPageProfile::BlockPageProfile(wulib::MemAllocator &allocator) : _allocator(allocator)
+BlockPageProfile::BlockPageProfile(wulib::MemAllocator &allocator, BlockLinker &linker) : _code_size(0), _code_lines(0), _dirty_lines(0), _allocator(allocator), _linker(linker), _age(0)
 {
 	_valid = false;
-	_dirty = false;
+	_referenced = false;
+	_resident = false;
 	for(auto &i : _table) i = nullptr;
 }
 
@@ -54,7 +70,7 @@ BlockPageProfile::~BlockPageProfile()
 void BlockPageProfile::Insert(Address address, const BlockTranslation &txln)
 {
 	// We shouldn't be translating any code on a page which is dirty
-	if(_dirty) Invalidate();
+	if(IsDirty()) InvalidateDirty();
 
 	if(!_valid) {
 
@@ -66,28 +82,48 @@ void BlockPageProfile::Insert(Address address, const BlockTranslation &txln)
 		_valid = true;
 	}
 
-	// Get the page offset of the address
-	uint32_t address_offset = address.GetPageOffset();
-
-	// XXX ARM HAX
-	uint32_t index = address_offset >> kInstructionAlignment;
+	auto &versions = getVersions(address);
 
-//	assert(Get(address).GetFn() == nullptr);
-	if(Get(address).GetFn() != nullptr) {
-		InvalidateTxln(address);
+	// A new translation replaces any existing translation for the same
+	// feature levels, and the oldest version if there are too many
+	for(auto i = versions.begin(); i != versions.end();) {
+		if(i->HasSameFeatures(txln)) {
+			freeTxln(*i);
+			i = versions.erase(i);
+		} else {
+			++i;
+		}
+	}
+	if(versions.size() >= kMaxVersions) {
+		freeTxln(versions.front());
+		versions.erase(versions.begin());
 	}
+
 	_txlns.insert(txln.GetFn());
-	Get(address) = txln;
+	_code_size += txln.GetSize();
+	_code_lines |= txln.GetCodeLines();
+	versions.push_back(txln);
+
+	_referenced = true;
 }
 
 void BlockPageProfile::InvalidateTxln(Address address)
 {
-	auto &txln = Get(address);
+	auto &versions = getVersions(address);
+	for(auto &txln : versions) {
+		freeTxln(txln);
+	}
+	versions.clear();
+}
 
+void BlockPageProfile::freeTxln(BlockTranslation& txln)
+{
 	auto fn = txln.GetFn();
 	if(fn) {
+		_linker.Remove(fn);
 		_allocator.Free((void*)fn);
 		_txlns.erase(fn);
+		_code_size -= txln.GetSize();
 	}
 
 	txln.Invalidate();
@@ -96,9 +132,11 @@ void BlockPageProfile::InvalidateTxln(Address address)
 void BlockPageProfile::Invalidate()
 {
 	_valid = false;
-	_dirty = false;
+	_dirty_lines = 0;
+	_code_lines = 0;
 	for(auto i : _txlns) {
 		assert(i != nullptr);
+		_linker.Remove(i);
 		_allocator.Free((void*)i);
 	}
 
@@ -107,9 +145,86 @@ void BlockPageProfile::Invalidate()
 		i = nullptr;
 	}
 	_txlns.clear();
+	_code_size = 0;
+}
+
+size_t BlockPageProfile::InvalidateDirty()
+{
+	uint64_t dirty_lines = _dirty_lines;
+	_dirty_lines = 0;
+
+	if((_code_lines & ~dirty_lines) == 0) {
+		size_t count = _txlns.size();
+		Invalidate();
+		return count;
+	}
+
+	// Only translations of modified code are thrown away. The remaining
+	// translations make up the page's new set of code lines.
+	size_t count = 0;
+	_code_lines = 0;
+	for(auto chunk : _table) {
+		if(chunk == nullptr) continue;
+
+		for(auto &entry : *chunk) {
+			auto &versions = entry.second;
+			for(auto i = versions.begin(); i != versions.end();) {
+				if(i->GetCodeLines() & dirty_lines) {
+					freeTxln(*i);
+					i = versions.erase(i);
+					count++;
+				} else {
+					_code_lines |= i->GetCodeLines();
+					++i;
+				}
+			}
+		}
+	}
+
+	return count;
+}
+
+void BlockPageProfile::Unlink()
+{
+	for(auto i : _txlns) {
+		_linker.UnlinkTarget(i);
+	}
+}
+
+void BlockPageProfile::Unlink(uint64_t lines)
+{
+	if((_code_lines & ~lines) == 0) {
+		Unlink();
+		return;
+	}
+
+	for(auto chunk : _table) {
+		if(chunk == nullptr) continue;
+
+		for(const auto &entry : *chunk) {
+			for(const auto &txln : entry.second) {
+				if(txln.GetCodeLines() & lines) {
+					_linker.UnlinkTarget(txln.GetFn());
+				}
+			}
+		}
+	}
 }
 
-BlockProfile::BlockProfile(wulib::MemAllocator &allocator) : _allocator(allocator), code_size_(0)
+void BlockPageProfile::GetBlockOffsets(std::vector<uint32_t>& offsets) const
+{
+	for(uint32_t chunk = 0; chunk < _table.size(); ++chunk) {
+		if(_table[chunk] == nullptr) continue;
+
+		for(const auto &entry : *_table[chunk]) {
+			if(!entry.second.empty()) {
+				offsets.push_back((chunk * kBlocksPerChunk + entry.first) << kInstructionAlignment);
+			}
+		}
+	}
+}
+
+BlockProfile::BlockProfile(wulib::MemAllocator &allocator) : code_size_(0), _allocator(allocator)
 {
 	_table_pages_dirty.set();
 	for(auto &i : _page_profiles) {
@@ -118,19 +233,39 @@ BlockProfile::BlockProfile(wulib::MemAllocator &allocator) : _allocator(allocato
 	Invalidate();
 }
 
-void BlockProfile::Insert(Address address, const BlockTranslation &txln)
+bool BlockProfile::Insert(Address address, const BlockTranslation &txln)
 {
 	// Get the page index of the address
 	LC_DEBUG2(LogBlockProfile) << "Inserting " << std::hex << address.Get() << " into the block profile";
 
-	code_size_ += txln.GetSize();
+	auto &profile = getProfile(address);
+
+	// Translating code on a dirty page collects the page early
+	if(profile.IsDirty()) {
+		code_size_ -= profile.GetCodeSize();
+		_early_collection.InvalidatedTxlns += profile.InvalidateDirty();
+		_early_collection.PreservedTxlns += profile.GetTxlnCount();
+		code_size_ += profile.GetCodeSize();
+	}
+
+	code_size_ -= profile.GetCodeSize();
+	profile.Insert(address, txln);
+	code_size_ += profile.GetCodeSize();
 
-	getProfile(address).Insert(address, txln);
+	if(!profile.IsResident()) {
+		profile.SetResident(true);
+		_resident_pages.push_back(address.PageBase());
+	}
+
+	bool retranslated = _evicted_blocks.erase(address.Get()) != 0;
+	retranslated |= _older_evicted_blocks.erase(address.Get()) != 0;
+	return retranslated;
 }
 
 void BlockProfile::Invalidate()
 {
 	LC_DEBUG1(LogBlockProfile) << "Performing a full invalidation";
+	_linker.UnlinkAll();
 	for(auto &i : _page_profiles) {
 		if(i != nullptr) {
 			i->Invalidate();
@@ -139,20 +274,108 @@ void BlockProfile::Invalidate()
 
 	code_size_ = 0;
 	_table_pages_dirty.reset();
+
+	for(auto page : _resident_pages) {
+		getProfile(page).SetResident(false);
+	}
+	_resident_pages.clear();
+	_evicted_blocks.clear();
+	_older_evicted_blocks.clear();
 }
 
 void BlockProfile::InvalidatePage(Address address)
 {
-	getProfile(address).Invalidate();
+	auto &profile = getProfile(address);
+	code_size_ -= profile.GetCodeSize();
+	profile.Invalidate();
+}
+
+void BlockProfile::Evict(uint64_t target_size, BlockEvictionStats& stats)
+{
+	LC_DEBUG1(LogBlockProfile) << "Evicting code down to " << target_size << " bytes";
+
+	// Age every resident page, so that each page's history records which of
+	// the recent evictions it was used before. Pages emptied by invalidation
+	// leave the resident set here.
+	std::vector<std::pair<Address, BlockPageProfile *>> candidates;
+	for(auto page : _resident_pages) {
+		auto &profile = getProfile(page);
+
+		if(profile.GetTxlnCount() == 0) {
+			profile.SetResident(false);
+			continue;
+		}
+
+		// Chained code enters the page without going through the profile,
+		// so unlink it to see whether it is still in use by next time
+		if(profile.IsReferenced()) {
+			profile.Unlink();
+		}
+		profile.Age();
+
+		// Dirty pages are freed at the next collection anyway
+		if(!profile.IsDirty()) {
+			candidates.push_back({page, &profile});
+		}
+	}
+
+	// Evict the least recently and least frequently used pages first. Pages
+	// with the same history are evicted in the order they were translated.
+	std::stable_sort(candidates.begin(), candidates.end(), [](const std::pair<Address, BlockPageProfile *> &a, const std::pair<Address, BlockPageProfile *> &b) {
+		return a.second->GetAge() < b.second->GetAge();
+	});
+
+	// Start a new generation of evicted blocks, forgetting the oldest one
+	_older_evicted_blocks.swap(_evicted_blocks);
+	_evicted_blocks.clear();
+
+	std::vector<uint32_t> offsets;
+	for(auto &candidate : candidates) {
+		if(code_size_ <= target_size) {
+			break;
+		}
+
+		Address page = candidate.first;
+		auto profile = candidate.second;
+
+		offsets.clear();
+		profile->GetBlockOffsets(offsets);
+		for(auto offset : offsets) {
+			_evicted_blocks.insert(page.Get() + offset);
+		}
+
+		stats.Pages++;
+		stats.Txlns += profile->GetTxlnCount();
+		stats.Bytes += profile->GetCodeSize();
+
+		code_size_ -= profile->GetCodeSize();
+		profile->Invalidate();
+		profile->SetResident(false);
+	}
+
+	_resident_pages.erase(std::remove_if(_resident_pages.begin(), _resident_pages.end(), [this](Address page) {
+		return !getProfile(page).IsResident();
+	}), _resident_pages.end());
 }
 
-void BlockProfile::GarbageCollect()
+void BlockProfile::GarbageCollect(BlockCollectionStats &stats)
 {
 	if(_dirty_pages.size()) {
 		LC_DEBUG1(LogBlockProfile) << "Performing a garbage collection";
 	}
+
+	stats.InvalidatedTxlns += _early_collection.InvalidatedTxlns;
+	stats.PreservedTxlns += _early_collection.PreservedTxlns;
+	_early_collection = BlockCollectionStats();
+
 	for(auto &i : _dirty_pages) {
-		i.second->Invalidate();
+		// The page may already have been collected when it was retranslated
+		if(!i.second->IsDirty()) continue;
+
+		code_size_ -= i.second->GetCodeSize();
+		stats.InvalidatedTxlns += i.second->InvalidateDirty();
+		stats.PreservedTxlns += i.second->GetTxlnCount();
+		code_size_ += i.second->GetCodeSize();
 	}
 
 	_dirty_pages.clear();
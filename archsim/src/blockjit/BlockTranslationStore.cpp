@@ -0,0 +1,385 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * BlockTranslationStore.cpp
+ */
+
+#include "blockjit/BlockTranslationStore.h"
+#include "blockjit/BlockLinker.h"
+#include "util/LogContext.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+
+#include <dlfcn.h>
+#include <link.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+UseLogContext(LogBlockProfile);
+
+using namespace archsim::blockjit;
+
+static const char kStoreMagic[4] = { 'A', 'S', 'T', 'X' };
+static const uint32_t kStoreVersion = 1;
+
+namespace
+{
+	bool stat_module(const std::string &name, uint64_t &size, uint64_t &time)
+	{
+		struct stat st;
+		if(stat(name.c_str(), &st) != 0) {
+			return false;
+		}
+
+		size = st.st_size;
+		time = st.st_mtime;
+		return true;
+	}
+
+	int collect_module(struct dl_phdr_info *info, size_t, void *data)
+	{
+		auto &modules = *(std::map<std::string, uint64_t>*)data;
+
+		// Name modules in the same way as dladdr, which is used when
+		// translations are recorded
+		for(int i = 0; i < info->dlpi_phnum; ++i) {
+			if(info->dlpi_phdr[i].p_type != PT_LOAD) continue;
+
+			Dl_info dl;
+			if(dladdr((void*)(info->dlpi_addr + info->dlpi_phdr[i].p_vaddr), &dl) && dl.dli_fname != nullptr) {
+				modules[dl.dli_fname] = (uint64_t)dl.dli_fbase;
+			}
+			break;
+		}
+
+		return 0;
+	}
+
+	template<typename T> void write_pod(std::ostream &str, const T &t)
+	{
+		str.write((const char*)&t, sizeof(t));
+	}
+	template<typename T> void write_vector(std::ostream &str, const std::vector<T> &v)
+	{
+		write_pod(str, (uint32_t)v.size());
+		str.write((const char*)v.data(), v.size() * sizeof(T));
+	}
+
+	template<typename T> bool read_pod(std::istream &str, T &t)
+	{
+		return (bool)str.read((char*)&t, sizeof(t));
+	}
+
+	// The number of bytes left to read in a file of the given size
+	uint64_t remaining_bytes(std::istream &str, uint64_t file_size)
+	{
+		std::streamoff pos = str.tellg();
+		if(pos < 0 || (uint64_t)pos > file_size) return 0;
+		return file_size - pos;
+	}
+
+	// Sizes read from the file are checked against what is left of it before
+	// anything is allocated, so that a corrupt store can't exhaust memory
+	template<typename T> bool read_vector(std::istream &str, uint64_t file_size, std::vector<T> &v)
+	{
+		uint32_t size;
+		if(!read_pod(str, size)) return false;
+		if((uint64_t)size * sizeof(T) > remaining_bytes(str, file_size)) return false;
+		v.resize(size);
+		return (bool)str.read((char*)v.data(), size * sizeof(T));
+	}
+}
+
+BlockTranslationStore::BlockTranslationStore(uint64_t signature) : signature_(signature)
+{
+
+}
+
+uint64_t BlockTranslationStore::Checksum(const uint8_t* data, size_t size)
+{
+	// FNV-1a
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for(size_t i = 0; i < size; ++i) {
+		hash ^= data[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+bool BlockTranslationStore::getModuleFor(uint64_t address, uint32_t& module, uint64_t& module_offset)
+{
+	Dl_info dl;
+	if(!dladdr((void*)address, &dl) || dl.dli_fname == nullptr) {
+		return false;
+	}
+
+	module_offset = address - (uint64_t)dl.dli_fbase;
+
+	for(module = 0; module < modules_.size(); ++module) {
+		if(modules_[module].Name == dl.dli_fname && modules_[module].Base == (uint64_t)dl.dli_fbase) {
+			return true;
+		}
+	}
+
+	HostModule new_module;
+	new_module.Name = dl.dli_fname;
+	new_module.Base = (uint64_t)dl.dli_fbase;
+	if(!stat_module(new_module.Name, new_module.FileSize, new_module.FileTime)) {
+		return false;
+	}
+
+	modules_.push_back(new_module);
+	return true;
+}
+
+void BlockTranslationStore::addEntry(const BlockTranslationKey& key, Entry&& entry)
+{
+	auto &entries = entries_[key];
+
+	// Replace any translation of the same code in the same context
+	for(auto &existing : entries) {
+		if(existing.PageChecksum == entry.PageChecksum && existing.Features == entry.Features) {
+			existing = std::move(entry);
+			return;
+		}
+	}
+
+	entries.push_back(std::move(entry));
+}
+
+void BlockTranslationStore::Record(const BlockTranslationKey& key, uint64_t page_checksum, const BlockTranslation& txln, const std::vector<uint32_t>& host_relocations, const chain_slot_list_t& chain_slots)
+{
+	std::lock_guard<std::mutex> lg(lock_);
+
+	Entry entry;
+	entry.PageChecksum = page_checksum;
+	entry.ChainSlots = chain_slots;
+
+	auto features = txln.GetFeatures();
+	entry.Features.assign(features.begin(), features.end());
+
+	const uint8_t *code = (const uint8_t*)txln.GetFn();
+	entry.Code.assign(code, code + txln.GetSize());
+
+	for(auto offset : host_relocations) {
+		Relocation reloc;
+		reloc.Offset = offset;
+
+		uint64_t target;
+		memcpy(&target, code + offset, sizeof(target));
+		if(!getModuleFor(target, reloc.Module, reloc.ModuleOffset)) {
+			LC_DEBUG1(LogBlockProfile) << "Not storing translation of " << std::hex << key.VirtualPC << ": could not relocate host address " << target;
+			return;
+		}
+
+		memset(entry.Code.data() + offset, 0, sizeof(target));
+		entry.Relocations.push_back(reloc);
+	}
+
+	// The slots are filled in again when the translation is restored
+	for(auto slot : chain_slots) {
+		auto stored_slot = (BlockChainSlot*)(entry.Code.data() + slot.first);
+		stored_slot->Target = 0;
+		stored_slot->Unlinked = 0;
+		stored_slot->Source = 0;
+	}
+
+	addEntry(key, std::move(entry));
+}
+
+bool BlockTranslationStore::Has(const BlockTranslationKey& key)
+{
+	std::lock_guard<std::mutex> lg(lock_);
+	return entries_.count(key) != 0;
+}
+
+bool BlockTranslationStore::Restore(const BlockTranslationKey& key, uint64_t page_checksum, const archsim::ProcessorFeatureSet& features, wulib::MemAllocator& allocator, BlockTranslation& txln)
+{
+	std::lock_guard<std::mutex> lg(lock_);
+
+	auto entries = entries_.find(key);
+	if(entries == entries_.end()) {
+		return false;
+	}
+
+	for(const auto &entry : entries->second) {
+		if(entry.PageChecksum != page_checksum) continue;
+
+		bool valid = true;
+		for(auto feature : entry.Features) {
+			if(features.GetFeatureLevel(feature.first) != feature.second) valid = false;
+		}
+		for(auto reloc : entry.Relocations) {
+			if(modules_.at(reloc.Module).Base == 0) valid = false;
+		}
+		if(!valid) continue;
+
+		uint8_t *code = (uint8_t*)allocator.Allocate(entry.Code.size());
+		memcpy(code, entry.Code.data(), entry.Code.size());
+
+		for(auto reloc : entry.Relocations) {
+			uint64_t target = modules_.at(reloc.Module).Base + reloc.ModuleOffset;
+			memcpy(code + reloc.Offset, &target, sizeof(target));
+		}
+
+		for(auto slot : entry.ChainSlots) {
+			auto code_slot = (BlockChainSlot*)(code + slot.first);
+			code_slot->Unlinked = (uint64_t)code + slot.second;
+			code_slot->Target = code_slot->Unlinked;
+			code_slot->Source = (uint64_t)code;
+		}
+
+		txln.Invalidate();
+		txln.SetFn((block_txln_fn)code);
+		txln.SetSize(entry.Code.size());
+		for(auto feature : entry.Features) {
+			txln.AddRequiredFeature(feature.first, feature.second);
+		}
+
+		return true;
+	}
+
+	return false;
+}
+
+bool BlockTranslationStore::Save(const std::string& filename)
+{
+	std::lock_guard<std::mutex> lg(lock_);
+
+	// Write to a temporary file first, so that concurrent runs never see a
+	// partially written store
+	std::string tmp_filename = filename + "." + std::to_string(getpid()) + ".tmp";
+	std::ofstream str (tmp_filename, std::ios::binary | std::ios::trunc);
+	if(!str) {
+		LC_ERROR(LogBlockProfile) << "Could not open " << tmp_filename << " to save translations";
+		return false;
+	}
+
+	str.write(kStoreMagic, sizeof(kStoreMagic));
+	write_pod(str, kStoreVersion);
+	write_pod(str, signature_);
+
+	write_pod(str, (uint32_t)modules_.size());
+	for(const auto &module : modules_) {
+		std::vector<char> name (module.Name.begin(), module.Name.end());
+		write_vector(str, name);
+		write_pod(str, module.FileSize);
+		write_pod(str, module.FileTime);
+	}
+
+	uint64_t entry_count = 0;
+	for(const auto &entries : entries_) {
+		entry_count += entries.second.size();
+	}
+	write_pod(str, entry_count);
+
+	for(const auto &entries : entries_) {
+		for(const auto &entry : entries.second) {
+			write_pod(str, entries.first.PhysicalPC);
+			write_pod(str, entries.first.VirtualPC);
+			write_pod(str, entries.first.IsaMode);
+			write_pod(str, entry.PageChecksum);
+			write_vector(str, entry.Features);
+			write_vector(str, entry.Code);
+			write_vector(str, entry.Relocations);
+			write_vector(str, entry.ChainSlots);
+		}
+	}
+
+	str.close();
+	if(!str || rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+		LC_ERROR(LogBlockProfile) << "Failed to save translations to " << filename;
+		return false;
+	}
+
+	LC_INFO(LogBlockProfile) << "Saved " << entry_count << " translations to " << filename;
+	return true;
+}
+
+bool BlockTranslationStore::Load(const std::string& filename)
+{
+	std::lock_guard<std::mutex> lg(lock_);
+
+	std::ifstream str (filename, std::ios::binary | std::ios::ate);
+	if(!str) {
+		LC_INFO(LogBlockProfile) << "No saved translations found in " << filename;
+		return false;
+	}
+	uint64_t file_size = str.tellg();
+	str.seekg(0);
+
+	char magic[sizeof(kStoreMagic)];
+	uint32_t version;
+	uint64_t signature;
+	if(!str.read(magic, sizeof(magic)) || memcmp(magic, kStoreMagic, sizeof(magic)) || !read_pod(str, version) || version != kStoreVersion || !read_pod(str, signature)) {
+		LC_WARNING(LogBlockProfile) << filename << " is not a translation store";
+		return false;
+	}
+	if(signature != signature_) {
+		LC_WARNING(LogBlockProfile) << "Translations in " << filename << " were saved with a different configuration, ignoring them";
+		return false;
+	}
+
+	std::map<std::string, uint64_t> loaded_modules;
+	dl_iterate_phdr(collect_module, &loaded_modules);
+
+	// Each module takes at least its name length, size and time
+	uint32_t module_count;
+	if(!read_pod(str, module_count) || (uint64_t)module_count * (sizeof(uint32_t) + 2 * sizeof(uint64_t)) > remaining_bytes(str, file_size)) {
+		LC_WARNING(LogBlockProfile) << filename << " is corrupt, ignoring it";
+		return false;
+	}
+
+	std::vector<HostModule> modules (module_count);
+	for(auto &module : modules) {
+		std::vector<char> name;
+		if(!read_vector(str, file_size, name) || !read_pod(str, module.FileSize) || !read_pod(str, module.FileTime)) return false;
+		module.Name.assign(name.begin(), name.end());
+
+		// Only relocate against the same build of each module
+		uint64_t size, time;
+		module.Base = 0;
+		if(loaded_modules.count(module.Name) && stat_module(module.Name, size, time) && size == module.FileSize && time == module.FileTime) {
+			module.Base = loaded_modules.at(module.Name);
+		}
+	}
+
+	uint64_t entry_count;
+	if(!read_pod(str, entry_count)) return false;
+
+	decltype(entries_) entries;
+	for(uint64_t i = 0; i < entry_count; ++i) {
+		BlockTranslationKey key;
+		Entry entry;
+
+		if(!read_pod(str, key.PhysicalPC) || !read_pod(str, key.VirtualPC) || !read_pod(str, key.IsaMode) || !read_pod(str, entry.PageChecksum)
+		        || !read_vector(str, file_size, entry.Features) || !read_vector(str, file_size, entry.Code) || !read_vector(str, file_size, entry.Relocations) || !read_vector(str, file_size, entry.ChainSlots)) {
+			LC_WARNING(LogBlockProfile) << filename << " is truncated, ignoring it";
+			return false;
+		}
+
+		for(auto reloc : entry.Relocations) {
+			if(reloc.Module >= modules.size() || reloc.Offset + sizeof(uint64_t) > entry.Code.size()) {
+				LC_WARNING(LogBlockProfile) << filename << " is corrupt, ignoring it";
+				return false;
+			}
+		}
+		for(auto slot : entry.ChainSlots) {
+			if(slot.first + sizeof(BlockChainSlot) > entry.Code.size() || slot.second >= entry.Code.size()) {
+				LC_WARNING(LogBlockProfile) << filename << " is corrupt, ignoring it";
+				return false;
+			}
+		}
+
+		entries[key].push_back(std::move(entry));
+	}
+
+	modules_ = std::move(modules);
+	entries_ = std::move(entries);
+
+	LC_INFO(LogBlockProfile) << "Loaded " << entry_count << " translations from " << filename;
+	return true;
+}
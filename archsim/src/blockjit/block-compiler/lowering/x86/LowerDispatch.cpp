@@ -12,95 +12,261 @@
 #include "blockjit/block-compiler/block-compiler.h"
 #include "blockjit/translation-context.h"
 #include "blockjit/block-compiler/lowering/x86/X86BlockjitABI.h"
+#include "blockjit/BlockLinker.h"
+#include "blockjit/BlockCache.h"
+
+#include <cstddef>
+#include <vector>
 
 using namespace captive::arch::jit::lowering::x86;
 using namespace captive::shared;
+using archsim::blockjit::BlockCache;
+using archsim::blockjit::BlockReturnStack;
+
+// Load the current guest PC into RAX (zero extended)
+static void load_guest_pc(X86Encoder &encoder, const archsim::RegisterFileEntryDescriptor &pc_desc)
+{
+	X86Memory pc_mem = X86Memory::get(BLKJIT_ARG0(8), pc_desc.GetOffset());
+	if(pc_desc.GetEntrySize() == 8) {
+		encoder.mov(pc_mem, REG_RAX);
+	} else {
+		encoder.mov(pc_mem, REG_EAX);
+	}
+}
+
+// Probe the thread's block cache for the guest PC in RAX, and jump straight
+// to the translation on a hit.
+static void emit_cache_probe(X86Encoder &encoder, const archsim::StateBlockDescriptor &sbd, std::vector<uint32_t> &miss_relocs)
+{
+	static_assert(sizeof(archsim::blockjit::BlockCacheEntry) == 16, "Block cache probe assumes 16 byte entries");
+
+	encoder.mov(REG_EAX, REG_EDX);
+	if(BlockCache::kInstructionShift) {
+		encoder.shr(BlockCache::kInstructionShift, REG_EDX);
+	}
+	encoder.andd(BlockCache::kCacheSize - 1, REG_EDX);
+	encoder.shl(4, REG_EDX);
+	encoder.add(X86Memory::get(BLKJIT_ARG1(8), sbd.GetBlockOffset("BlockCache")), REG_RDX);
+
+	uint32_t miss_reloc;
+	encoder.cmp(REG_RAX, X86Memory::get(REG_RDX));
+	encoder.jne_reloc(miss_reloc);
+	miss_relocs.push_back(miss_reloc);
+
+	encoder.jmp(X86Memory::get(REG_RDX, 8));
+}
+
+// Push a predicted return address, along with its translation if there is
+// one in the block cache.
+static void emit_return_stack_push(X86Encoder &encoder, const archsim::StateBlockDescriptor &sbd, uint64_t return_pc)
+{
+	encoder.mov(X86Memory::get(BLKJIT_ARG1(8), sbd.GetBlockOffset("BlockReturnStack")), REG_RDX);
+	encoder.mov(X86Memory::get(REG_RDX), REG_RCX);
+	encoder.add(1, REG_RCX);
+	encoder.andd(BlockReturnStack::kSize - 1, REG_RCX);
+	encoder.mov(REG_RCX, X86Memory::get(REG_RDX));
+
+	// RDX = &entries[top]
+	encoder.shl(4, REG_RCX);
+	encoder.lea(X86Memory::get(REG_RDX, offsetof(BlockReturnStack, entries), REG_RCX, 1), REG_RDX);
+
+	encoder.mov(return_pc, REG_RAX);
+	encoder.mov(REG_RAX, X86Memory::get(REG_RDX, offsetof(archsim::blockjit::BlockReturnStackEntry, guest_pc)));
+
+	// The cache index of the return address is known statically
+	int32_t entry_offset = ((return_pc >> BlockCache::kInstructionShift) % BlockCache::kCacheSize) * sizeof(archsim::blockjit::BlockCacheEntry);
+	uint32_t hit_reloc;
+	encoder.mov(X86Memory::get(BLKJIT_ARG1(8), sbd.GetBlockOffset("BlockCache")), REG_RCX);
+	encoder.cmp(REG_RAX, X86Memory::get(REG_RCX, entry_offset));
+	encoder.mov(X86Memory::get(REG_RCX, entry_offset + 8), REG_RCX);
+	encoder.je_reloc(hit_reloc);
+	encoder.xorr(REG_ECX, REG_ECX);
+	*(uint32_t*)(encoder.get_buffer() + hit_reloc) = encoder.current_offset() - hit_reloc - 4;
+
+	encoder.mov(REG_RCX, X86Memory::get(REG_RDX, offsetof(archsim::blockjit::BlockReturnStackEntry, host_fn)));
+}
+
+// Pop the predicted return address, and jump to its translation if it
+// matches the guest PC in RAX.
+static void emit_return_stack_pop(X86Encoder &encoder, const archsim::StateBlockDescriptor &sbd, std::vector<uint32_t> &miss_relocs)
+{
+	encoder.mov(X86Memory::get(BLKJIT_ARG1(8), sbd.GetBlockOffset("BlockReturnStack")), REG_RDX);
+	encoder.mov(X86Memory::get(REG_RDX), REG_RCX);
+	encoder.mov(REG_RCX, REG_R8);
+	encoder.sub(1, REG_R8);
+	encoder.andd(BlockReturnStack::kSize - 1, REG_R8);
+	encoder.mov(REG_R8, X86Memory::get(REG_RDX));
+
+	// RDX = &entries[old top]
+	encoder.shl(4, REG_RCX);
+	encoder.lea(X86Memory::get(REG_RDX, offsetof(BlockReturnStack, entries), REG_RCX, 1), REG_RDX);
+
+	uint32_t miss_reloc;
+	encoder.cmp(REG_RAX, X86Memory::get(REG_RDX, offsetof(archsim::blockjit::BlockReturnStackEntry, guest_pc)));
+	encoder.jne_reloc(miss_reloc);
+	miss_relocs.push_back(miss_reloc);
+
+	encoder.mov(X86Memory::get(REG_RDX, offsetof(archsim::blockjit::BlockReturnStackEntry, host_fn)), REG_RCX);
+	encoder.test(REG_RCX, REG_RCX);
+	encoder.je_reloc(miss_reloc);
+	miss_relocs.push_back(miss_reloc);
+
+	encoder.jmp(REG_RCX);
+}
+
+static void patch_relocs(X86Encoder &encoder, std::vector<uint32_t> &relocs)
+{
+	for(auto reloc : relocs) {
+		*(uint32_t*)(encoder.get_buffer() + reloc) = encoder.current_offset() - reloc - 4;
+	}
+	relocs.clear();
+}
 
 bool LowerDispatch::Lower(const captive::shared::IRInstruction *&insn)
 {
-	UNIMPLEMENTED;
-//	const auto *cpu = GetCompiler().get_cpu();
-//	uint32_t pc_offset = cpu->GetRegisterByTag("PC")->Offset;
-//
-//	// If we shouldn't dispatch, just do a return instead
-//	if(!GetCompiler().emit_chaining_logic) {
-//		LowerRet r;
-//		r.SetContexts(GetLoweringContext(),GetTranslationContext(), GetCompiler());
-//		r.Lower(insn);
-//		// insn incremented by return lowering
-//		return true;
-//	}
-//
-//	// Dispatch instruction can have three general forms:
-//	// 1. All operands populated - instruction is a predicated jump and both target and fallthrough are compiled
-//	// 2. Fallthrough function not populated - instruction is a predicated jump and only the target is compiled
-//	// 3. Fallthrough PC and function not populated - instruction is a non predicated jump
-//
-//	const IROperand &target_pc = insn->operands[0];
-//	const IROperand &fallthrough_pc = insn->operands[1];
-//	const IROperand &target_fn = insn->operands[2];
-//	const IROperand &fallthrough_fn = insn->operands[3];
-//
-//	assert(target_fn.value != 0 || fallthrough_fn.value != 0);
-//
-//	// We need to do some stuff no matter what kind of dispatch we're doing
-//	// 1. fix up stack
-//	// 2. make sure we don't realloc halfway through emitting dispatch code and wreck the offsets
-//	// 3. do an interrupt check
-//
-//	if(GetLoweringContext().GetStackFrameSize()) {
-//		Encoder().add(GetLoweringContext().GetStackFrameSize(), REG_RSP);
-//	}
-//
-////	Encoder().int3();
-//
-//	// Decrement iteration count
-//	Encoder().cmp4(0, X86Memory::get(BLKJIT_CPUSTATE_REG, gensim::CpuStateOffsets::CpuState_pending_actions));
-//
-//	Encoder().ensure_extra_buffer(32);
-//
-//	// If iteration count is nonzero...
-//	uint32_t iteration_count_zero;
-//	Encoder().jne_reloc(iteration_count_zero);
-//
-//	uint32_t pc_not_target = 0;
-//	uint32_t fallthrough_not_target = 0;
-//	if(target_fn.value != 0) {
-//		// compare PC against target PC...
-//		Encoder().cmp4((uint32_t)target_pc.value, X86Memory::get(REG_RBP, pc_offset)); // XXX ARM HACK
-//		Encoder().jne_reloc(pc_not_target);
-//		if(archsim::options::Verbose.GetValue()) {
-//			Encoder().add(1, 8, X86Memory::get(BLKJIT_CPUSTATE_REG, gensim::CpuStateOffsets::CpuState_chained_target));
-//		}
-//		Encoder().jmp((void*)target_fn.value, REG_R15);
-//	}
-//	if(fallthrough_fn.value != 0) {
-//		// compare PC against target PC...
-//		Encoder().cmp4((uint32_t)fallthrough_pc.value, X86Memory::get(REG_RBP, pc_offset)); // XXX ARM HACK
-//		Encoder().jne_reloc(fallthrough_not_target);
-//		if(archsim::options::Verbose.GetValue()) {
-//			Encoder().add(1, 8, X86Memory::get(BLKJIT_CPUSTATE_REG, gensim::CpuStateOffsets::CpuState_chained_fallthrough));
-//		}
-//		Encoder().jmp((void*)fallthrough_fn.value, REG_R15);
-//	}
-//
-//
-//	// fill in jump targets
-//	*(uint32_t*)(Encoder().get_buffer() + iteration_count_zero) = Encoder().current_offset() - iteration_count_zero - 4;
-//	if(fallthrough_not_target != 0) {
-//		*(uint32_t*)(Encoder().get_buffer() + fallthrough_not_target) = Encoder().current_offset() - fallthrough_not_target - 4;
-//	}
-//	if(pc_not_target != 0) {
-//		*(uint32_t*)(Encoder().get_buffer() + pc_not_target) = Encoder().current_offset() - pc_not_target - 4;
-//	}
-//
-//	if(archsim::options::Verbose.GetValue()) {
-//		Encoder().add(1, 8, X86Memory::get(BLKJIT_CPUSTATE_REG, gensim::CpuStateOffsets::CpuState_chained_failed));
-//	}
-//
-//	Encoder().xorr(REG_RAX, REG_RAX);
-//	Encoder().ret();
-//
-//	insn++;
-//	return true;
+	const auto &sbd = GetLoweringContext().GetStateBlockDescriptor();
+
+	// If the execution engine doesn't support chaining, just do a return instead
+	if(!sbd.HasEntry("BlockChainExit")) {
+		GetLoweringContext().EmitEpilogue();
+		Encoder().ret();
+
+		insn++;
+		return true;
+	}
+
+	// The dispatch instruction has up to two exits, the target and the
+	// fallthrough. Each exit has a PC, and a kind which says how the exit
+	// should be chained (see BlockChainExitKind).
+	struct chain_exit {
+		uint64_t pc;
+		uint64_t kind;
+		uint32_t miss_reloc;
+		uint32_t jmp_reloc;
+		uint32_t lea_reloc;
+		uint32_t stub_offset;
+	};
+
+	chain_exit exits[2];
+	unsigned exit_count = 0;
+	uint64_t indirect_kind = archsim::blockjit::ChainNone;
+	bool is_call = false;
+	uint64_t return_pc = 0;
+
+	for(unsigned i = 0; i < 2; ++i) {
+		const IROperand &pc = insn->operands[i];
+		const IROperand &kind = insn->operands[i+2];
+		assert(pc.is_constant() && kind.is_constant());
+
+		switch(kind.value) {
+			case archsim::blockjit::ChainNone:
+				break;
+			case archsim::blockjit::ChainSamePage:
+			case archsim::blockjit::ChainCrossPage:
+				exits[exit_count].pc = pc.value;
+				exits[exit_count].kind = kind.value;
+				exit_count++;
+				break;
+			case archsim::blockjit::ChainIndirect:
+			case archsim::blockjit::ChainReturn:
+				indirect_kind = kind.value;
+				break;
+			case archsim::blockjit::ChainCall:
+				is_call = true;
+				return_pc = pc.value;
+				break;
+			default:
+				assert(false);
+		}
+	}
+
+	const auto &pc_desc = GetLoweringContext().GetArchDescriptor().GetRegisterFileDescriptor().GetTaggedEntry("PC");
+	X86Memory pc_mem = X86Memory::get(BLKJIT_ARG0(8), pc_desc.GetOffset());
+
+	std::vector<uint32_t> return_relocs;
+	uint32_t reloc;
+
+	// A chained block is entered exactly as if it had been called by the
+	// dispatch loop, so keep hold of the state pointers and tear down our
+	// own frame first.
+	Encoder().mov(BLKJIT_REGSTATE_REG, BLKJIT_ARG0(8));
+	Encoder().mov(BLKJIT_CPUSTATE_REG, BLKJIT_ARG1(8));
+	GetLoweringContext().EmitEpilogue();
+
+	// Drop back to the dispatch loop if the thread has a message waiting,
+	// or if its block cache needs flushing
+	Encoder().cmp4(0, X86Memory::get(BLKJIT_ARG1(8), sbd.GetBlockOffset("MessageWaiting")));
+	Encoder().jne_reloc(reloc);
+	return_relocs.push_back(reloc);
+	Encoder().cmp4(0, X86Memory::get(BLKJIT_ARG1(8), sbd.GetBlockOffset("PendingFlush")));
+	Encoder().jne_reloc(reloc);
+	return_relocs.push_back(reloc);
+
+	if(is_call) {
+		emit_return_stack_push(Encoder(), sbd, return_pc);
+	}
+
+	for(unsigned i = 0; i < exit_count; ++i) {
+		auto &chain = exits[i];
+
+		if(pc_desc.GetEntrySize() == 8) {
+			Encoder().mov(chain.pc, REG_RAX);
+			Encoder().cmp(REG_RAX, pc_mem);
+		} else {
+			Encoder().cmp4((uint32_t)chain.pc, pc_mem);
+		}
+		Encoder().jne_reloc(chain.miss_reloc);
+		Encoder().jmp_rip_reloc(chain.jmp_reloc);
+
+		*(uint32_t*)(Encoder().get_buffer() + chain.miss_reloc) = Encoder().current_offset() - chain.miss_reloc - 4;
+	}
+
+	if(indirect_kind != archsim::blockjit::ChainNone) {
+		load_guest_pc(Encoder(), pc_desc);
+
+		if(indirect_kind == archsim::blockjit::ChainReturn) {
+			std::vector<uint32_t> mispredict_relocs;
+			emit_return_stack_pop(Encoder(), sbd, mispredict_relocs);
+			patch_relocs(Encoder(), mispredict_relocs);
+		}
+
+		emit_cache_probe(Encoder(), sbd, return_relocs);
+	}
+
+	// None of the exits matched
+	patch_relocs(Encoder(), return_relocs);
+	Encoder().ret();
+
+	// Unlinked exits report which slot they came through, so that the
+	// execution engine can link it
+	for(unsigned i = 0; i < exit_count; ++i) {
+		auto &chain = exits[i];
+
+		chain.stub_offset = Encoder().current_offset();
+		Encoder().lea_rip_reloc(REG_RAX, chain.lea_reloc);
+		Encoder().mov(REG_RAX, X86Memory::get(BLKJIT_ARG1(8), sbd.GetBlockOffset("BlockChainExit")));
+		Encoder().ret();
+	}
+
+	// Slots must be naturally aligned so that they can be patched atomically.
+	// The slot contents are filled in once the code has been relocated.
+	Encoder().align_up(8);
+	for(unsigned i = 0; i < exit_count; ++i) {
+		auto &chain = exits[i];
+
+		uint32_t slot_offset = Encoder().current_offset();
+		*(uint32_t*)(Encoder().get_buffer() + chain.jmp_reloc) = slot_offset - chain.jmp_reloc - 4;
+		*(uint32_t*)(Encoder().get_buffer() + chain.lea_reloc) = slot_offset - chain.lea_reloc - 4;
+
+		Encoder().data64(0);
+		Encoder().data64(0);
+		Encoder().data64(0);
+		Encoder().data64(chain.pc);
+		Encoder().data64(chain.kind == archsim::blockjit::ChainCrossPage ? archsim::blockjit::BlockChainSlot::CrossPage : 0);
+
+		GetLoweringContext().RegisterChainSlot(slot_offset, chain.stub_offset);
+	}
+
+	insn++;
+	return true;
 }
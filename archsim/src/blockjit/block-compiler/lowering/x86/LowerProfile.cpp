@@ -0,0 +1,40 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * LowerProfile.cpp
+ */
+
+#include "blockjit/block-compiler/lowering/x86/X86LoweringContext.h"
+#include "blockjit/block-compiler/lowering/x86/X86Lowerers.h"
+#include "blockjit/block-compiler/block-compiler.h"
+#include "blockjit/translation-context.h"
+#include "blockjit/block-compiler/lowering/x86/X86BlockjitABI.h"
+#include "blockjit/BlockCache.h"
+
+using namespace captive::arch::jit::lowering::x86;
+using namespace captive::shared;
+
+bool LowerProfile::Lower(const captive::shared::IRInstruction *&insn)
+{
+	const IROperand *counter = &insn->operands[0];
+	const auto &sbd = GetLoweringContext().GetStateBlockDescriptor();
+
+	// Count this execution of the block
+	Encoder().mov(counter->value, BLKJIT_ARG0(8));
+	Encoder().add8(1, X86Memory::get(BLKJIT_ARG0(8)));
+
+	// Once the thread's budget of profiled blocks runs out, ask it to
+	// return to the dispatch loop. The request is picked up by the dispatch
+	// code at the end of the block. Other threads may set bits in the
+	// pending flush word at the same time, so the update must be atomic.
+	Encoder().sub(1, 4, X86Memory::get(BLKJIT_CPUSTATE_REG, sbd.GetBlockOffset("ProfileBudget")));
+
+	uint32_t reloc;
+	Encoder().jns_reloc(reloc);
+	Encoder().lock();
+	Encoder().orr(archsim::blockjit::kPendingProfile, 4, X86Memory::get(BLKJIT_CPUSTATE_REG, sbd.GetBlockOffset("PendingFlush")));
+	*(uint32_t*)(Encoder().get_buffer() + reloc) = Encoder().current_offset() - reloc - 4;
+
+	insn++;
+	return true;
+}
@@ -40,7 +40,7 @@ bool LowerReadDevice::Lower(const captive::shared::IRInstruction *&insn)
 	GetLoweringContext().encode_operand_function_argument(reg, REG_RDX, GetStackMap());
 
 	// Load the address of the target function into a temporary, and perform an indirect call.
-	Encoder().mov((uint64_t)&devReadDevice, BLKJIT_RETURN(8));
+	Encoder().mov_host_ptr((void*)&devReadDevice, BLKJIT_RETURN(8));
 	Encoder().call(BLKJIT_RETURN(8));
 
 	GetLoweringContext().emit_restore_reg_state(GetIsStackFixed());
@@ -0,0 +1,174 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * LowerTrace.cpp
+ *
+ * Writes a trace record (and a data extension record for 8 byte values)
+ * straight into the thread's trace buffer. The current position in the
+ * buffer and the limit up to which records can be written are kept in the
+ * state block. If the records would go past the limit, the trace source is
+ * called to make room for them (or to say that they should be dropped).
+ */
+
+#include "blockjit/block-compiler/lowering/x86/X86LoweringContext.h"
+#include "blockjit/block-compiler/lowering/x86/X86Lowerers.h"
+#include "blockjit/block-compiler/lowering/Finalisation.h"
+#include "blockjit/block-compiler/block-compiler.h"
+#include "blockjit/translation-context.h"
+#include "blockjit/block-compiler/lowering/x86/X86BlockjitABI.h"
+
+#include "libtrace/RecordTypes.h"
+
+#include <algorithm>
+
+using namespace captive::arch::jit::lowering::x86;
+using namespace captive::shared;
+
+extern "C" {
+	uint32_t blkTraceReserve();
+}
+
+class LowerTraceFinaliser : public captive::arch::jit::lowering::X86Finalisation
+{
+public:
+	LowerTraceFinaliser(X86Encoder &encoder, uint32_t jump_in, uint32_t write_target, uint32_t return_target, uint32_t type, uint32_t count) :
+		encoder_(encoder), jump_in_(jump_in), write_target_(write_target), return_target_(return_target), type_(type), count_(count)
+	{
+
+	}
+
+	virtual ~LowerTraceFinaliser() {}
+
+	bool FinaliseX86(captive::arch::jit::lowering::x86::X86LoweringContext &ctx)
+	{
+		*(uint32_t*)(Encoder().get_buffer() + jump_in_) = Encoder().current_offset() - jump_in_ - 4;
+
+		// The shunt preserves all of the allocatable registers, and aligns
+		// the stack itself
+		ctx.load_state_field("thread_ptr", BLKJIT_ARG0(8));
+		Encoder().mov(type_, BLKJIT_ARG1(4));
+		Encoder().mov(count_, BLKJIT_ARG2(4));
+		Encoder().call((void*)blkTraceReserve, BLKJIT_RETURN(8));
+
+		// Skip the records if they should be dropped, otherwise write them
+		// at the (possibly new) buffer position
+		Encoder().test(BLKJIT_ARG0(4), BLKJIT_ARG0(4));
+		Encoder().jz((int32_t)(return_target_ - Encoder().current_offset() - 6));
+
+		ctx.load_state_field("TraceBufferPos", BLKJIT_TEMPS_0(8));
+		Encoder().jmp_offset(write_target_ - Encoder().current_offset() - 5);
+
+		return true;
+	}
+
+	X86Encoder &Encoder()
+	{
+		return encoder_;
+	}
+
+private:
+	X86Encoder &encoder_;
+
+	// The offset of the relocation for the 32 bit jump into this finalisation
+	uint32_t jump_in_;
+
+	// The offset of the code which writes the records
+	uint32_t write_target_;
+
+	// The offset of the instruction after the records have been written
+	uint32_t return_target_;
+
+	uint32_t type_;
+	uint32_t count_;
+};
+
+// Load an operand into the 4 or 8 byte scratch register, zero extending it
+static const X86Register &load_zero_extended(X86LoweringContext &ctx, const IROperand *operand, uint8_t width)
+{
+	X86Encoder &encoder = ctx.GetEncoder();
+	const X86Register &dst = BLKJIT_TEMPS_1(width);
+
+	if(operand->is_constant()) {
+		uint64_t value = operand->value;
+		if(operand->size < 8) {
+			value &= (1ULL << (operand->size * 8)) - 1;
+		}
+		encoder.mov(value, dst);
+	} else if(operand->size >= 4) {
+		// Writing to the 32 bit register clears the top half
+		ctx.encode_operand_to_reg(operand, BLKJIT_TEMPS_1(std::min(operand->size, width)));
+	} else if(operand->is_alloc_reg()) {
+		encoder.movzx(ctx.register_from_operand(operand), dst);
+	} else if(operand->is_alloc_stack()) {
+		encoder.movzx(operand->size, ctx.stack_from_operand(operand), dst);
+	} else {
+		assert(false);
+	}
+
+	return dst;
+}
+
+bool LowerTrace::Lower(const captive::shared::IRInstruction *&insn)
+{
+	const IROperand *header = &insn->operands[0];
+	const IROperand *index = &insn->operands[1];
+	const IROperand *value = &insn->operands[2];
+
+	assert(header->is_constant());
+
+	const auto &sbd = GetLoweringContext().GetStateBlockDescriptor();
+	X86Memory pos_field = X86Memory::get(BLKJIT_CPUSTATE_REG, sbd.GetBlockOffset("TraceBufferPos"));
+	X86Memory limit_field = X86Memory::get(BLKJIT_CPUSTATE_REG, sbd.GetBlockOffset("TraceBufferLimit"));
+
+	uint32_t count = value->size == 8 ? 2 : 1;
+	uint32_t type = header->value >> 24;
+	uint32_t header_word = header->value | ((count - 1) << 16);
+
+	const X86Register &pos = BLKJIT_TEMPS_0(8);
+
+	Encoder().ensure_extra_buffer(128);
+
+	// Check that there is room for the records below the limit
+	Encoder().mov(pos_field, pos);
+	Encoder().lea(X86Memory::get(pos, count * sizeof(libtrace::TraceRecord)), BLKJIT_TEMPS_1(8));
+	Encoder().cmp(limit_field, BLKJIT_TEMPS_1(8));
+
+	uint32_t reserve_reloc;
+	Encoder().ja_reloc(reserve_reloc);
+
+	uint32_t write_target = Encoder().current_offset();
+
+	if(index->is_constant()) {
+		Encoder().mov4(header_word | (index->value & 0xff), X86Memory::get(pos));
+	} else {
+		load_zero_extended(GetLoweringContext(), index, 4);
+		Encoder().andd(0xff, BLKJIT_TEMPS_1(4));
+		Encoder().orr(header_word, BLKJIT_TEMPS_1(4));
+		Encoder().mov(BLKJIT_TEMPS_1(4), X86Memory::get(pos));
+	}
+
+	if(value->is_constant()) {
+		Encoder().mov4(value->value, X86Memory::get(pos, 4));
+		if(count == 2) {
+			Encoder().mov4(((uint32_t)libtrace::DataExtension << 24) | type, X86Memory::get(pos, 8));
+			Encoder().mov4(value->value >> 32, X86Memory::get(pos, 12));
+		}
+	} else if(count == 2) {
+		load_zero_extended(GetLoweringContext(), value, 8);
+		Encoder().mov(BLKJIT_TEMPS_1(4), X86Memory::get(pos, 4));
+		Encoder().mov4(((uint32_t)libtrace::DataExtension << 24) | type, X86Memory::get(pos, 8));
+		Encoder().shr(32, BLKJIT_TEMPS_1(8));
+		Encoder().mov(BLKJIT_TEMPS_1(4), X86Memory::get(pos, 12));
+	} else {
+		load_zero_extended(GetLoweringContext(), value, 4);
+		Encoder().mov(BLKJIT_TEMPS_1(4), X86Memory::get(pos, 4));
+	}
+
+	Encoder().lea(X86Memory::get(pos, count * sizeof(libtrace::TraceRecord)), pos);
+	Encoder().mov(pos, pos_field);
+
+	GetLoweringContext().RegisterFinalisation(new LowerTraceFinaliser(Encoder(), reserve_reloc, write_target, Encoder().current_offset(), type, count));
+
+	insn++;
+	return true;
+}
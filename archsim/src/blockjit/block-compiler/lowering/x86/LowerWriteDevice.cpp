@@ -42,7 +42,7 @@ bool LowerWriteDevice::Lower(const captive::shared::IRInstruction *&insn)
 	GetLoweringContext().encode_operand_function_argument(val, REG_RCX, GetStackMap());
 
 	// Load the address of the target function into a temporary, and perform an indirect call.
-	Encoder().mov((uint64_t)&devWriteDevice, BLKJIT_RETURN(8));
+	Encoder().mov_host_ptr((void*)&devWriteDevice, BLKJIT_RETURN(8));
 	Encoder().call(BLKJIT_RETURN(8));
 
 	if (next_insn && next_insn->type == IRInstruction::WRITE_DEVICE) {
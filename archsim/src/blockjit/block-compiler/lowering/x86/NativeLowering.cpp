@@ -6,6 +6,7 @@
 
 #include "blockjit/block-compiler/lowering/x86/X86Encoder.h"
 #include "blockjit/block-compiler/lowering/x86/X86LoweringContext.h"
+#include "blockjit/BlockLinker.h"
 
 #include "util/LogContext.h"
 
@@ -28,7 +29,20 @@ LoweringResult captive::arch::jit::lowering::NativeLowering(TranslationContext &
 
 	block_txln_fn fn = (block_txln_fn)encoder.get_buffer();
 	fn = (block_txln_fn)allocator.Reallocate(encoder.get_buffer(), encoder.get_buffer_size());
-	return LoweringResult(fn, encoder.get_buffer_size());
+
+	// Point the chain slots at their exit stubs, now that we know where the
+	// code has ended up
+	for(const auto &i : lowering.GetChainSlots()) {
+		archsim::blockjit::BlockChainSlot *slot = (archsim::blockjit::BlockChainSlot*)((uint8_t*)fn + i.first);
+		slot->Unlinked = (uint64_t)fn + i.second;
+		slot->Target = slot->Unlinked;
+		slot->Source = (uint64_t)fn;
+	}
+
+	LoweringResult result (fn, encoder.get_buffer_size());
+	result.HostRelocations = encoder.get_host_relocations();
+	result.ChainSlots.assign(lowering.GetChainSlots().begin(), lowering.GetChainSlots().end());
+	return result;
 }
 
 bool captive::arch::jit::lowering::HasNativeLowering()
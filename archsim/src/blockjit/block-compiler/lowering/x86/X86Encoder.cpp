@@ -789,6 +789,18 @@ void X86Encoder::pxor(const X86VectorRegister& src, const X86VectorRegister& des
 	encode_mod_reg_rm(dest, src);
 }
 
+void X86Encoder::mov_host_ptr(const void *src, const X86Register& dst)
+{
+	assert(dst.size == 8);
+
+	// Always use the full 64-bit immediate form, so that the address can be
+	// patched in place
+	emit8(REX_W | (dst.hireg ? REX_B : 0));
+	emit8(0xb8 + dst.raw_index);
+	_host_relocations.push_back(_write_offset);
+	emit64((uint64_t)src);
+}
+
 void X86Encoder::movfs(uint32_t off, const X86Register& dst)
 {
 	assert(false);
@@ -1441,7 +1453,7 @@ void X86Encoder::call(void *target, const X86Register &reg)
 
 	int64_t offset = ptr - buffer_ptr;
 	if(!_support_relocation || offset > INT32_MAX || offset < INT32_MIN) {
-		mov((uint64_t)target, reg);
+		mov_host_ptr(target, reg);
 		call(reg);
 	} else {
 		emit8(0xe8);
@@ -1473,7 +1485,7 @@ void X86Encoder::jmp(void *target, const X86Register &reg)
 
 	int64_t offset = ptr - buffer_ptr;
 	if(!_support_relocation || offset > INT32_MAX || offset < INT32_MIN) {
-		mov((uint64_t)target, reg);
+		mov_host_ptr(target, reg);
 		jmp(reg);
 	} else {
 		emit8(0xe9);
@@ -1510,6 +1522,27 @@ void X86Encoder::jmp_reloc(uint32_t& reloc_offset)
 	emit32(0);
 }
 
+void X86Encoder::jmp_rip_reloc(uint32_t& reloc_offset)
+{
+	// jmp *disp32(%rip)
+	emit8(0xff);
+	emit8(0x25);
+	reloc_offset = _write_offset;
+	emit32(0);
+}
+
+void X86Encoder::lea_rip_reloc(const X86Register& dst, uint32_t& reloc_offset)
+{
+	assert(dst.size == 8);
+
+	// lea disp32(%rip), dst
+	encode_rex_prefix(false, false, dst.hireg, true);
+	emit8(0x8d);
+	emit8(0x05 | ((dst.raw_index & 7) << 3));
+	reloc_offset = _write_offset;
+	emit32(0);
+}
+
 void X86Encoder::jmp_short_reloc(uint32_t& reloc_offset)
 {
 	emit8(0xeb);
@@ -1613,6 +1646,11 @@ void X86Encoder::int3()
 	emit8(0xcc);
 }
 
+void X86Encoder::lock()
+{
+	emit8(0xf0);
+}
+
 void X86Encoder::intt(uint8_t irq)
 {
 	emit8(0xcd);
@@ -1674,6 +1712,11 @@ void X86Encoder::align_up(uint8_t amount)
 	nop(align_end - _write_offset);
 }
 
+void X86Encoder::data64(uint64_t value)
+{
+	emit64(value);
+}
+
 void X86Encoder::nop(const X86Memory& mem)
 {
 	emit8(0x0f);
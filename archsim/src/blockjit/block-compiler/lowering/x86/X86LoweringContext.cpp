@@ -110,6 +110,8 @@ bool X86LoweringContext::Prepare(const TranslationContext &ctx)
 	A(IRInstruction::TAKE_EXCEPTION, TakeException);
 	A(IRInstruction::VERIFY, Verify);
 	A(IRInstruction::COUNT, Count);
+	A(IRInstruction::PROFILE, Profile);
+	A(IRInstruction::TRACE, Trace);
 
 	A(IRInstruction::CMPSGT, CompareSigned);
 	A(IRInstruction::CMPSGTE, CompareSigned);
@@ -23,7 +23,7 @@ bool LowerFCtrl_GetRound::Lower(const captive::shared::IRInstruction *&insn)
 	GetLoweringContext().load_state_field("thread_ptr", REG_RDI);
 
 	// Load the address of the target function into a temporary, and perform an indirect call.
-	Encoder().mov((uint64_t)&cpuGetRoundingMode, BLKJIT_RETURN(8));
+	Encoder().mov_host_ptr((void*)&cpuGetRoundingMode, BLKJIT_RETURN(8));
 	Encoder().call(BLKJIT_RETURN(8));
 
 	Encoder().mov(REG_RAX, BLKJIT_RETURN(8));
@@ -52,7 +52,7 @@ bool LowerFCtrl_SetRound::Lower(const captive::shared::IRInstruction *&insn)
 	GetLoweringContext().encode_operand_function_argument(mode, REG_RSI, GetStackMap());
 
 	// Load the address of the target function into a temporary, and perform an indirect call.
-	Encoder().mov((uint64_t)&cpuSetRoundingMode, BLKJIT_RETURN(8));
+	Encoder().mov_host_ptr((void*)&cpuSetRoundingMode, BLKJIT_RETURN(8));
 	Encoder().call(BLKJIT_RETURN(8));
 
 	GetLoweringContext().emit_restore_reg_state(GetIsStackFixed());
@@ -70,7 +70,7 @@ bool LowerFCtrl_GetFlush::Lower(const captive::shared::IRInstruction *&insn)
 	GetLoweringContext().load_state_field("thread_ptr", REG_RDI);
 
 	// Load the address of the target function into a temporary, and perform an indirect call.
-	Encoder().mov((uint64_t)&cpuGetFlushMode, BLKJIT_RETURN(8));
+	Encoder().mov_host_ptr((void*)&cpuGetFlushMode, BLKJIT_RETURN(8));
 	Encoder().call(BLKJIT_RETURN(8));
 
 	Encoder().mov(REG_RAX, BLKJIT_RETURN(8));
@@ -99,7 +99,7 @@ bool LowerFCtrl_SetFlush::Lower(const captive::shared::IRInstruction *&insn)
 	GetLoweringContext().encode_operand_function_argument(mode, REG_RSI, GetStackMap());
 
 	// Load the address of the target function into a temporary, and perform an indirect call.
-	Encoder().mov((uint64_t)&cpuSetFlushMode, BLKJIT_RETURN(8));
+	Encoder().mov_host_ptr((void*)&cpuSetFlushMode, BLKJIT_RETURN(8));
 	Encoder().call(BLKJIT_RETURN(8));
 
 	GetLoweringContext().emit_restore_reg_state(GetIsStackFixed());
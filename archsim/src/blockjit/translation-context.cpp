@@ -90,6 +90,7 @@ struct captive::shared::insn_descriptor captive::shared::insn_descriptors[] = {
 	{ .mnemonic = "barrier",	.format = "NXXXXX", .has_side_effects = true },
 	{ .mnemonic = "exception",	.format = "IIXXXX", .has_side_effects = true },
 	{ .mnemonic = "profile",	.format = "NXXXXX", .has_side_effects = true },
+	{ .mnemonic = "trace",		.format = "NIIXXX", .has_side_effects = true },
 
 	{ .mnemonic = "cmps gt",	.format = "IIOXXX", .has_side_effects = false },
 	{ .mnemonic = "cmps gte",	.format = "IIOXXX", .has_side_effects = false },
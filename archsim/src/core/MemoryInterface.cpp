@@ -4,12 +4,20 @@
 #include "core/thread/ThreadInstance.h"
 #include "util/LogContext.h"
 
+#include <algorithm>
+#include <cstring>
+
 using namespace archsim;
 
 DeclareLogContext(LogCacheMemory, "CachedMemory");
 
 MemoryDevice::~MemoryDevice() {}
 
+bool MemoryDevice::LockSpans(Address address, size_t size, bool is_write, archsim::abi::memory::host_span_list_t &spans)
+{
+	return false;
+}
+
 TranslationResult MMUTranslationProvider::Translate(Address virt_addr, Address& phys_addr, bool is_write, bool is_fetch, bool side_effects)
 {
 	AccessInfo info;
@@ -29,36 +37,58 @@ TranslationResult MMUTranslationProvider::Translate(Address virt_addr, Address&
 
 MemoryResult MemoryInterface::WriteString(Address address, const char *data)
 {
-	do {
-		Write8(address, *data);
-		data++;
-		address += 1;
-	} while(*data);
-
-	return MemoryResult::OK;
+	return Write(address, (const unsigned char*)data, strlen(data) + 1);
 }
 
 MemoryResult MemoryInterface::ReadString(Address address, char *data, size_t max_size)
 {
-	if(max_size == 0) {
-		return MemoryResult::OK;
+	archsim::abi::memory::host_span_list_t spans;
+
+	// The length of the string isn't known, so look for the terminator one
+	// page at a time
+	while(max_size != 0) {
+		size_t chunk = std::min(max_size, (size_t)(Address::PageSize - address.GetPageOffset()));
+		if(!LockSpans(address, chunk, false, spans)) {
+			break;
+		}
+
+		auto src = (const char*)spans.front().iov_base;
+		auto end = (const char*)memchr(src, 0, chunk);
+		if(end != nullptr) {
+			memcpy(data, src, end - src + 1);
+			return MemoryResult::OK;
+		}
+
+		memcpy(data, src, chunk);
+		data += chunk;
+		address += chunk;
+		max_size -= chunk;
 	}
 
-	uint8_t cdata;
-	do {
+	uint8_t cdata = 1;
+	while(cdata && max_size != 0) {
 		Read8(address, cdata);
 		*data = cdata;
 
 		data++;
 		address += 1;
 		max_size--;
-	} while(cdata && max_size != 0);
+	}
 
 	return MemoryResult::OK;
 }
 
 MemoryResult MemoryInterface::Read(Address address, unsigned char *data, size_t size)
 {
+	archsim::abi::memory::host_span_list_t spans;
+	if(LockSpans(address, size, false, spans)) {
+		for(const auto &span : spans) {
+			memcpy(data, span.iov_base, span.iov_len);
+			data += span.iov_len;
+		}
+		return MemoryResult::OK;
+	}
+
 	while(size >= 8) {
 		auto result = Read64(address, *(uint64_t*)data);
 
@@ -93,6 +123,15 @@ MemoryResult MemoryInterface::Read(Address address, unsigned char *data, size_t
 
 MemoryResult MemoryInterface::Write(Address address, const unsigned char *data, size_t size)
 {
+	archsim::abi::memory::host_span_list_t spans;
+	if(LockSpans(address, size, true, spans)) {
+		for(const auto &span : spans) {
+			memcpy(span.iov_base, data, span.iov_len);
+			data += span.iov_len;
+		}
+		return MemoryResult::OK;
+	}
+
 	for(unsigned int i = 0; i < size; ++i) {
 		Write8(address + i, data[i]);
 	}
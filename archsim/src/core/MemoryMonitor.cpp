@@ -2,56 +2,183 @@
 
 #include "core/MemoryMonitor.h"
 
+#include <algorithm>
+#include <cassert>
+
 DeclareLogContext(LogMonitor, "Monitor");
 
 using namespace archsim::core;
 
+MemoryMonitor::MemoryMonitor()
+{
+	for(auto &reserved : reserved_) {
+		reserved = 0;
+	}
+}
+
+BaseMemoryMonitor::BaseMemoryMonitor() : exclusive_active_(false)
+{
+	for(auto &bucket : buckets_) {
+		bucket.Locked = false;
+	}
+	for(uint32_t i = 0; i < kMaxThreads; ++i) {
+		threads_[i].ThreadID = i;
+		threads_[i].HasReservation = false;
+		threads_[i].HeldBucket = nullptr;
+		threads_[i].HoldsExclusive = false;
+	}
+}
+
+BaseMemoryMonitor::ThreadState &BaseMemoryMonitor::getThreadState(archsim::core::thread::ThreadInstance* thread)
+{
+	assert(thread->GetThreadID() >= 0 && (uint32_t)thread->GetThreadID() < kMaxThreads);
+	return threads_[thread->GetThreadID()];
+}
+
+void BaseMemoryMonitor::lockBucket(Bucket& bucket)
+{
+	while(bucket.Locked.exchange(true, std::memory_order_seq_cst)) {
+		while(bucket.Locked.load(std::memory_order_relaxed)) {
+			__builtin_ia32_pause();
+		}
+	}
+}
+
+void BaseMemoryMonitor::lockBucketForStore(Bucket& bucket, const ThreadState &state)
+{
+	// A store must not land in the middle of another thread's locked
+	// sequence, so back off until it has finished.
+	while(true) {
+		lockBucket(bucket);
+		if(state.HoldsExclusive || !exclusive_active_.load(std::memory_order_seq_cst)) {
+			return;
+		}
+
+		unlockBucket(bucket);
+		std::lock_guard<std::mutex> lg(exclusive_lock_);
+	}
+}
+
+void BaseMemoryMonitor::unlockBucket(Bucket& bucket)
+{
+	bucket.Locked.store(false, std::memory_order_release);
+}
+
+void BaseMemoryMonitor::addReservation(uint32_t bucket_index, ThreadState& state)
+{
+	auto &bucket = buckets_[bucket_index];
+	if(bucket.Reservations.empty()) {
+		reserved_[bucket_index / 64].fetch_or(1ULL << (bucket_index % 64), std::memory_order_relaxed);
+	}
+	bucket.Reservations.push_back(&state);
+	state.HasReservation = true;
+}
+
+void BaseMemoryMonitor::removeReservation(uint32_t bucket_index, ThreadState& state)
+{
+	auto &bucket = buckets_[bucket_index];
+	bucket.Reservations.erase(std::remove(bucket.Reservations.begin(), bucket.Reservations.end(), &state), bucket.Reservations.end());
+	if(bucket.Reservations.empty()) {
+		reserved_[bucket_index / 64].fetch_and(~(1ULL << (bucket_index % 64)), std::memory_order_relaxed);
+	}
+	state.HasReservation = false;
+}
+
+void BaseMemoryMonitor::releaseAll(ThreadState& state)
+{
+	if(state.HeldBucket != nullptr) {
+		unlockBucket(*state.HeldBucket);
+		state.HeldBucket = nullptr;
+	}
+
+	if(state.HoldsExclusive) {
+		state.HoldsExclusive = false;
+		exclusive_active_.store(false, std::memory_order_seq_cst);
+		exclusive_lock_.unlock();
+	}
+}
+
 void BaseMemoryMonitor::Lock(archsim::core::thread::ThreadInstance* thread)
 {
 	LC_DEBUG1(LogMonitor) << "Thread " << thread->GetThreadID() << ": locking monitor";
 
-	if (thread != locked_thread_) {
-		lock_.lock();
-		LC_DEBUG1(LogMonitor) << "Thread " << thread->GetThreadID() << ": locked monitor";
-		locked_thread_ = thread;
-	} else {
+	auto &state = getThreadState(thread);
+	if(state.HoldsExclusive) {
 		LC_DEBUG1(LogMonitor) << "Thread " << thread->GetThreadID() << ": already had monitor lock";
+		return;
 	}
+
+	exclusive_lock_.lock();
+	state.HoldsExclusive = true;
+	exclusive_active_.store(true, std::memory_order_seq_cst);
+
+	// Wait for any exclusive stores which started before the flag was set
+	for(auto &bucket : buckets_) {
+		if(&bucket == state.HeldBucket) {
+			continue;
+		}
+		while(bucket.Locked.load(std::memory_order_seq_cst)) {
+			__builtin_ia32_pause();
+		}
+	}
+
+	LC_DEBUG1(LogMonitor) << "Thread " << thread->GetThreadID() << ": locked monitor";
 }
 
 void BaseMemoryMonitor::Unlock(archsim::core::thread::ThreadInstance* thread)
 {
 	LC_DEBUG1(LogMonitor) << "Thread " << thread->GetThreadID() << ": unlocking monitor";
 
-	if(locked_thread_ == thread) {
-		locked_thread_ = nullptr;
-		lock_.unlock();
-		LC_DEBUG1(LogMonitor) << "Thread " << thread->GetThreadID() << ": unlocked monitor";
-	} else {
-		LC_DEBUG1(LogMonitor) << "Thread " << thread->GetThreadID() << ": did not have monitor lock";
-	}
+	// This is also used to clean up after a fault part way through an
+	// exclusive store, so release the reservation bucket too
+	releaseAll(getThreadState(thread));
 }
 
 void BaseMemoryMonitor::AcquireMonitor(archsim::core::thread::ThreadInstance* thread, Address addr)
 {
-	Lock(thread);
+	auto &state = getThreadState(thread);
 
-	LC_DEBUG1(LogMonitor) << "Thread " << thread->GetThreadID() << " took monitor on " << addr;
-	monitors_[thread->GetThreadID()] = addr;
+	// A thread only ever has one reservation. Its address is only changed
+	// by the thread itself, but other threads may clear it.
+	if(state.HasReservation) {
+		uint32_t old_index = GetBucketIndex(state.Reservation);
+		lockBucket(buckets_[old_index]);
+		if(state.HasReservation) {
+			removeReservation(old_index, state);
+		}
+		unlockBucket(buckets_[old_index]);
+	}
 
-	Unlock(thread);
+	uint32_t index = GetBucketIndex(addr);
+	lockBucket(buckets_[index]);
+	state.Reservation = addr;
+	addReservation(index, state);
+	unlockBucket(buckets_[index]);
+
+	LC_DEBUG1(LogMonitor) << "Thread " << thread->GetThreadID() << " took monitor on " << addr;
 }
 
 bool BaseMemoryMonitor::LockMonitor(archsim::core::thread::ThreadInstance* thread, Address addr)
 {
-	Lock(thread);
+	auto &state = getThreadState(thread);
 
-	if(monitors_.count(thread->GetThreadID()) != 0 && monitors_.at(thread->GetThreadID()) == addr) {
+	uint32_t index = GetBucketIndex(addr);
+	auto &bucket = buckets_[index];
+	lockBucketForStore(bucket, state);
+
+	// The reservation is used up by the store, whether or not it succeeds
+	bool success = state.HasReservation && state.Reservation == addr;
+	if(state.HasReservation && GetBucketIndex(state.Reservation) == index) {
+		removeReservation(index, state);
+	}
+
+	if(success) {
 		LC_DEBUG1(LogMonitor) << "Thread " << thread->GetThreadID() << " successfully locked on " << addr;
+		state.HeldBucket = &bucket;
 		return true;
 	} else {
 		LC_DEBUG1(LogMonitor) << "Thread " << thread->GetThreadID() << " failed to lock on " << addr;
-		Unlock(thread);
+		unlockBucket(bucket);
 		return false;
 	}
 }
@@ -59,18 +186,43 @@ bool BaseMemoryMonitor::LockMonitor(archsim::core::thread::ThreadInstance* threa
 void BaseMemoryMonitor::UnlockMonitor(archsim::core::thread::ThreadInstance* thread, Address addr)
 {
 	LC_DEBUG1(LogMonitor) << "Thread " << thread->GetThreadID() << " unlocking monitor";
-	Unlock(thread);
+
+	auto &state = getThreadState(thread);
+	if(state.HeldBucket != nullptr) {
+		unlockBucket(*state.HeldBucket);
+		state.HeldBucket = nullptr;
+	}
 }
 
 void BaseMemoryMonitor::Notify(archsim::core::thread::ThreadInstance* thread, Address addr)
 {
-	Lock(thread);
+	// Most writes are to lines which nobody has reserved
+	if(!HasReservations(addr)) {
+		return;
+	}
+
 	LC_DEBUG1(LogMonitor) << "Thread " << thread->GetThreadID() << " notified " << addr;
-	for(const auto &monitor : monitors_) {
-		if(monitor.first != thread->GetThreadID() && addr == monitor.second) {
-			monitors_.erase(monitor.first);
+
+	auto &state = getThreadState(thread);
+	uint32_t index = GetBucketIndex(addr);
+	auto &bucket = buckets_[index];
+
+	bool take_lock = state.HeldBucket != &bucket;
+	if(take_lock) {
+		lockBucket(bucket);
+	}
+
+	uint64_t line = addr.Get() >> kLineBits;
+	for(size_t i = 0; i < bucket.Reservations.size();) {
+		auto other = bucket.Reservations[i];
+		if(other != &state && (other->Reservation.Get() >> kLineBits) == line) {
+			removeReservation(index, *other);
+		} else {
+			++i;
 		}
 	}
 
-	Unlock(thread);
+	if(take_lock) {
+		unlockBucket(bucket);
+	}
 }
@@ -4,8 +4,10 @@
 #include "core/execution/BasicJITExecutionEngine.h"
 #include "core/MemoryInterface.h"
 #include "util/LogContext.h"
+#include "system.h"
 
 #include <chrono>
+#include <sstream>
 
 using namespace archsim::core::execution;
 
@@ -13,95 +15,262 @@ DeclareLogContext(LogBasicJIT, "BasicJIT");
 
 void flush_txlns_callback(PubSubType::PubSubType type, void *context, const void *data)
 {
-	BasicJITExecutionEngine *engine = (BasicJITExecutionEngine*)context;
+	BasicJITExecutionEngineThreadContext *ctx = (BasicJITExecutionEngineThreadContext*)context;
+	BasicJITExecutionEngine *engine = (BasicJITExecutionEngine*)ctx->GetEngine();
 
+	// This may be called from any thread, so only request that the owning
+	// thread flushes its dispatch cache rather than touching it directly.
 	switch(type) {
 		case PubSubType::ITlbFullFlush:
-		case PubSubType::ITlbEntryFlush:
-			engine->FlushTxlnCache();
+			// Links to other pages depend on the virtual mapping which is
+			// being flushed
+			engine->UnlinkCrossPage();
+			ctx->RequestFlush(BasicJITExecutionEngineThreadContext::FlushCache);
 			break;
+		case PubSubType::ITlbEntryFlush: {
+			// Only blocks on the flushed page, and links into it, depend on
+			// the mapping which is changing
+			archsim::Address page ((uint64_t)data);
+			engine->UnlinkCrossPageInto(page);
+			ctx->RequestPageFlush(page);
+			break;
+		}
 		case PubSubType::FlushTranslations:
 		case PubSubType::L1ICacheFlush:
 			engine->FlushTxlns();
+			ctx->RequestFlush(BasicJITExecutionEngineThreadContext::FlushCache);
 			break;
 
 		case PubSubType::FeatureChange:
-			engine->FlushTxlnsFeature();
+			engine->UnlinkFeatureDependent();
+			ctx->RequestFlush(BasicJITExecutionEngineThreadContext::FlushFeatures);
 			break;
 
 		case PubSubType::FlushAllTranslations:
 			engine->FlushAllTxlns();
+			ctx->RequestFlush(BasicJITExecutionEngineThreadContext::FlushCache);
+			break;
+
+		case PubSubType::ASIDChange:
+			// Translations and the dispatch cache are only tagged with
+			// virtual addresses, so the thread must not reach blocks of the
+			// old address space through them
+			if(data == ctx->GetThread()->GetPeripherals().GetDeviceByName("mmu")) {
+				engine->UnlinkCrossPage();
+				ctx->RequestFlush(BasicJITExecutionEngineThreadContext::FlushCache);
+			}
 			break;
 
-		case PubSubType::RegionInvalidatePhysical:
-			engine->InvalidateRegion(archsim::Address((uint64_t)data));
+		case PubSubType::RegionInvalidatePhysicalLines: {
+			auto invalidation = (const archsim::translate::profile::CodeLineInvalidation*)data;
+			engine->InvalidateLines(invalidation->PageBase, invalidation->Lines);
 			break;
+		}
 		default:
 			break;
 	}
 }
 
-BasicJITExecutionEngine::BasicJITExecutionEngine(uint64_t max_code_size) : phys_block_profile_(mem_allocator_), subscribed_(false), flush_txlns_(0), flush_all_txlns_(0), max_code_size_(max_code_size)
+BasicJITExecutionEngineThreadContext::BasicJITExecutionEngineThreadContext(ExecutionEngine *engine, thread::ThreadInstance *thread) : ExecutionEngineThreadContext(engine, thread), pending_flush_(nullptr), code_epoch_(0), reader_slot_(0), chain_exit_(nullptr)
 {
 
 }
 
+BasicJITExecutionEngineThreadContext::~BasicJITExecutionEngineThreadContext()
+{
+
+}
+
+BasicJITExecutionEngine::BasicJITExecutionEngine(uint64_t max_code_size) : code_allocator_(mem_allocator_), phys_block_profile_(code_allocator_), flush_txlns_(false), flush_all_txlns_(false), max_code_size_(max_code_size), active_threads_(0)
+{
+
+}
+
+ExecutionEngineThreadContext* BasicJITExecutionEngine::GetNewContext(thread::ThreadInstance* thread)
+{
+	return new BasicJITExecutionEngineThreadContext(this, thread);
+}
 
 void BasicJITExecutionEngine::FlushTxlns()
 {
-	virt_block_cache_.Invalidate();
-	flush_txlns_ = 1;
+	flush_txlns_ = true;
 }
 
 void BasicJITExecutionEngine::FlushAllTxlns()
 {
-	virt_block_cache_.Invalidate();
-	flush_all_txlns_ = 1;
-	flush_txlns_ = 1;
+	flush_all_txlns_ = true;
+	flush_txlns_ = true;
+}
+
+void BasicJITExecutionEngine::retireFreedCode()
+{
+	// Moving to a new epoch makes every thread drop its references to the
+	// code freed so far at its next safepoint, after which the code can be
+	// reused
+	code_allocator_.RetireFreed();
+}
+
+void BasicJITExecutionEngine::InvalidateRegion(Address addr)
+{
+	std::lock_guard<std::mutex> lg(profile_lock_);
+	phys_block_profile_.MarkPageDirty(addr);
+}
+
+void BasicJITExecutionEngine::InvalidateLines(Address page_base, uint64_t lines)
+{
+	std::lock_guard<std::mutex> lg(profile_lock_);
+	phys_block_profile_.MarkLinesDirty(page_base, lines);
 }
 
-void BasicJITExecutionEngine::FlushTxlnCache()
+void BasicJITExecutionEngine::UnlinkCrossPage()
 {
-	virt_block_cache_.Invalidate();
+	std::lock_guard<std::mutex> lg(profile_lock_);
+	phys_block_profile_.GetLinker().UnlinkCrossPage();
 }
 
-void BasicJITExecutionEngine::FlushTxlnsFeature()
+void BasicJITExecutionEngine::UnlinkCrossPageInto(Address page_base)
 {
-	for(auto i : GetThreads()) {
-		virt_block_cache_.InvalidateFeatures(i->GetFeatures().GetAvailableMask());
+	std::lock_guard<std::mutex> lg(profile_lock_);
+	phys_block_profile_.GetLinker().UnlinkCrossPageInto(page_base);
+}
+
+void BasicJITExecutionEngine::UnlinkFeatureDependent()
+{
+	std::lock_guard<std::mutex> lg(profile_lock_);
+	phys_block_profile_.GetLinker().UnlinkFeatureDependent();
+}
+
+void BasicJITExecutionEngine::checkFlushTxlns(BasicJITExecutionEngineThreadContext *ctx)
+{
+	if(flush_txlns_.exchange(false)) {
+		bool flush_all = flush_all_txlns_.exchange(false);
+
+		std::lock_guard<std::mutex> lg(profile_lock_);
+		if(archsim::options::AggressiveCodeInvalidation || flush_all) {
+			phys_block_profile_.Invalidate();
+		} else {
+			archsim::blockjit::BlockCollectionStats stats;
+			phys_block_profile_.GarbageCollect(stats);
+
+			auto &metrics = ctx->GetThread()->GetMetrics();
+			metrics.JITModifiedTxlns.inc(stats.InvalidatedTxlns);
+			metrics.JITPreservedTxlns.inc(stats.PreservedTxlns);
+		}
+
+		retireFreedCode();
+	}
+
+	// This is a safepoint for this thread: it is not executing any translated
+	// code, so once its dispatch cache is up to date it cannot reach any code
+	// freed before the current epoch.
+	uint64_t epoch = code_allocator_.GetEpoch();
+	uint32_t pending = ctx->TakePendingFlush();
+
+	// Take the queued pages even if the whole cache is being flushed, so
+	// that they aren't flushed again later
+	std::vector<Address> pages;
+	if(pending & BasicJITExecutionEngineThreadContext::FlushPages) {
+		pages = ctx->TakePendingPages();
+	}
+
+	if(pending & BasicJITExecutionEngineThreadContext::FlushCache) {
+		flushDispatchCache(ctx);
+	} else {
+		// Only the entries for code which has been freed since this thread
+		// last caught up need to be dropped. This must happen before any
+		// feature dependent entries are swapped back in.
+		if(epoch != ctx->GetCodeEpoch()) {
+			std::vector<void*> retired;
+			code_allocator_.GetRetiredSince(ctx->GetCodeEpoch(), retired);
+
+			std::unordered_set<captive::shared::block_txln_fn> txlns;
+			for(auto buffer : retired) {
+				txlns.insert((captive::shared::block_txln_fn)buffer);
+			}
+			flushDispatchCode(ctx, txlns);
+		}
+
+		if(pending & BasicJITExecutionEngineThreadContext::FlushFeatures) {
+			ctx->GetBlockCache().InvalidateFeatures(ctx->GetThread()->GetFeatures().GetAvailableMask());
+		}
+
+		for(auto page : pages) {
+			flushDispatchPage(ctx, page);
+		}
+		ctx->GetThread()->GetMetrics().JITPageFlushes.inc(pages.size());
+	}
+
+	ctx->SetCodeEpoch(epoch);
+	code_allocator_.Quiesce(ctx->GetReaderSlot(), epoch);
+
+	if(pending & BasicJITExecutionEngineThreadContext::ProfileDue) {
+		profileTranslations(ctx);
 	}
 }
 
-void BasicJITExecutionEngine::InvalidateRegion(Address addr)
+void BasicJITExecutionEngine::flushDispatchCache(BasicJITExecutionEngineThreadContext* ctx)
 {
-	phys_block_profile_.MarkPageDirty(addr);
+	ctx->GetBlockCache().Invalidate();
+
+	// A pending exit may belong to code which has now been freed
+	if(ctx->GetChainExit() != nullptr) {
+		*ctx->GetChainExit() = nullptr;
+	}
 }
 
-void BasicJITExecutionEngine::checkFlushTxlns()
+void BasicJITExecutionEngine::flushDispatchCode(BasicJITExecutionEngineThreadContext* ctx, const std::unordered_set<captive::shared::block_txln_fn> &txlns)
 {
-	if(flush_txlns_) {
-		if(archsim::options::AggressiveCodeInvalidation || flush_all_txlns_) phys_block_profile_.Invalidate();
-		else phys_block_profile_.GarbageCollect();
-		virt_block_cache_.Invalidate();
-		flush_txlns_ = false;
-		flush_all_txlns_ = false;
+	ctx->GetBlockCache().InvalidateCode(txlns);
+
+	// A pending exit may belong to code which is about to be reused
+	auto chain_exit = ctx->GetChainExit();
+	if(chain_exit != nullptr && *chain_exit != nullptr && txlns.count((captive::shared::block_txln_fn)(*chain_exit)->Source)) {
+		*chain_exit = nullptr;
 	}
 }
 
-void BasicJITExecutionEngine::checkCodeSize()
+void BasicJITExecutionEngine::flushDispatchPage(BasicJITExecutionEngineThreadContext* ctx, Address page_base)
+{
+	ctx->GetBlockCache().InvalidatePage(page_base);
+}
+
+void BasicJITExecutionEngine::checkCodeSize(BasicJITExecutionEngineThreadContext *ctx)
 {
 	if(max_code_size_ == 0) {
 		return;
 	}
+
+	std::lock_guard<std::mutex> lg(profile_lock_);
+	if(phys_block_profile_.GetTotalCodeSize() <= max_code_size_) {
+		return;
+	}
+
+	auto &metrics = ctx->GetThread()->GetMetrics();
+
+	if(!archsim::options::JitFlushFullCodeCache) {
+		// Evict well below the limit, so that we don't have to evict again
+		// on the very next translation
+		archsim::blockjit::BlockEvictionStats stats;
+		phys_block_profile_.Evict(max_code_size_ - (max_code_size_ / 4), stats);
+
+		LC_DEBUG1(LogBasicJIT) << "Evicted " << stats.Txlns << " translations (" << stats.Bytes << " bytes) from " << stats.Pages << " pages";
+		metrics.JITEvictedPages.inc(stats.Pages);
+		metrics.JITEvictedTxlns.inc(stats.Txlns);
+		metrics.JITEvictedBytes.inc(stats.Bytes);
+	}
+
+	// Fall back to a full flush if nothing could be evicted (e.g. if every
+	// page is dirty)
 	if(phys_block_profile_.GetTotalCodeSize() > max_code_size_) {
 		phys_block_profile_.Invalidate();
-		virt_block_cache_.Invalidate();
+		metrics.JITCodeFlushes.inc();
 	}
 
+	retireFreedCode();
 }
 
 
-template<typename PC_t> ExecutionResult BasicJITExecutionEngine::ExecuteLoop(ExecutionEngineThreadContext *ctx, PC_t *pc_ptr)
+template<typename PC_t> ExecutionResult BasicJITExecutionEngine::ExecuteLoop(BasicJITExecutionEngineThreadContext *ctx, PC_t *pc_ptr)
 {
 	auto thread = ctx->GetThread();
 
@@ -118,7 +287,7 @@ template<typename PC_t> ExecutionResult BasicJITExecutionEngine::ExecuteLoop(Exe
 			thread->GetTraceSource()->Trace_End_Insn();
 		}
 
-		checkFlushTxlns();
+		checkFlushTxlns(ctx);
 
 		if(thread->HasMessage()) {
 			auto result = thread->HandleMessage();
@@ -132,7 +301,7 @@ template<typename PC_t> ExecutionResult BasicJITExecutionEngine::ExecuteLoop(Exe
 		}
 
 		block_txln_fn fn;
-		if(lookupBlock(thread, Address(*pc_ptr), fn)) {
+		if(lookupBlock(ctx, Address(*pc_ptr), fn)) {
 			assert(fn != nullptr);
 
 			if(verbose) {
@@ -145,7 +314,7 @@ template<typename PC_t> ExecutionResult BasicJITExecutionEngine::ExecuteLoop(Exe
 				thread->GetMetrics().JITTime.Stop();
 			}
 		} else {
-			if(!translateBlock(thread, Address(*pc_ptr), false, false)) {
+			if(!translateBlock(ctx, Address(*pc_ptr), supportsChaining(), false)) {
 				// failed to decode a block: abort
 				if(verbose) {
 					thread->GetMetrics().SelfRuntime.Stop();
@@ -166,42 +335,87 @@ template<typename PC_t> ExecutionResult BasicJITExecutionEngine::ExecuteLoop(Exe
 	return ExecutionResult::Halt;
 }
 
-template<typename PC_t> void BasicJITExecutionEngine::ExecuteInnerLoop(ExecutionEngineThreadContext* ctx, PC_t* pc_ptr)
+template<typename PC_t> void BasicJITExecutionEngine::ExecuteInnerLoop(BasicJITExecutionEngineThreadContext* ctx, PC_t* pc_ptr)
 {
 	auto thread = ctx->GetThread();
 	auto regfile = thread->GetRegisterFile();
+	const auto &cache = ctx->GetBlockCache();
+	auto chain_exit = ctx->GetChainExit();
 
-	while(!thread->HasMessage()) {
+	// Leave the loop if a flush has been requested, so that it can be
+	// performed at the safepoint in the outer loop
+	while(!thread->HasMessage() && !ctx->HasPendingFlush()) {
 		uint64_t pc = *(PC_t*)(pc_ptr);
 
-		uint64_t entry_idx = pc & BLOCKCACHE_MASK;
-		entry_idx >>= BLOCKCACHE_INSTRUCTION_SHIFT;
-
-		const auto & entry  = virt_block_cache_.GetEntry(Address(pc));
+		const auto & entry  = cache.GetEntry(Address(pc));
 
-		if(entry.virt_tag == pc) {
-			entry.ptr(regfile, thread->GetStateBlock().GetData());
-		} else {
+		if(entry.virt_tag != pc) {
+			// Leave any reported exit pending until the block it leads to
+			// has been translated
 			return;
 		}
+
+		if(chain_exit != nullptr && *chain_exit != nullptr) {
+			linkBlock(ctx, *chain_exit, Address(pc), entry.ptr);
+			*chain_exit = nullptr;
+		}
+
+		entry.ptr(regfile, thread->GetStateBlock().GetData());
 	}
 }
 
-ExecutionResult BasicJITExecutionEngine::Execute(ExecutionEngineThreadContext* ctx)
+ExecutionResult BasicJITExecutionEngine::Execute(ExecutionEngineThreadContext* thread_ctx)
 {
+	BasicJITExecutionEngineThreadContext *ctx = (BasicJITExecutionEngineThreadContext*)thread_ctx;
 	auto thread = ctx->GetThread();
 
-	util::PubSubscriber pubsub (thread->GetPubsub());
-	pubsub.Subscribe(PubSubType::FlushTranslations, flush_txlns_callback, this);
-	pubsub.Subscribe(PubSubType::FlushAllTranslations, flush_txlns_callback, this);
-	pubsub.Subscribe(PubSubType::ITlbFullFlush, flush_txlns_callback, this);
-	pubsub.Subscribe(PubSubType::ITlbEntryFlush, flush_txlns_callback, this);
-	pubsub.Subscribe(PubSubType::L1ICacheFlush, flush_txlns_callback, this);
-	pubsub.Subscribe(PubSubType::FeatureChange, flush_txlns_callback, this);
-	pubsub.Subscribe(PubSubType::RegionInvalidatePhysical, flush_txlns_callback, this);
+	auto &state_block = thread->GetStateBlock();
 
-	ctx->GetThread()->GetStateBlock().AddBlock("BlockCache", sizeof(void*));
-	ctx->GetThread()->GetStateBlock().SetEntry<archsim::blockjit::BlockCacheEntry*>("BlockCache", virt_block_cache_.GetPtr());
+	// Pointers into the state block are only stable once every entry has
+	// been added, so add them all before taking any
+	state_block.AddBlock("PendingFlush", sizeof(uint32_t));
+	state_block.AddBlock("BlockCache", sizeof(void*));
+	if(supportsChaining()) {
+		state_block.AddBlock("BlockChainExit", sizeof(void*));
+		state_block.AddBlock("BlockReturnStack", sizeof(void*));
+	}
+	if(thread->GetTraceSource()) {
+		state_block.AddBlock("TraceBufferPos", sizeof(void*));
+		state_block.AddBlock("TraceBufferLimit", sizeof(void*));
+	}
+
+	state_block.SetEntry<uint32_t>("PendingFlush", BasicJITExecutionEngineThreadContext::FlushNone);
+	ctx->SetPendingFlush(state_block.GetEntryPointer<uint32_t>("PendingFlush"));
+	state_block.SetEntry<archsim::blockjit::BlockCacheEntry*>("BlockCache", ctx->GetBlockCache().GetPtr());
+
+	if(supportsChaining()) {
+		state_block.SetEntry<archsim::blockjit::BlockChainSlot*>("BlockChainExit", nullptr);
+		ctx->SetChainExit(state_block.GetEntryPointer<archsim::blockjit::BlockChainSlot*>("BlockChainExit"));
+		state_block.SetEntry<archsim::blockjit::BlockReturnStack*>("BlockReturnStack", ctx->GetBlockCache().GetReturnStackPtr());
+	}
+
+	// Translated code writes trace records straight into the trace buffer
+	if(thread->GetTraceSource()) {
+		thread->GetTraceSource()->BindBuffer(state_block.GetEntryPointer<libtrace::TraceRecord*>("TraceBufferPos"), state_block.GetEntryPointer<libtrace::TraceRecord*>("TraceBufferLimit"));
+	}
+
+	util::PubSubscriber pubsub (thread->GetPubsub());
+	pubsub.Subscribe(PubSubType::FlushTranslations, flush_txlns_callback, ctx);
+	pubsub.Subscribe(PubSubType::FlushAllTranslations, flush_txlns_callback, ctx);
+	pubsub.Subscribe(PubSubType::ITlbFullFlush, flush_txlns_callback, ctx);
+	pubsub.Subscribe(PubSubType::ITlbEntryFlush, flush_txlns_callback, ctx);
+	pubsub.Subscribe(PubSubType::L1ICacheFlush, flush_txlns_callback, ctx);
+	pubsub.Subscribe(PubSubType::FeatureChange, flush_txlns_callback, ctx);
+	pubsub.Subscribe(PubSubType::RegionInvalidatePhysicalLines, flush_txlns_callback, ctx);
+	pubsub.Subscribe(PubSubType::ASIDChange, flush_txlns_callback, ctx);
+
+	openTranslationStore(ctx);
+	active_threads_++;
+
+	// Each executing thread is a reader of the shared code cache
+	ctx->GetBlockCache().Invalidate();
+	code_allocator_.RegisterReader(ctx->GetReaderSlot());
+	ctx->SetCodeEpoch(code_allocator_.GetEpoch());
 
 	std::unique_ptr<util::CounterTimerContext> timer_ctx;
 
@@ -212,21 +426,40 @@ ExecutionResult BasicJITExecutionEngine::Execute(ExecutionEngineThreadContext* c
 	const auto &pc_desc = thread->GetArch().GetRegisterFileDescriptor().GetTaggedEntry("PC");
 	void *pc_ptr = (uint8_t*)thread->GetRegisterFile() + pc_desc.GetOffset();
 
+	ExecutionResult result;
 	switch(pc_desc.GetEntrySize()) {
 		case 4:
-			return ExecuteLoop(ctx, (uint32_t*)pc_ptr);
+			result = ExecuteLoop(ctx, (uint32_t*)pc_ptr);
+			break;
 		case 8:
-			return ExecuteLoop(ctx, (uint64_t*)pc_ptr);
+			result = ExecuteLoop(ctx, (uint64_t*)pc_ptr);
+			break;
 		default:
+			code_allocator_.UnregisterReader(ctx->GetReaderSlot());
 			throw std::logic_error("Unsupported PC type");
 	}
+
+	code_allocator_.UnregisterReader(ctx->GetReaderSlot());
+	if(thread->GetTraceSource()) {
+		thread->GetTraceSource()->UnbindBuffer();
+	}
+
+	// Save translations once the last thread has stopped
+	if(--active_threads_ == 0 && translation_store_ && archsim::options::JitSaveTranslations) {
+		translation_store_->Save(archsim::options::JitTranslationFile.GetValue());
+	}
+
+	return result;
 }
 
-bool BasicJITExecutionEngine::lookupBlock(thread::ThreadInstance* thread, Address addr, captive::shared::block_txln_fn& txln_fn)
+bool BasicJITExecutionEngine::lookupBlock(BasicJITExecutionEngineThreadContext *ctx, Address addr, captive::shared::block_txln_fn& txln_fn)
 {
+	auto thread = ctx->GetThread();
+	auto &cache = ctx->GetBlockCache();
+
 	LC_DEBUG2(LogBasicJIT) << "Looking up " << addr;
 	// Look up the block in the cache, just in case we already have it translated
-	if((txln_fn = virt_block_cache_.Lookup(addr))) {
+	if((txln_fn = cache.Lookup(addr))) {
 		LC_DEBUG2(LogBasicJIT) << " - found in cache";
 		return true;
 	}
@@ -243,24 +476,177 @@ bool BasicJITExecutionEngine::lookupBlock(thread::ThreadInstance* thread, Addres
 		return false;
 	}
 
-	archsim::blockjit::BlockTranslation txln = phys_block_profile_.Get(physaddr, thread->GetFeatures());
+	archsim::blockjit::BlockTranslation txln;
+	{
+		std::lock_guard<std::mutex> lg(profile_lock_);
+		txln = phys_block_profile_.Get(physaddr, thread->GetFeatures());
+	}
 
 	LC_DEBUG2(LogBasicJIT) << " - Found translation (" << (void*)txln.GetFn() << "), checking features:";
 
 	if(txln.IsValid(thread->GetFeatures())) {
 		LC_DEBUG2(LogBasicJIT) << " - Features valid";
-		virt_block_cache_.Insert(addr, txln.GetFn(), txln.GetFeatures());
+		cache.Insert(addr, txln.GetFn(), txln.GetFeatures());
 		txln_fn = txln.GetFn();
 		return true;
 	} else {
 		LC_DEBUG2(LogBasicJIT) << " - Features invalid";
-		return false;
+		return restoreTranslation(ctx, physaddr, addr, txln_fn);
 	}
 }
 
-void BasicJITExecutionEngine::registerTranslation(Address phys_addr, Address virt_addr, archsim::blockjit::BlockTranslation& txln)
+void BasicJITExecutionEngine::registerTranslation(BasicJITExecutionEngineThreadContext *ctx, Address phys_addr, Address virt_addr, archsim::blockjit::BlockTranslation& txln)
 {
 	LC_DEBUG2(LogBasicJIT) << "Registering translation at " << virt_addr << "(" << phys_addr << ")";
-	phys_block_profile_.Insert(phys_addr, txln);
-	virt_block_cache_.Insert(virt_addr, txln.GetFn(), txln.GetFeatures());
+	bool retranslated;
+	{
+		std::lock_guard<std::mutex> lg(profile_lock_);
+		retranslated = phys_block_profile_.Insert(phys_addr, txln);
+	}
+	// Inserting may replace older versions of the block, or collect a
+	// dirty page early
+	retireFreedCode();
+
+	if(retranslated) {
+		ctx->GetThread()->GetMetrics().JITRetranslations.inc();
+	}
+	ctx->GetBlockCache().Insert(virt_addr, txln.GetFn(), txln.GetFeatures());
+}
+
+void BasicJITExecutionEngine::linkBlock(BasicJITExecutionEngineThreadContext *ctx, archsim::blockjit::BlockChainSlot *slot, Address target_pc, captive::shared::block_txln_fn target)
+{
+	// The exit is only taken when the PC matches the exit's target, so make
+	// sure the PC hasn't been changed since (e.g. by an interrupt)
+	if(slot->GuestPC != target_pc.Get()) {
+		return;
+	}
+
+	if(!canLinkBlock(ctx, target)) {
+		return;
+	}
+
+	Address physaddr (0);
+	if(ctx->GetThread()->GetFetchMI().PerformTranslation(target_pc, physaddr, false, true, false) != archsim::TranslationResult::OK) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lg(profile_lock_);
+
+	// The exit or its target may have been freed by another thread since
+	// this thread's last safepoint. Their memory can't have been reused yet,
+	// but they mustn't be linked.
+	if(code_allocator_.IsRetired((void*)slot->Source) || code_allocator_.IsRetired((void*)target)) {
+		return;
+	}
+
+	// Don't link into code which has been modified
+	if(phys_block_profile_.IsTxlnDirty(physaddr)) {
+		return;
+	}
+
+	// Chained code doesn't go through the profile, so count the link as a
+	// use of the target for eviction
+	phys_block_profile_.Touch(physaddr);
+
+	LC_DEBUG2(LogBasicJIT) << "Linking exit to " << target_pc;
+	phys_block_profile_.GetLinker().Link(slot, target, ctx->GetBlockCache().HasFeatureRequirements(target_pc));
+}
+
+void BasicJITExecutionEngine::unlinkPage(Address phys_addr)
+{
+	std::lock_guard<std::mutex> lg(profile_lock_);
+	phys_block_profile_.UnlinkPage(phys_addr);
+}
+
+void BasicJITExecutionEngine::openTranslationStore(BasicJITExecutionEngineThreadContext* ctx)
+{
+	if(!supportsTranslationStore() || !(archsim::options::JitLoadTranslations || archsim::options::JitSaveTranslations)) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lg(profile_lock_);
+	if(translation_store_) {
+		return;
+	}
+
+	// Translated code depends on the layout of the register file and state
+	// block, and on every option which affects code generation. Options
+	// added to the translator must be added here too.
+	auto thread = ctx->GetThread();
+	std::ostringstream config;
+	config << thread->GetArch().GetName() << ";" << thread->GetArch().GetRegisterFileDescriptor().GetSize() << ";";
+	for(const auto &entry : thread->GetStateBlock().GetDescriptor().GetBlockOffsets()) {
+		config << entry.first << "=" << entry.second << ";";
+	}
+	config << archsim::options::JitDisableBranchOpt << archsim::options::JitMergeBlocks << archsim::options::JitDisableChaining << archsim::options::JitDisableCrossPageChaining << archsim::options::JitDisableIndirectChaining << ";";
+	config << archsim::options::InstructionTick << archsim::options::MemoryCheckAlignment << ";" << archsim::options::SystemMemoryModel.GetValue() << ";";
+	config << archsim::options::Trace << ";" << archsim::options::TracePCRanges.GetValue() << ";" << archsim::options::TraceFunctions.GetValue() << ";" << archsim::options::TraceRings.GetValue() << ";" << archsim::options::TraceASIDs.GetValue() << ";" << (archsim::options::TraceStop > archsim::options::TraceSkip);
+
+	std::string config_str = config.str();
+	uint64_t signature = archsim::blockjit::BlockTranslationStore::Checksum((const uint8_t*)config_str.data(), config_str.size());
+
+	translation_store_.reset(new archsim::blockjit::BlockTranslationStore(signature));
+	if(archsim::options::JitLoadTranslations) {
+		translation_store_->Load(archsim::options::JitTranslationFile.GetValue());
+	}
+}
+
+bool BasicJITExecutionEngine::checksumPage(BasicJITExecutionEngineThreadContext* ctx, Address virt_addr, uint64_t& checksum)
+{
+	uint8_t data[Address::PageSize];
+	if(ctx->GetThread()->GetFetchMI().Read(virt_addr.PageBase(), data, sizeof(data)) != MemoryResult::OK) {
+		return false;
+	}
+
+	checksum = archsim::blockjit::BlockTranslationStore::Checksum(data, sizeof(data));
+	return true;
+}
+
+void BasicJITExecutionEngine::storeTranslation(BasicJITExecutionEngineThreadContext* ctx, Address phys_addr, Address virt_addr, const archsim::blockjit::BlockTranslation& txln, const std::vector<uint32_t>& host_relocations, const archsim::blockjit::BlockTranslationStore::chain_slot_list_t& chain_slots)
+{
+	if(!translation_store_ || !archsim::options::JitSaveTranslations) {
+		return;
+	}
+
+	uint64_t checksum;
+	if(!checksumPage(ctx, virt_addr, checksum)) {
+		return;
+	}
+
+	archsim::blockjit::BlockTranslationKey key { phys_addr.Get(), virt_addr.Get(), ctx->GetThread()->GetModeID() };
+	translation_store_->Record(key, checksum, txln, host_relocations, chain_slots);
+}
+
+bool BasicJITExecutionEngine::restoreTranslation(BasicJITExecutionEngineThreadContext* ctx, Address phys_addr, Address virt_addr, captive::shared::block_txln_fn& fn)
+{
+	if(!translation_store_ || !archsim::options::JitLoadTranslations) {
+		return false;
+	}
+
+	auto thread = ctx->GetThread();
+	archsim::blockjit::BlockTranslationKey key { phys_addr.Get(), virt_addr.Get(), thread->GetModeID() };
+	if(!translation_store_->Has(key)) {
+		return false;
+	}
+
+	uint64_t checksum;
+	if(!checksumPage(ctx, virt_addr, checksum)) {
+		return false;
+	}
+
+	archsim::blockjit::BlockTranslation txln;
+	if(!translation_store_->Restore(key, checksum, thread->GetFeatures(), GetMemAllocator(), txln)) {
+		return false;
+	}
+
+	LC_DEBUG2(LogBasicJIT) << " - Restored stored translation";
+
+	// The page must be watched for modification, just as if the block had
+	// been translated
+	thread->GetEmulationModel().GetSystem().GetCodeRegions().MarkRegionAsCode(PhysicalAddress(phys_addr.PageBase().Get()));
+	registerTranslation(ctx, phys_addr, virt_addr, txln);
+	thread->GetMetrics().JITRestoredTxlns.inc();
+
+	fn = txln.GetFn();
+	return true;
 }
@@ -16,7 +16,12 @@ using namespace archsim::core::execution;
 using namespace archsim::core::thread;
 
 
-BlockJITExecutionEngine::BlockJITExecutionEngine(gensim::blockjit::BaseBlockJITTranslate *translator) : BasicJITExecutionEngine(64*1024*1024), translator_(translator)
+BlockJITExecutionEngineThreadContext::BlockJITExecutionEngineThreadContext(ExecutionEngine *engine, thread::ThreadInstance *thread, gensim::blockjit::BaseBlockJITTranslate *translator) : BasicJITExecutionEngineThreadContext(engine, thread), translator_(translator)
+{
+
+}
+
+BlockJITExecutionEngine::BlockJITExecutionEngine(translator_factory_t translator_factory) : BasicJITExecutionEngine(64*1024*1024), translator_factory_(translator_factory)
 {
 
 }
@@ -24,15 +29,17 @@ BlockJITExecutionEngine::BlockJITExecutionEngine(gensim::blockjit::BaseBlockJITT
 
 ExecutionEngineThreadContext* BlockJITExecutionEngine::GetNewContext(thread::ThreadInstance* thread)
 {
-	return new ExecutionEngineThreadContext(this, thread);
+	return new BlockJITExecutionEngineThreadContext(this, thread, translator_factory_());
 }
 
-bool BlockJITExecutionEngine::translateBlock(ThreadInstance *thread, archsim::Address block_pc, bool support_chaining, bool support_profiling)
+bool BlockJITExecutionEngine::translateBlock(BasicJITExecutionEngineThreadContext *ctx, archsim::Address block_pc, bool support_chaining, bool support_profiling)
 {
-	checkCodeSize();
+	auto thread = ctx->GetThread();
+
+	checkCodeSize(ctx);
 
 	captive::shared::block_txln_fn fn;
-	if(lookupBlock(thread, block_pc, fn)) {
+	if(lookupBlock(ctx, block_pc, fn)) {
 		return true;
 	}
 
@@ -45,8 +52,8 @@ bool BlockJITExecutionEngine::translateBlock(ThreadInstance *thread, archsim::Ad
 	thread->GetEmulationModel().GetSystem().GetCodeRegions().MarkRegionAsCode(PhysicalAddress(physaddr.PageBase().Get()));
 
 	LC_DEBUG4(LogBlockJitCpu) << "Translating block " << std::hex << block_pc.Get();
-	auto *translate = translator_;
-	if(!support_chaining) translate->setSupportChaining(false);
+	auto *translate = ((BlockJITExecutionEngineThreadContext*)ctx)->GetTranslator();
+	translate->setSupportChaining(support_chaining && !archsim::options::JitDisableChaining);
 
 	if(support_profiling) {
 		translate->setSupportProfiling(true);
@@ -55,9 +62,13 @@ bool BlockJITExecutionEngine::translateBlock(ThreadInstance *thread, archsim::Ad
 	bool success = translate->translate_block(thread, block_pc, txln, GetMemAllocator());
 
 	if(success) {
+		if(translate->IsRelocatable()) {
+			storeTranslation(ctx, physaddr, block_pc, txln, translate->GetHostRelocations(), translate->GetChainSlots());
+		}
+
 		// we successfully created a translation, so add it to the physical profile
 		// and to the cache, since we'll probably need it again soon
-		registerTranslation(physaddr, block_pc, txln);
+		registerTranslation(ctx, physaddr, block_pc, txln);
 	} else {
 		// if we failed to produce a translation, then try and stop the simulation
 		LC_ERROR(LogBlockJitCpu) << "Failed to compile block! Aborting.";
@@ -81,8 +92,8 @@ ExecutionEngine *archsim::core::execution::BlockJITExecutionEngine::Factory(cons
 		return nullptr;
 	}
 
-	auto translator_entry = module->GetEntry<archsim::module::ModuleBlockJITTranslatorEntry>(entry_name)->Get();
-	return new BlockJITExecutionEngine(translator_entry);
+	auto translator_entry = module->GetEntry<archsim::module::ModuleBlockJITTranslatorEntry>(entry_name);
+	return new BlockJITExecutionEngine(translator_entry->Get);
 }
 
 static archsim::core::execution::ExecutionEngineFactoryRegistration registration("BlockJIT", 100, archsim::core::execution::BlockJITExecutionEngine::Factory);
@@ -59,12 +59,6 @@ BlockLLVMExecutionEngine::BlockLLVMExecutionEngine(gensim::BaseLLVMTranslate *tr
 
 }
 
-
-ExecutionEngineThreadContext* BlockLLVMExecutionEngine::GetNewContext(thread::ThreadInstance* thread)
-{
-	return new ExecutionEngineThreadContext(this, thread);
-}
-
 static unsigned __int128 uremi128(unsigned __int128 a, unsigned __int128 b)
 {
 	return a % b;
@@ -99,12 +93,14 @@ static bool shunt_builtin_f64_is_qnan(archsim::core::thread::ThreadInstance* thr
 	return thread->fn___builtin_f64_is_qnan(f);
 }
 
-bool BlockLLVMExecutionEngine::translateBlock(thread::ThreadInstance* thread, archsim::Address block_pc, bool support_chaining, bool support_profiling)
+bool BlockLLVMExecutionEngine::translateBlock(BasicJITExecutionEngineThreadContext *ctx, archsim::Address block_pc, bool support_chaining, bool support_profiling)
 {
-	checkCodeSize();
+	auto thread = ctx->GetThread();
+
+	checkCodeSize(ctx);
 
 	captive::shared::block_txln_fn fn;
-	if(lookupBlock(thread, block_pc, fn)) {
+	if(lookupBlock(ctx, block_pc, fn)) {
 		return true;
 	}
 
@@ -167,7 +163,7 @@ bool BlockLLVMExecutionEngine::translateBlock(thread::ThreadInstance* thread, ar
 //			txln.Dump("llvm-bin-" + std::to_string(physaddr.Get()));
 //		}
 //
-//		registerTranslation(physaddr, block_pc, txln);
+//		registerTranslation(ctx, physaddr, block_pc, txln);
 //
 //		return true;
 //	} else {
@@ -65,19 +65,22 @@ static llvm::TargetMachine *GetNativeMachine()
 	return machine;
 }
 
-BlockToLLVMExecutionEngine::BlockToLLVMExecutionEngine(gensim::blockjit::BaseBlockJITTranslate *translator) :
-	BlockJITExecutionEngine(translator),
+BlockToLLVMExecutionEngine::BlockToLLVMExecutionEngine(translator_factory_t translator_factory) :
+	BlockJITExecutionEngine(translator_factory),
 	adaptor_(*llvm_ctx_.getContext()),
 	compiler_(llvm_ctx_)
 {
 
 }
 
-bool BlockToLLVMExecutionEngine::buildBlockJITIR(thread::ThreadInstance* thread, archsim::Address block_pc, captive::arch::jit::TranslationContext& ctx, archsim::blockjit::BlockTranslation &txln)
+bool BlockToLLVMExecutionEngine::buildBlockJITIR(BasicJITExecutionEngineThreadContext *thread_ctx, archsim::Address block_pc, captive::arch::jit::TranslationContext& ctx, archsim::blockjit::BlockTranslation &txln)
 {
-	auto translator = GetTranslator();
+	auto thread = thread_ctx->GetThread();
+	auto translator = ((BlockJITExecutionEngineThreadContext*)thread_ctx)->GetTranslator();
 	translator->InitialiseFeatures(thread);
 	translator->InitialiseIsaMode(thread);
+	// The LLVM adaptor has no lowering for chained exits
+	translator->setSupportChaining(false);
 	auto decode_ctx = thread->GetEmulationModel().GetNewDecodeContext(*thread);
 	translator->SetDecodeContext(decode_ctx);
 
@@ -110,12 +113,14 @@ bool BlockToLLVMExecutionEngine::buildBlockJITIR(thread::ThreadInstance* thread,
 }
 
 
-bool BlockToLLVMExecutionEngine::translateBlock(thread::ThreadInstance* thread, archsim::Address block_pc, bool support_chaining, bool support_profiling)
+bool BlockToLLVMExecutionEngine::translateBlock(BasicJITExecutionEngineThreadContext *ctx, archsim::Address block_pc, bool support_chaining, bool support_profiling)
 {
-	checkCodeSize();
+	auto thread = ctx->GetThread();
+
+	checkCodeSize(ctx);
 
 	captive::shared::block_txln_fn fn;
-	if(lookupBlock(thread, block_pc, fn)) {
+	if(lookupBlock(ctx, block_pc, fn)) {
 		return true;
 	}
 
@@ -135,7 +140,7 @@ bool BlockToLLVMExecutionEngine::translateBlock(thread::ThreadInstance* thread,
 
 	blockjit::BlockTranslation txln;
 	captive::arch::jit::TranslationContext txln_ctx;
-	if(!buildBlockJITIR(thread, block_pc, txln_ctx, txln)) {
+	if(!buildBlockJITIR(ctx, block_pc, txln_ctx, txln)) {
 		return false;
 	}
 
@@ -165,7 +170,7 @@ bool BlockToLLVMExecutionEngine::translateBlock(thread::ThreadInstance* thread,
 //			txln.Dump("llvm-bin-" + std::to_string(physaddr.Get()));
 //		}
 //
-//		registerTranslation(physaddr, block_pc, txln);
+//		registerTranslation(ctx, physaddr, block_pc, txln);
 //
 //		return true;
 //	} else {
@@ -183,8 +188,8 @@ ExecutionEngine *BlockToLLVMExecutionEngine::Factory(const archsim::module::Modu
 	std::string blockjit_entry_name = cpu_prefix + "BlockJITTranslator";
 	std::string llvm_entry_name = cpu_prefix + "LLVMTranslator";
 	if(module->HasEntry(blockjit_entry_name)) {
-		auto translator_entry = module->GetEntry<archsim::module::ModuleBlockJITTranslatorEntry>(blockjit_entry_name)->Get();
-		return new BlockToLLVMExecutionEngine(translator_entry);
+		auto translator_entry = module->GetEntry<archsim::module::ModuleBlockJITTranslatorEntry>(blockjit_entry_name);
+		return new BlockToLLVMExecutionEngine(translator_entry->Get);
 	} else {
 		return nullptr;
 	}
@@ -85,7 +85,21 @@ void ExecutionEngine::AttachThread(thread::ThreadInstance* thread)
 		auto source = new libtrace::TraceSource(1024);
 		source->SetSink(GetTraceSink());
 		source->SetInstructionSkip(archsim::options::TraceSkip);
+		source->SetAggressiveFlush(!GetTraceSink()->IsBuffered());
 		thread->SetTraceSource(source);
+
+		auto filter = TraceFilter::CreateFromOptions(*thread);
+		thread->SetTraceFilter(filter);
+
+		if(archsim::options::TraceStop > archsim::options::TraceSkip) {
+			source->SetInstructionLimit(archsim::options::TraceStop - archsim::options::TraceSkip);
+
+			// Stop the translations from writing records at all once the
+			// window has ended
+			source->SetStopHandler([filter]() {
+				filter->Stop();
+			});
+		}
 	}
 
 	thread_contexts_[thread] = GetNewContext(thread);
@@ -107,6 +121,19 @@ void ExecutionEngine::DetachThread(thread::ThreadInstance* thread)
 		throw std::logic_error("Thread not attached to this engine");
 	}
 
+	// Hand over any records which the trace source is still holding
+	if(thread->GetTraceSource()) {
+		thread->GetTraceSource()->Flush();
+	}
+
+	if(thread->GetTraceFilter()) {
+		if(thread->GetTraceSource()) {
+			thread->GetTraceSource()->SetStopHandler(nullptr);
+		}
+		delete thread->GetTraceFilter();
+		thread->SetTraceFilter(nullptr);
+	}
+
 	auto context = GetContext(thread);
 	delete context;
 	thread_contexts_.erase(thread);
@@ -7,7 +7,7 @@
 
 using namespace archsim::core::execution;
 
-InterpreterExecutionEngineThreadContext::InterpreterExecutionEngineThreadContext(ExecutionEngine* engine, thread::ThreadInstance* thread) : ExecutionEngineThreadContext(engine, thread)
+InterpreterExecutionEngineThreadContext::InterpreterExecutionEngineThreadContext(ExecutionEngine* engine, thread::ThreadInstance* thread) : ExecutionEngineThreadContext(engine, thread), predecoded_blocks_(thread->GetEmulationModel().GetSystem().GetPubSub())
 {
 	auto &isa = thread->GetArch().GetISA(0);
 	decode_ctx_ = thread->GetEmulationModel().GetNewDecodeContext(*thread);
@@ -9,22 +9,15 @@
 using namespace archsim::core::execution;
 DeclareLogContext(LogRegionJIT, "LLVMRegionJIT");
 
-LLVMRegionJITExecutionEngineContext::LLVMRegionJITExecutionEngineContext(archsim::core::execution::ExecutionEngine* engine, archsim::core::thread::ThreadInstance* thread) : InterpreterExecutionEngineThreadContext(engine, thread), TxlnMgr(&thread->GetEmulationModel().GetSystem().GetPubSub())
+LLVMRegionJITExecutionEngineContext::LLVMRegionJITExecutionEngineContext(archsim::core::execution::ExecutionEngine* engine, archsim::core::thread::ThreadInstance* thread) : InterpreterExecutionEngineThreadContext(engine, thread)
 {
-	LLVMRegionJITExecutionEngine *e = (LLVMRegionJITExecutionEngine*)engine;
-
-	TxlnMgr.SetManager(thread->GetEmulationModel().GetSystem().GetCodeRegions());
-	if(!TxlnMgr.Initialise(e->translator_)) {
-		throw std::logic_error("");
-	}
-
 	thread->GetStateBlock().AddBlock("page_cache", 8);
 	thread->GetStateBlock().SetEntry("page_cache", &PageCache.Cache[0]);
 }
 
 LLVMRegionJITExecutionEngineContext::~LLVMRegionJITExecutionEngineContext()
 {
-	TxlnMgr.Destroy();
+
 }
 
 
@@ -36,18 +29,56 @@ LLVMRegionJITExecutionEngine::LLVMRegionJITExecutionEngine(interpret::Interprete
 
 LLVMRegionJITExecutionEngine::~LLVMRegionJITExecutionEngine()
 {
-
+	if(txln_mgr_) {
+		txln_mgr_->Destroy();
+	}
 }
 
 ExecutionEngineThreadContext* LLVMRegionJITExecutionEngine::GetNewContext(thread::ThreadInstance* thread)
 {
+	GetTxlnMgr(thread);
 	return new LLVMRegionJITExecutionEngineContext(this, thread);
 }
 
+archsim::translate::AsynchronousTranslationManager &LLVMRegionJITExecutionEngine::GetTxlnMgr(archsim::core::thread::ThreadInstance *thread)
+{
+	std::lock_guard<std::mutex> lg(txln_mgr_init_lock_);
+
+	if(!txln_mgr_) {
+		auto &system = thread->GetEmulationModel().GetSystem();
+		txln_mgr_.reset(new translate::AsynchronousTranslationManager(&system.GetPubSub()));
+		txln_mgr_->SetManager(system.GetCodeRegions());
+		if(!txln_mgr_->Initialise(translator_)) {
+			throw std::logic_error("");
+		}
+	}
+
+	return *txln_mgr_;
+}
+
+void LLVMRegionJITExecutionEngine::profile(LLVMRegionJITExecutionEngineContext *ctx)
+{
+	auto thread = ctx->GetThread();
+	auto &txln_mgr = *txln_mgr_;
+
+	std::lock_guard<std::mutex> lg(txln_mgr.GetLock());
+
+	// Successors are only recorded within this thread's trace
+	txln_mgr.ResetTrace();
+	for(const auto &entry : ctx->Trace) {
+		txln_mgr.GetRegion(entry.PhysPC).TraceBlock(entry.VirtPC, entry.IsaMode, entry.Ring);
+	}
+	ctx->Trace.clear();
+
+	txln_mgr.Profile(thread);
+	txln_mgr.RegisterCompletedTranslations();
+}
+
 ExecutionResult LLVMRegionJITExecutionEngine::Execute(ExecutionEngineThreadContext* thread_ctx)
 {
 	LLVMRegionJITExecutionEngineContext *ctx = (LLVMRegionJITExecutionEngineContext*)thread_ctx;
 	auto thread = thread_ctx->GetThread();
+	auto &txln_mgr = GetTxlnMgr(thread);
 
 	archsim::util::CounterTimerContext self_timer(thread->GetMetrics().SelfRuntime);
 
@@ -77,37 +108,46 @@ ExecutionResult LLVMRegionJITExecutionEngine::Execute(ExecutionEngineThreadConte
 
 			auto txln = thread->GetFetchMI().PerformTranslation(virt_pc, phys_pc, false, true, false);
 			if(txln == TranslationResult::OK) {
-				auto &region = ctx->TxlnMgr.GetRegion(phys_pc);
-				ctx->CurrentRegion = &region;
+				archsim::translate::Translation *region_txln = nullptr;
+				{
+					std::lock_guard<std::mutex> lg(txln_mgr.GetLock());
+					auto &region = txln_mgr.GetRegion(phys_pc);
 
-				LC_DEBUG3(LogRegionJIT) << "Looking for region P" << region.GetPhysicalBaseAddress();
+					LC_DEBUG3(LogRegionJIT) << "Looking for region P" << region.GetPhysicalBaseAddress();
 
-				if(region.HasTranslations()) {
-					LC_DEBUG3(LogRegionJIT) << "Region " << region.GetPhysicalBaseAddress() << " has translations";
+					if(region.HasTranslations()) {
+						LC_DEBUG3(LogRegionJIT) << "Region " << region.GetPhysicalBaseAddress() << " has translations";
 
-					LC_DEBUG3(LogRegionJIT) << "Region " << region.GetPhysicalBaseAddress() << " has virtual images:";
-					for(auto i : region.virtual_images) {
-						LC_DEBUG3(LogRegionJIT) << Address(i);
+						LC_DEBUG3(LogRegionJIT) << "Region " << region.GetPhysicalBaseAddress() << " has virtual images:";
+						for(auto i : region.virtual_images) {
+							LC_DEBUG3(LogRegionJIT) << Address(i);
+						}
+
+						if(region.txln != nullptr && region.virtual_images.count(virt_pc.PageBase()) && region.txln->ContainsBlock(virt_pc.PageOffset())) {
+							region_txln = region.txln;
+						} else {
+							LC_DEBUG3(LogRegionJIT) << "Translation NOT found for current block";
+						}
 					}
+				}
 
-					if(region.txln != nullptr && region.virtual_images.count(virt_pc.PageBase()) && region.txln->ContainsBlock(virt_pc.PageOffset())) {
-						LC_DEBUG3(LogRegionJIT) << "Translation found for current block";
-						captive::shared::block_txln_fn fn;
-						region.txln->Install(&fn);
-						ctx->PageCache.InsertEntry(virt_pc.PageBase(), fn);
+				// Region translations are never freed, so the translation
+				// can be used without holding the lock
+				if(region_txln != nullptr) {
+					LC_DEBUG3(LogRegionJIT) << "Translation found for current block";
+					captive::shared::block_txln_fn fn;
+					region_txln->Install(&fn);
+					ctx->PageCache.InsertEntry(virt_pc.PageBase(), fn);
 
-						if(archsim::options::Verbose) {
-							thread->GetMetrics().JITTime.Start();
-						}
-						auto exit_reason = region.txln->Execute(thread);
-						LC_DEBUG2(LogRegionJIT) << "Left JIT for reason " << exit_reason;
-						if(archsim::options::Verbose) {
-							thread->GetMetrics().JITTime.Stop();
-						}
-						continue;
-					} else {
-						LC_DEBUG3(LogRegionJIT) << "Translation NOT found for current block";
+					if(archsim::options::Verbose) {
+						thread->GetMetrics().JITTime.Start();
 					}
+					auto exit_reason = region_txln->Execute(thread);
+					LC_DEBUG2(LogRegionJIT) << "Left JIT for reason " << exit_reason;
+					if(archsim::options::Verbose) {
+						thread->GetMetrics().JITTime.Stop();
+					}
+					continue;
 				}
 			} else {
 				LC_DEBUG1(LogRegionJIT) << "Fetch virtual translation failed";
@@ -129,8 +169,7 @@ ExecutionResult LLVMRegionJITExecutionEngine::Execute(ExecutionEngineThreadConte
 			}
 
 		}
-		ctx->TxlnMgr.Profile(thread);
-		ctx->TxlnMgr.RegisterCompletedTranslations();
+		profile(ctx);
 
 	}
 	return ExecutionResult::Halt;
@@ -139,30 +178,19 @@ ExecutionResult LLVMRegionJITExecutionEngine::Execute(ExecutionEngineThreadConte
 ExecutionResult LLVMRegionJITExecutionEngine::EpochInterpret(LLVMRegionJITExecutionEngineContext *ctx)
 {
 	auto thread = ctx->GetThread();
-	archsim::translate::profile::Region* region = nullptr;
 
 	while(ctx->Iterations-- > 0 && !thread->HasMessage()) {
-
-
 		auto virt_pc = thread->GetPC();
-		if(region == nullptr || !region->virtual_images.count(virt_pc)) {
-			if(region != nullptr) {
-				region->Release();
-			}
-
-			Address phys_pc;
-			auto txln_result = thread->GetFetchMI().PerformTranslation(virt_pc, phys_pc, false, true, false);
-			if(txln_result != TranslationResult::OK) {
-				// step a block without tracing to trigger a fetch fault
-				interpreter_->StepBlock(ctx);
-				continue;
-			}
 
-			region = &ctx->TxlnMgr.GetRegion(phys_pc);
-			region->Acquire();
+		Address phys_pc;
+		auto txln_result = thread->GetFetchMI().PerformTranslation(virt_pc, phys_pc, false, true, false);
+		if(txln_result != TranslationResult::OK) {
+			// step a block without tracing to trigger a fetch fault
+			interpreter_->StepBlock(ctx);
+			continue;
 		}
 
-		region->TraceBlock(thread, virt_pc);
+		ctx->Trace.push_back({phys_pc, virt_pc, (uint8_t)thread->GetModeID(), thread->GetExecutionRing()});
 		auto result = interpreter_->StepBlock(ctx);
 
 		switch(result) {
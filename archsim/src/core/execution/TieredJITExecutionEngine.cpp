@@ -0,0 +1,303 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include "blockjit/block-compiler/lowering/NativeLowering.h"
+#include "core/execution/TieredJITExecutionEngine.h"
+#include "core/execution/ExecutionEngineFactory.h"
+#include "core/thread/ThreadInstance.h"
+#include "core/MemoryInterface.h"
+#include "translate/Translation.h"
+#include "translate/profile/Block.h"
+#include "translate/profile/Region.h"
+#include "util/LogContext.h"
+#include "system.h"
+
+using namespace archsim::core::execution;
+using archsim::translate::profile::Region;
+
+DeclareLogContext(LogTieredJIT, "TieredJIT");
+
+TieredJITExecutionEngineThreadContext::TieredJITExecutionEngineThreadContext(ExecutionEngine *engine, thread::ThreadInstance *thread, gensim::blockjit::BaseBlockJITTranslate *translator, gensim::BaseLLVMTranslate *region_translator) : BlockJITExecutionEngineThreadContext(engine, thread, translator), TxlnMgr(&thread->GetEmulationModel().GetSystem().GetPubSub())
+{
+	TxlnMgr.SetManager(thread->GetEmulationModel().GetSystem().GetCodeRegions());
+	if(!TxlnMgr.Initialise(region_translator)) {
+		throw std::logic_error("Could not initialise region translation manager");
+	}
+
+	ProfileCursor = 0;
+
+	thread->GetStateBlock().AddBlock("page_cache", 8);
+	thread->GetStateBlock().SetEntry("page_cache", &PageCache.Cache[0]);
+
+	thread->GetStateBlock().AddBlock("ProfileBudget", sizeof(int32_t));
+	thread->GetStateBlock().SetEntry<int32_t>("ProfileBudget", archsim::options::JitProfilingInterval);
+}
+
+TieredJITExecutionEngineThreadContext::~TieredJITExecutionEngineThreadContext()
+{
+	for(auto region : InstalledRegions) {
+		region.first->Release();
+	}
+
+	TxlnMgr.Destroy();
+}
+
+TieredJITExecutionEngine::TieredJITExecutionEngine(translator_factory_t translator_factory, region_translator_factory_t region_translator_factory) : BlockJITExecutionEngine(translator_factory), region_translator_factory_(region_translator_factory), profiled_block_count_(0)
+{
+	for(auto &chunk : profiled_block_chunks_) {
+		chunk.store(nullptr, std::memory_order_relaxed);
+	}
+}
+
+TieredJITExecutionEngine::~TieredJITExecutionEngine()
+{
+	for(auto &chunk : profiled_block_chunks_) {
+		delete [] chunk.load(std::memory_order_relaxed);
+	}
+}
+
+ExecutionEngineThreadContext* TieredJITExecutionEngine::GetNewContext(thread::ThreadInstance* thread)
+{
+	auto ctx = new TieredJITExecutionEngineThreadContext(this, thread, translator_factory_(), region_translator_factory_());
+	ctx->GetTranslator()->setBlockProfiler([this](Address virt_pc, Address phys_pc, uint8_t isa_mode) {
+		return getBlockCounter(virt_pc, phys_pc, isa_mode);
+	});
+	return ctx;
+}
+
+bool TieredJITExecutionEngine::translateBlock(BasicJITExecutionEngineThreadContext *ctx, archsim::Address block_pc, bool support_chaining, bool support_profiling)
+{
+	return BlockJITExecutionEngine::translateBlock(ctx, block_pc, support_chaining, true);
+}
+
+uint64_t *TieredJITExecutionEngine::getBlockCounter(Address virt_pc, Address phys_pc, uint8_t isa_mode)
+{
+	std::lock_guard<std::mutex> lg(profiled_blocks_lock_);
+
+	// Retranslations of a block keep counting into the same counter
+	auto existing = profiled_block_index_.find(phys_pc.Get());
+	if(existing != profiled_block_index_.end()) {
+		if(existing->second->IsaMode != isa_mode) {
+			return nullptr;
+		}
+		return &existing->second->Count;
+	}
+
+	// Blocks beyond the last chunk are simply not profiled
+	size_t index = profiled_block_count_.load(std::memory_order_relaxed);
+	if(index >= kProfiledBlocksPerChunk * kMaxProfiledBlockChunks) {
+		return nullptr;
+	}
+
+	auto &chunk = profiled_block_chunks_[index / kProfiledBlocksPerChunk];
+	if(chunk.load(std::memory_order_relaxed) == nullptr) {
+		chunk.store(new ProfiledBlock[kProfiledBlocksPerChunk], std::memory_order_relaxed);
+	}
+
+	auto &block = getProfiledBlock(index);
+	block = {virt_pc, phys_pc, isa_mode, 0};
+	profiled_block_index_[phys_pc.Get()] = &block;
+
+	// Publish the counter to threads scanning the profile
+	profiled_block_count_.store(index + 1, std::memory_order_release);
+	return &block.Count;
+}
+
+bool TieredJITExecutionEngine::lookupBlock(BasicJITExecutionEngineThreadContext *basic_ctx, Address addr, captive::shared::block_txln_fn& fn)
+{
+	auto ctx = (TieredJITExecutionEngineThreadContext*)basic_ctx;
+
+	if((fn = ctx->GetBlockCache().Lookup(addr))) {
+		return true;
+	}
+
+	// Prefer region code, if this block is an entry point of a region which
+	// has already been installed
+	Address phys_addr (0);
+	if(!ctx->InstalledRegions.empty() && ctx->GetThread()->GetFetchMI().PerformTranslation(addr, phys_addr, false, true, false) == archsim::TranslationResult::OK) {
+		std::lock_guard<std::mutex> lg(ctx->TxlnMgr.GetLock());
+
+		Region *region;
+		auto installed = ctx->InstalledRegions.end();
+		if(ctx->TxlnMgr.TryGetRegion(phys_addr, region)) {
+			installed = ctx->InstalledRegions.find(region);
+		}
+
+		if(installed != ctx->InstalledRegions.end() && region->IsValid() && region->virtual_images.count(addr.PageBase())) {
+			auto block = region->blocks.find(addr.PageOffset());
+			if(block != region->blocks.end() && block->second->IsRootBlock() && region->txln->ContainsBlock(addr)) {
+				ctx->GetBlockCache().Insert(addr, installed->second, archsim::ProcessorFeatureSet());
+				fn = installed->second;
+				return true;
+			}
+		}
+	}
+
+	return BlockJITExecutionEngine::lookupBlock(ctx, addr, fn);
+}
+
+void TieredJITExecutionEngine::profileTranslations(BasicJITExecutionEngineThreadContext *basic_ctx)
+{
+	auto ctx = (TieredJITExecutionEngineThreadContext*)basic_ctx;
+	auto thread = ctx->GetThread();
+
+	std::lock_guard<std::mutex> txln_lg(ctx->TxlnMgr.GetLock());
+
+	// Only scan a batch of the counters, continuing from where this thread
+	// last stopped. Counts build up until they are scanned, so none are lost,
+	// and a large profile doesn't make every safepoint slow.
+	size_t block_count = profiled_block_count_.load(std::memory_order_acquire);
+	size_t scan = block_count < kProfileScanBatch ? block_count : kProfileScanBatch;
+	for(size_t i = 0; i < scan; ++i) {
+		if(ctx->ProfileCursor >= block_count) {
+			ctx->ProfileCursor = 0;
+		}
+
+		auto &block = getProfiledBlock(ctx->ProfileCursor++);
+		uint64_t count = __atomic_exchange_n(&block.Count, 0, __ATOMIC_RELAXED);
+		if(count == 0) {
+			continue;
+		}
+
+		// Getting the region also marks it as touched, so that it is
+		// considered for translation below
+		auto &region = ctx->TxlnMgr.GetRegion(block.PhysPC.PageBase());
+		region.ProfileBlock(thread, block.VirtPC, block.IsaMode, count);
+	}
+
+	ctx->TxlnMgr.Profile(thread);
+
+	// Install any region translations which have completed since the last
+	// time the profile was checked
+	std::vector<Region*> completed;
+	ctx->TxlnMgr.RegisterCompletedTranslations(completed);
+	for(auto region : completed) {
+		if(region->IsValid() && region->txln != nullptr) {
+			installRegion(ctx, *region);
+		}
+		region->Release();
+	}
+
+	thread->GetStateBlock().SetEntry<int32_t>("ProfileBudget", archsim::options::JitProfilingInterval);
+}
+
+void TieredJITExecutionEngine::installRegion(TieredJITExecutionEngineThreadContext *ctx, Region &region)
+{
+	captive::shared::block_txln_fn fn;
+	region.txln->Install(&fn);
+
+	auto installed = ctx->InstalledRegions.find(&region);
+	if(installed != ctx->InstalledRegions.end()) {
+		if(installed->second == fn) {
+			return;
+		}
+		installed->second = fn;
+	} else {
+		region.Acquire();
+		ctx->InstalledRegions[&region] = fn;
+	}
+	ctx->RegionCode.insert(fn);
+
+	LC_DEBUG1(LogTieredJIT) << "Promoting region " << region.GetPhysicalBaseAddress() << " to LLVM";
+
+	auto thread = ctx->GetThread();
+	for(auto virt_page : region.virtual_images) {
+		// Only install the region at addresses which still map to it
+		Address phys_page (0);
+		if(thread->GetFetchMI().PerformTranslation(virt_page, phys_page, false, true, false) != archsim::TranslationResult::OK || phys_page.PageBase() != region.GetPhysicalBaseAddress()) {
+			continue;
+		}
+
+		ctx->PageCache.InsertEntry(virt_page, fn);
+		for(auto block : region.blocks) {
+			if(block.second->IsRootBlock() && region.txln->ContainsBlock(block.first)) {
+				ctx->GetBlockCache().Insert(virt_page + block.first, fn, archsim::ProcessorFeatureSet());
+			}
+		}
+	}
+
+	// Existing chains into the page would bypass the region code
+	unlinkPage(region.GetPhysicalBaseAddress());
+	thread->GetMetrics().JITPromotedRegions.inc();
+}
+
+bool TieredJITExecutionEngine::canLinkBlock(BasicJITExecutionEngineThreadContext *basic_ctx, captive::shared::block_txln_fn target)
+{
+	auto ctx = (TieredJITExecutionEngineThreadContext*)basic_ctx;
+	return ctx->RegionCode.count(target) == 0;
+}
+
+void TieredJITExecutionEngine::flushDispatchCache(BasicJITExecutionEngineThreadContext *basic_ctx)
+{
+	auto ctx = (TieredJITExecutionEngineThreadContext*)basic_ctx;
+
+	BlockJITExecutionEngine::flushDispatchCache(ctx);
+	ctx->PageCache.Invalidate();
+
+	// Forget regions which have been invalidated, now that nothing in this
+	// thread can reach their code
+	for(auto i = ctx->InstalledRegions.begin(); i != ctx->InstalledRegions.end();) {
+		if(!i->first->IsValid()) {
+			ctx->RegionCode.erase(i->second);
+			i->first->Release();
+			i = ctx->InstalledRegions.erase(i);
+		} else {
+			++i;
+		}
+	}
+}
+
+void TieredJITExecutionEngine::flushDispatchCode(BasicJITExecutionEngineThreadContext *basic_ctx, const std::unordered_set<captive::shared::block_txln_fn> &txlns)
+{
+	auto ctx = (TieredJITExecutionEngineThreadContext*)basic_ctx;
+
+	// Region code isn't allocated by this engine, so it is never freed
+	// through it, but regions which have been invalidated must not be
+	// entered again either
+	std::unordered_set<captive::shared::block_txln_fn> dropped (txlns);
+	for(auto i = ctx->InstalledRegions.begin(); i != ctx->InstalledRegions.end();) {
+		if(!i->first->IsValid()) {
+			dropped.insert(i->second);
+			ctx->RegionCode.erase(i->second);
+			i->first->Release();
+			i = ctx->InstalledRegions.erase(i);
+		} else {
+			++i;
+		}
+	}
+
+	BlockJITExecutionEngine::flushDispatchCode(ctx, dropped);
+	for(auto &entry : ctx->PageCache.Cache) {
+		if(dropped.count(entry.Translation)) {
+			entry.PageBase = Address(1);
+			entry.Translation = nullptr;
+		}
+	}
+}
+
+void TieredJITExecutionEngine::flushDispatchPage(BasicJITExecutionEngineThreadContext *basic_ctx, Address page_base)
+{
+	auto ctx = (TieredJITExecutionEngineThreadContext*)basic_ctx;
+
+	BlockJITExecutionEngine::flushDispatchPage(ctx, page_base);
+	ctx->PageCache.InvalidatePage(page_base);
+}
+
+ExecutionEngine *TieredJITExecutionEngine::Factory(const archsim::module::ModuleInfo *module, const std::string &cpu_prefix)
+{
+	std::string entry_name = cpu_prefix + "BlockJITTranslator";
+	if(!module->HasEntry(entry_name) || !module->HasEntry("LLVMTranslator")) {
+		return nullptr;
+	}
+
+	if(!captive::arch::jit::lowering::HasNativeLowering()) {
+		return nullptr;
+	}
+
+	auto translator_entry = module->GetEntry<archsim::module::ModuleBlockJITTranslatorEntry>(entry_name);
+	auto region_translator_entry = module->GetEntry<archsim::module::ModuleLLVMTranslatorEntry>("LLVMTranslator");
+	return new TieredJITExecutionEngine(translator_entry->Get, region_translator_entry->Get);
+}
+
+// The tiered engine is ranked below every other engine, so that it is only
+// used when it is selected explicitly
+static ExecutionEngineFactoryRegistration registration("TieredJIT", 0, TieredJITExecutionEngine::Factory);
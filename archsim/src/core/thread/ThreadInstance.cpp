@@ -86,6 +86,7 @@ ThreadInstance::ThreadInstance(util::PubSubContext &pubsub, const ArchDescriptor
 	pc_is_64bit_ = GetArch().GetRegisterFileDescriptor().GetTaggedEntry("PC").GetEntrySize() == 8;
 
 	trace_source_ = nullptr;
+	trace_filter_ = nullptr;
 }
 
 void ThreadInstance::ReturnToSafepoint()
@@ -217,6 +218,38 @@ void ThreadInstance::HandleIRQ()
 	}
 }
 
+bool ThreadInstance::hasAssertedIRQ() const
+{
+	for(auto irq : irq_lines_) {
+		if(irq && irq->IsAsserted()) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void ThreadInstance::WaitForInterrupt()
+{
+	// The interrupt is already on its way. While the guest has interrupts
+	// masked, HandleIRQ consumes the message but leaves the line asserted,
+	// and WFI must still wake up for it.
+	if(HasMessage() || hasAssertedIRQ()) {
+		return;
+	}
+
+	if(!GetEmulationModel().SetThreadIdle(this, true)) {
+		return;
+	}
+
+	// Sleep until a message arrives. The message itself is handled once
+	// execution gets back to the dispatch loop.
+	{
+		std::unique_lock<std::mutex> lock(message_lock_);
+		message_arrived_.wait(lock, [this] { return !message_queue_.empty() || hasAssertedIRQ(); });
+	}
+	GetEmulationModel().SetThreadIdle(this, false);
+}
+
 void ThreadInstance::PendIRQ()
 {
 	bool should_pend_interrupts = false;
@@ -56,6 +56,8 @@ void ThreadMetricPrinter::PrintStats(const ArchDescriptor &arch, const ThreadMet
 	str << "Read hits: " << metrics.ReadHits.get_value() << std::endl;
 	str << "Writes: " << metrics.Writes.get_value() << std::endl;
 	str << "Write hits: " << metrics.WriteHits.get_value() << std::endl;
+	str << "MMU TLB hits: " << metrics.MMUTLBHits.get_value() << std::endl;
+	str << "MMU TLB misses: " << metrics.MMUTLBMisses.get_value() << std::endl;
 
 	str << "Self Runtime: " << metrics.SelfRuntime.GetElapsedS() << " seconds" << std::endl;
 	str << "JIT Runtime: " << metrics.JITTime.GetElapsedS() << " seconds" << std::endl;
@@ -74,6 +76,15 @@ void ThreadMetricPrinter::PrintStats(const ArchDescriptor &arch, const ThreadMet
 	str << "Successful chains: " << metrics.JITSuccessfulChains.get_value() << std::endl;
 	str << "Failed chains: " << metrics.JITFailedChains.get_value() << std::endl;
 
+	str << "Evicted code pages: " << metrics.JITEvictedPages.get_value() << std::endl;
+	str << "Evicted translations: " << metrics.JITEvictedTxlns.get_value() << " (" << metrics.JITEvictedBytes.get_value() << " bytes)" << std::endl;
+	str << "Retranslations: " << metrics.JITRetranslations.get_value() << std::endl;
+	str << "Full code cache flushes: " << metrics.JITCodeFlushes.get_value() << std::endl;
+	str << "Single page dispatch flushes: " << metrics.JITPageFlushes.get_value() << std::endl;
+	str << "Restored translations: " << metrics.JITRestoredTxlns.get_value() << std::endl;
+	str << "Translations of modified code: " << metrics.JITModifiedTxlns.get_value() << " (" << metrics.JITPreservedTxlns.get_value() << " kept on the same pages)" << std::endl;
+	str << "Promoted regions: " << metrics.JITPromotedRegions.get_value() << std::endl;
+
 	str << "JIT Exit reasons: " << std::endl;
 	hp.PrintHistogram(metrics.JITExitReasons, str, [](uint32_t i) {
 		return std::to_string(i);
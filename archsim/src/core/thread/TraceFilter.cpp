@@ -0,0 +1,204 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include "core/thread/TraceFilter.h"
+#include "core/thread/ThreadInstance.h"
+#include "abi/EmulationModel.h"
+#include "abi/devices/MMU.h"
+#include "system.h"
+#include "util/LogContext.h"
+#include "util/SimOptions.h"
+#include "util/string_util.h"
+
+#include <cstdlib>
+
+UseLogContext(LogCPU);
+
+using namespace archsim::core::thread;
+
+TraceFilter::TraceFilter(ThreadInstance &thread) : thread_(thread), subscriber_(thread.GetEmulationModel().GetSystem().GetPubSub()), active_feature_(ChooseActiveFeature(thread)), functions_resolved_(true), pc_filtered_(false), asid_(0), may_stop_(false), stopped_(false), active_(true)
+{
+	thread_.GetFeatures().AddNamedFeature("TRACE_ACTIVE", active_feature_);
+	thread_.GetFeatures().SetFeatureLevel(active_feature_, 1);
+
+	subscriber_.Subscribe(PubSubType::PrivilegeLevelChange, PrivilegeLevelChanged, this);
+	subscriber_.Subscribe(PubSubType::ASIDChange, ASIDChanged, this);
+}
+
+uint32_t TraceFilter::ChooseActiveFeature(ThreadInstance &thread)
+{
+	// Only the first 7 features are held in the feature masks, so use a
+	// free one of those if the architecture leaves one
+	for(uint32_t id = 0; id < 7; ++id) {
+		if(!thread.GetFeatures().HasFeature(id)) {
+			return id;
+		}
+	}
+
+	LC_WARNING(LogCPU) << "No free feature for the trace filters: translations will be dropped whenever the filter state changes";
+	return kFallbackActiveFeature;
+}
+
+TraceFilter *TraceFilter::CreateFromOptions(ThreadInstance &thread)
+{
+	bool has_filter = false;
+	TraceFilter *filter = new TraceFilter(thread);
+
+	for(const auto &range : archsim::util::split_string(archsim::options::TracePCRanges.GetValue(), ',')) {
+		if(range.empty()) {
+			continue;
+		}
+
+		auto bounds = archsim::util::split_string(range, '-');
+		if(bounds.size() != 2 || bounds[0].empty() || bounds[1].empty()) {
+			LC_WARNING(LogCPU) << "Ignoring malformed trace PC range " << range;
+			continue;
+		}
+
+		char *start_end, *end_end;
+		uint64_t start = strtoull(bounds[0].c_str(), &start_end, 16);
+		uint64_t end = strtoull(bounds[1].c_str(), &end_end, 16);
+		if(*start_end != 0 || *end_end != 0 || start >= end) {
+			LC_WARNING(LogCPU) << "Ignoring malformed trace PC range " << range;
+			continue;
+		}
+		filter->AddPCRange(start, end);
+		has_filter = true;
+	}
+
+	for(const auto &function : archsim::util::split_string(archsim::options::TraceFunctions.GetValue(), ',')) {
+		if(function.empty()) {
+			continue;
+		}
+		filter->AddFunction(function);
+		has_filter = true;
+	}
+
+	for(const auto &ring : archsim::util::split_string(archsim::options::TraceRings.GetValue(), ',')) {
+		if(ring.empty()) {
+			continue;
+		}
+		filter->AddRing(strtoul(ring.c_str(), nullptr, 0));
+		has_filter = true;
+	}
+
+	for(const auto &asid : archsim::util::split_string(archsim::options::TraceASIDs.GetValue(), ',')) {
+		if(asid.empty()) {
+			continue;
+		}
+		filter->AddASID(strtoul(asid.c_str(), nullptr, 0));
+		has_filter = true;
+	}
+
+	if(archsim::options::TraceStop > archsim::options::TraceSkip) {
+		filter->SetMayStop(true);
+		has_filter = true;
+	}
+
+	if(!has_filter) {
+		delete filter;
+		return nullptr;
+	}
+
+	filter->Update();
+	return filter;
+}
+
+void TraceFilter::AddPCRange(Address::underlying_t start, Address::underlying_t end)
+{
+	ranges_.push_back({start, end});
+	pc_filtered_ = true;
+}
+
+void TraceFilter::AddFunction(const std::string &name)
+{
+	functions_.push_back(name);
+	functions_resolved_ = false;
+	pc_filtered_ = true;
+}
+
+void TraceFilter::AddRing(uint32_t ring)
+{
+	rings_.insert(ring);
+}
+
+void TraceFilter::AddASID(uint32_t asid)
+{
+	asids_.insert(asid);
+}
+
+void TraceFilter::Stop()
+{
+	stopped_ = true;
+	Update();
+}
+
+void TraceFilter::Update()
+{
+	bool active = !stopped_;
+	if(!rings_.empty() && !rings_.count(thread_.GetExecutionRing())) {
+		active = false;
+	}
+	if(!asids_.empty() && !asids_.count(asid_)) {
+		active = false;
+	}
+
+	active_ = active;
+	thread_.GetFeatures().SetFeatureLevel(active_feature_, active_);
+}
+
+bool TraceFilter::ShouldTracePC(Address pc)
+{
+	if(!functions_resolved_) {
+		ResolveFunctions();
+	}
+
+	if(!pc_filtered_) {
+		return true;
+	}
+
+	for(const auto &range : ranges_) {
+		if(pc.Get() >= range.first && pc.Get() < range.second) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void TraceFilter::ResolveFunctions()
+{
+	functions_resolved_ = true;
+
+	for(const auto &name : functions_) {
+		Address value;
+		const archsim::abi::BinarySymbol *symbol;
+		if(!thread_.GetEmulationModel().ResolveSymbol(name, value) || !thread_.GetEmulationModel().LookupSymbol(value, true, symbol)) {
+			LC_WARNING(LogCPU) << "Could not find symbol " << name << " to trace";
+			continue;
+		}
+		if(symbol->Size == 0) {
+			LC_WARNING(LogCPU) << "Symbol " << name << " has no size, so it cannot be traced";
+			continue;
+		}
+
+		AddPCRange(value.Get(), value.Get() + symbol->Size);
+	}
+	functions_.clear();
+}
+
+void TraceFilter::PrivilegeLevelChanged(PubSubType::PubSubType type, void *ctx, const void *data)
+{
+	TraceFilter *filter = (TraceFilter*)ctx;
+	if(data == &filter->thread_) {
+		filter->Update();
+	}
+}
+
+void TraceFilter::ASIDChanged(PubSubType::PubSubType type, void *ctx, const void *data)
+{
+	TraceFilter *filter = (TraceFilter*)ctx;
+	auto mmu = (archsim::abi::devices::MMU*)filter->thread_.GetPeripherals().GetDeviceByName("mmu");
+	if(mmu != nullptr && data == mmu) {
+		filter->asid_ = mmu->GetASID();
+		filter->Update();
+	}
+}
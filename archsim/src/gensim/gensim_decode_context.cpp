@@ -28,10 +28,15 @@ void DecodeContext::WriteBackState(archsim::core::thread::ThreadInstance* thread
 
 }
 
-void FlushCallback(PubSubType::PubSubType, void *ctx, const void *data)
+void FlushCallback(PubSubType::PubSubType type, void *ctx, const void *data)
 {
 	CachedDecodeContext *d = (CachedDecodeContext*)ctx;
-	d->Flush();
+
+	if(type == PubSubType::ITlbEntryFlush) {
+		d->InvalidatePage(archsim::Address((uint64_t)data));
+	} else {
+		d->Flush();
+	}
 }
 
 void purge_decode(gensim::BaseDecode*& d)
@@ -46,6 +51,7 @@ CachedDecodeContext::CachedDecodeContext(archsim::util::PubSubContext& pubsub, D
 {
 	pubsub_.Subscribe(PubSubType::FlushTranslations, FlushCallback, this);
 	pubsub_.Subscribe(PubSubType::FlushAllTranslations, FlushCallback, this);
+	pubsub_.Subscribe(PubSubType::ITlbEntryFlush, FlushCallback, this);
 }
 
 uint32_t CachedDecodeContext::DecodeSync(archsim::MemoryInterface& mem_interface, archsim::Address address, uint32_t mode, BaseDecode*& target)
@@ -95,6 +101,13 @@ void CachedDecodeContext::Flush()
 	decode_cache_.purge();
 }
 
+void CachedDecodeContext::InvalidatePage(archsim::Address page_base)
+{
+	std::lock_guard<std::mutex> lock(lock_);
+
+	decode_cache_.invalidate_range(page_base.PageBase(), archsim::Address::PageSize);
+}
+
 
 DefineComponentType(gensim::DecodeContext);
 DefineComponentType(gensim::DecodeTranslateContext);
@@ -0,0 +1,147 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * PredecodedBlockCache.cpp
+ */
+
+#include "interpret/PredecodedBlockCache.h"
+#include "gensim/gensim_decode.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace archsim::interpret;
+
+static void predecode_invalidate_callback(PubSubType::PubSubType type, void *context, const void *data)
+{
+	PredecodedBlockCache *cache = (PredecodedBlockCache*)context;
+
+	switch(type) {
+		case PubSubType::RegionInvalidatePhysical:
+			cache->InvalidatePage(archsim::Address((uint64_t)data));
+			break;
+		default:
+			cache->Flush();
+			break;
+	}
+}
+
+PredecodedBlock::~PredecodedBlock()
+{
+	for(auto &insn : Instructions) {
+		if(insn.Decode != nullptr) {
+			insn.Decode->Release();
+		}
+	}
+}
+
+PredecodedBlockCache::PredecodedBlockCache(util::PubSubContext &pubsub) : invalidated_(false), pending_flush_(false), subscriber_(pubsub)
+{
+	memset(front_cache_, 0, sizeof(front_cache_));
+
+	subscriber_.Subscribe(PubSubType::FlushTranslations, predecode_invalidate_callback, this);
+	subscriber_.Subscribe(PubSubType::FlushAllTranslations, predecode_invalidate_callback, this);
+	subscriber_.Subscribe(PubSubType::L1ICacheFlush, predecode_invalidate_callback, this);
+	subscriber_.Subscribe(PubSubType::RegionInvalidatePhysical, predecode_invalidate_callback, this);
+}
+
+PredecodedBlockCache::~PredecodedBlockCache()
+{
+	clear();
+}
+
+PredecodedBlock *PredecodedBlockCache::lookupSlow(Address phys_pc, uint32_t isa_mode)
+{
+	auto block = blocks_.find(phys_pc.Get());
+	if(block == blocks_.end() || block->second->IsaMode != isa_mode) {
+		return nullptr;
+	}
+
+	front_cache_[(phys_pc.Get() >> 1) % kFrontCacheSize] = block->second;
+	return block->second;
+}
+
+PredecodedBlock *PredecodedBlockCache::Insert(Address phys_pc, uint32_t isa_mode)
+{
+	auto existing = blocks_.find(phys_pc.Get());
+	if(existing != blocks_.end()) {
+		erase(existing->second);
+	}
+
+	auto block = new PredecodedBlock(phys_pc, isa_mode);
+	blocks_[phys_pc.Get()] = block;
+	page_blocks_[phys_pc.PageBase().Get()].push_back(block);
+	front_cache_[(phys_pc.Get() >> 1) % kFrontCacheSize] = block;
+
+	return block;
+}
+
+void PredecodedBlockCache::Flush()
+{
+	std::lock_guard<std::mutex> lg(pending_lock_);
+	pending_flush_ = true;
+	invalidated_ = true;
+}
+
+void PredecodedBlockCache::InvalidatePage(Address phys_page)
+{
+	std::lock_guard<std::mutex> lg(pending_lock_);
+	pending_pages_.push_back(phys_page.PageBase());
+	invalidated_ = true;
+}
+
+void PredecodedBlockCache::collect()
+{
+	std::lock_guard<std::mutex> lg(pending_lock_);
+
+	if(pending_flush_) {
+		clear();
+	} else {
+		for(auto page : pending_pages_) {
+			auto blocks = page_blocks_.find(page.Get());
+			if(blocks == page_blocks_.end()) {
+				continue;
+			}
+
+			// Take the list, since erasing a block removes it from the list
+			auto page_blocks = std::move(blocks->second);
+			page_blocks_.erase(blocks);
+			for(auto block : page_blocks) {
+				erase(block);
+			}
+		}
+	}
+
+	pending_flush_ = false;
+	pending_pages_.clear();
+	invalidated_ = false;
+}
+
+void PredecodedBlockCache::erase(PredecodedBlock *block)
+{
+	auto &front_entry = front_cache_[(block->PhysPC.Get() >> 1) % kFrontCacheSize];
+	if(front_entry == block) {
+		front_entry = nullptr;
+	}
+
+	blocks_.erase(block->PhysPC.Get());
+
+	auto page = page_blocks_.find(block->PhysPC.PageBase().Get());
+	if(page != page_blocks_.end()) {
+		auto &page_blocks = page->second;
+		page_blocks.erase(std::remove(page_blocks.begin(), page_blocks.end(), block), page_blocks.end());
+	}
+
+	delete block;
+}
+
+void PredecodedBlockCache::clear()
+{
+	for(auto block : blocks_) {
+		delete block.second;
+	}
+
+	blocks_.clear();
+	page_blocks_.clear();
+	memset(front_cache_, 0, sizeof(front_cache_));
+}
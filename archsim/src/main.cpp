@@ -25,6 +25,7 @@
 
 #include "abi/devices/generic/block/FileBackedBlockDevice.h"
 #include "abi/devices/generic/block/MemoryCOWBlockDevice.h"
+#include "abi/devices/generic/block/OverlayBlockDevice.h"
 
 #include "abi/devices/generic/timing/TickSource.h"
 
@@ -57,7 +58,7 @@ static int run_simple_simulation(archsim::Session& session)
 	System *simsys = new System(session);
 
 	if(archsim::options::InstructionTick) {
-		simsys->SetTickSource(new archsim::abi::devices::timing::SubscriberTickSource(simsys->GetPubSub(), PubSubType::InstructionExecute, 1));
+		simsys->SetTickSource(new archsim::abi::devices::timing::InstructionTickSource(simsys->GetPubSub()));
 	} else {
 		simsys->SetTickSource(new archsim::abi::devices::timing::MicrosecondTickSource(1000));
 	}
@@ -65,10 +66,20 @@ static int run_simple_simulation(archsim::Session& session)
 	archsim::abi::devices::generic::block::BlockDevice *block_dev = nullptr;
 
 	archsim::abi::devices::generic::block::FileBackedBlockDevice master_fbbd;
+	archsim::abi::devices::generic::block::OverlayBlockDevice overlay;
 	if(archsim::options::BlockDeviceFile.IsSpecified()) {
-		master_fbbd.Open(archsim::options::BlockDeviceFile.GetValue());
-
-		if(archsim::options::CopyOnWrite) {
+		// With an overlay, the block device file is only written to if the
+		// overlay is to be committed into it
+		bool use_overlay = archsim::options::BlockDeviceOverlay.IsSpecified();
+		master_fbbd.Open(archsim::options::BlockDeviceFile.GetValue(), use_overlay && !archsim::options::CommitOverlay);
+
+		if(use_overlay) {
+			if(!overlay.Open(master_fbbd, archsim::options::BlockDeviceOverlay.GetValue())) {
+				LC_ERROR(LogInfrastructure) << "Unable to open block device overlay";
+				return -1;
+			}
+			block_dev = &overlay;
+		} else if(archsim::options::CopyOnWrite) {
 			archsim::abi::devices::generic::block::MemoryCOWBlockDevice *mem_cow = new archsim::abi::devices::generic::block::MemoryCOWBlockDevice();
 			mem_cow->Open(master_fbbd);
 			block_dev = mem_cow;
@@ -103,6 +114,15 @@ static int run_simple_simulation(archsim::Session& session)
 
 	delete simsys;
 
+	if(overlay.IsOpen()) {
+		if(archsim::options::CommitOverlay && !overlay.Commit()) {
+			LC_ERROR(LogInfrastructure) << "Unable to commit block device overlay";
+			rc = -1;
+		}
+
+		overlay.Close();
+	}
+
 	return rc;
 }
 
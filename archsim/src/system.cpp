@@ -23,6 +23,7 @@
 
 #include <iostream>
 #include <libtrace/TraceSink.h>
+#include <libtrace/CompressedTraceSink.h>
 
 DeclareLogContext(LogSystem, "System");
 DeclareLogContext(LogInfrastructure, "Infrastructure");
@@ -64,6 +65,13 @@ bool System::Initialise()
 
 			sink = new libtrace::BinaryFileTraceSink(archsim::options::TraceFile.GetValue());
 
+		} else if(archsim::options::TraceMode == "compressed") {
+			if(!archsim::options::TraceFile.IsSpecified()) {
+				UNIMPLEMENTED;
+			}
+
+			sink = new libtrace::CompressedFileTraceSink(archsim::options::TraceFile.GetValue());
+
 		} else {
 			UNIMPLEMENTED;
 		}
@@ -76,6 +84,7 @@ bool System::Initialise()
 
 		LC_ERROR(LogSystem) << "Unable to create emulation model '" << archsim::options::EmulationModel.GetValue() << "'";
 		LC_ERROR(LogSystem) << GetRegisteredComponents(emulation_model);
+		emulation_model = nullptr;
 		return false;
 	}
 
@@ -83,6 +92,7 @@ bool System::Initialise()
 
 	if (!uarch->Initialise()) {
 		delete uarch;
+		uarch = nullptr;
 
 		LC_ERROR(LogSystem) << "Unable to initialise uArch model";
 		return false;
@@ -92,6 +102,7 @@ bool System::Initialise()
 		if(uarch != nullptr) {
 			uarch->Destroy();
 			delete uarch;
+			uarch = nullptr;
 		}
 
 		LC_ERROR(LogSystem) << "Unable to initialise emulation model '" << archsim::options::EmulationModel.GetValue() << "'";
@@ -112,11 +123,25 @@ void System::Destroy()
 		GetECM().GetTraceSink()->Flush();
 	}
 
-	emulation_model->Destroy();
-	delete emulation_model;
+	if(emulation_model) {
+		emulation_model->Destroy();
+		delete emulation_model;
+		emulation_model = nullptr;
+	}
+
+	if(uarch) {
+		uarch->Destroy();
+		delete uarch;
+		uarch = nullptr;
+	}
 
-	uarch->Destroy();
-	delete uarch;
+	// Deleting the sink closes its files, which writes the index and
+	// footer of compressed traces. Nothing can trace into it once the
+	// threads have been detached.
+	if(GetECM().GetTraceSink()) {
+		delete GetECM().GetTraceSink();
+		GetECM().SetTraceSink(nullptr);
+	}
 }
 
 void System::PrintStatistics(std::ostream& stream)
@@ -134,6 +159,10 @@ void System::PrintStatistics(std::ostream& stream)
 		}
 	}
 
+	if(GetECM().GetTraceSink()) {
+		GetECM().GetTraceSink()->PrintStatistics(stream);
+	}
+
 	stream << "Simulation Statistics" << std::endl;
 
 	// Print Emulation Model statistics
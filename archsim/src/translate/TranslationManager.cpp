@@ -58,6 +58,8 @@ void RegionTable::Clear()
 static void InvalidateCallback(PubSubType::PubSubType type, void *ctx, const void *data)
 {
 	TranslationManager *txln_mgr = (TranslationManager*)ctx;
+	std::lock_guard<std::mutex> lg(txln_mgr->GetLock());
+
 	switch(type) {
 		case PubSubType::ITlbEntryFlush:
 			txln_mgr->InvalidateRegionTxlnCacheEntry(Address((uint64_t)data));
@@ -159,9 +161,12 @@ bool TranslationManager::TryGetRegion(Address phys_addr, profile::Region*& regio
 
 void TranslationManager::TraceBlock(archsim::core::thread::ThreadInstance *thread, Block& block)
 {
-	uint32_t mode = (uint32_t)thread->GetExecutionRing();
+	TraceBlock(thread->GetExecutionRing(), block);
+}
 
-	LC_DEBUG4(LogProfile) << "Tracing block " << std::hex << block.GetOffset() << ", isa = " << (uint32_t)thread->GetModeID() << ", mode = " << mode;
+void TranslationManager::TraceBlock(uint32_t mode, Block& block)
+{
+	LC_DEBUG4(LogProfile) << "Tracing block " << std::hex << block.GetOffset() << ", isa = " << (uint32_t)block.GetISAMode() << ", mode = " << mode;
 	auto &prev_block = this->prev_block[mode];
 
 	if (prev_block && prev_block->GetParent().GetPhysicalBaseAddress() == block.GetParent().GetPhysicalBaseAddress()) {
@@ -305,15 +310,31 @@ bool TranslationManager::MarkTranslationAsComplete(Region &unit, Translation &tx
 }
 
 void TranslationManager::RegisterCompletedTranslations()
+{
+	std::vector<Region*> registered;
+	RegisterCompletedTranslations(registered);
+
+	for(auto region : registered) {
+		region->Release();
+	}
+}
+
+void TranslationManager::RegisterCompletedTranslations(std::vector<Region*> &registered)
 {
 	if(completed_translations.empty()) return;
-	bool registered = false;
 
 	completed_translations_lock.lock();
 	for(auto &txln : completed_translations) {
-		registered |= RegisterTranslation(*txln.first, *txln.second);
+		bool success = RegisterTranslation(*txln.first, *txln.second);
 		InvalidateRegionTxlnCacheEntry(txln.first->GetPhysicalBaseAddress());
-		txln.first->Release();
+
+		// Hand the reference taken when the translation completed over to
+		// the caller
+		if(success) {
+			registered.push_back(txln.first);
+		} else {
+			txln.first->Release();
+		}
 	}
 	completed_translations.clear();
 	completed_translations_lock.unlock();
@@ -35,6 +35,9 @@ BlockJITValues::BlockJITValues(::llvm::Module* module)
 	cpuSetFeaturePtr = (llvm::Function*)module->getOrInsertFunction("cpuSetFeature", voidTy, i8PtrTy, i32Ty, i32Ty);
 	cpuSetFeaturePtr->setLinkage(llvm::Function::ExternalLinkage);
 
+	cpuTraceReservePtr = (llvm::Function*)module->getOrInsertFunction("cpuTraceReserve", i32Ty, i8PtrTy, i32Ty, i32Ty);
+	cpuTraceReservePtr->setLinkage(llvm::Function::ExternalLinkage);
+
 	cpuSetRoundingModePtr = (llvm::Function*)module->getOrInsertFunction("cpuSetRoundingMode", voidTy, i8PtrTy, i32Ty);
 	cpuSetRoundingModePtr->setLinkage(llvm::Function::ExternalLinkage);
 
@@ -92,6 +95,7 @@ bool BlockJITLoweringContext::Prepare(const TranslationContext& ctx)
 	AddLowerer(IRInstruction::CMPSLT, new BlockJITCMPLowering(IRInstruction::CMPSLT));
 	AddLowerer(IRInstruction::CMPSLTE, new BlockJITCMPLowering(IRInstruction::CMPSLTE));
 	AddLowerer(IRInstruction::COUNT, new BlockJITCOUNTLowering());
+	AddLowerer(IRInstruction::TRACE, new BlockJITTRACELowering());
 	AddLowerer(IRInstruction::INCPC, new BlockJITINCPCLowering());
 	AddLowerer(IRInstruction::IMUL, new BlockJITUMULLLowering());
 	AddLowerer(IRInstruction::JMP, new BlockJITJMPLowering());
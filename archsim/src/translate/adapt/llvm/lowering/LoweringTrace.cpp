@@ -0,0 +1,82 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include "translate/adapt/BlockJITAdaptorLowering.h"
+#include "translate/adapt/BlockJITAdaptorLoweringContext.h"
+
+#include "libtrace/RecordTypes.h"
+
+#include <llvm/IR/BasicBlock.h>
+
+using namespace archsim::translate::adapt;
+
+bool BlockJITTRACELowering::Lower(const captive::shared::IRInstruction*& insn)
+{
+	const auto &header = insn->operands[0];
+	const auto &index = insn->operands[1];
+	const auto &value = insn->operands[2];
+
+	assert(header.is_constant());
+
+	auto &ctx = GetContext().GetLLVMContext();
+	auto i32Ty = llvm::Type::getInt32Ty(ctx);
+	auto i32PtrTy = i32Ty->getPointerTo(0);
+
+	uint32_t count = value.size == 8 ? 2 : 1;
+	uint32_t type = header.value >> 24;
+	uint32_t header_word = header.value | ((count - 1) << 16);
+
+	// Each record is two 32 bit words
+	auto pos_ptr = GetContext().GetStateBlockEntryPtr("TraceBufferPos", i32PtrTy);
+	auto limit_ptr = GetContext().GetStateBlockEntryPtr("TraceBufferLimit", i32PtrTy);
+
+	auto pos = GetBuilder().CreateLoad(pos_ptr);
+	auto end = GetBuilder().CreateGEP(pos, llvm::ConstantInt::get(i32Ty, count * 2));
+	auto fits = GetBuilder().CreateICmpULE(end, GetBuilder().CreateLoad(limit_ptr));
+
+	auto reserve_block = llvm::BasicBlock::Create(ctx, "", GetBuilder().GetInsertBlock()->getParent());
+	auto write_block = llvm::BasicBlock::Create(ctx, "", GetBuilder().GetInsertBlock()->getParent());
+	auto final_block = llvm::BasicBlock::Create(ctx, "", GetBuilder().GetInsertBlock()->getParent());
+	GetBuilder().CreateCondBr(fits, write_block, reserve_block);
+
+	// Ask the trace source to make room for the records, or to drop them
+	{
+		GetBuilder().SetInsertPoint(reserve_block);
+		auto reserved = GetBuilder().CreateCall(GetContext().GetValues().cpuTraceReservePtr, {GetThreadPtr(), llvm::ConstantInt::get(i32Ty, type), llvm::ConstantInt::get(i32Ty, count)});
+		auto keep = GetBuilder().CreateICmpNE(reserved, llvm::ConstantInt::get(i32Ty, 0));
+		GetBuilder().CreateCondBr(keep, write_block, final_block);
+	}
+
+	{
+		GetBuilder().SetInsertPoint(write_block);
+
+		// The buffer may have been flushed, so reload the position
+		pos = GetBuilder().CreateLoad(pos_ptr);
+
+		llvm::Value *header_value = llvm::ConstantInt::get(i32Ty, header_word);
+		if(index.is_constant()) {
+			header_value = llvm::ConstantInt::get(i32Ty, header_word | (index.value & 0xff));
+		} else {
+			auto index_value = GetBuilder().CreateZExtOrTrunc(GetValueFor(index), i32Ty);
+			header_value = GetBuilder().CreateOr(header_value, GetBuilder().CreateAnd(index_value, 0xff));
+		}
+
+		auto data = GetValueFor(value);
+		GetBuilder().CreateStore(header_value, pos);
+		GetBuilder().CreateStore(GetBuilder().CreateZExtOrTrunc(data, i32Ty), GetBuilder().CreateGEP(pos, llvm::ConstantInt::get(i32Ty, 1)));
+
+		if(count == 2) {
+			auto high = GetBuilder().CreateTrunc(GetBuilder().CreateLShr(data, 32), i32Ty);
+			GetBuilder().CreateStore(llvm::ConstantInt::get(i32Ty, ((uint32_t)libtrace::DataExtension << 24) | type), GetBuilder().CreateGEP(pos, llvm::ConstantInt::get(i32Ty, 2)));
+			GetBuilder().CreateStore(high, GetBuilder().CreateGEP(pos, llvm::ConstantInt::get(i32Ty, 3)));
+		}
+
+		GetBuilder().CreateStore(GetBuilder().CreateGEP(pos, llvm::ConstantInt::get(i32Ty, count * 2)), pos_ptr);
+		GetBuilder().CreateBr(final_block);
+	}
+
+	GetBuilder().SetInsertPoint(final_block);
+
+	insn++;
+
+	return true;
+}
@@ -4,6 +4,7 @@
 #include "define.h"
 
 #include "abi/devices/MMU.h"
+#include "abi/devices/generic/timing/TickSource.h"
 #include "abi/memory/MemoryModel.h"
 
 #include "core/MemoryInterface.h"
@@ -117,10 +118,9 @@ extern "C" {
 //		cpu->flush_dtlb();
 	}
 
-	void tmFlushITlbEntry(gensim::Processor *cpu, uint64_t addr)
+	void tmFlushITlbEntry(archsim::core::thread::ThreadInstance *cpu, uint64_t addr)
 	{
-		UNIMPLEMENTED;
-//		cpu->flush_itlb_entry(addr);
+		cpu->fn_flush_itlb_entry(addr);
 	}
 
 	void tmFlushDTlbEntry(gensim::Processor *cpu, uint64_t addr)
@@ -288,7 +288,7 @@ extern "C" {
 		if(rval != archsim::MemoryResult::OK) {
 			cpu->TakeMemoryException(interface, archsim::Address(address));
 		} else {
-			// OK!
+			interface.NotifyWrite(cpu, archsim::Address(address));
 		}
 		return 0;
 	}
@@ -301,7 +301,7 @@ extern "C" {
 		if(rval != archsim::MemoryResult::OK) {
 			cpu->TakeMemoryException(interface, archsim::Address(address));
 		} else {
-			// OK!
+			interface.NotifyWrite(cpu, archsim::Address(address));
 		}
 		return 0;
 	}
@@ -314,7 +314,7 @@ extern "C" {
 		if(rval != archsim::MemoryResult::OK) {
 			cpu->TakeMemoryException(interface, archsim::Address(address));
 		} else {
-			// OK!
+			interface.NotifyWrite(cpu, archsim::Address(address));
 		}
 		return 0;
 	}
@@ -326,7 +326,7 @@ extern "C" {
 		if(rval != archsim::MemoryResult::OK) {
 			cpu->TakeMemoryException(interface, archsim::Address(address));
 		} else {
-			// OK!
+			interface.NotifyWrite(cpu, archsim::Address(address));
 		}
 		return 0;
 	}
@@ -401,9 +401,17 @@ extern "C" {
 //		cpu->enter_user_mode();
 	}
 
-	void cpuInstructionTick(archsim::core::thread::ThreadInstance *cpu)
+	void cpuInstructionTick(archsim::core::thread::ThreadInstance *cpu, uint32_t count)
+	{
+		// The translators only emit instruction ticks after checking that
+		// the system is driven by an instruction tick source
+		auto tick_source = cpu->GetEmulationModel().GetSystem().GetTickSource();
+		static_cast<archsim::abi::devices::timing::InstructionTickSource*>(tick_source)->AddInstructions(count);
+	}
+
+	void cpuWaitForInterrupt(archsim::core::thread::ThreadInstance *cpu)
 	{
-		cpu->GetEmulationModel().GetSystem().GetPubSub().Publish(PubSubType::InstructionExecute, NULL);
+		cpu->WaitForInterrupt();
 	}
 
 	/*
@@ -425,6 +433,11 @@ extern "C" {
 		cpu->GetTraceSource()->Trace_End_Insn();
 	}
 
+	uint32_t cpuTraceReserve(archsim::core::thread::ThreadInstance *cpu, uint32_t type, uint32_t count)
+	{
+		return cpu->GetTraceSource()->ReserveRecords((libtrace::TraceRecordType)type, count);
+	}
+
 	void cpuTraceRegWrite(archsim::core::thread::ThreadInstance *cpu, uint8_t reg, uint64_t value)
 	{
 		auto &descriptor = cpu->GetArch().GetRegisterFileDescriptor().GetByID(reg);
@@ -2,6 +2,9 @@
 
 #include "translate/llvm/LLVMBlockTranslator.h"
 #include "translate/llvm/LLVMTranslationContext.h"
+#include "abi/devices/generic/timing/TickSource.h"
+#include "abi/EmulationModel.h"
+#include "system.h"
 
 #include <llvm/IR/BasicBlock.h>
 
@@ -76,15 +79,18 @@ llvm::BasicBlock *LLVMBlockTranslator::TranslateBlock(Address block_base, Transl
 		txlt_->EmitIncrementCounter(builder, ctx_, ctx_.GetThread()->GetMetrics().JITInstructionCount, block.GetInstructions().size());
 	}
 
+	// cpuInstructionTick relies on the tick source type being checked here
+	auto tick_source = ctx_.GetThread()->GetEmulationModel().GetSystem().GetTickSource();
+	if(archsim::options::InstructionTick && dynamic_cast<archsim::abi::devices::timing::InstructionTickSource*>(tick_source) != nullptr) {
+		// advance the clock once for the whole block
+		builder.CreateCall(ctx_.Functions.InstructionTick, {ctx_.GetThreadPtr(builder), llvm::ConstantInt::get(ctx_.Types.i32, block.GetInstructions().size())});
+	}
+
 	auto ji = ctx_.GetThread()->GetArch().GetISA(0).GetNewJumpInfo();
 
 	for(auto insn : block.GetInstructions()) {
 		auto insn_pc = block_base + insn->GetOffset();
 
-		if(archsim::options::InstructionTick) {
-			builder.CreateCall(ctx_.Functions.InstructionTick, {ctx_.GetThreadPtr(builder)});
-		}
-
 		if(insn->GetDecode().GetIsPredicated()) {
 			TranslateInstructionPredicated(builder, ctx_, txlt_, ctx_.GetThread(), &insn->GetDecode(), insn_pc, target_fn_);
 		} else {
@@ -154,6 +154,7 @@ void LLVMCompiler::initJitSymbols()
 	jit_symbols_["__divti3"] = (void*)divi128;
 
 	jit_symbols_["cpuInstructionTick"] = (void*)cpuInstructionTick;
+	jit_symbols_["cpuWaitForInterrupt"] = (void*)cpuWaitForInterrupt;
 
 	// todo: change these to actual bitcode
 	jit_symbols_["txln_shunt___builtin_f32_is_snan"] = (void*)shunt_builtin_f32_is_snan;
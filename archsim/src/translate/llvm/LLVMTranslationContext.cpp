@@ -326,7 +326,8 @@ LLVMTranslationContext::LLVMTranslationContext(llvm::LLVMContext &ctx, llvm::Fun
 	Functions.cpuPendIRQ = (llvm::Function*)Module->getOrInsertFunction("cpuPendInterrupt", Types.vtype, Types.i8Ptr);
 	Functions.cpuPushInterrupt = (llvm::Function*)Module->getOrInsertFunction("cpuPushInterrupt", Types.vtype, Types.i8Ptr, Types.i32);
 
-	Functions.InstructionTick = (llvm::Function*)Module->getOrInsertFunction("cpuInstructionTick", Types.vtype, Types.i8Ptr);
+	Functions.InstructionTick = (llvm::Function*)Module->getOrInsertFunction("cpuInstructionTick", Types.vtype, Types.i8Ptr, Types.i32);
+	Functions.cpuWaitForInterrupt = (llvm::Function*)Module->getOrInsertFunction("cpuWaitForInterrupt", Types.vtype, Types.i8Ptr);
 
 	guest_reg_emitter_ = std::unique_ptr<LLVMGuestRegisterAccessEmitter>(new GEPLLVMGuestRegisterAccessEmitter(*this));
 	memory_access_emitter_ = std::unique_ptr<LLVMMemoryAccessEmitter>(new BaseLLVMMemoryAccessEmitter(*this));
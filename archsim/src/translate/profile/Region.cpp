@@ -94,6 +94,11 @@ bool Region::HasTranslations() const
 }
 
 void Region::TraceBlock(archsim::core::thread::ThreadInstance *thread, Address virt_addr)
+{
+	TraceBlock(virt_addr, thread->GetModeID(), thread->GetExecutionRing());
+}
+
+void Region::TraceBlock(Address virt_addr, uint8_t isa_mode, uint32_t ring)
 {
 	total_interp_count_++;
 
@@ -102,13 +107,32 @@ void Region::TraceBlock(archsim::core::thread::ThreadInstance *thread, Address v
 
 	virtual_images.insert(virt_addr.PageBase());
 
-	auto &block = GetBlock(virt_addr, thread->GetModeID());
+	auto &block = GetBlock(virt_addr, isa_mode);
 	block.IncrementInterpCount();
 	if(block.GetInterpCount() > max_block_interp_count_) {
 		max_block_interp_count_ = block.GetInterpCount();
 	}
 
-	mgr.TraceBlock(thread, block);
+	mgr.TraceBlock(ring, block);
+}
+
+void Region::ProfileBlock(archsim::core::thread::ThreadInstance *thread, Address virt_addr, uint8_t isa_mode, uint64_t count)
+{
+	total_interp_count_ += count;
+
+	if (GetStatus() == InTranslation)
+		return;
+
+	virtual_images.insert(virt_addr.PageBase());
+
+	// Without a trace of the blocks' successors, any of them may be entered
+	// from outside the region
+	auto &block = GetBlock(virt_addr, isa_mode);
+	block.SetRoot();
+	block.AddInterpCount(count);
+	if(block.GetInterpCount() > max_block_interp_count_) {
+		max_block_interp_count_ = block.GetInterpCount();
+	}
 }
 
 void Region::Invalidate()
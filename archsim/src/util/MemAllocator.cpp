@@ -10,7 +10,9 @@
 #include "util/MemAllocator.h"
 #include <errno.h>
 #include <malloc.h>
+#include <stdexcept>
 #include <string>
+#include <algorithm>
 
 using namespace wulib;
 
@@ -183,3 +185,117 @@ float SimpleZoneMemAllocator::Efficiency() const
 	}
 	return (float)total_consumed / total_space;
 }
+
+EpochMemAllocator::EpochMemAllocator(MemAllocator &underlying) : _underlying(underlying), _epoch(1), _has_retired(false), _freed_in_epoch(false), _retired_count(0), _reclaimed_count(0)
+{
+
+}
+
+EpochMemAllocator::~EpochMemAllocator()
+{
+	// Nobody can be executing out of this allocator any more
+	for(auto &i : _retired) {
+		_underlying.Free(i.buffer);
+	}
+}
+
+void *EpochMemAllocator::Allocate(size_t size_bytes)
+{
+	std::lock_guard<std::mutex> lg(_lock);
+	return _underlying.Allocate(size_bytes);
+}
+
+void *EpochMemAllocator::Reallocate(void *buffer, size_t new_size_bytes)
+{
+	// Buffers are only reallocated while they are still private to the
+	// thread which allocated them, so the old buffer can be reused directly.
+	std::lock_guard<std::mutex> lg(_lock);
+	return _underlying.Reallocate(buffer, new_size_bytes);
+}
+
+void EpochMemAllocator::Free(void *buffer)
+{
+	std::lock_guard<std::mutex> lg(_lock);
+
+	// Retire the buffer in the current epoch. It can't be reclaimed until
+	// the epoch has been advanced, and every reader has then observed the
+	// new epoch at a quiescent point.
+	_retired.push_back({buffer, GetEpoch()});
+	_retired_buffers.insert(buffer);
+	_retired_count++;
+	_has_retired = true;
+	_freed_in_epoch = true;
+}
+
+bool EpochMemAllocator::RetireFreed()
+{
+	std::lock_guard<std::mutex> lg(_lock);
+	if(!_freed_in_epoch) {
+		return false;
+	}
+
+	_freed_in_epoch = false;
+	AdvanceEpoch();
+	return true;
+}
+
+bool EpochMemAllocator::IsRetired(void *buffer)
+{
+	std::lock_guard<std::mutex> lg(_lock);
+	return _retired_buffers.count(buffer) != 0;
+}
+
+void EpochMemAllocator::GetRetiredSince(uint64_t epoch, std::vector<void*> &buffers)
+{
+	std::lock_guard<std::mutex> lg(_lock);
+	for(const auto &i : _retired) {
+		if(i.epoch >= epoch) {
+			buffers.push_back(i.buffer);
+		}
+	}
+}
+
+void EpochMemAllocator::RegisterReader(reader_slot_t &slot)
+{
+	std::lock_guard<std::mutex> lg(_lock);
+	slot = GetEpoch();
+	_readers.push_back(&slot);
+}
+
+void EpochMemAllocator::UnregisterReader(reader_slot_t &slot)
+{
+	std::lock_guard<std::mutex> lg(_lock);
+	_readers.erase(std::remove(_readers.begin(), _readers.end(), &slot), _readers.end());
+	Reclaim();
+}
+
+void EpochMemAllocator::Quiesce(reader_slot_t &slot, uint64_t epoch)
+{
+	slot.store(epoch, std::memory_order_release);
+
+	if(_has_retired.load(std::memory_order_relaxed)) {
+		std::lock_guard<std::mutex> lg(_lock);
+		Reclaim();
+	}
+}
+
+void EpochMemAllocator::Reclaim()
+{
+	uint64_t min_epoch = GetEpoch();
+	for(auto reader : _readers) {
+		min_epoch = std::min(min_epoch, reader->load(std::memory_order_acquire));
+	}
+
+	auto it = std::partition(_retired.begin(), _retired.end(), [min_epoch](const RetiredBuffer &b) {
+		return b.epoch >= min_epoch;
+	});
+
+	for(auto i = it; i != _retired.end(); ++i) {
+		_underlying.Free(i->buffer);
+		_retired_buffers.erase(i->buffer);
+		_reclaimed_count++;
+	}
+	_retired.erase(it, _retired.end());
+
+	_has_retired = !_retired.empty();
+}
@@ -0,0 +1,100 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * RadixPageTable.cpp
+ */
+
+#include "util/RadixPageTable.h"
+
+using namespace archsim::util;
+
+RadixPageTable::RadixPageTable()
+{
+	for(auto &entry : root_.Entries) {
+		entry.store(nullptr, std::memory_order_relaxed);
+	}
+}
+
+RadixPageTable::~RadixPageTable()
+{
+	for(auto &entry : root_.Entries) {
+		auto child = (Node*)entry.load(std::memory_order_relaxed);
+		if(child != nullptr) {
+			freeNode(child, 1);
+		}
+	}
+}
+
+char *RadixPageTable::Insert(uint64_t addr, char *page)
+{
+	Node *node = &root_;
+	for(uint32_t level = 0; level < kLevels - 1; ++level) {
+		node = getOrCreateChild(node, GetIndex(addr, level));
+	}
+
+	void *expected = nullptr;
+	if(node->Entries[GetIndex(addr, kLevels - 1)].compare_exchange_strong(expected, page, std::memory_order_acq_rel)) {
+		return page;
+	}
+	return (char*)expected;
+}
+
+void RadixPageTable::ForEachPage(const std::function<void(uint64_t page_base, char *page)> &fn) const
+{
+	forEachPage(&root_, 0, 0, fn);
+}
+
+RadixPageTable::Node *RadixPageTable::getOrCreateChild(Node *node, uint32_t index)
+{
+	auto &entry = node->Entries[index];
+
+	Node *child = (Node*)entry.load(std::memory_order_acquire);
+	if(child != nullptr) {
+		return child;
+	}
+
+	// Several threads may race to create the same node, in which case only
+	// one of them wins and the others throw theirs away
+	Node *new_child = new Node();
+	for(auto &i : new_child->Entries) {
+		i.store(nullptr, std::memory_order_relaxed);
+	}
+
+	void *expected = nullptr;
+	if(entry.compare_exchange_strong(expected, new_child, std::memory_order_acq_rel)) {
+		return new_child;
+	}
+
+	delete new_child;
+	return (Node*)expected;
+}
+
+void RadixPageTable::forEachPage(const Node *node, uint32_t level, uint64_t base, const std::function<void(uint64_t, char*)> &fn) const
+{
+	uint32_t shift = kPageBits + (kLevels - 1 - level) * kLevelBits;
+	for(uint64_t i = 0; i < kEntriesPerLevel; ++i) {
+		void *entry = node->Entries[i].load(std::memory_order_acquire);
+		if(entry == nullptr) continue;
+
+		uint64_t entry_base = base | (i << shift);
+		if(level == kLevels - 1) {
+			fn(entry_base, (char*)entry);
+		} else {
+			forEachPage((const Node*)entry, level + 1, entry_base, fn);
+		}
+	}
+}
+
+void RadixPageTable::freeNode(Node *node, uint32_t level)
+{
+	if(level < kLevels - 1) {
+		for(auto &entry : node->Entries) {
+			auto child = (Node*)entry.load(std::memory_order_relaxed);
+			if(child != nullptr) {
+				freeNode(child, level + 1);
+			}
+		}
+	}
+
+	delete node;
+}
@@ -0,0 +1,216 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * TimerWheel.cpp
+ */
+
+#include "util/TimerWheel.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <vector>
+
+using namespace archsim::util::timing;
+
+const uint32_t TimerWheel::kSlotBits;
+const uint32_t TimerWheel::kSlots;
+const uint32_t TimerWheel::kLevels;
+const uint64_t TimerWheel::kNever;
+
+// Timers which have been taken off the wheel to be expired are marked with
+// this level, so that they can still be cancelled or rescheduled by the
+// callbacks of timers which expire before them
+static const uint8_t kExpiringLevel = TimerWheel::kLevels;
+
+TimerWheel::Timer::Timer() : prev_(nullptr), next_(nullptr), deadline_(0), level_(0), slot_(0), scheduled_(false)
+{
+
+}
+
+TimerWheel::Timer::~Timer()
+{
+	assert(!scheduled_);
+}
+
+TimerWheel::TimerWheel(uint64_t now) : now_(now)
+{
+	memset(occupied_, 0, sizeof(occupied_));
+	memset(slots_, 0, sizeof(slots_));
+}
+
+TimerWheel::~TimerWheel()
+{
+	for(uint32_t level = 0; level < kLevels; ++level) {
+		for(uint32_t slot = 0; slot < kSlots; ++slot) {
+			for(Timer *timer = slots_[level][slot]; timer != nullptr; timer = timer->next_) {
+				timer->scheduled_ = false;
+			}
+		}
+	}
+}
+
+void TimerWheel::Schedule(Timer& timer, uint64_t deadline)
+{
+	if(timer.scheduled_) {
+		unlink(timer);
+	}
+
+	timer.deadline_ = deadline;
+	timer.scheduled_ = true;
+	insert(timer);
+}
+
+void TimerWheel::Cancel(Timer& timer)
+{
+	if(timer.scheduled_) {
+		unlink(timer);
+		timer.scheduled_ = false;
+	}
+}
+
+void TimerWheel::insert(Timer& timer)
+{
+	uint32_t level = 0;
+	uint64_t slot_time = now_;
+
+	// Timers which are already due go on the current slot, which is always
+	// looked at by the next advance
+	if(timer.deadline_ > now_) {
+		level = (63 - __builtin_clzll(timer.deadline_ ^ now_)) / kSlotBits;
+		slot_time = timer.deadline_;
+	}
+
+	uint32_t slot = (slot_time >> (level * kSlotBits)) & (kSlots - 1);
+
+	timer.level_ = level;
+	timer.slot_ = slot;
+	timer.prev_ = nullptr;
+	timer.next_ = slots_[level][slot];
+	if(timer.next_) {
+		timer.next_->prev_ = &timer;
+	}
+
+	slots_[level][slot] = &timer;
+	occupied_[level] |= 1ULL << slot;
+}
+
+void TimerWheel::unlink(Timer& timer)
+{
+	if(timer.level_ == kExpiringLevel) {
+		return;
+	}
+
+	if(timer.prev_) {
+		timer.prev_->next_ = timer.next_;
+	} else {
+		slots_[timer.level_][timer.slot_] = timer.next_;
+		if(timer.next_ == nullptr) {
+			occupied_[timer.level_] &= ~(1ULL << timer.slot_);
+		}
+	}
+
+	if(timer.next_) {
+		timer.next_->prev_ = timer.prev_;
+	}
+
+	timer.prev_ = timer.next_ = nullptr;
+}
+
+void TimerWheel::Advance(uint64_t now)
+{
+	if(now < now_) {
+		return;
+	}
+
+	uint64_t then = now_;
+	now_ = now;
+
+	std::vector<Timer*> taken;
+	for(uint32_t level = 0; level < kLevels; ++level) {
+		if(occupied_[level] == 0) {
+			continue;
+		}
+
+		// Take every slot which time has passed through on this level
+		uint32_t shift = level * kSlotBits;
+		uint64_t from = then >> shift, to = now >> shift;
+		uint64_t mask;
+		if(to - from >= kSlots - 1) {
+			mask = ~0ULL;
+		} else {
+			uint32_t count = to - from + 1;
+			uint32_t first = from & (kSlots - 1);
+			uint64_t span = (1ULL << count) - 1;
+			mask = (span << first) | (first ? span >> (kSlots - first) : 0);
+		}
+
+		uint64_t slots = occupied_[level] & mask;
+		while(slots) {
+			uint32_t slot = __builtin_ctzll(slots);
+			slots &= slots - 1;
+
+			for(Timer *timer = slots_[level][slot]; timer != nullptr; timer = timer->next_) {
+				taken.push_back(timer);
+			}
+
+			slots_[level][slot] = nullptr;
+			occupied_[level] &= ~(1ULL << slot);
+		}
+	}
+
+	if(taken.empty()) {
+		return;
+	}
+
+	// Timers which aren't due yet move down to a finer level
+	std::vector<Timer*> expired;
+	for(auto timer : taken) {
+		if(timer->deadline_ <= now) {
+			timer->level_ = kExpiringLevel;
+			timer->prev_ = timer->next_ = nullptr;
+			expired.push_back(timer);
+		} else {
+			insert(*timer);
+		}
+	}
+
+	std::stable_sort(expired.begin(), expired.end(), [](const Timer *a, const Timer *b) {
+		return a->deadline_ < b->deadline_;
+	});
+
+	for(auto timer : expired) {
+		// An earlier callback may have cancelled or rescheduled this timer
+		if(!timer->scheduled_ || timer->level_ != kExpiringLevel) {
+			continue;
+		}
+
+		timer->scheduled_ = false;
+		timer->level_ = 0;
+		timer->Expired(now);
+	}
+}
+
+uint64_t TimerWheel::GetNextDeadline() const
+{
+	// Every timer on a level is due after every timer on the levels below
+	// it, and the slots of a level are due in order from the current one
+	for(uint32_t level = 0; level < kLevels; ++level) {
+		if(occupied_[level] == 0) {
+			continue;
+		}
+
+		uint32_t current = (now_ >> (level * kSlotBits)) & (kSlots - 1);
+		uint64_t rotated = (occupied_[level] >> current) | (current ? occupied_[level] << (kSlots - current) : 0);
+		uint32_t slot = (current + __builtin_ctzll(rotated)) & (kSlots - 1);
+
+		uint64_t deadline = kNever;
+		for(const Timer *timer = slots_[level][slot]; timer != nullptr; timer = timer->next_) {
+			deadline = std::min(deadline, timer->deadline_);
+		}
+
+		return deadline;
+	}
+
+	return kNever;
+}
@@ -0,0 +1,119 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include <gtest/gtest.h>
+
+#include "blockjit/BlockProfile.h"
+
+#include <memory>
+
+using archsim::Address;
+using archsim::blockjit::BlockEvictionStats;
+using archsim::blockjit::BlockProfile;
+using archsim::blockjit::BlockTranslation;
+using captive::shared::block_txln_fn;
+
+namespace
+{
+	BlockTranslation make_txln(wulib::MemAllocator &allocator, size_t size)
+	{
+		BlockTranslation txln;
+		txln.SetFn((block_txln_fn)allocator.Allocate(size));
+		txln.SetSize(size);
+		return txln;
+	}
+}
+
+TEST(BlockJIT_Eviction, EvictsUnusedPages)
+{
+	wulib::StandardMemAllocator allocator;
+	std::unique_ptr<BlockProfile> profile (new BlockProfile(allocator));
+	archsim::ProcessorFeatureSet features;
+
+	Address a (0x1000), b (0x2000), c (0x3000), d (0x4000);
+
+	profile->Insert(a, make_txln(allocator, 100));
+	profile->Insert(b, make_txln(allocator, 100));
+	profile->Insert(c, make_txln(allocator, 100));
+	ASSERT_EQ(300u, profile->GetTotalCodeSize());
+
+	// Everything has just been used, so every page has the same history and
+	// the oldest translation goes first
+	BlockEvictionStats stats;
+	profile->Evict(250, stats);
+	ASSERT_EQ(1u, stats.Pages);
+	ASSERT_EQ(1u, stats.Txlns);
+	ASSERT_EQ(100u, stats.Bytes);
+	ASSERT_EQ(200u, profile->GetTotalCodeSize());
+	ASSERT_EQ(nullptr, profile->Get(a, features).GetFn());
+
+	// Only c is unused since the last eviction
+	profile->Insert(d, make_txln(allocator, 100));
+	ASSERT_NE(nullptr, profile->Get(b, features).GetFn());
+
+	profile->Evict(200, stats);
+	ASSERT_EQ(2u, stats.Pages);
+	ASSERT_EQ(nullptr, profile->Get(c, features).GetFn());
+	ASSERT_NE(nullptr, profile->Get(b, features).GetFn());
+	ASSERT_NE(nullptr, profile->Get(d, features).GetFn());
+
+	// Translating an evicted block again is reported as a retranslation
+	ASSERT_TRUE(profile->Insert(a, make_txln(allocator, 100)));
+	ASSERT_FALSE(profile->Insert(c + 4, make_txln(allocator, 100)));
+}
+
+TEST(BlockJIT_Eviction, KeepsFrequentlyUsedPages)
+{
+	wulib::StandardMemAllocator allocator;
+	std::unique_ptr<BlockProfile> profile (new BlockProfile(allocator));
+	archsim::ProcessorFeatureSet features;
+
+	Address a (0x1000), b (0x2000), c (0x3000);
+
+	profile->Insert(a, make_txln(allocator, 100));
+	profile->Insert(b, make_txln(allocator, 100));
+	profile->Insert(c, make_txln(allocator, 100));
+
+	// Age the pages without evicting anything, using only b in between
+	BlockEvictionStats stats;
+	profile->Evict(1000, stats);
+	profile->Get(b, features);
+	profile->Evict(1000, stats);
+	ASSERT_EQ(0u, stats.Pages);
+
+	// Every page has been used since the last eviction, but b has been used
+	// more often, so it outlives a even though a was translated first
+	profile->Get(a, features);
+	profile->Get(b, features);
+	profile->Get(c, features);
+	profile->Evict(150, stats);
+	ASSERT_EQ(2u, stats.Pages);
+	ASSERT_EQ(nullptr, profile->Get(a, features).GetFn());
+	ASSERT_NE(nullptr, profile->Get(b, features).GetFn());
+	ASSERT_EQ(nullptr, profile->Get(c, features).GetFn());
+}
+
+TEST(BlockJIT_Eviction, ForgetsOldEvictions)
+{
+	wulib::StandardMemAllocator allocator;
+	std::unique_ptr<BlockProfile> profile (new BlockProfile(allocator));
+
+	Address a (0x1000), b (0x2000);
+
+	profile->Insert(a, make_txln(allocator, 100));
+	profile->Insert(b, make_txln(allocator, 100));
+
+	BlockEvictionStats stats;
+	profile->Evict(100, stats);
+	ASSERT_EQ(1u, stats.Pages);
+
+	// a is still remembered after one more eviction, but not after two
+	profile->Evict(100, stats);
+	profile->Evict(100, stats);
+	ASSERT_EQ(1u, stats.Pages);
+	ASSERT_FALSE(profile->Insert(a, make_txln(allocator, 100)));
+
+	profile->Evict(0, stats);
+	ASSERT_EQ(3u, stats.Pages);
+	profile->Evict(0, stats);
+	ASSERT_TRUE(profile->Insert(b, make_txln(allocator, 100)));
+}
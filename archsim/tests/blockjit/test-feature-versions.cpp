@@ -0,0 +1,101 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include <gtest/gtest.h>
+
+#include "blockjit/BlockCache.h"
+#include "blockjit/BlockProfile.h"
+
+#include <memory>
+
+using archsim::Address;
+using archsim::ProcessorFeatureSet;
+using archsim::blockjit::BlockCache;
+using archsim::blockjit::BlockPageProfile;
+using archsim::blockjit::BlockProfile;
+using archsim::blockjit::BlockTranslation;
+using captive::shared::block_txln_fn;
+
+namespace
+{
+	BlockTranslation make_txln(wulib::MemAllocator &allocator, uint32_t fp_level)
+	{
+		BlockTranslation txln;
+		txln.SetFn((block_txln_fn)allocator.Allocate(100));
+		txln.SetSize(100);
+		txln.AddRequiredFeature(0, fp_level);
+		return txln;
+	}
+
+	ProcessorFeatureSet make_features(uint32_t fp_level)
+	{
+		ProcessorFeatureSet features;
+		features.AddFeature(0);
+		features.SetFeatureLevel(0, fp_level);
+		return features;
+	}
+}
+
+TEST(BlockJIT_FeatureVersions, ProfileKeepsVersions)
+{
+	wulib::StandardMemAllocator allocator;
+	std::unique_ptr<BlockProfile> profile (new BlockProfile(allocator));
+
+	Address a (0x1000);
+	auto fp_off = make_txln(allocator, 0);
+	auto fp_on = make_txln(allocator, 1);
+	profile->Insert(a, fp_off);
+	profile->Insert(a, fp_on);
+	ASSERT_EQ(200u, profile->GetTotalCodeSize());
+
+	// Looking up a block for other features leaves its translation alone
+	ASSERT_EQ(fp_off.GetFn(), profile->Get(a, make_features(0)).GetFn());
+	ASSERT_EQ(fp_on.GetFn(), profile->Get(a, make_features(1)).GetFn());
+	ASSERT_EQ(nullptr, profile->Get(a, make_features(2)).GetFn());
+	ASSERT_EQ(200u, profile->GetTotalCodeSize());
+
+	// A new translation for the same features replaces the old one
+	auto fp_on_again = make_txln(allocator, 1);
+	profile->Insert(a, fp_on_again);
+	ASSERT_EQ(200u, profile->GetTotalCodeSize());
+	ASSERT_EQ(fp_on_again.GetFn(), profile->Get(a, make_features(1)).GetFn());
+
+	// Only a few versions of each block are kept
+	for(uint32_t level = 2; level < 2 + BlockPageProfile::kMaxVersions; ++level) {
+		profile->Insert(a, make_txln(allocator, level));
+	}
+	ASSERT_EQ(100 * BlockPageProfile::kMaxVersions, profile->GetTotalCodeSize());
+	ASSERT_EQ(nullptr, profile->Get(a, make_features(0)).GetFn());
+}
+
+TEST(BlockJIT_FeatureVersions, CacheSwapsVersions)
+{
+	std::unique_ptr<BlockCache> cache (new BlockCache());
+
+	Address a (0x1000), b (0x1004);
+	auto fp_off = (block_txln_fn)0x100, fp_on = (block_txln_fn)0x200, other = (block_txln_fn)0x300;
+
+	cache->Insert(a, fp_off, make_features(0));
+	cache->Insert(b, other, ProcessorFeatureSet());
+
+	// Switching features drops the block until it is looked up again
+	cache->InvalidateFeatures(make_features(1).GetAvailableMask());
+	ASSERT_EQ(nullptr, cache->Lookup(a));
+	ASSERT_EQ(other, cache->Lookup(b));
+
+	cache->Insert(a, fp_on, make_features(1));
+
+	// From then on, switching features just swaps the versions
+	cache->InvalidateFeatures(make_features(0).GetAvailableMask());
+	ASSERT_EQ(fp_off, cache->Lookup(a));
+	cache->InvalidateFeatures(make_features(1).GetAvailableMask());
+	ASSERT_EQ(fp_on, cache->Lookup(a));
+	cache->InvalidateFeatures(make_features(2).GetAvailableMask());
+	ASSERT_EQ(nullptr, cache->Lookup(a));
+	cache->InvalidateFeatures(make_features(1).GetAvailableMask());
+	ASSERT_EQ(fp_on, cache->Lookup(a));
+
+	// A full invalidation forgets both versions
+	cache->Invalidate();
+	cache->InvalidateFeatures(make_features(0).GetAvailableMask());
+	ASSERT_EQ(nullptr, cache->Lookup(a));
+}
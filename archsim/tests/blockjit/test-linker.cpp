@@ -0,0 +1,78 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include <gtest/gtest.h>
+
+#include "blockjit/BlockLinker.h"
+
+using archsim::blockjit::BlockChainSlot;
+using archsim::blockjit::BlockLinker;
+using captive::shared::block_txln_fn;
+
+namespace
+{
+	void init_slot(BlockChainSlot &slot, uint64_t source, uint64_t flags)
+	{
+		slot.Unlinked = 0x1000 + source;
+		slot.Target = slot.Unlinked;
+		slot.Source = source;
+		slot.GuestPC = 0;
+		slot.Flags = flags;
+	}
+}
+
+TEST(BlockJIT_Linker, UnlinkTarget)
+{
+	BlockLinker linker;
+	BlockChainSlot a, b;
+	init_slot(a, 1, 0);
+	init_slot(b, 2, 0);
+
+	linker.Link(&a, (block_txln_fn)3, false);
+	linker.Link(&b, (block_txln_fn)4, false);
+	ASSERT_EQ(3u, a.Target);
+	ASSERT_EQ(4u, b.Target);
+
+	linker.UnlinkTarget((block_txln_fn)3);
+	ASSERT_EQ(a.Unlinked, a.Target);
+	ASSERT_EQ(4u, b.Target);
+}
+
+TEST(BlockJIT_Linker, RemoveSourceForgetsSlots)
+{
+	BlockLinker linker;
+	BlockChainSlot a;
+	init_slot(a, 1, 0);
+
+	linker.Link(&a, (block_txln_fn)3, false);
+	linker.Remove((block_txln_fn)1);
+
+	// The source has been freed, so its slot must not be written to
+	a.Target = 0x55;
+	linker.UnlinkTarget((block_txln_fn)3);
+	ASSERT_EQ(0x55u, a.Target);
+}
+
+TEST(BlockJIT_Linker, UnlinkByKind)
+{
+	BlockLinker linker;
+	BlockChainSlot same, cross, features;
+	init_slot(same, 1, 0);
+	init_slot(cross, 1, BlockChainSlot::CrossPage);
+	init_slot(features, 1, 0);
+
+	linker.Link(&same, (block_txln_fn)3, false);
+	linker.Link(&cross, (block_txln_fn)4, false);
+	linker.Link(&features, (block_txln_fn)5, true);
+
+	linker.UnlinkCrossPage();
+	ASSERT_EQ(3u, same.Target);
+	ASSERT_EQ(cross.Unlinked, cross.Target);
+	ASSERT_EQ(5u, features.Target);
+
+	linker.UnlinkFeatureDependent();
+	ASSERT_EQ(3u, same.Target);
+	ASSERT_EQ(features.Unlinked, features.Target);
+
+	linker.UnlinkAll();
+	ASSERT_EQ(same.Unlinked, same.Target);
+}
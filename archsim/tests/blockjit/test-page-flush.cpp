@@ -0,0 +1,143 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include <gtest/gtest.h>
+
+#include "blockjit/BlockCache.h"
+#include "blockjit/BlockLinker.h"
+#include "util/Cache.h"
+
+#include <memory>
+
+using archsim::Address;
+using archsim::ProcessorFeatureSet;
+using archsim::blockjit::BlockCache;
+using archsim::blockjit::BlockChainSlot;
+using archsim::blockjit::BlockLinker;
+using captive::shared::block_txln_fn;
+
+TEST(BlockJIT_PageFlush, CacheDropsOnlyPage)
+{
+	std::unique_ptr<BlockCache> cache (new BlockCache());
+
+	Address a (0x1000), b (0x1ffc), c (0x2000);
+	auto fn_a = (block_txln_fn)0x100, fn_b = (block_txln_fn)0x200, fn_c = (block_txln_fn)0x300;
+
+	cache->Insert(a, fn_a, ProcessorFeatureSet());
+	cache->Insert(b, fn_b, ProcessorFeatureSet());
+	cache->Insert(c, fn_c, ProcessorFeatureSet());
+
+	cache->InvalidatePage(Address(0x1234));
+	ASSERT_EQ(nullptr, cache->Lookup(a));
+	ASSERT_EQ(nullptr, cache->Lookup(b));
+	ASSERT_EQ(fn_c, cache->Lookup(c));
+
+	// The block can be cached again straight away
+	cache->Insert(a, fn_a, ProcessorFeatureSet());
+	ASSERT_EQ(fn_a, cache->Lookup(a));
+}
+
+TEST(BlockJIT_PageFlush, ReturnStackDropsOnlyPage)
+{
+	std::unique_ptr<BlockCache> cache (new BlockCache());
+
+	auto stack = cache->GetReturnStackPtr();
+	stack->entries[0].guest_pc = 0x1010;
+	stack->entries[0].host_fn = (block_txln_fn)0x100;
+	stack->entries[1].guest_pc = 0x2010;
+	stack->entries[1].host_fn = (block_txln_fn)0x200;
+
+	cache->InvalidatePage(Address(0x1000));
+	ASSERT_EQ(nullptr, stack->entries[0].host_fn);
+	ASSERT_EQ((block_txln_fn)0x200, stack->entries[1].host_fn);
+}
+
+TEST(BlockJIT_PageFlush, CacheDropsOnlyFreedCode)
+{
+	std::unique_ptr<BlockCache> cache (new BlockCache());
+
+	Address a (0x1000), b (0x1004);
+	auto fn_a = (block_txln_fn)0x100, fn_b = (block_txln_fn)0x200;
+
+	cache->Insert(a, fn_a, ProcessorFeatureSet());
+	cache->Insert(b, fn_b, ProcessorFeatureSet());
+
+	auto stack = cache->GetReturnStackPtr();
+	stack->entries[0].guest_pc = a.Get();
+	stack->entries[0].host_fn = fn_a;
+	stack->entries[1].guest_pc = b.Get();
+	stack->entries[1].host_fn = fn_b;
+
+	cache->InvalidateCode({ fn_a });
+	ASSERT_EQ(nullptr, cache->Lookup(a));
+	ASSERT_EQ(fn_b, cache->Lookup(b));
+	ASSERT_EQ(nullptr, stack->entries[0].host_fn);
+	ASSERT_EQ(fn_b, stack->entries[1].host_fn);
+}
+
+TEST(BlockJIT_PageFlush, LinkerUnlinksOnlyIntoPage)
+{
+	BlockLinker linker;
+	BlockChainSlot into, other;
+	for(auto slot : { &into, &other }) {
+		slot->Unlinked = 0x1001;
+		slot->Target = slot->Unlinked;
+		slot->Source = 1;
+		slot->Flags = BlockChainSlot::CrossPage;
+	}
+	into.GuestPC = 0x2040;
+	other.GuestPC = 0x3040;
+
+	linker.Link(&into, (block_txln_fn)3, false);
+	linker.Link(&other, (block_txln_fn)4, false);
+
+	linker.UnlinkCrossPageInto(Address(0x2000));
+	ASSERT_EQ(into.Unlinked, into.Target);
+	ASSERT_EQ(4u, other.Target);
+}
+
+TEST(BlockJIT_PageFlush, CacheKeepsReusedSlots)
+{
+	std::unique_ptr<BlockCache> cache (new BlockCache());
+
+	// Both blocks map to the same slot, so the second replaces the first
+	Address a (0x1000), b (0x2000);
+	ASSERT_EQ(BlockCache::GetSlot(a), BlockCache::GetSlot(b));
+	auto fn_a = (block_txln_fn)0x100, fn_b = (block_txln_fn)0x200;
+
+	cache->Insert(a, fn_a, ProcessorFeatureSet());
+	cache->Insert(b, fn_b, ProcessorFeatureSet());
+
+	cache->InvalidatePage(a);
+	ASSERT_EQ(fn_b, cache->Lookup(b));
+
+	cache->InvalidatePage(b);
+	ASSERT_EQ(nullptr, cache->Lookup(b));
+
+	// Pages are tracked again after a full flush
+	cache->Insert(a, fn_a, ProcessorFeatureSet());
+	cache->Invalidate();
+	cache->Insert(b, fn_b, ProcessorFeatureSet());
+	cache->InvalidatePage(b);
+	ASSERT_EQ(nullptr, cache->Lookup(b));
+}
+
+TEST(BlockJIT_PageFlush, DecodeCacheDropsOnlyRange)
+{
+	std::unique_ptr<archsim::util::Cache<Address, int>> cache (new archsim::util::Cache<Address, int>());
+
+	int *way;
+	for(auto addr : { 0x0ffc, 0x1000, 0x1ffc, 0x2000 }) {
+		cache->try_cache_fetch(Address(addr), way);
+		*way = addr;
+	}
+
+	cache->invalidate_range(Address(0x1000), Address::PageSize);
+	for(auto addr : { 0x0ffc, 0x2000 }) {
+		ASSERT_NE(archsim::util::CACHE_MISS, cache->try_cache_fetch(Address(addr), way));
+		ASSERT_EQ(addr, *way);
+	}
+	for(auto addr : { 0x1000, 0x1ffc }) {
+		ASSERT_EQ(archsim::util::CACHE_MISS, cache->try_cache_fetch(Address(addr), way));
+		ASSERT_EQ(0, *way);
+	}
+}
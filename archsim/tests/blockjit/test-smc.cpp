@@ -0,0 +1,136 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include <gtest/gtest.h>
+
+#include "blockjit/BlockProfile.h"
+#include "translate/profile/CodeRegionTracker.h"
+
+#include <memory>
+#include <vector>
+
+using archsim::Address;
+using archsim::PhysicalAddress;
+using archsim::blockjit::BlockCollectionStats;
+using archsim::blockjit::BlockProfile;
+using archsim::blockjit::BlockTranslation;
+using archsim::translate::profile::CodeLineInvalidation;
+using archsim::translate::profile::CodeRegionTracker;
+using captive::shared::block_txln_fn;
+
+namespace
+{
+	BlockTranslation make_txln(wulib::MemAllocator &allocator, uint32_t page_offset, uint32_t code_size)
+	{
+		BlockTranslation txln;
+		txln.SetFn((block_txln_fn)allocator.Allocate(100));
+		txln.SetSize(100);
+		txln.SetCodeLines(CodeRegionTracker::GetLineMask(page_offset, code_size));
+		return txln;
+	}
+
+	void record_invalidation(PubSubType::PubSubType type, void *context, const void *data)
+	{
+		auto invalidations = (std::vector<CodeLineInvalidation>*)context;
+		invalidations->push_back(*(const CodeLineInvalidation*)data);
+	}
+}
+
+TEST(BlockJIT_SMC, LineMask)
+{
+	ASSERT_EQ(0x1u, CodeRegionTracker::GetLineMask(0, 1));
+	ASSERT_EQ(0x1u, CodeRegionTracker::GetLineMask(0x3c, 4));
+	ASSERT_EQ(0x3u, CodeRegionTracker::GetLineMask(0x3e, 4));
+	ASSERT_EQ(0x8000000000000000ULL, CodeRegionTracker::GetLineMask(0xffc, 8));
+	ASSERT_EQ(~0ULL, CodeRegionTracker::GetLineMask(0, 0x1000));
+	ASSERT_EQ(0u, CodeRegionTracker::GetLineMask(0x100, 0));
+}
+
+TEST(BlockJIT_SMC, KeepsUnmodifiedTranslations)
+{
+	wulib::StandardMemAllocator allocator;
+	std::unique_ptr<BlockProfile> profile (new BlockProfile(allocator));
+	archsim::ProcessorFeatureSet features;
+
+	Address a (0x1000), b (0x1080), c (0x1100);
+	profile->Insert(a, make_txln(allocator, a.GetPageOffset(), 0x10));
+	profile->Insert(b, make_txln(allocator, b.GetPageOffset(), 0x40));
+	profile->Insert(c, make_txln(allocator, c.GetPageOffset(), 0x10));
+
+	// A write to a line with no code on it is ignored entirely
+	profile->MarkLinesDirty(a, CodeRegionTracker::GetLineMask(0x800, 4));
+	ASSERT_FALSE(profile->IsPageDirty(a));
+
+	// A write to b's code only makes b dirty
+	profile->MarkLinesDirty(a, CodeRegionTracker::GetLineMask(0xb0, 4));
+	ASSERT_TRUE(profile->IsPageDirty(a));
+	ASSERT_TRUE(profile->IsTxlnDirty(b));
+	ASSERT_FALSE(profile->IsTxlnDirty(a));
+	ASSERT_FALSE(profile->IsTxlnDirty(c));
+
+	BlockCollectionStats stats;
+	profile->GarbageCollect(stats);
+	ASSERT_EQ(1u, stats.InvalidatedTxlns);
+	ASSERT_EQ(2u, stats.PreservedTxlns);
+	ASSERT_EQ(200u, profile->GetTotalCodeSize());
+
+	ASSERT_NE(nullptr, profile->Get(a, features).GetFn());
+	ASSERT_EQ(nullptr, profile->Get(b, features).GetFn());
+	ASSERT_NE(nullptr, profile->Get(c, features).GetFn());
+	ASSERT_FALSE(profile->IsPageDirty(a));
+}
+
+TEST(BlockJIT_SMC, RetranslationCollectsEarly)
+{
+	wulib::StandardMemAllocator allocator;
+	std::unique_ptr<BlockProfile> profile (new BlockProfile(allocator));
+	archsim::ProcessorFeatureSet features;
+
+	Address a (0x1000), b (0x1080);
+	profile->Insert(a, make_txln(allocator, a.GetPageOffset(), 0x10));
+	profile->Insert(b, make_txln(allocator, b.GetPageOffset(), 0x10));
+
+	// Translating the modified code again must not leave the stale
+	// translation behind, nor lose the new one at the next collection
+	profile->MarkLinesDirty(b, CodeRegionTracker::GetLineMask(b.GetPageOffset(), 4));
+	profile->Insert(b, make_txln(allocator, b.GetPageOffset(), 0x10));
+
+	BlockCollectionStats stats;
+	profile->GarbageCollect(stats);
+	ASSERT_EQ(1u, stats.InvalidatedTxlns);
+	ASSERT_EQ(1u, stats.PreservedTxlns);
+	ASSERT_NE(nullptr, profile->Get(a, features).GetFn());
+	ASSERT_NE(nullptr, profile->Get(b, features).GetFn());
+	ASSERT_EQ(200u, profile->GetTotalCodeSize());
+}
+
+TEST(BlockJIT_SMC, TrackerReportsEachLineOnce)
+{
+	archsim::util::PubSubContext pubsub;
+	std::unique_ptr<CodeRegionTracker> tracker (new CodeRegionTracker(pubsub));
+
+	std::vector<CodeLineInvalidation> invalidations;
+	archsim::util::PubSubscriber subscriber (pubsub);
+	subscriber.Subscribe(PubSubType::RegionInvalidatePhysicalLines, record_invalidation, &invalidations);
+
+	PhysicalAddress page (0x4000);
+	tracker->MarkRegionAsCode(page);
+	ASSERT_TRUE(tracker->IsRegionCode(page));
+
+	tracker->InvalidateRange(page + 0x44, 4);
+	tracker->InvalidateRange(page + 0x48, 4);
+	ASSERT_EQ(1u, invalidations.size());
+	ASSERT_EQ(0x4000u, invalidations[0].PageBase.Get());
+	ASSERT_EQ(0x2u, invalidations[0].Lines);
+	ASSERT_TRUE(tracker->IsRegionCode(page));
+
+	// Marking the page again watches every line again
+	tracker->MarkRegionAsCode(page);
+	tracker->InvalidateRange(page + 0x48, 4);
+	ASSERT_EQ(2u, invalidations.size());
+
+	// Once every line has been written, the page is no longer code
+	tracker->InvalidateRegion(page);
+	ASSERT_EQ(3u, invalidations.size());
+	ASSERT_EQ(~0x2ULL, invalidations[2].Lines);
+	ASSERT_FALSE(tracker->IsRegionCode(page));
+}
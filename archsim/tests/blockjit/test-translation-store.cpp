@@ -0,0 +1,130 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include <gtest/gtest.h>
+
+#include "blockjit/BlockTranslationStore.h"
+
+#include <cstdio>
+#include <cstring>
+
+using archsim::blockjit::BlockChainSlot;
+using archsim::blockjit::BlockTranslation;
+using archsim::blockjit::BlockTranslationKey;
+using archsim::blockjit::BlockTranslationStore;
+using captive::shared::block_txln_fn;
+
+namespace
+{
+	// Stands in for a helper function called by translated code
+	void test_store_helper() {}
+
+	struct FakeCode {
+		uint8_t prologue[8];
+		uint64_t helper;
+		uint8_t stub[8];
+		BlockChainSlot slot;
+	};
+
+	const uint32_t kHelperOffset = offsetof(FakeCode, helper);
+	const uint32_t kStubOffset = offsetof(FakeCode, stub);
+	const uint32_t kSlotOffset = offsetof(FakeCode, slot);
+}
+
+TEST(BlockJIT_TranslationStore, SaveAndRestore)
+{
+	wulib::StandardMemAllocator allocator;
+	archsim::ProcessorFeatureSet features;
+	BlockTranslationKey key { 0x1000, 0x80001000, 0 };
+	std::string filename = ::testing::TempDir() + "test-translation-store.bin";
+
+	FakeCode code;
+	memset(&code, 0x90, sizeof(code));
+	code.helper = (uint64_t)&test_store_helper;
+	code.slot.Target = 1;
+	code.slot.GuestPC = 0x80001040;
+
+	BlockTranslation txln;
+	txln.SetFn((block_txln_fn)&code);
+	txln.SetSize(sizeof(code));
+
+	{
+		BlockTranslationStore store (1234);
+		store.Record(key, 55, txln, {kHelperOffset}, {{kSlotOffset, kStubOffset}});
+		ASSERT_TRUE(store.Save(filename));
+	}
+
+	// Translations saved with a different configuration must not be loaded
+	{
+		BlockTranslationStore store (4321);
+		ASSERT_FALSE(store.Load(filename));
+		ASSERT_FALSE(store.Has(key));
+	}
+
+	BlockTranslationStore store (1234);
+	ASSERT_TRUE(store.Load(filename));
+	ASSERT_TRUE(store.Has(key));
+
+	// The guest page has changed
+	BlockTranslation restored;
+	ASSERT_FALSE(store.Restore(key, 56, features, allocator, restored));
+
+	ASSERT_TRUE(store.Restore(key, 55, features, allocator, restored));
+	ASSERT_EQ(sizeof(code), restored.GetSize());
+
+	const FakeCode *restored_code = (const FakeCode*)restored.GetFn();
+	ASSERT_EQ(0, memcmp(restored_code->prologue, code.prologue, sizeof(code.prologue)));
+	ASSERT_EQ((uint64_t)&test_store_helper, restored_code->helper);
+	ASSERT_EQ((uint64_t)restored_code + kStubOffset, restored_code->slot.Unlinked);
+	ASSERT_EQ(restored_code->slot.Unlinked, restored_code->slot.Target);
+	ASSERT_EQ((uint64_t)restored_code, restored_code->slot.Source);
+	ASSERT_EQ(0x80001040, restored_code->slot.GuestPC);
+
+	allocator.Free((void*)restored.GetFn());
+	remove(filename.c_str());
+}
+
+TEST(BlockJIT_TranslationStore, RejectsCorruptSizes)
+{
+	std::string filename = ::testing::TempDir() + "test-translation-store-corrupt.bin";
+
+	// A store whose only module claims a name far longer than the file
+	{
+		FILE *f = fopen(filename.c_str(), "wb");
+		ASSERT_NE(nullptr, f);
+
+		uint32_t version = 1, module_count = 1, name_size = 0xfffffff0;
+		uint64_t signature = 1234;
+		fwrite("ASTX", 1, 4, f);
+		fwrite(&version, sizeof(version), 1, f);
+		fwrite(&signature, sizeof(signature), 1, f);
+		fwrite(&module_count, sizeof(module_count), 1, f);
+		fwrite(&name_size, sizeof(name_size), 1, f);
+		fclose(f);
+	}
+
+	{
+		BlockTranslationStore store (1234);
+		ASSERT_FALSE(store.Load(filename));
+	}
+
+	// A store which claims more modules than the file could hold
+	{
+		FILE *f = fopen(filename.c_str(), "wb");
+		ASSERT_NE(nullptr, f);
+
+		uint32_t version = 1, module_count = 0xffffffff;
+		uint64_t signature = 1234;
+		fwrite("ASTX", 1, 4, f);
+		fwrite(&version, sizeof(version), 1, f);
+		fwrite(&signature, sizeof(signature), 1, f);
+		fwrite(&module_count, sizeof(module_count), 1, f);
+		fclose(f);
+	}
+
+	{
+		BlockTranslationStore store (1234);
+		ASSERT_FALSE(store.Load(filename));
+	}
+
+	remove(filename.c_str());
+}
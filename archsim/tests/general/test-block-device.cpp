@@ -0,0 +1,210 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include <gtest/gtest.h>
+
+#include "abi/devices/generic/block/FileBackedBlockDevice.h"
+#include "abi/devices/generic/block/OverlayBlockDevice.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <vector>
+
+using archsim::abi::devices::generic::block::FileBackedBlockDevice;
+using archsim::abi::devices::generic::block::OverlayBlockDevice;
+
+namespace
+{
+	std::string make_image(uint32_t blocks)
+	{
+		char name[] = "/tmp/archsim-block-XXXXXX";
+		int fd = mkstemp(name);
+
+		std::vector<uint8_t> data (blocks * 512);
+		for(size_t i = 0; i < data.size(); ++i) {
+			data[i] = i / 512;
+		}
+		EXPECT_EQ((ssize_t)data.size(), write(fd, data.data(), data.size()));
+
+		close(fd);
+		return name;
+	}
+
+	std::string make_overlay()
+	{
+		char name[] = "/tmp/archsim-overlay-XXXXXX";
+		close(mkstemp(name));
+		return name;
+	}
+}
+
+TEST(Archsim_BlockDevice, VectoredTransfers)
+{
+	auto image = make_image(8);
+	FileBackedBlockDevice bdev;
+	ASSERT_TRUE(bdev.Open(image));
+
+	// Bring block 3 into the cache, so the write must replace it
+	uint8_t block[512];
+	ASSERT_TRUE(bdev.ReadBlocks(3, 1, block));
+	ASSERT_EQ(3, block[0]);
+
+	// Buffers split blocks between them
+	std::vector<uint8_t> a (100, 0xaa), b (700, 0xbb), c (224, 0xcc);
+	struct iovec iov[] = { { a.data(), a.size() }, { b.data(), b.size() }, { c.data(), c.size() } };
+	ASSERT_TRUE(bdev.WriteBlocksV(3, iov, 3));
+
+	ASSERT_TRUE(bdev.ReadBlocks(3, 1, block));
+	ASSERT_EQ(0xaa, block[0]);
+	ASSERT_EQ(0xbb, block[100]);
+	ASSERT_EQ(0xbb, block[511]);
+
+	std::vector<uint8_t> x (300), y (1236);
+	struct iovec riov[] = { { x.data(), x.size() }, { y.data(), y.size() } };
+	ASSERT_TRUE(bdev.ReadBlocksV(2, riov, 2));
+	ASSERT_EQ(2, x[0]);
+	ASSERT_EQ(2, y[211]);
+	ASSERT_EQ(0xaa, y[212]);
+	ASSERT_EQ(0xcc, y[212 + 1023]);
+
+	// Transfers past the end of the device are refused
+	ASSERT_FALSE(bdev.ReadBlocksV(7, riov, 2));
+
+	unlink(image.c_str());
+}
+
+TEST(Archsim_BlockDevice, OverlayKeepsWrites)
+{
+	// The image is a little over two clusters long
+	auto image = make_image(300);
+	auto overlay_file = make_overlay();
+
+	FileBackedBlockDevice base;
+	ASSERT_TRUE(base.Open(image, true));
+
+	std::vector<uint8_t> data (1024, 0xee);
+	uint8_t block[512];
+	{
+		OverlayBlockDevice overlay;
+		ASSERT_TRUE(overlay.Open(base, overlay_file));
+		ASSERT_EQ(0u, overlay.GetAllocatedClusterCount());
+
+		// A write across a cluster boundary copies up both clusters
+		ASSERT_TRUE(overlay.WriteBlocks(127, 2, data.data()));
+		ASSERT_EQ(3u, overlay.GetAllocatedClusterCount());
+
+		ASSERT_TRUE(overlay.ReadBlocks(126, 1, block));
+		ASSERT_EQ(126, block[0]);
+		ASSERT_TRUE(overlay.ReadBlocks(128, 1, block));
+		ASSERT_EQ(0xee, block[0]);
+
+		// The last cluster is only partly backed by the image
+		ASSERT_TRUE(overlay.WriteBlocks(299, 1, data.data()));
+		ASSERT_TRUE(overlay.ReadBlocks(298, 2, data.data()));
+		ASSERT_EQ((uint8_t)298, data[0]);
+		ASSERT_EQ(0xee, data[512]);
+
+		ASSERT_TRUE(overlay.Flush());
+	}
+
+	ASSERT_TRUE(base.ReadBlocks(128, 1, block));
+	ASSERT_EQ(128, block[0]);
+
+	// The writes are still there when the overlay is opened again
+	OverlayBlockDevice overlay;
+	ASSERT_TRUE(overlay.Open(base, overlay_file));
+	ASSERT_EQ(4u, overlay.GetAllocatedClusterCount());
+	ASSERT_TRUE(overlay.ReadBlocks(127, 1, block));
+	ASSERT_EQ(0xee, block[0]);
+
+	// A read only image can't be committed to
+	ASSERT_FALSE(overlay.Commit());
+	overlay.Close();
+	base.Close();
+
+	ASSERT_TRUE(base.Open(image, false));
+	ASSERT_TRUE(overlay.Open(base, overlay_file));
+	ASSERT_TRUE(overlay.Commit());
+	ASSERT_EQ(0u, overlay.GetAllocatedClusterCount());
+	ASSERT_TRUE(base.ReadBlocks(128, 1, block));
+	ASSERT_EQ(0xee, block[0]);
+	ASSERT_TRUE(base.ReadBlocks(126, 1, block));
+	ASSERT_EQ(126, block[0]);
+	overlay.Close();
+	base.Close();
+
+	unlink(overlay_file.c_str());
+	unlink(image.c_str());
+}
+
+TEST(Archsim_BlockDevice, OverlayIsLocked)
+{
+	auto image = make_image(16);
+	auto overlay_file = make_overlay();
+
+	FileBackedBlockDevice base;
+	ASSERT_TRUE(base.Open(image, true));
+
+	OverlayBlockDevice overlay, other;
+	ASSERT_TRUE(overlay.Open(base, overlay_file));
+	ASSERT_FALSE(other.Open(base, overlay_file));
+
+	overlay.Close();
+	ASSERT_TRUE(other.Open(base, overlay_file));
+	other.Close();
+	base.Close();
+
+	unlink(overlay_file.c_str());
+	unlink(image.c_str());
+}
+
+TEST(Archsim_BlockDevice, OverlayRejectsCorruptTables)
+{
+	auto image = make_image(16);
+	auto overlay_file = make_overlay();
+
+	FileBackedBlockDevice base;
+	ASSERT_TRUE(base.Open(image, true));
+
+	std::vector<uint8_t> data (512, 0xee);
+	{
+		OverlayBlockDevice overlay;
+		ASSERT_TRUE(overlay.Open(base, overlay_file));
+		ASSERT_TRUE(overlay.WriteBlocks(0, 1, data.data()));
+		overlay.Close();
+	}
+
+	// The header is followed by the L1 table, whose first entry points at
+	// the L2 table of the written cluster
+	const off_t next_free_offset = 40, l1_offset = 48;
+	int fd = open(overlay_file.c_str(), O_RDWR);
+	ASSERT_LE(0, fd);
+
+	uint64_t good, bad = 12345;
+	ASSERT_EQ((ssize_t)sizeof(good), pread(fd, &good, sizeof(good), l1_offset));
+	ASSERT_EQ((ssize_t)sizeof(bad), pwrite(fd, &bad, sizeof(bad), l1_offset));
+	{
+		OverlayBlockDevice overlay;
+		ASSERT_FALSE(overlay.Open(base, overlay_file));
+	}
+	ASSERT_EQ((ssize_t)sizeof(good), pwrite(fd, &good, sizeof(good), l1_offset));
+
+	// Allocation must not run past the end of the file
+	ASSERT_EQ((ssize_t)sizeof(good), pread(fd, &good, sizeof(good), next_free_offset));
+	bad = good + 16 * OverlayBlockDevice::kClusterSize;
+	ASSERT_EQ((ssize_t)sizeof(bad), pwrite(fd, &bad, sizeof(bad), next_free_offset));
+	{
+		OverlayBlockDevice overlay;
+		ASSERT_FALSE(overlay.Open(base, overlay_file));
+	}
+	ASSERT_EQ((ssize_t)sizeof(good), pwrite(fd, &good, sizeof(good), next_free_offset));
+	close(fd);
+
+	OverlayBlockDevice overlay;
+	ASSERT_TRUE(overlay.Open(base, overlay_file));
+	overlay.Close();
+	base.Close();
+
+	unlink(overlay_file.c_str());
+	unlink(image.c_str());
+}
@@ -0,0 +1,122 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include <gtest/gtest.h>
+
+#include "util/MemAllocator.h"
+
+#include <vector>
+
+namespace
+{
+	class CountingMemAllocator : public wulib::StandardMemAllocator
+	{
+	public:
+		CountingMemAllocator() : frees(0) {}
+
+		void Free(void *buffer) override
+		{
+			frees++;
+			wulib::StandardMemAllocator::Free(buffer);
+		}
+
+		int frees;
+	};
+}
+
+TEST(Archsim_EpochMemAllocator, FreeWithoutReaders)
+{
+	CountingMemAllocator underlying;
+	wulib::EpochMemAllocator allocator (underlying);
+	wulib::EpochMemAllocator::reader_slot_t slot;
+
+	allocator.RegisterReader(slot);
+	allocator.UnregisterReader(slot);
+
+	void *buffer = allocator.Allocate(64);
+	allocator.Free(buffer);
+	ASSERT_TRUE(allocator.RetireFreed());
+
+	// With no registered readers the buffer is reclaimed at the next opportunity
+	allocator.RegisterReader(slot);
+	allocator.Quiesce(slot, allocator.GetEpoch());
+
+	ASSERT_EQ(1, underlying.frees);
+	allocator.UnregisterReader(slot);
+}
+
+TEST(Archsim_EpochMemAllocator, FreeDeferredUntilAllReadersQuiesce)
+{
+	CountingMemAllocator underlying;
+	wulib::EpochMemAllocator allocator (underlying);
+	wulib::EpochMemAllocator::reader_slot_t a, b;
+
+	allocator.RegisterReader(a);
+	allocator.RegisterReader(b);
+
+	void *buffer = allocator.Allocate(64);
+	uint64_t free_epoch = allocator.GetEpoch();
+	allocator.Free(buffer);
+
+	// Buffers can't be reclaimed until the epoch has moved on
+	allocator.Quiesce(a, free_epoch);
+	allocator.Quiesce(b, free_epoch);
+	ASSERT_EQ(0, underlying.frees);
+
+	ASSERT_TRUE(allocator.RetireFreed());
+	ASSERT_NE(free_epoch, allocator.GetEpoch());
+
+	// A reader which quiesces at the epoch of the free could still hold a reference
+	allocator.Quiesce(a, free_epoch);
+	ASSERT_EQ(0, underlying.frees);
+
+	allocator.Quiesce(a, allocator.GetEpoch());
+	ASSERT_EQ(0, underlying.frees);
+
+	allocator.Quiesce(b, allocator.GetEpoch());
+	ASSERT_EQ(1, underlying.frees);
+	ASSERT_EQ(1u, allocator.GetReclaimedCount());
+
+	allocator.UnregisterReader(a);
+	allocator.UnregisterReader(b);
+}
+
+TEST(Archsim_EpochMemAllocator, OneEpochPerBatch)
+{
+	CountingMemAllocator underlying;
+	wulib::EpochMemAllocator allocator (underlying);
+	wulib::EpochMemAllocator::reader_slot_t slot;
+
+	allocator.RegisterReader(slot);
+	uint64_t reader_epoch = allocator.GetEpoch();
+
+	void *a = allocator.Allocate(64);
+	void *b = allocator.Allocate(64);
+	void *c = allocator.Allocate(64);
+
+	uint64_t start_epoch = allocator.GetEpoch();
+	allocator.Free(a);
+	allocator.Free(b);
+	ASSERT_EQ(start_epoch, allocator.GetEpoch());
+
+	ASSERT_TRUE(allocator.RetireFreed());
+	ASSERT_EQ(start_epoch + 1, allocator.GetEpoch());
+
+	// Nothing more has been freed
+	ASSERT_FALSE(allocator.RetireFreed());
+	ASSERT_EQ(start_epoch + 1, allocator.GetEpoch());
+
+	// The reader is told exactly which buffers it has to drop
+	ASSERT_TRUE(allocator.IsRetired(a));
+	ASSERT_FALSE(allocator.IsRetired(c));
+
+	std::vector<void*> retired;
+	allocator.GetRetiredSince(reader_epoch, retired);
+	ASSERT_EQ(2u, retired.size());
+
+	allocator.Quiesce(slot, allocator.GetEpoch());
+	ASSERT_EQ(2, underlying.frees);
+	ASSERT_FALSE(allocator.IsRetired(a));
+
+	allocator.Free(c);
+	allocator.UnregisterReader(slot);
+}
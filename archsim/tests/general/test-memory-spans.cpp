@@ -0,0 +1,84 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include <gtest/gtest.h>
+
+#include "abi/memory/MemoryModel.h"
+#include "core/MemoryInterface.h"
+
+#include <cstring>
+#include <vector>
+
+using archsim::Address;
+using archsim::abi::memory::host_span_list_t;
+
+namespace
+{
+	// Guest pages 0x1000 and 0x2000 are adjacent in host memory, page 0x3000
+	// is elsewhere, and nothing else can be accessed directly
+	class SplitMemoryModel : public archsim::abi::memory::NullMemoryModel
+	{
+	public:
+		SplitMemoryModel() : low_(2 * Address::PageSize), high_(Address::PageSize) {}
+
+		bool LockRegion(archsim::abi::memory::guest_addr_t guest_addr, archsim::abi::memory::guest_size_t guest_size, host_addr_t &host_addr) override
+		{
+			if(guest_addr >= Address(0x1000) && guest_addr + guest_size <= Address(0x3000)) {
+				host_addr = low_.data() + (guest_addr.Get() - 0x1000);
+				return true;
+			}
+			if(guest_addr >= Address(0x3000) && guest_addr + guest_size <= Address(0x4000)) {
+				host_addr = high_.data() + (guest_addr.Get() - 0x3000);
+				return true;
+			}
+			return false;
+		}
+
+		std::vector<char> low_, high_;
+	};
+}
+
+TEST(Archsim_MemorySpans, SplitsAtHostDiscontinuities)
+{
+	SplitMemoryModel model;
+	host_span_list_t spans;
+
+	ASSERT_TRUE(model.LockSpans(Address(0x1800), 0x2000, archsim::abi::memory::LockRead, spans));
+	ASSERT_EQ(2u, spans.size());
+	ASSERT_EQ(model.low_.data() + 0x800, spans[0].iov_base);
+	ASSERT_EQ(0x1800u, spans[0].iov_len);
+	ASSERT_EQ(model.high_.data(), spans[1].iov_base);
+	ASSERT_EQ(0x800u, spans[1].iov_len);
+
+	ASSERT_FALSE(model.LockSpans(Address(0x3800), 0x1000, archsim::abi::memory::LockRead, spans));
+}
+
+TEST(Archsim_MemorySpans, InterfaceCopiesThroughSpans)
+{
+	SplitMemoryModel model;
+	archsim::MemoryInterfaceDescriptor descriptor ("mem", 4, 4, false, 0);
+	archsim::LegacyMemoryInterface device (model);
+	archsim::MemoryInterface interface (descriptor);
+	interface.Connect(device);
+
+	// A string which crosses into the separate page
+	strcpy(model.low_.data() + 0x1ffc, "span");
+	strcpy(model.high_.data(), "test");
+
+	char str[16];
+	ASSERT_EQ(archsim::MemoryResult::OK, interface.ReadString(Address(0x2ffc), str, sizeof(str)));
+	ASSERT_STREQ("spantest", str);
+
+	// Strings are cut off at the maximum size
+	memset(str, 0, sizeof(str));
+	interface.ReadString(Address(0x2ffc), str, 6);
+	ASSERT_STREQ("spante", str);
+
+	const unsigned char data[] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+	ASSERT_EQ(archsim::MemoryResult::OK, interface.Write(Address(0x2ffc), data, sizeof(data)));
+	ASSERT_EQ(4, model.low_[0x1fff]);
+	ASSERT_EQ(5, model.high_[0]);
+
+	unsigned char readback[8];
+	ASSERT_EQ(archsim::MemoryResult::OK, interface.Read(Address(0x2ffc), readback, sizeof(readback)));
+	ASSERT_EQ(0, memcmp(data, readback, sizeof(data)));
+}
@@ -0,0 +1,57 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include <gtest/gtest.h>
+
+#include "interpret/PredecodedBlockCache.h"
+
+using archsim::Address;
+using archsim::interpret::PredecodedBlockCache;
+
+TEST(Archsim_PredecodedBlockCache, LookupByModeAndPC)
+{
+	archsim::util::PubSubContext pubsub;
+	PredecodedBlockCache cache (pubsub);
+
+	auto block = cache.Insert(Address(0x1000), 0);
+	ASSERT_EQ(block, cache.Lookup(Address(0x1000), 0));
+	ASSERT_EQ(nullptr, cache.Lookup(Address(0x1000), 1));
+	ASSERT_EQ(nullptr, cache.Lookup(Address(0x1004), 0));
+
+	// Blocks which collide in the front cache are still found
+	auto other = cache.Insert(Address(0x1000 + 2 * 1024), 0);
+	ASSERT_EQ(block, cache.Lookup(Address(0x1000), 0));
+	ASSERT_EQ(other, cache.Lookup(Address(0x1000 + 2 * 1024), 0));
+}
+
+TEST(Archsim_PredecodedBlockCache, InvalidatePageOnCollect)
+{
+	archsim::util::PubSubContext pubsub;
+	PredecodedBlockCache cache (pubsub);
+
+	cache.Insert(Address(0x1000), 0);
+	cache.Insert(Address(0x1100), 0);
+	auto kept = cache.Insert(Address(0x2000), 0);
+
+	pubsub.Publish(PubSubType::RegionInvalidatePhysical, (void*)0x1000);
+	ASSERT_TRUE(cache.IsInvalidated());
+
+	// Invalidated blocks are only dropped once the owner collects them
+	ASSERT_NE(nullptr, cache.Lookup(Address(0x1000), 0));
+
+	cache.Collect();
+	ASSERT_FALSE(cache.IsInvalidated());
+	ASSERT_EQ(nullptr, cache.Lookup(Address(0x1000), 0));
+	ASSERT_EQ(nullptr, cache.Lookup(Address(0x1100), 0));
+	ASSERT_EQ(kept, cache.Lookup(Address(0x2000), 0));
+}
+
+TEST(Archsim_PredecodedBlockCache, FlushOnCollect)
+{
+	archsim::util::PubSubContext pubsub;
+	PredecodedBlockCache cache (pubsub);
+
+	cache.Insert(Address(0x1000), 0);
+	pubsub.Publish(PubSubType::FlushTranslations, nullptr);
+	cache.Collect();
+	ASSERT_EQ(nullptr, cache.Lookup(Address(0x1000), 0));
+}
@@ -0,0 +1,72 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include <gtest/gtest.h>
+
+#include "util/RadixPageTable.h"
+
+#include <map>
+#include <thread>
+#include <vector>
+
+using archsim::util::RadixPageTable;
+
+TEST(Archsim_RadixPageTable, LookupAndInsert)
+{
+	std::unique_ptr<RadixPageTable> table (new RadixPageTable());
+	char a, b, c;
+
+	ASSERT_EQ(nullptr, table->Lookup(0x1000));
+
+	ASSERT_EQ(&a, table->Insert(0x1000, &a));
+	ASSERT_EQ(&a, table->Lookup(0x1000));
+	ASSERT_EQ(&a, table->Lookup(0x1fff));
+	ASSERT_EQ(nullptr, table->Lookup(0x2000));
+
+	// Addresses above 4GB have their own pages
+	ASSERT_EQ(&b, table->Insert(0xffff800000001000ULL, &b));
+	ASSERT_EQ(&b, table->Lookup(0xffff800000001234ULL));
+	ASSERT_EQ(&a, table->Lookup(0x1000));
+
+	// An existing page is never replaced
+	ASSERT_EQ(&a, table->Insert(0x1000, &c));
+	ASSERT_EQ(&a, table->Lookup(0x1000));
+
+	std::map<uint64_t, char*> pages;
+	table->ForEachPage([&pages](uint64_t page_base, char *page) {
+		pages[page_base] = page;
+	});
+	ASSERT_EQ(2u, pages.size());
+	ASSERT_EQ(&a, pages.at(0x1000));
+	ASSERT_EQ(&b, pages.at(0xffff800000001000ULL));
+}
+
+TEST(Archsim_RadixPageTable, ConcurrentInsert)
+{
+	std::unique_ptr<RadixPageTable> table (new RadixPageTable());
+
+	// Every thread tries to insert its own page at the same addresses, and
+	// all of them must agree on which page won
+	const int kThreads = 4, kPages = 1024;
+	std::vector<std::vector<char>> data (kThreads, std::vector<char>(kPages));
+	std::vector<std::vector<char*>> results (kThreads, std::vector<char*>(kPages));
+
+	std::vector<std::thread> threads;
+	for(int t = 0; t < kThreads; ++t) {
+		threads.emplace_back([&, t]() {
+			for(int i = 0; i < kPages; ++i) {
+				results[t][i] = table->Insert((uint64_t)i << 24, &data[t][i]);
+			}
+		});
+	}
+	for(auto &thread : threads) {
+		thread.join();
+	}
+
+	for(int i = 0; i < kPages; ++i) {
+		char *page = table->Lookup((uint64_t)i << 24);
+		ASSERT_NE(nullptr, page);
+		for(int t = 0; t < kThreads; ++t) {
+			ASSERT_EQ(page, results[t][i]);
+		}
+	}
+}
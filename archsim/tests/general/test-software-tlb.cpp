@@ -0,0 +1,79 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include <gtest/gtest.h>
+
+#include "abi/devices/SoftwareTLB.h"
+
+#include <memory>
+
+using archsim::Address;
+using archsim::abi::devices::SoftwareTLB;
+
+TEST(Archsim_SoftwareTLB, LookupByTag)
+{
+	std::unique_ptr<SoftwareTLB> tlb (new SoftwareTLB());
+	Address phys;
+
+	ASSERT_FALSE(tlb->Lookup(Address(0x1234), 0, 0, SoftwareTLB::PermRead, phys));
+
+	tlb->Insert(Address(0x1234), Address(0x80001234), 0, 0, SoftwareTLB::PermRead);
+	ASSERT_TRUE(tlb->Lookup(Address(0x1ff8), 0, 0, SoftwareTLB::PermRead, phys));
+	ASSERT_EQ(0x80001ff8, phys.Get());
+
+	// Other ASIDs and rings need their own walks
+	ASSERT_FALSE(tlb->Lookup(Address(0x1234), 1, 0, SoftwareTLB::PermRead, phys));
+	ASSERT_FALSE(tlb->Lookup(Address(0x1234), 0, 1, SoftwareTLB::PermRead, phys));
+
+	// So do accesses which have not been allowed yet
+	ASSERT_FALSE(tlb->Lookup(Address(0x1234), 0, 0, SoftwareTLB::PermWrite, phys));
+	tlb->Insert(Address(0x1234), Address(0x80001234), 0, 0, SoftwareTLB::PermWrite);
+	ASSERT_TRUE(tlb->Lookup(Address(0x1234), 0, 0, SoftwareTLB::PermWrite, phys));
+	ASSERT_TRUE(tlb->Lookup(Address(0x1234), 0, 0, SoftwareTLB::PermRead, phys));
+
+	// A page which has moved loses the permissions of the old mapping
+	tlb->Insert(Address(0x1234), Address(0x90001234), 0, 0, SoftwareTLB::PermRead);
+	ASSERT_TRUE(tlb->Lookup(Address(0x1234), 0, 0, SoftwareTLB::PermRead, phys));
+	ASSERT_EQ(0x90001234, phys.Get());
+	ASSERT_FALSE(tlb->Lookup(Address(0x1234), 0, 0, SoftwareTLB::PermWrite, phys));
+}
+
+TEST(Archsim_SoftwareTLB, ReplacesWithinSet)
+{
+	std::unique_ptr<SoftwareTLB> tlb (new SoftwareTLB());
+	Address phys;
+
+	// Pages this far apart all map to the same set
+	const uint64_t stride = SoftwareTLB::kSets * Address::PageSize;
+	for(uint64_t i = 0; i <= SoftwareTLB::kWays; ++i) {
+		tlb->Insert(Address(i * stride), Address(i * stride), 0, 0, SoftwareTLB::PermRead);
+	}
+
+	ASSERT_FALSE(tlb->Lookup(Address(0), 0, 0, SoftwareTLB::PermRead, phys));
+	for(uint64_t i = 1; i <= SoftwareTLB::kWays; ++i) {
+		ASSERT_TRUE(tlb->Lookup(Address(i * stride), 0, 0, SoftwareTLB::PermRead, phys));
+	}
+}
+
+TEST(Archsim_SoftwareTLB, Invalidation)
+{
+	std::unique_ptr<SoftwareTLB> tlb (new SoftwareTLB());
+	Address phys;
+
+	tlb->Insert(Address(0x1000), Address(0x1000), 0, 0, SoftwareTLB::PermRead);
+	tlb->Insert(Address(0x2000), Address(0x2000), 0, 0, SoftwareTLB::PermRead);
+	tlb->Insert(Address(0x3000), Address(0x3000), 1, 0, SoftwareTLB::PermRead);
+
+	tlb->Evict(Address(0x1abc));
+	ASSERT_FALSE(tlb->Lookup(Address(0x1000), 0, 0, SoftwareTLB::PermRead, phys));
+	ASSERT_TRUE(tlb->Lookup(Address(0x2000), 0, 0, SoftwareTLB::PermRead, phys));
+
+	tlb->EvictASID(1);
+	ASSERT_TRUE(tlb->Lookup(Address(0x2000), 0, 0, SoftwareTLB::PermRead, phys));
+	ASSERT_FALSE(tlb->Lookup(Address(0x3000), 1, 0, SoftwareTLB::PermRead, phys));
+
+	// A requested flush happens at the next lookup
+	tlb->RequestFlush();
+	ASSERT_FALSE(tlb->Lookup(Address(0x2000), 0, 0, SoftwareTLB::PermRead, phys));
+	tlb->Insert(Address(0x2000), Address(0x2000), 0, 0, SoftwareTLB::PermRead);
+	ASSERT_TRUE(tlb->Lookup(Address(0x2000), 0, 0, SoftwareTLB::PermRead, phys));
+}
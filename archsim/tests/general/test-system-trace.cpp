@@ -0,0 +1,84 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include <gtest/gtest.h>
+
+#include "libtrace/RecordFile.h"
+#include "libtrace/TraceSink.h"
+#include "session.h"
+#include "system.h"
+#include "util/SimOptions.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace libtrace;
+
+// Tracing options are global, so put them back for the following tests
+class Archsim_System : public ::testing::Test
+{
+public:
+	Archsim_System() : Trace(archsim::options::Trace), TraceMode(archsim::options::TraceMode), TraceFile(archsim::options::TraceFile) {}
+
+	void TearDown() override
+	{
+		archsim::options::Trace = Trace;
+		archsim::options::TraceMode = TraceMode;
+		archsim::options::TraceFile = TraceFile;
+	}
+
+	archsim::SimOption<bool> Trace;
+	archsim::SimOption<std::string> TraceMode;
+	archsim::SimOption<std::string> TraceFile;
+};
+
+TEST_F(Archsim_System, DestroyClosesTraceSink)
+{
+	char pattern[] = "/tmp/archsim-system-trace-XXXXXX";
+	int fd = mkstemp(pattern);
+	ASSERT_NE(-1, fd);
+	close(fd);
+
+	archsim::options::Trace.SetValue(true);
+	archsim::options::TraceMode.SetValue("compressed");
+	archsim::options::TraceFile.SetValue(pattern);
+	archsim::options::TraceFile.SetIsSpecified();
+
+	archsim::Session session;
+	System system (session);
+
+	// There is no emulation model, so initialisation stops once the trace
+	// sink has been created
+	ASSERT_FALSE(system.Initialise());
+
+	auto sink = system.GetECM().GetTraceSink();
+	ASSERT_NE(nullptr, sink);
+
+	std::vector<TraceRecord> records;
+	for(uint32_t i = 0; i < 1000; ++i) {
+		records.push_back(TraceRecord(InstructionHeader, 0, i * 4, 0));
+	}
+
+	int id = sink->Open();
+	sink->SinkPackets(id, records.data(), records.data() + records.size());
+
+	system.Destroy();
+	ASSERT_EQ(nullptr, system.GetECM().GetTraceSink());
+
+	// The trace was closed properly, so it has an index
+	std::string filename = std::string(pattern) + "0";
+	FILE *f = fopen(filename.c_str(), "r");
+	ASSERT_NE(nullptr, f);
+	{
+		RecordFile file (f);
+		ASSERT_TRUE(file.IsCompressed());
+		ASSERT_TRUE(file.HasIndex());
+		ASSERT_EQ(records.size(), file.Size());
+	}
+	fclose(f);
+
+	unlink(filename.c_str());
+	unlink(pattern);
+}
@@ -0,0 +1,77 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include <gtest/gtest.h>
+
+#include "abi/devices/generic/timing/TickSource.h"
+
+#include <vector>
+
+using namespace archsim::abi::devices::timing;
+
+namespace
+{
+	class RecordingTimer : public TickTimer
+	{
+	public:
+		RecordingTimer(std::vector<uint64_t> &log) : log_(log) { }
+
+		void Expired(uint64_t now) override
+		{
+			log_.push_back(now);
+		}
+
+	private:
+		std::vector<uint64_t> &log_;
+	};
+}
+
+TEST(Archsim_TickSource, InstructionTicksExpireTimers)
+{
+	archsim::util::PubSubContext pubsub;
+	std::vector<uint64_t> log;
+	RecordingTimer timer (log);
+
+	InstructionTickSource source (pubsub);
+	source.Start();
+	source.ScheduleTimer(timer, 100);
+
+	source.AddInstructions(50);
+	ASSERT_TRUE(log.empty());
+	ASSERT_EQ(50u, source.GetCounter());
+
+	// The interpreter counts instructions through the pubsub event
+	pubsub.Publish(PubSubType::InstructionExecute, nullptr);
+	ASSERT_EQ(51u, source.GetCounter());
+
+	source.AddInstructions(60);
+	ASSERT_EQ(1u, log.size());
+	ASSERT_EQ(111u, log[0]);
+}
+
+TEST(Archsim_TickSource, SkipToNextDeadline)
+{
+	archsim::util::PubSubContext pubsub;
+	std::vector<uint64_t> log;
+	RecordingTimer timer (log);
+
+	InstructionTickSource source (pubsub);
+	source.Start();
+
+	// Nothing to skip to
+	source.SkipToNextDeadline();
+	ASSERT_EQ(0u, source.GetCounter());
+
+	source.AddInstructions(10);
+	source.ScheduleTimer(timer, 1000000);
+	source.SkipToNextDeadline();
+
+	ASSERT_EQ(1u, log.size());
+	ASSERT_EQ(1000000u, log[0]);
+	ASSERT_EQ(1000000u, source.GetCounter());
+
+	// Counting carries on from the deadline
+	source.AddInstructions(5);
+	ASSERT_EQ(1000005u, source.GetCounter());
+
+	source.CancelTimer(timer);
+}
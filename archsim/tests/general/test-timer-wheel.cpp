@@ -0,0 +1,89 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include <gtest/gtest.h>
+
+#include "util/TimerWheel.h"
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+
+using archsim::util::timing::TimerWheel;
+
+namespace
+{
+	class RecordingTimer : public TimerWheel::Timer
+	{
+	public:
+		RecordingTimer(std::vector<uint64_t> &log, uint64_t id) : log_(log), id_(id) { }
+
+		void Expired(uint64_t now) override
+		{
+			log_.push_back(id_);
+		}
+
+	private:
+		std::vector<uint64_t> &log_;
+		uint64_t id_;
+	};
+}
+
+TEST(Archsim_TimerWheel, ExpiresInDeadlineOrder)
+{
+	std::vector<uint64_t> log;
+	TimerWheel wheel;
+	RecordingTimer a (log, 1), b (log, 2), c (log, 3), d (log, 4);
+
+	wheel.Schedule(a, 5000);
+	wheel.Schedule(b, 70);
+	wheel.Schedule(c, 3);
+	wheel.Schedule(d, 1ULL << 40);
+	ASSERT_EQ(3u, wheel.GetNextDeadline());
+
+	// Nothing is due yet
+	wheel.Advance(2);
+	ASSERT_TRUE(log.empty());
+
+	// A long jump expires everything which has passed, in order
+	wheel.Advance(6000);
+	ASSERT_EQ((std::vector<uint64_t> { 3, 2, 1 }), log);
+	ASSERT_FALSE(a.IsScheduled());
+	ASSERT_TRUE(d.IsScheduled());
+	ASSERT_EQ(1ULL << 40, wheel.GetNextDeadline());
+
+	// Cancelled timers never expire, and past deadlines expire at once
+	wheel.Cancel(d);
+	ASSERT_EQ(TimerWheel::kNever, wheel.GetNextDeadline());
+	wheel.Schedule(a, 10);
+	wheel.Advance(6000);
+	ASSERT_EQ((std::vector<uint64_t> { 3, 2, 1, 1 }), log);
+}
+
+TEST(Archsim_TimerWheel, MatchesSortedDeadlines)
+{
+	std::vector<uint64_t> log;
+	TimerWheel wheel (12345);
+	std::mt19937_64 rng (1);
+
+	std::vector<uint64_t> deadlines;
+	std::vector<std::unique_ptr<RecordingTimer>> timers;
+	for(uint64_t i = 0; i < 1000; ++i) {
+		uint64_t deadline = 12345 + (rng() >> (rng() % 50 + 14));
+		timers.emplace_back(new RecordingTimer(log, deadline));
+		wheel.Schedule(*timers.back(), deadline);
+		deadlines.push_back(deadline);
+	}
+	std::sort(deadlines.begin(), deadlines.end());
+
+	// Step from deadline to deadline, as a sleeping timer thread would
+	uint64_t now = 12345;
+	while(wheel.GetNextDeadline() != TimerWheel::kNever) {
+		uint64_t next = wheel.GetNextDeadline();
+		ASSERT_GE(next, now);
+		now = next + rng() % 3;
+		wheel.Advance(now);
+	}
+
+	ASSERT_EQ(deadlines, log);
+}
@@ -0,0 +1,142 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include <gtest/gtest.h>
+
+#include "libtrace/CompressedTraceSink.h"
+#include "libtrace/TraceAnalysis.h"
+
+#include <cstdio>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace libtrace;
+
+namespace
+{
+	// Instructions with a varying number of register reads, so that
+	// segment boundaries fall in the middle of instructions
+	std::vector<TraceRecord> make_trace(size_t instructions)
+	{
+		std::vector<TraceRecord> records;
+		for(size_t i = 0; i < instructions; ++i) {
+			records.push_back(InstructionHeaderRecord(0, i * 4, 0));
+			for(size_t j = 0; j < i % 5; ++j) {
+				records.push_back(RegReadRecord(j, i, 0));
+			}
+		}
+		return records;
+	}
+
+	class CheckVisitor : public TraceAnalysisVisitor
+	{
+	public:
+		CheckVisitor() : first_pc(0), reads(0), bad_reads(0), pc_(0) {}
+
+		void VisitInstructionHeader(const InstructionHeaderReader &record) override
+		{
+			pc_ = record.GetPC().AsU32();
+			if(GetInstructionCount() == 1) first_pc = pc_;
+		}
+		void VisitRegRead(const RegReadReader &record) override
+		{
+			reads++;
+			if(record.GetValue().AsU32() * 4 != pc_) bad_reads++;
+		}
+
+		uint32_t first_pc;
+		uint64_t reads;
+		uint64_t bad_reads;
+
+	private:
+		uint32_t pc_;
+	};
+
+	class CheckAnalysis : public TraceAnalysis
+	{
+	public:
+		CheckAnalysis() : instructions(0), reads(0), bad_reads(0), bad_segments(0) {}
+
+		TraceAnalysisVisitor *CreateVisitor() override
+		{
+			return new CheckVisitor();
+		}
+
+		void Merge(TraceAnalysisVisitor *visitor, const TraceSegmentInfo &segment) override
+		{
+			CheckVisitor *check = (CheckVisitor*)visitor;
+
+			// Segments must be merged in order, and must start at an
+			// instruction header
+			if(segment.first_instruction != instructions) bad_segments++;
+			if(segment.instruction_count && check->first_pc != segment.first_instruction * 4) bad_segments++;
+			if(segment.first_instruction && segment.prev_pc != (segment.first_instruction - 1) * 4) bad_segments++;
+
+			instructions += segment.instruction_count;
+			reads += check->reads;
+			bad_reads += check->bad_reads;
+		}
+
+		uint64_t instructions;
+		uint64_t reads;
+		uint64_t bad_reads;
+		uint64_t bad_segments;
+	};
+
+	void check_analysis(const std::string &filename, size_t instructions, size_t records)
+	{
+		for(unsigned threads : { 1, 3 }) {
+			CheckAnalysis analysis;
+			ASSERT_TRUE(TraceAnalysisRunner(filename, threads).Run(analysis));
+
+			ASSERT_EQ(instructions, analysis.instructions);
+			ASSERT_EQ(records - instructions, analysis.reads);
+			ASSERT_EQ(0U, analysis.bad_reads);
+			ASSERT_EQ(0U, analysis.bad_segments);
+		}
+	}
+}
+
+TEST(Libtrace_TraceAnalysis, RawTrace)
+{
+	char filename[] = "/tmp/archsim-trace-XXXXXX";
+	int fd = mkstemp(filename);
+	ASSERT_NE(-1, fd);
+
+	const size_t instructions = 500000;
+	auto records = make_trace(instructions);
+	ASSERT_GT(records.size(), TraceAnalysisRunner::kSegmentRecords);
+	ASSERT_EQ((ssize_t)(records.size() * sizeof(TraceRecord)), write(fd, records.data(), records.size() * sizeof(TraceRecord)));
+	close(fd);
+
+	check_analysis(filename, instructions, records.size());
+	unlink(filename);
+}
+
+TEST(Libtrace_TraceAnalysis, IndexedTrace)
+{
+	char pattern[] = "/tmp/archsim-trace-XXXXXX";
+	int fd = mkstemp(pattern);
+	ASSERT_NE(-1, fd);
+	close(fd);
+
+	const size_t instructions = 100000;
+	auto records = make_trace(instructions);
+	{
+		CompressedFileTraceSink sink (pattern);
+		int id = sink.Open();
+		sink.SinkPackets(id, records.data(), records.data() + records.size());
+	}
+
+	std::string filename = std::string(pattern) + "0";
+	check_analysis(filename, instructions, records.size());
+
+	unlink(filename.c_str());
+	unlink(pattern);
+}
+
+TEST(Libtrace_TraceAnalysis, MissingFile)
+{
+	CheckAnalysis analysis;
+	ASSERT_FALSE(TraceAnalysisRunner("/nonexistent/trace").Run(analysis));
+}
@@ -0,0 +1,175 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include <gtest/gtest.h>
+
+#include "libtrace/TraceSink.h"
+#include "libtrace/TraceSource.h"
+
+#include <vector>
+
+using namespace libtrace;
+
+namespace
+{
+	class CollectingSink : public TraceSink
+	{
+	public:
+		int Open() override
+		{
+			return 0;
+		}
+		void SinkPackets(int id, const TraceRecord *start, const TraceRecord *end) override
+		{
+			records.insert(records.end(), start, end);
+			sink_calls++;
+		}
+		void Flush() override {}
+
+		std::vector<TraceRecord> records;
+		int sink_calls = 0;
+	};
+
+	// Writes records the same way as generated code does
+	class InlineWriter
+	{
+	public:
+		InlineWriter(TraceSource &source) : source_(source)
+		{
+			source_.BindBuffer(&pos_, &limit_);
+		}
+		~InlineWriter()
+		{
+			source_.UnbindBuffer();
+		}
+
+		void Write(TraceRecordType type, uint16_t data16, uint32_t data32)
+		{
+			if(pos_ + 1 > limit_ && !source_.ReserveRecords(type, 1)) {
+				return;
+			}
+			*pos_++ = TraceRecord(type, data16, data32, 0);
+		}
+
+	private:
+		TraceSource &source_;
+		TraceRecord *pos_;
+		TraceRecord *limit_;
+	};
+
+	void write_instruction(InlineWriter &writer, uint32_t pc)
+	{
+		writer.Write(InstructionHeader, 0, pc);
+		writer.Write(InstructionCode, 0, 0);
+		writer.Write(RegWrite, 1, pc + 1);
+	}
+}
+
+TEST(Libtrace_TraceBuffer, InlineRecords)
+{
+	CollectingSink sink;
+	TraceSource source (1024);
+	source.SetSink(&sink);
+	source.SetAggressiveFlush(false);
+
+	{
+		InlineWriter writer (source);
+		for(uint32_t i = 0; i < 1000; ++i) {
+			write_instruction(writer, i * 4);
+		}
+	}
+	source.EmitPackets();
+
+	ASSERT_EQ(3000u, sink.records.size());
+	ASSERT_EQ(InstructionHeader, sink.records[3 * 999].GetType());
+	ASSERT_EQ(999u * 4, sink.records[3 * 999].GetData32());
+	ASSERT_EQ(999u * 4 + 1, sink.records[3 * 999 + 2].GetData32());
+
+	// The buffer is only flushed when it fills up
+	ASSERT_EQ((int)(3000 / TraceSource::PacketBufferSize + 1), sink.sink_calls);
+
+	source.Terminate();
+}
+
+TEST(Libtrace_TraceBuffer, SkipInstructions)
+{
+	CollectingSink sink;
+	TraceSource source (1024);
+	source.SetSink(&sink);
+	source.SetAggressiveFlush(false);
+	source.SetInstructionSkip(2);
+
+	{
+		InlineWriter writer (source);
+		for(uint32_t i = 0; i < 4; ++i) {
+			write_instruction(writer, i * 4);
+		}
+	}
+	source.EmitPackets();
+
+	ASSERT_EQ(6u, sink.records.size());
+	ASSERT_EQ(InstructionHeader, sink.records[0].GetType());
+	ASSERT_EQ(8u, sink.records[0].GetData32());
+	ASSERT_EQ(RegWrite, sink.records[2].GetType());
+	ASSERT_EQ(9u, sink.records[2].GetData32());
+	ASSERT_EQ(12u, sink.records[3].GetData32());
+
+	source.Terminate();
+}
+
+TEST(Libtrace_TraceBuffer, AggressiveFlush)
+{
+	CollectingSink sink;
+	TraceSource source (1024);
+	source.SetSink(&sink);
+	source.SetAggressiveFlush(true);
+
+	{
+		InlineWriter writer (source);
+		write_instruction(writer, 0);
+		write_instruction(writer, 4);
+	}
+	source.EmitPackets();
+
+	// Every record goes through the trace source, which flushes the
+	// records written before it
+	ASSERT_EQ(6u, sink.records.size());
+	ASSERT_EQ(7, sink.sink_calls);
+
+	source.Terminate();
+}
+
+TEST(Libtrace_TraceBuffer, InstructionLimit)
+{
+	CollectingSink sink;
+	TraceSource source (1024);
+	source.SetSink(&sink);
+	source.SetAggressiveFlush(false);
+	source.SetInstructionSkip(1);
+	source.SetInstructionLimit(2);
+
+	bool stopped = false;
+	source.SetStopHandler([&]() {
+		stopped = true;
+	});
+
+	{
+		InlineWriter writer (source);
+		for(uint32_t i = 0; i < 4; ++i) {
+			write_instruction(writer, i * 4);
+		}
+		source.EmitPackets();
+		ASSERT_TRUE(stopped);
+		ASSERT_TRUE(source.IsStopped());
+
+		// Nothing is written once tracing has stopped
+		write_instruction(writer, 16);
+	}
+	source.EmitPackets();
+
+	ASSERT_EQ(6u, sink.records.size());
+	ASSERT_EQ(4u, sink.records[0].GetData32());
+	ASSERT_EQ(8u, sink.records[3].GetData32());
+	ASSERT_EQ(9u, sink.records[5].GetData32());
+
+	source.Terminate();
+}
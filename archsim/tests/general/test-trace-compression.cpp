@@ -0,0 +1,203 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include <gtest/gtest.h>
+
+#include "libtrace/CompressedTraceSink.h"
+#include "libtrace/RecordFile.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace libtrace;
+
+namespace
+{
+	std::vector<TraceRecord> make_records(size_t count, uint32_t seed)
+	{
+		std::vector<TraceRecord> records;
+		for(size_t i = 0; i < count; ++i) {
+			records.push_back(TraceRecord(InstructionHeader, seed, i * 4, 0));
+		}
+		return records;
+	}
+
+	void check_file(const std::string &filename, const std::vector<TraceRecord> &expected, bool compressed)
+	{
+		FILE *f = fopen(filename.c_str(), "r");
+		ASSERT_NE(nullptr, f);
+
+		{
+			RecordFile file (f);
+			ASSERT_EQ(compressed, file.IsCompressed());
+			ASSERT_EQ(expected.size(), file.Size());
+
+			uint64_t i = 0;
+			for(auto it = file.begin(); it != file.end(); ++it, ++i) {
+				TraceRecord record = *it;
+				ASSERT_EQ(expected[i].GetHeader(), record.GetHeader());
+				ASSERT_EQ(expected[i].GetData(), record.GetData());
+			}
+
+			// Jump back into an earlier chunk
+			Record r;
+			ASSERT_TRUE(file.Get(7, r));
+			ASSERT_EQ(expected[7].GetData(), r.GetData());
+		}
+
+		fclose(f);
+	}
+}
+
+TEST(Libtrace_CompressedSink, RoundTrip)
+{
+	char pattern[] = "/tmp/archsim-trace-XXXXXX";
+	int fd = mkstemp(pattern);
+	ASSERT_NE(-1, fd);
+	close(fd);
+
+	// Enough records for several full chunks, and a partial one
+	auto records0 = make_records(CompressedFileTraceSink::kChunkRecords * 3 + 123, 0);
+	auto records1 = make_records(1000, 1);
+
+	{
+		CompressedFileTraceSink sink (pattern);
+		int id0 = sink.Open();
+		int id1 = sink.Open();
+
+		for(size_t i = 0; i < records0.size(); i += 1024) {
+			size_t end = std::min(records0.size(), i + 1024);
+			sink.SinkPackets(id0, records0.data() + i, records0.data() + end);
+
+			if(i < records1.size()) {
+				sink.SinkPackets(id1, records1.data() + i, records1.data() + std::min(records1.size(), i + 1024));
+			}
+		}
+
+		sink.Flush();
+
+		auto stats = sink.GetStatistics();
+		ASSERT_EQ(records0.size() + records1.size(), stats.records);
+		ASSERT_LT(stats.compressed_bytes, stats.uncompressed_bytes);
+	}
+
+	check_file(std::string(pattern) + "0", records0, true);
+	check_file(std::string(pattern) + "1", records1, true);
+
+	unlink((std::string(pattern) + "0").c_str());
+	unlink((std::string(pattern) + "1").c_str());
+	unlink(pattern);
+}
+
+TEST(Libtrace_CompressedSink, RawFilesStillReadable)
+{
+	char pattern[] = "/tmp/archsim-trace-XXXXXX";
+	int fd = mkstemp(pattern);
+	ASSERT_NE(-1, fd);
+
+	auto records = make_records(300000, 2);
+	ASSERT_EQ((ssize_t)(records.size() * sizeof(TraceRecord)), write(fd, records.data(), records.size() * sizeof(TraceRecord)));
+	close(fd);
+
+	check_file(pattern, records, false);
+	unlink(pattern);
+}
+
+namespace
+{
+	// Each instruction is a header followed by a register write. The PC
+	// moves to a new page every 4096 instructions.
+	std::vector<TraceRecord> make_instructions(size_t count)
+	{
+		std::vector<TraceRecord> records;
+		for(size_t i = 0; i < count; ++i) {
+			uint32_t pc = 0x10000 + (i / 4096) * 0x1000 + (i % 4096);
+			records.push_back(InstructionHeaderRecord(0, pc, 0));
+			records.push_back(RegWriteRecord(1, i, 0));
+		}
+		return records;
+	}
+
+	void check_seek(RecordFile &file, size_t instructions)
+	{
+		ASSERT_EQ(instructions, file.InstructionCount());
+
+		const size_t targets[] = { 0, 1, 4095, 4096, 70000, instructions - 1 };
+		for(auto target : targets) {
+			uint64_t idx;
+			ASSERT_TRUE(file.FindInstruction(target, idx));
+			ASSERT_EQ(target * 2, idx);
+		}
+
+		uint64_t idx;
+		ASSERT_FALSE(file.FindInstruction(instructions, idx));
+
+		// The first page is only executed by the first chunk
+		size_t matching_chunks = 0;
+		for(size_t i = 0; i < file.ChunkCount(); ++i) {
+			if(file.GetChunk(i).MayContainPC(0x10004)) {
+				matching_chunks++;
+			}
+		}
+		ASSERT_EQ(1U, matching_chunks);
+		ASSERT_TRUE(file.GetChunk(0).MayContainPC(0x10004));
+	}
+}
+
+TEST(Libtrace_CompressedSink, IndexedSeek)
+{
+	char pattern[] = "/tmp/archsim-trace-XXXXXX";
+	int fd = mkstemp(pattern);
+	ASSERT_NE(-1, fd);
+	close(fd);
+
+	const size_t instructions = CompressedFileTraceSink::kChunkRecords * 2 + 5;
+	auto records = make_instructions(instructions);
+
+	{
+		CompressedFileTraceSink sink (pattern);
+		int id = sink.Open();
+		sink.SinkPackets(id, records.data(), records.data() + records.size());
+	}
+
+	std::string filename = std::string(pattern) + "0";
+	FILE *f = fopen(filename.c_str(), "r");
+	ASSERT_NE(nullptr, f);
+
+	{
+		RecordFile file (f);
+		ASSERT_TRUE(file.HasIndex());
+		ASSERT_EQ(records.size(), file.Size());
+		check_seek(file, instructions);
+	}
+
+	fclose(f);
+	unlink(filename.c_str());
+	unlink(pattern);
+}
+
+TEST(Libtrace_CompressedSink, RawFileSeek)
+{
+	char pattern[] = "/tmp/archsim-trace-XXXXXX";
+	int fd = mkstemp(pattern);
+	ASSERT_NE(-1, fd);
+
+	const size_t instructions = 150000;
+	auto records = make_instructions(instructions);
+	ASSERT_EQ((ssize_t)(records.size() * sizeof(TraceRecord)), write(fd, records.data(), records.size() * sizeof(TraceRecord)));
+	close(fd);
+
+	FILE *f = fopen(pattern, "r");
+	ASSERT_NE(nullptr, f);
+
+	{
+		RecordFile file (f);
+		ASSERT_FALSE(file.HasIndex());
+		check_seek(file, instructions);
+	}
+
+	fclose(f);
+	unlink(pattern);
+}
@@ -0,0 +1,105 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include <gtest/gtest.h>
+
+#include "abi/EmulationModel.h"
+#include "arch/risc-v/RiscVMMU.h"
+#include "core/arch/ArchDescriptor.h"
+#include "core/thread/ThreadInstance.h"
+#include "core/thread/TraceFilter.h"
+#include "session.h"
+#include "system.h"
+#include "uarch/uArch.h"
+#include "util/SimOptions.h"
+
+using archsim::Address;
+using archsim::core::thread::ThreadInstance;
+using archsim::core::thread::TraceFilter;
+
+static archsim::ArchDescriptor GetArch()
+{
+	archsim::ISABehavioursDescriptor behaviours({});
+	archsim::ISADescriptor isa("isa", 0, [](archsim::Address addr, archsim::MemoryInterface *, gensim::BaseDecode&) {
+		UNIMPLEMENTED;
+		return 0u;
+	}, nullptr, []()->gensim::BaseDecode* { UNIMPLEMENTED; }, []()->gensim::BaseJumpInfoProvider* { UNIMPLEMENTED; }, []()->gensim::DecodeTranslateContext* { UNIMPLEMENTED; }, behaviours);
+	archsim::FeaturesDescriptor f({});
+	archsim::MemoryInterfacesDescriptor mem({ archsim::MemoryInterfaceDescriptor("Mem", 8, 8, false, 0) }, "Mem");
+	archsim::RegisterFileDescriptor rf(128, { archsim::RegisterFileEntryDescriptor("PC", 0, 0, 1, 8, 1, 8, 8, "PC") });
+	archsim::ArchDescriptor arch ("test_arch", rf, mem, f, {isa});
+
+	return arch;
+}
+
+class TraceFilterEmulationModel : public archsim::abi::EmulationModel
+{
+public:
+	void HaltCores() override {}
+	gensim::DecodeContext *GetNewDecodeContext(ThreadInstance &cpu) override
+	{
+		return nullptr;
+	}
+	bool PrepareBoot(System &system) override
+	{
+		return true;
+	}
+	archsim::abi::ExceptionAction HandleException(ThreadInstance *thread, uint64_t category, uint64_t data) override
+	{
+		return archsim::abi::AbortSimulation;
+	}
+	void PrintStatistics(std::ostream &stream) override {}
+};
+
+class Archsim_TraceFilter : public ::testing::Test
+{
+public:
+	Archsim_TraceFilter() : MemoryModel(archsim::options::MemoryModel) {}
+
+	void TearDown() override
+	{
+		archsim::options::MemoryModel = MemoryModel;
+	}
+
+	archsim::SimOption<std::string> MemoryModel;
+};
+
+TEST_F(Archsim_TraceFilter, FollowsASIDSwitch)
+{
+	archsim::options::MemoryModel.SetValue("sparse");
+
+	archsim::Session session;
+	System system (session);
+	archsim::uarch::uArch uarch;
+	TraceFilterEmulationModel model;
+	ASSERT_TRUE(model.Initialise(system, uarch));
+
+	auto arch = GetArch();
+	ThreadInstance thread (system.GetPubSub(), arch, model);
+
+	archsim::arch::riscv::RiscVMMU mmu;
+	ASSERT_TRUE(thread.GetPeripherals().RegisterDevice("mmu", &mmu));
+	ASSERT_TRUE(thread.GetPeripherals().InitialiseDevices());
+
+	TraceFilter filter (thread);
+	filter.AddASID(5);
+	filter.Update();
+
+	Address pc (0x1000);
+	ASSERT_FALSE(filter.ShouldTrace(pc));
+
+	// Switch to the traced address space by writing satp (Sv39, ASID 5)
+	uint64_t satp = (uint64_t)8 << 60 | (uint64_t)5 << 44 | 0x80;
+	mmu.SetSATP(satp);
+	ASSERT_EQ(5u, mmu.GetASID());
+	ASSERT_EQ(satp, mmu.GetSATP());
+	ASSERT_TRUE(filter.ShouldTrace(pc));
+	ASSERT_EQ(1u, thread.GetFeatures().GetFeatureLevel(filter.GetActiveFeature()));
+
+	// And away from it again
+	mmu.SetSATP((uint64_t)8 << 60 | (uint64_t)6 << 44 | 0x80);
+	ASSERT_EQ(6u, mmu.GetASID());
+	ASSERT_FALSE(filter.ShouldTrace(pc));
+	ASSERT_EQ(0u, thread.GetFeatures().GetFeatureLevel(filter.GetActiveFeature()));
+
+	model.Destroy();
+}
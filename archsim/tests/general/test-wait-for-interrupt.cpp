@@ -0,0 +1,81 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include <gtest/gtest.h>
+
+#include "abi/EmulationModel.h"
+#include "abi/devices/IRQController.h"
+#include "core/arch/ArchDescriptor.h"
+#include "core/thread/ThreadInstance.h"
+#include "util/PubSubSync.h"
+
+#include <chrono>
+#include <future>
+
+using archsim::core::thread::ThreadInstance;
+using archsim::core::thread::ThreadMessage;
+
+static archsim::ArchDescriptor GetArch()
+{
+	archsim::ISABehavioursDescriptor behaviours({});
+	archsim::ISADescriptor isa("isa", 0, [](archsim::Address addr, archsim::MemoryInterface *, gensim::BaseDecode&) {
+		UNIMPLEMENTED;
+		return 0u;
+	}, nullptr, []()->gensim::BaseDecode* { UNIMPLEMENTED; }, []()->gensim::BaseJumpInfoProvider* { UNIMPLEMENTED; }, []()->gensim::DecodeTranslateContext* { UNIMPLEMENTED; }, behaviours);
+	archsim::FeaturesDescriptor f({});
+	archsim::MemoryInterfacesDescriptor mem({ archsim::MemoryInterfaceDescriptor("Mem", 4, 4, false, 0) }, "Mem");
+	archsim::RegisterFileDescriptor rf(128, { archsim::RegisterFileEntryDescriptor("PC", 0, 0, 1, 4, 1, 4, 4, "PC") });
+	archsim::ArchDescriptor arch ("test_arch", rf, mem, f, {isa});
+
+	return arch;
+}
+
+// Behaves as though another thread is still running, so that a thread
+// waiting for an interrupt goes to sleep, and as though the guest has
+// interrupts masked, so that interrupts are never taken.
+class MaskedEmulationModel : public archsim::abi::EmulationModel
+{
+public:
+	void HaltCores() override {}
+	gensim::DecodeContext *GetNewDecodeContext(ThreadInstance &cpu) override
+	{
+		return nullptr;
+	}
+	bool PrepareBoot(System &system) override
+	{
+		return true;
+	}
+	archsim::abi::ExceptionAction HandleException(ThreadInstance *thread, uint64_t category, uint64_t data) override
+	{
+		return archsim::abi::AbortSimulation;
+	}
+	void HandleInterrupt(ThreadInstance *thread, archsim::abi::devices::CPUIRQLine *irq) override {}
+	bool SetThreadIdle(ThreadInstance *thread, bool idle) override
+	{
+		return idle;
+	}
+	void PrintStatistics(std::ostream &stream) override {}
+};
+
+TEST(Archsim_WaitForInterrupt, WakesForMaskedIRQ)
+{
+	archsim::util::PubSubContext pubsub;
+	auto arch = GetArch();
+	MaskedEmulationModel model;
+	ThreadInstance thread (pubsub, arch, model);
+
+	// The interrupt message is consumed while the guest has interrupts
+	// masked, which leaves the line asserted
+	thread.GetIRQLine(0)->Assert();
+	ASSERT_TRUE(thread.HasMessage());
+	thread.HandleMessage();
+	ASSERT_FALSE(thread.HasMessage());
+
+	auto wfi = std::async(std::launch::async, [&thread] { thread.WaitForInterrupt(); });
+	bool woke = wfi.wait_for(std::chrono::seconds(5)) == std::future_status::ready;
+	if(!woke) {
+		thread.SendMessage(ThreadMessage::Nop);
+	}
+	wfi.wait();
+
+	ASSERT_TRUE(woke);
+}
@@ -27,6 +27,7 @@ namespace gensim
 			~InterpEEGenerator();
 		private:
 			bool GenerateBlockExecutor(util::cppformatstream &str) const;
+			bool GeneratePredecodedBlockExecutor(util::cppformatstream &str) const;
 
 			bool GenerateDecodeInstruction(util::cppformatstream &str) const;
 			bool GenerateHelperFunctions(util::cppformatstream &str) const;
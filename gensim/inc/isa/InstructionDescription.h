@@ -75,6 +75,11 @@ namespace gensim
 			std::list<std::vector<DecodeConstraint> > EOB_Contraints;
 
 			std::list<std::vector<DecodeConstraint> > Uses_PC_Constraints;
+
+			// Hints for return address prediction: the jump is a call (it
+			// will return to the next instruction) or a return
+			std::list<std::vector<DecodeConstraint> > Call_Constraints;
+			std::list<std::vector<DecodeConstraint> > Return_Constraints;
 			std::vector<uint32_t> Specialisations;
 
 			std::list<AsmDescription*> Disasms;
@@ -1022,6 +1022,9 @@ namespace gensim
 //							output << "UNIMPLEMENTED; // pendirq\n";
 							output << "builder.call(IROperand::const32(0), IROperand::func((void*)cpuPendInterrupt));";
 							break;
+						case IntrinsicID::WaitForInterrupt:
+							output << "builder.call(IROperand::const32(0), IROperand::func((void*)cpuWaitForInterrupt));";
+							break;
 						case IntrinsicID::PopInterrupt:
 							// XXX TODO FIXME
 							output << "builder.trap();";
@@ -1233,7 +1236,8 @@ namespace gensim
 					output << "builder.ldmem(IROperand::const32(" << Statement.GetInterface()->GetID() << ")," << operand_for_node(*address) << ", IROperand::const32(0), " << operand_for_symbol(*Statement.Target()) << ");\n";
 
 					output << "if(trace) {";
-					output << "builder.call(IROperand::const32(0), IROperand::func((void*)cpuTraceOnlyMemRead" << (uint32_t)(8*Statement.Width) << "), " << operand_for_node(*address) << ", " << operand_for_symbol(*Statement.Target()) << ");";
+					output << "builder.trace(libtrace::MemReadAddr, " << (uint32_t)Statement.Width << ", " << operand_for_node(*address) << ");";
+					output << "builder.trace(libtrace::MemReadData, " << (uint32_t)Statement.Width << ", " << operand_for_symbol(*Statement.Target()) << ");";
 					output << "}";
 
 					return true;
@@ -1268,8 +1272,10 @@ namespace gensim
 //						output << "builder.stmem_user(" << operand_for_node(*value) << ", " << operand_for_node(*address) << ");\n";
 //					} else {
 					output << "builder.stmem(IROperand::const32(" << Statement.GetInterface()->GetID() << "), " << operand_for_node(*value) << ", IROperand::const32(0), " << operand_for_node(*address) << ");\n";
-					output << "if(trace)";
-					output << "builder.call(IROperand::const32(0), IROperand::func((void*)cpuTraceOnlyMemWrite" << (uint32_t)(8*Statement.Width) << "), " << operand_for_node(*address) << ", " << operand_for_node(*value) << ");";
+					output << "if(trace) {";
+					output << "builder.trace(libtrace::MemWriteAddr, " << (uint32_t)Statement.Width << ", " << operand_for_node(*address) << ");";
+					output << "builder.trace(libtrace::MemWriteData, " << (uint32_t)Statement.Width << ", " << operand_for_node(*value) << ");";
+					output << "}";
 //					}
 
 					return true;
@@ -1371,16 +1377,7 @@ namespace gensim
 						       << ");\n";
 
 						if(register_width <= 8) {
-							output << "if(trace) {";
-							output << "IRRegId tmp = builder.alloc_reg(8);\n";
-							if(Value->Statement.GetType().SizeInBytes() < 8) {
-								output << "builder.zx(" << operand_for_node(*Value) << ", IROperand::vreg(tmp, 8));";
-							} else {
-								output << "builder.mov(" << operand_for_node(*Value) << ", IROperand::vreg(tmp, 8));";
-							}
-
-							output << "builder.call(IROperand::const32(0), IROperand::func((void*)cpuTraceRegBankWrite), IROperand::const8(" << (uint32_t)write.Bank << "), IROperand::const8(" << RegNum->GetFixedValue() << "), IROperand::vreg(tmp,8));";
-							output << "}";
+							output << "if(trace) builder.trace(libtrace::BankRegWrite, " << (((uint32_t)write.Bank << 8) | (uint8_t)RegNum->GetFixedValue()) << ", " << operand_for_node(*Value) << ");";
 						}
 						return true;
 					} else {
@@ -1393,7 +1390,7 @@ namespace gensim
 
 						output << "builder.streg(" << operand_for_node(*Value) << ", IROperand::vreg(tmp, 8));\n";
 						if(register_width <= 8) {
-							output << "if(trace) builder.call(IROperand::const32(0), IROperand::func((void*)cpuTraceRegBankWrite), IROperand::const8(" << (uint32_t)write.Bank << "), " << operand_for_node(*RegNum) << ", " << operand_for_node(*Value) << ");";
+							output << "if(trace) builder.trace(libtrace::BankRegWrite, " << ((uint32_t)write.Bank << 8) << ", " << operand_for_node(*RegNum) << ", " << operand_for_node(*Value) << ");";
 						}
 						output << "}";
 					}
@@ -1414,7 +1411,9 @@ namespace gensim
 
 					if (write.RegNum()->IsFixed()) {
 						output << "builder.ldreg(IROperand::const32((uint32_t)(" << offset << " + (" << register_stride << " * " << RegNum->GetFixedValue() << "))), " << operand_for_stmt(Statement) << ");\n";
-						output << "if(trace) builder.call(IROperand::const32(0), IROperand::func((void*)cpuTraceRegBankRead), IROperand::const8(" << (uint32_t)write.Bank << "), IROperand::const8(" << RegNum->GetFixedValue() << "), " << operand_for_stmt(Statement) << ");";
+						if(register_width <= 8) {
+							output << "if(trace) builder.trace(libtrace::BankRegRead, " << (((uint32_t)write.Bank << 8) | (uint8_t)RegNum->GetFixedValue()) << ", " << operand_for_stmt(Statement) << ");";
+						}
 						return true;
 					} else {
 						output << "{";
@@ -1426,10 +1425,9 @@ namespace gensim
 
 						output << "builder.ldreg(IROperand::vreg(tmp, 4), " << operand_for_stmt(Statement) << ");";
 
-						output <<
-						       "if(trace) {"
-						       "  builder.call(IROperand::const32(0), IROperand::func((void*)cpuTraceRegBankRead), IROperand::const8(" << (uint32_t)write.Bank << ")," << operand_for_node(*RegNum) << ", " << operand_for_stmt(Statement) << ");"
-						       "}";
+						if(register_width <= 8) {
+							output << "if(trace) builder.trace(libtrace::BankRegRead, " << ((uint32_t)write.Bank << 8) << ", " << operand_for_node(*RegNum) << ", " << operand_for_stmt(Statement) << ");";
+						}
 
 						output << "}";
 					}
@@ -1450,22 +1448,14 @@ namespace gensim
 						output << "IRRegId tmp = builder.alloc_reg(" << register_width << ");";
 						output << "builder.trunc(" << operand_for_node(*Value) << ", IROperand::vreg(tmp, " << register_width << "));";
 						output << "builder.streg(IROperand::vreg(tmp, " << register_width << "), IROperand::const32(" << offset << "));";
-						output << "if(trace) builder.call(IROperand::const32(0), IROperand::func((void*)cpuTraceRegWrite), IROperand::const8(" << (uint32_t)write.Bank << "), IROperand::vreg(tmp, " << register_width << "));";
+						output << "if(trace) builder.trace(libtrace::RegWrite, " << (uint32_t)write.Bank << ", IROperand::vreg(tmp, " << register_width << "));";
 						output << "}";
 					} else if (Value->Statement.GetType().SizeInBytes() < register_width) {
 						assert(false);
 					} else {
 						output << "builder.streg(" << operand_for_node(*Value) << ", IROperand::const32(" << offset << "));";
 
-						output << "if(trace) {";
-						if(register_width < 8) {
-							output << "  IRRegId tmp = builder.alloc_reg(8);";
-							output << "  builder.zx(" << operand_for_node(*Value) << ", IROperand::vreg(tmp, 8));";
-							output << "  builder.call(IROperand::const32(0), IROperand::func((void*)cpuTraceRegWrite), IROperand::const8(" << (uint32_t)write.Bank << "), IROperand::vreg(tmp, 8));";
-						} else {
-							output << "  builder.call(IROperand::const32(0), IROperand::func((void*)cpuTraceRegWrite), IROperand::const8(" << (uint32_t)write.Bank << ")," << operand_for_node(*Value) << ");";
-						}
-						output << "}";
+						output << "if(trace) builder.trace(libtrace::RegWrite, " << (uint32_t)write.Bank << ", " << operand_for_node(*Value) << ");";
 
 					}
 
@@ -1481,16 +1471,7 @@ namespace gensim
 					output << "IRRegId " << Statement.GetName() << " = builder.alloc_reg(" << register_width << ");\n";
 					output << "builder.ldreg(IROperand::const32(" << offset << "), " << operand_for_stmt(Statement) << ");";
 
-					output << "if(trace) {";
-					if(register_width < 8) {
-						output << "  IRRegId tmp = builder.alloc_reg(8);";
-						output << "  builder.zx(IROperand::vreg(" << Statement.GetName() << ", " << register_width << "), IROperand::vreg(tmp, 8));";
-						output << "  builder.call(IROperand::const32(0), IROperand::func((void*)cpuTraceRegRead), IROperand::const8(" << (uint32_t)write.Bank << "), IROperand::vreg(tmp, 8));";
-					} else {
-						output << "  builder.call(IROperand::const32(0), IROperand::func((void*)cpuTraceRegRead), IROperand::const8(" << (uint32_t)write.Bank << "), IROperand::vreg(" << Statement.GetName() << ", 8));";
-					}
-
-					output << "}";
+					output << "if(trace) builder.trace(libtrace::RegRead, " << (uint32_t)write.Bank << ", " << operand_for_stmt(Statement) << ");";
 
 					return true;
 				}
@@ -71,7 +71,7 @@ bool BlockJITExecutionEngineGenerator::GenerateSource(util::cppformatstream& str
 	JitGenerator jitgen (Manager);
 	jitgen.GenerateTranslation(str);
 
-	str << "BlockJITEE::BlockJITEE() : archsim::core::execution::BlockJITExecutionEngine(new captive::arch::" << Manager.GetArch().Name << "::JIT) {}";
+	str << "BlockJITEE::BlockJITEE() : archsim::core::execution::BlockJITExecutionEngine([]() -> gensim::blockjit::BaseBlockJITTranslate* { return new captive::arch::" << Manager.GetArch().Name << "::JIT(); }) {}";
 
 
 
@@ -47,6 +47,8 @@ bool InterpEEGenerator::GenerateHeader(util::cppformatstream &str) const
 	    "	using decode_t = gensim::" << Manager.GetArch().Name << "::Decode;"
 	    "private:"
 	    "	gensim::DecodeContext *decode_context_;"
+	    "  archsim::core::execution::ExecutionResult StepBlockDecode(archsim::core::execution::InterpreterExecutionEngineThreadContext *thread_ctx);"
+	    "  archsim::core::execution::ExecutionResult StepPredecodedBlock(archsim::core::execution::InterpreterExecutionEngineThreadContext *thread_ctx);"
 	    "  uint32_t DecodeInstruction(archsim::core::execution::InterpreterExecutionEngineThreadContext *thread_ctx, decode_t *&inst);"
 	    "  archsim::core::execution::ExecutionResult StepInstruction(archsim::core::thread::ThreadInstance *thread, decode_t &inst);"
 
@@ -75,6 +77,8 @@ bool InterpEEGenerator::GenerateSource(util::cppformatstream &str) const
 	    "#include <gensim/gensim_processor_api.h>\n"
 	    "#include <abi/devices/Device.h>\n"
 	    "#include <gensim/gensim_decode_context.h>\n"
+	    "#include <abi/EmulationModel.h>\n"
+	    "#include <system.h>\n"
 	    "#include <cmath>\n"
 	    ;
 
@@ -82,13 +86,21 @@ bool InterpEEGenerator::GenerateSource(util::cppformatstream &str) const
 
 	GenerateDecodeInstruction(str);
 
+	// Pre-decoded blocks are used unless the instruction by instruction
+	// behaviour of the decoding interpreter is needed
 	str << "archsim::core::execution::ExecutionResult Interpreter::StepBlock(archsim::core::execution::InterpreterExecutionEngineThreadContext *thread_ctx) { ";
+	str << "if(archsim::options::Trace || archsim::options::Verbose || archsim::options::InstructionTick || archsim::options::AggressiveCodeInvalidation) { return StepBlockDecode(thread_ctx); }";
+	str << "return StepPredecodedBlock(thread_ctx);";
+	str << "}";
+
+	str << "archsim::core::execution::ExecutionResult Interpreter::StepBlockDecode(archsim::core::execution::InterpreterExecutionEngineThreadContext *thread_ctx) { ";
 	str << "auto thread = thread_ctx->GetThread();";
 	GenerateBlockExecutor(str);
 	str << "}";
 
 	GenerateHelperFunctions(str);
 	GenerateStepInstruction(str);
+	GeneratePredecodedBlockExecutor(str);
 
 	GenerateBehavioursDescriptors(str);
 
@@ -181,6 +193,93 @@ bool InterpEEGenerator::GenerateBlockExecutor(util::cppformatstream& str) const
 	return true;
 }
 
+bool InterpEEGenerator::GeneratePredecodedBlockExecutor(util::cppformatstream& str) const
+{
+	// Each instruction in a block is bound to a label in this function, and
+	// instructions are dispatched with computed gotos
+	str << "archsim::core::execution::ExecutionResult Interpreter::StepPredecodedBlock(archsim::core::execution::InterpreterExecutionEngineThreadContext *thread_ctx) { ";
+	str << "auto thread = thread_ctx->GetThread();";
+	str << "auto &cache = thread_ctx->GetPredecodedBlocks();";
+	str << "gensim::" << Manager.GetArch().Name << "::ArchInterface interface(thread);";
+	str << "cache.Collect();";
+
+	str << "archsim::Address virt_pc (interface.read_pc());";
+	str << "archsim::Address phys_pc (0);";
+	// The decoding interpreter raises any fetch fault
+	str << "if(thread->GetFetchMI().PerformTranslation(virt_pc, phys_pc, false, true, false) != archsim::TranslationResult::OK) { return StepBlockDecode(thread_ctx); }";
+
+	str << "uint32_t isa_mode = thread->GetModeID();";
+	str << "auto block = cache.Lookup(phys_pc, isa_mode);";
+	str << "if(block == nullptr) {";
+	str << "  block = cache.Insert(phys_pc, isa_mode);";
+	// Mark the page as code before decoding it, so that any write to it from
+	// now on invalidates the block
+	str << "  thread->GetEmulationModel().GetSystem().GetCodeRegions().MarkRegionAsCode(archsim::PhysicalAddress(phys_pc.PageBase().Get()));";
+	str << "  archsim::Address pc = virt_pc;";
+	str << "  while(block->Instructions.size() < archsim::interpret::PredecodedBlockCache::kMaxBlockInstructions) {";
+	str << "    gensim::BaseDecode *decode = nullptr;";
+	str << "    if(thread_ctx->GetDC()->DecodeSync(thread->GetFetchMI(), pc, isa_mode, decode) || pc.GetPageOffset() + decode->Instr_Length > archsim::Address::PageSize) { if(decode != nullptr) { decode->Release(); } break; }";
+	str << "    const void *handler = nullptr;";
+	str << "    switch(isa_mode) {";
+	for(auto isa : Manager.GetArch().ISAs) {
+		str << "case " << isa->isa_mode_id << ": switch(decode->Instr_Code) {";
+		for(auto i : isa->Instructions) {
+			str << "case INST_" << isa->ISAName << "_" << i.second->Name << ": handler = &&insn_" << isa->ISAName << "_" << i.first << "; break;";
+		}
+		str << "} break;";
+	}
+	str << "    }";
+	str << "    if(handler == nullptr) { decode->Release(); break; }";
+	str << "    block->Instructions.push_back({handler, decode});";
+	str << "    if(decode->GetEndOfBlock()) { break; }";
+	str << "    pc += decode->Instr_Length;";
+	str << "  }";
+	str << "  block->Instructions.push_back({&&block_exit, nullptr});";
+	str << "}";
+
+	// Blocks which start with an instruction which can't be pre-decoded
+	// are left to the decoding interpreter
+	str << "if(block->Instructions.size() == 1) { return StepBlockDecode(thread_ctx); }";
+
+	str << "auto insn = block->Instructions.data();";
+	str << "archsim::core::execution::ExecutionResult result = archsim::core::execution::ExecutionResult::Continue;";
+	str << "if(thread->HasMessage()) { return thread->HandleMessage(); }";
+	str << "goto *insn->Handler;";
+
+	for(auto isa : Manager.GetArch().ISAs) {
+		bool predicated = isa->GetSSAContext().HasAction("instruction_is_predicated") && isa->GetSSAContext().HasAction("instruction_predicate");
+
+		for(auto i : isa->Instructions) {
+			str << "insn_" << isa->ISAName << "_" << i.first << ": {";
+			str << "  auto &decode = *(decode_t*)insn->Decode;";
+			if(predicated) {
+				str << "  bool should_execute = !" << isa->ISAName << "_is_predicated(thread, decode) || " << isa->ISAName << "_check_predicate(thread, decode);";
+			} else {
+				str << "  bool should_execute = true;";
+			}
+			str << "  if(should_execute) { result = StepInstruction_" << isa->ISAName << "_" << i.first << "<false>(thread, decode); }";
+			str << "  if(!decode.GetEndOfBlock() || !should_execute) { interface.write_pc(interface.read_pc() + decode.Instr_Length); }";
+			str << "  if(decode.GetEndOfBlock()) { return archsim::core::execution::ExecutionResult::Continue; }";
+			str << "  goto next_insn;";
+			str << "}";
+		}
+	}
+
+	str << "next_insn:";
+	str << "if(result != archsim::core::execution::ExecutionResult::Continue) { return result; }";
+	str << "++insn;";
+	str << "if(thread->HasMessage()) { return thread->HandleMessage(); }";
+	// Stop as soon as the block's code has been modified
+	str << "if(cache.IsInvalidated()) { return archsim::core::execution::ExecutionResult::Continue; }";
+	str << "goto *insn->Handler;";
+
+	str << "block_exit:";
+	str << "return archsim::core::execution::ExecutionResult::Continue;";
+	str << "}";
+
+	return true;
+}
+
 bool InterpEEGenerator::GenerateStepInstruction(util::cppformatstream& str) const
 {
 	for(auto i : Manager.GetArch().ISAs) {
@@ -195,10 +294,11 @@ bool InterpEEGenerator::GenerateStepInstruction(util::cppformatstream& str) cons
 	str << "if(archsim::options::ProfileIrFreq) {thread->GetMetrics().InstructionIRHistogram.inc(inst.ir);}";
 	str << "thread->GetMetrics().InstructionCount++;";
 	str << "}";
+	str << "bool trace = archsim::options::Trace && (thread->GetTraceFilter() == nullptr || thread->GetTraceFilter()->ShouldTrace(thread->GetPC()));";
 	str << "switch(thread->GetModeID()) {";
 
 	for(auto i : Manager.GetArch().ISAs) {
-		str << "case " << i->isa_mode_id << ": if(archsim::options::Trace) { return StepInstruction_" << i->ISAName << "<true>(thread, inst); } else { return StepInstruction_" << i->ISAName << "<false>(thread, inst); }";
+		str << "case " << i->isa_mode_id << ": if(trace) { return StepInstruction_" << i->ISAName << "<true>(thread, inst); } else { return StepInstruction_" << i->ISAName << "<false>(thread, inst); }";
 	}
 
 	str <<
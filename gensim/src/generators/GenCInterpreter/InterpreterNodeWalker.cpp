@@ -446,6 +446,9 @@ namespace gensim
 					case IntrinsicID::PendInterrupt:
 						output << "thread->PendIRQ();";
 						break;
+					case IntrinsicID::WaitForInterrupt:
+						output << "thread->WaitForInterrupt();";
+						break;
 
 					case IntrinsicID::DoubleAbs:
 					case IntrinsicID::FloatAbs:
@@ -789,6 +792,8 @@ namespace gensim
 				output << "archsim::MemoryResult _value = mem_interface.Write" << (stmt.Width * 8) << "(addr," << Factory.GetOrCreate(stmt.Value())->GetFixedValue() << ");";
 				output << "if(_value != archsim::MemoryResult::OK) {";
 				output << "  thread->TakeMemoryException(mem_interface, addr);";
+				output << "} else {";
+				output << "  mem_interface.NotifyWrite(thread, addr);";
 				output << "}";
 				output << "if(trace) { thread->GetTraceSource()->Trace_Mem_Write(1, " << Factory.GetOrCreate(stmt.Addr())->GetFixedValue() << ", " << Factory.GetOrCreate(stmt.Value())->GetFixedValue() << ", " << (uint32_t)stmt.Width << "); }";
 				output << "}";
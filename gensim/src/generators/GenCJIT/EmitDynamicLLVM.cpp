@@ -949,6 +949,9 @@ namespace gensim
 						case IntrinsicID::PendInterrupt:
 							output << "__irBuilder.CreateCall(ctx.Functions.cpuPendIRQ, ctx.GetThreadPtr(__irBuilder));";
 							break;
+						case IntrinsicID::WaitForInterrupt:
+							output << "__irBuilder.CreateCall(ctx.Functions.cpuWaitForInterrupt, ctx.GetThreadPtr(__irBuilder));";
+							break;
 						case IntrinsicID::HaltCpu:
 							output << "__irBuilder.CreateCall(ctx.Functions.cpu_halt, ctx.GetThreadPtr(__irBuilder));";
 							break;
@@ -27,6 +27,7 @@ public:
 private:
 	bool GenerateHeader(util::cppformatstream &stream) const;
 	bool GenerateSource(util::cppformatstream &stream) const;
+	void GenerateHint(util::cppformatstream &stream, const std::list<std::vector<isa::InstructionDescription::DecodeConstraint> > &constraints, const std::string &hint) const;
 };
 
 bool JumpInfoGenerator::Generate() const
@@ -55,7 +56,7 @@ bool JumpInfoGenerator::GenerateSource(util::cppformatstream &stream) const
 	stream << "using namespace gensim; using namespace gensim::" << Manager.GetArch().Name << ";";
 	stream << "void JumpInfoProvider::GetJumpInfo(const gensim::BaseDecode *instr, archsim::Address pc, JumpInfo &info) {";
 
-	stream << "info.IsJump = info.IsIndirect = info.IsConditional = false;";
+	stream << "info.IsJump = info.IsIndirect = info.IsConditional = info.IsCall = info.IsReturn = false;";
 	stream << "const Decode *inst = static_cast<const Decode*>(instr);";
 
 	stream << "if(!instr->GetEndOfBlock()) { return; }";
@@ -71,6 +72,8 @@ bool JumpInfoGenerator::GenerateSource(util::cppformatstream &stream) const
 				stream << "info.IsJump = true;";
 				if (i->second->VariableJump) stream << "info.IsIndirect = true;";
 				if (i->second->FixedJumpPred) stream << "info.IsConditional = true;";
+				GenerateHint(stream, i->second->Call_Constraints, "IsCall");
+				GenerateHint(stream, i->second->Return_Constraints, "IsReturn");
 				if (i->second->FixedJump || i->second->FixedJumpPred) {
 					assert(i->second->FixedJumpField.length() != 0);
 					// Fixed jump
@@ -92,6 +95,44 @@ bool JumpInfoGenerator::GenerateSource(util::cppformatstream &stream) const
 	return true;
 }
 
+// Set the given hint if any of the constraint sets matches the instruction
+void JumpInfoGenerator::GenerateHint(util::cppformatstream &stream, const std::list<std::vector<isa::InstructionDescription::DecodeConstraint> > &constraints, const std::string &hint) const
+{
+	for (const auto &constraint_set : constraints) {
+		// A constraint set with zero constraints always matches
+		if (constraint_set.size() == 0) {
+			stream << "info." << hint << " = true;";
+			return;
+		}
+	}
+
+	for (const auto &constraint_set : constraints) {
+		stream << "if(";
+		bool first = true;
+		for (const auto &constraint : constraint_set) {
+			if (!first) stream << " && ";
+			first = false;
+			switch(constraint.Type) {
+				case isa::InstructionDescription::Constraint_Equals:
+					stream << "(inst->" << constraint.Field << " == " << constraint.Value << ")";
+					break;
+				case isa::InstructionDescription::Constraint_BitwiseAnd:
+					stream << "((inst->" << constraint.Field << " & " << constraint.Value << ") == " << constraint.Value << ")";
+					break;
+				case isa::InstructionDescription::Constraint_BitwiseXor:
+					stream << "((inst->" << constraint.Field << " ^ " << constraint.Value << ") != 0)";
+					break;
+				case isa::InstructionDescription::Constraint_NotEquals:
+					stream << "(inst->" << constraint.Field << " != " << constraint.Value << ")";
+					break;
+				default:
+					assert(false);
+			}
+		}
+		stream << ") info." << hint << " = true;";
+	}
+}
+
 bool JumpInfoGenerator::GenerateHeader(util::cppformatstream &stream) const
 {
 	stream << "#include <cstdint>\n";
@@ -80,6 +80,8 @@ tokens
 	SET_JUMP_VARIABLE = 'set_variable_jump';
 	SET_USES_PC = 'set_reads_pc';
 	SET_BLOCK_COND = 'set_block_cond';
+	SET_CALL = 'set_call';
+	SET_RETURN = 'set_return';
 
 	FIXED = 'FIXED';
 	RELATIVE = 'RELATIVE';
@@ -360,9 +362,15 @@ jumpFixedPredicatedResource
 	
 usesPcResource
 	:	instr = AC_ID PERIOD SET_USES_PC OPAREN (decodeConstraint (COMMA decodeConstraint)*)? CPAREN -> ^(SET_USES_PC $instr decodeConstraint*);
+
+callResource
+	:	instr = AC_ID PERIOD SET_CALL OPAREN (decodeConstraint (COMMA decodeConstraint)*)? CPAREN -> ^(SET_CALL $instr decodeConstraint*);
+
+returnResource
+	:	instr = AC_ID PERIOD SET_RETURN OPAREN (decodeConstraint (COMMA decodeConstraint)*)? CPAREN -> ^(SET_RETURN $instr decodeConstraint*);
 	
 instr_resource
-	:	(decoderResource | asmResource | behaviourResource | eobResource | jumpVariableResource | jumpFixedResource | jumpFixedPredicatedResource | usesPcResource | limmResource | blockCondResource) SEMICOLON!;
+	:	(decoderResource | asmResource | behaviourResource | eobResource | jumpVariableResource | jumpFixedResource | jumpFixedPredicatedResource | usesPcResource | limmResource | blockCondResource | callResource | returnResource) SEMICOLON!;
 
 assembler_resource
 	:	ASSEMBLER PERIOD (rsc=SET_COMMENT | rsc=SET_LINE_COMMENT) OPAREN STRING CPAREN SEMICOLON -> ^(ASSEMBLER $rsc STRING);
@@ -0,0 +1,101 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * CompressedTraceSink.h
+ *
+ * A trace sink which compresses and writes records on a background thread.
+ */
+
+#ifndef COMPRESSEDTRACESINK_H
+#define COMPRESSEDTRACESINK_H
+
+#include "RecordChunkWriter.h"
+#include "TraceSink.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace libtrace
+{
+
+	/*
+	 * Records are copied into a per-stream chunk on the thread which emits
+	 * them. Full chunks are queued for a writer thread, which compresses
+	 * them with LZ4 and writes them out. Only a fixed number of chunks may
+	 * be in flight: once they are all queued, emitting threads wait for the
+	 * writer to catch up, and the time spent waiting is recorded.
+	 */
+	class CompressedFileTraceSink : public TraceSink
+	{
+	public:
+		static const size_t kChunkRecords = 64 * 1024;
+		static const size_t kMaxChunksInFlight = 16;
+
+		struct Statistics {
+			uint64_t records;
+			uint64_t chunks;
+			uint64_t uncompressed_bytes;
+			uint64_t compressed_bytes;
+
+			// The number of times an emitting thread had to wait for a free
+			// chunk, and the total time spent waiting
+			uint64_t stalls;
+			uint64_t stall_ns;
+		};
+
+		CompressedFileTraceSink(const std::string &pattern);
+		~CompressedFileTraceSink();
+
+		int Open() override;
+		void SinkPackets(int id, const TraceRecord* start, const TraceRecord* end) override;
+
+		// Write out every record sunk so far, and wait for it to reach the
+		// files
+		void Flush() override;
+
+		bool IsBuffered() const override
+		{
+			return true;
+		}
+
+		void PrintStatistics(std::ostream &str) override;
+
+		Statistics GetStatistics();
+
+	private:
+		struct Chunk {
+			int id;
+			std::vector<TraceRecord> records;
+		};
+
+		Chunk *GetFreeChunk(std::unique_lock<std::mutex> &lock);
+		void SubmitChunk(int id);
+		void WriterThread();
+
+		std::string pattern_;
+
+		std::mutex lock_;
+		std::condition_variable work_cond_, free_cond_;
+
+		std::vector<RecordChunkWriter*> writers_;
+		std::vector<Chunk*> current_chunks_;
+
+		std::deque<Chunk*> queued_chunks_;
+		std::vector<Chunk*> free_chunks_;
+		size_t allocated_chunks_;
+		bool writer_busy_;
+		bool terminate_;
+
+		Statistics stats_;
+
+		std::thread writer_;
+	};
+
+}
+
+#endif
@@ -0,0 +1,88 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * RecordChunk.h
+ *
+ * The on-disk layout of compressed trace files.
+ */
+
+#ifndef RECORDCHUNK_H
+#define RECORDCHUNK_H
+
+#include "RecordTypes.h"
+
+#include <cstdint>
+
+namespace libtrace
+{
+
+	// A compressed trace file starts with this header, followed by a
+	// sequence of chunks. Each chunk is a chunk header followed by a run of
+	// whole records, compressed with LZ4 as a single block.
+	//
+	// Version 2 files end the chunk sequence with an empty chunk header,
+	// which is followed by an index of the chunks and then the footer.
+	struct CompressedTraceHeader {
+		static const uint64_t kMagic = 0x00345a4c4352544cULL; // "LTRCLZ4"
+		static const uint32_t kVersion = 2;
+
+		uint64_t magic;
+		uint32_t version;
+		uint32_t record_size;
+	};
+
+	struct CompressedChunkHeader {
+		uint32_t compressed_size;
+		uint32_t record_count;
+	};
+
+	// Describes one chunk: where it is, which records and instructions it
+	// holds, and a summary of the PCs of those instructions. The summary
+	// is conservative: MayContainPC can give false positives but never
+	// false negatives.
+	struct ChunkIndexEntry {
+		static const uint32_t kPCPageBits = 12;
+		static const uint32_t kPCPageSummaryBits = 256;
+
+		// Offset of the chunk header in the file
+		uint64_t file_offset;
+		uint64_t first_record;
+		// The number of instruction headers in all of the previous chunks
+		uint64_t first_instruction;
+		uint32_t compressed_size;
+		uint32_t record_count;
+		uint32_t instruction_count;
+		// The PC of the last instruction header in this chunk or, if
+		// there isn't one, in any previous chunk
+		uint32_t last_pc;
+		uint32_t min_pc;
+		uint32_t max_pc;
+		uint64_t pc_pages[kPCPageSummaryBits / 64];
+
+		// Start summarising a chunk which follows the given one (or the
+		// start of the trace if prev is null)
+		void BeginSummary(const ChunkIndexEntry *prev);
+		void Summarise(const Record &record);
+
+		bool MayContainPC(uint32_t pc) const;
+		bool MayContainPCRange(uint32_t low, uint32_t high) const;
+
+	private:
+		static uint32_t PageBit(uint32_t pc)
+		{
+			uint32_t page = pc >> kPCPageBits;
+			return (page ^ (page >> 8) ^ (page >> 16)) % kPCPageSummaryBits;
+		}
+	};
+
+	struct CompressedTraceFooter {
+		static const uint64_t kMagic = 0x0058444943525443ULL; // "CTRCIDX"
+
+		uint64_t index_offset;
+		uint64_t chunk_count;
+		uint64_t magic;
+	};
+
+}
+
+#endif
@@ -0,0 +1,47 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * RecordChunkWriter.h
+ *
+ * Writes records to a file in the compressed trace format (see
+ * RecordChunk.h).
+ */
+
+#ifndef RECORDCHUNKWRITER_H
+#define RECORDCHUNKWRITER_H
+
+#include "RecordChunk.h"
+#include "RecordTypes.h"
+
+#include <cstdio>
+#include <vector>
+
+namespace libtrace
+{
+
+	// Compresses and writes whole chunks of records, and keeps the index
+	// of the chunks written so far. The index and footer are written when
+	// the writer is closed, which also closes the file.
+	class RecordChunkWriter
+	{
+	public:
+		RecordChunkWriter(FILE *file);
+		~RecordChunkWriter();
+
+		// Returns the number of bytes written to the file
+		size_t WriteChunk(const Record *records, size_t count);
+		void Flush();
+		void Close();
+
+	private:
+		FILE *file_;
+		uint64_t offset_;
+
+		std::vector<ChunkIndexEntry> index_;
+		std::vector<char> buffer_;
+		void *lz4_ctx_;
+	};
+
+}
+
+#endif
@@ -2,6 +2,7 @@
 #ifndef RECORDFILE_H
 #define RECORDFILE_H
 
+#include "RecordChunk.h"
 #include "RecordTypes.h"
 #include "RecordIterator.h"
 #include "TraceRecordStream.h"
@@ -9,20 +10,25 @@
 #include <cassert>
 #include <cstdio>
 #include <cstdlib>
+#include <vector>
 
 namespace libtrace
 {
 
+	// Gives random access to the records in a trace file, which may either
+	// be a raw array of records or a compressed trace (see RecordChunk.h).
+	// Compressed chunks are decompressed as they are needed.
+	//
+	// The file is also divided into chunks, each of which is summarised by
+	// a ChunkIndexEntry. These let tools find instructions by number and
+	// skip chunks which cannot contain a given PC. Compressed traces carry
+	// an index of their chunks; for other files the summaries are built by
+	// reading the whole file the first time they are needed.
 	class RecordFile : public RecordBufferInterface
 	{
 	public:
-		RecordFile(FILE *f) : _file(f), _buffer(nullptr)
-		{
-			if(f) fseek(f, 0, SEEK_END);
-			uint64_t size = ftell(f);
-			_count = size / sizeof(Record);
-		}
-		virtual ~RecordFile() {}
+		RecordFile(FILE *f);
+		virtual ~RecordFile();
 
 		RecordIterator begin();
 		RecordIterator end();
@@ -31,8 +37,8 @@ namespace libtrace
 		{
 			if(i >= _count) return false;
 
-			if(!_buffer || _buffer_page != BufferPage(i)) loadBuffer(i);
-			r = _buffer[BufferOffset(i)];
+			if(!_buffer || i < _buffer_start || i >= _buffer_start + _buffer_count) loadBuffer(i);
+			r = _buffer[i - _buffer_start];
 			return true;
 		}
 		uint64_t Size() override
@@ -40,6 +46,25 @@ namespace libtrace
 			return _count;
 		}
 
+		bool IsCompressed() const
+		{
+			return _compressed;
+		}
+		bool HasIndex() const
+		{
+			return _indexed;
+		}
+
+		uint64_t InstructionCount();
+
+		// Find the index of the header record of the given instruction
+		// (counting from zero). Returns false if the trace has fewer
+		// instructions.
+		bool FindInstruction(uint64_t instruction, uint64_t &record_index);
+
+		size_t ChunkCount();
+		const ChunkIndexEntry &GetChunk(size_t i);
+
 	private:
 		static const uint64_t kBufferBits = 17;
 		static const uint64_t kBufferCount = 1 << kBufferBits;
@@ -47,34 +72,23 @@ namespace libtrace
 
 		FILE *_file;
 		uint64_t _count;
+		bool _compressed;
+		bool _indexed;
+		bool _summarised;
 
-		uint64_t BufferPage(uint64_t idx)
-		{
-			return idx >> kBufferBits;
-		}
-		uint64_t BufferOffset(uint64_t idx)
-		{
-			return idx % kBufferCount;
-		}
-		void loadBuffer(uint64_t idx)
-		{
-			if(!_buffer) _buffer = (Record*)malloc(kBufferSize);
-
-			_buffer_page = BufferPage(idx);
-
-			if(fseek(_file, _buffer_page * kBufferSize, SEEK_SET)) {
-				perror("");
-				abort();
-			}
-			if(fread(_buffer, kBufferSize, 1, _file) != 1) {
-				if(ferror(_file)) {
-					perror("");
-					abort();
-				}
-			}
-		}
+		std::vector<ChunkIndexEntry> _chunks;
+		std::vector<char> _compressed_buffer;
+
+		bool loadIndex(uint64_t file_size);
+		void scanChunks(uint64_t file_size);
+		void summariseChunks();
+		void loadBuffer(uint64_t idx);
+		void loadRawBuffer(uint64_t idx);
+		void loadChunk(uint64_t idx);
 
-		uint64_t _buffer_page;
+		uint64_t _buffer_start;
+		uint64_t _buffer_count;
+		uint64_t _buffer_capacity;
 		Record *_buffer;
 	};
 
@@ -0,0 +1,146 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * TraceAnalysis.h
+ *
+ * Runs an analysis over a trace file in parallel. The trace is split into
+ * segments, each of which starts at an instruction header and contains
+ * whole instructions. Each segment is visited by its own visitor on a
+ * worker thread, and the visitors are then merged in trace order.
+ */
+
+#ifndef TRACEANALYSIS_H
+#define TRACEANALYSIS_H
+
+#include "RecordChunk.h"
+#include "TraceRecordPacket.h"
+#include "TraceRecordPacketVisitor.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace libtrace
+{
+
+	class RecordFile;
+
+	// Visits the packets of a single segment. All of the visit methods do
+	// nothing by default, so analyses only need to override the ones they
+	// are interested in.
+	class TraceAnalysisVisitor : public TraceRecordPacketVisitor
+	{
+	public:
+		TraceAnalysisVisitor();
+		virtual ~TraceAnalysisVisitor();
+
+		void VisitInstructionHeader(const InstructionHeaderReader &record) override {}
+		void VisitInstructionCode(const InstructionCodeReader &record) override {}
+
+		void VisitRegRead(const RegReadReader &record) override {}
+		void VisitRegWrite(const RegWriteReader &record) override {}
+		void VisitBankRegRead(const BankRegReadReader &record) override {}
+		void VisitBankRegWrite(const BankRegWriteReader &record) override {}
+
+		void VisitMemReadAddr(const MemReadAddrReader &record) override {}
+		void VisitMemReadData(const MemReadDataReader &record) override {}
+		void VisitMemWriteAddr(const MemWriteAddrReader &record) override {}
+		void VisitMemWriteData(const MemWriteDataReader &record) override {}
+
+		// Called for every packet in the segment. By default this
+		// dispatches to the visit method for the packet's type, but
+		// analyses which work on raw records can override it instead.
+		virtual void VisitPacket(const TraceRecordPacket &packet)
+		{
+			Visit(packet);
+		}
+
+		// Called after the last packet in the segment
+		virtual void EndSegment() {}
+
+		// The number of instruction headers visited so far in this segment,
+		// including the current packet
+		uint64_t GetInstructionCount() const
+		{
+			return instruction_count_;
+		}
+		// The index in the trace of the current packet's first record
+		uint64_t GetRecordIndex() const
+		{
+			return record_index_;
+		}
+
+	protected:
+		// Append the packet's records to a list, for analyses which write
+		// out (part of) the trace
+		static void AppendPacket(std::vector<Record> &records, const TraceRecordPacket &packet);
+
+	private:
+		friend class TraceAnalysisRunner;
+
+		uint64_t instruction_count_;
+		uint64_t record_index_;
+	};
+
+	struct TraceSegmentInfo {
+		uint64_t first_record;
+		uint64_t end_record;
+
+		// The number of instructions in all of the earlier segments, and
+		// in this one
+		uint64_t first_instruction;
+		uint64_t instruction_count;
+
+		// The PC of the last instruction before this segment, or 0 if
+		// there isn't one
+		uint32_t prev_pc;
+	};
+
+	class TraceAnalysis
+	{
+	public:
+		virtual ~TraceAnalysis();
+
+		// Create a visitor for a segment. This may be called from any of
+		// the worker threads.
+		virtual TraceAnalysisVisitor *CreateVisitor() = 0;
+
+		// Merge the results of a visitor. This is called once for each
+		// visited segment, in trace order, on the thread which is running
+		// the analysis. The visitor is deleted afterwards.
+		virtual void Merge(TraceAnalysisVisitor *visitor, const TraceSegmentInfo &segment) = 0;
+
+		// For traces with a chunk index, chunks for which this returns
+		// false are not visited at all (e.g. because they cannot contain a
+		// PC which is being searched for).
+		virtual bool MayMatch(const ChunkIndexEntry &chunk)
+		{
+			return true;
+		}
+	};
+
+	class TraceAnalysisRunner
+	{
+	public:
+		// Segment size for traces without a chunk index. Indexed traces are
+		// split at chunk boundaries instead.
+		static const uint64_t kSegmentRecords = 1 << 20;
+
+		// Use one thread per core if threads is 0
+		TraceAnalysisRunner(const std::string &filename, unsigned threads = 0);
+
+		// Returns false if the trace could not be read
+		bool Run(TraceAnalysis &analysis);
+
+	private:
+		struct Segment;
+
+		void VisitSegment(RecordFile &file, const Segment &segment, TraceAnalysisVisitor *visitor, uint64_t &instruction_count, uint32_t &last_pc);
+
+		std::string filename_;
+		unsigned threads_;
+	};
+
+}
+
+#endif
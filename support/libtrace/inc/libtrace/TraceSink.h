@@ -14,6 +14,7 @@
 #include <cstdio>
 #include <vector>
 #include <fstream>
+#include <ostream>
 
 #include "RecordTypes.h"
 #include "TraceRecordPacket.h"
@@ -33,6 +34,15 @@ namespace libtrace
 		virtual int Open() = 0;
 		virtual void SinkPackets(int id, const TraceRecord *start, const TraceRecord *end) = 0;
 		virtual void Flush() = 0;
+
+		// Sinks which buffer records themselves don't need sources to hand
+		// over every record as soon as it has been traced
+		virtual bool IsBuffered() const
+		{
+			return false;
+		}
+
+		virtual void PrintStatistics(std::ostream &str) { }
 	};
 
 	class BinaryFileTraceSink : public TraceSink
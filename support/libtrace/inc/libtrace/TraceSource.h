@@ -9,6 +9,7 @@
 #include <string>
 #include <vector>
 #include <cstring>
+#include <functional>
 
 using uint128_t = __uint128_t;
 
@@ -33,14 +34,59 @@ namespace libtrace
 		void SetInstructionSkip(uint64_t skip)
 		{
 			skip_ = skip;
+			updateBufferLimit();
 		}
 
+		// Stop tracing after the given number of instructions have been
+		// traced (not counting skipped ones), or never if it is 0. The
+		// records of later instructions are dropped when the buffer is
+		// emitted, and the handler is called once tracing has stopped.
+		void SetInstructionLimit(uint64_t limit)
+		{
+			limited_ = limit > 0;
+			remaining_ = limit;
+		}
+		void SetStopHandler(const std::function<void()> &handler)
+		{
+			stop_handler_ = handler;
+		}
+		bool IsStopped() const
+		{
+			return stopped_;
+		}
+
+		// Generated code may write records into the packet buffer itself,
+		// rather than calling into the trace source for each one. While
+		// the buffer is bound, the current position in the buffer and the
+		// limit up to which generated code may write without calling
+		// ReserveRecords are kept at the given locations (e.g. in a
+		// thread's state block) instead of in the trace source.
+		void BindBuffer(TraceRecord **pos, TraceRecord **limit);
+		void UnbindBuffer();
+
+		// Called by generated code before writing count records, the first
+		// of which has the given type, if they would not fit below the
+		// limit. This makes room for them and returns true, or returns
+		// false if they belong to an instruction which is being skipped and
+		// should not be written.
+		bool ReserveRecords(TraceRecordType type, uint32_t count);
+
 	private:
 		template <typename PCT> void TraceInstructionHeader(PCT pc, uint8_t isa_mode);
 		template <typename CodeT> void TraceInstructionCode(CodeT pc, uint8_t irq_mode);
 		template <typename PCT> void TraceBundleHeader(PCT pc);
 
 		uint64_t skip_;
+		// Whether the last instruction header which generated code tried
+		// to write was skipped
+		bool skipping_insn_;
+
+		// The number of instructions left to emit before stopping, if
+		// limited
+		bool limited_;
+		uint64_t remaining_;
+		bool stopped_;
+		std::function<void()> stop_handler_;
 
 	public:
 		template<typename PCT> void Trace_StartBundle(PCT PC)
@@ -51,6 +97,9 @@ namespace libtrace
 
 		template<typename PCT, typename CodeT> void Trace_Insn(PCT PC, CodeT IR, bool JIT, uint8_t isa_mode, uint8_t irq_mode, uint8_t exec)
 		{
+			if(stopped_) {
+				return;
+			}
 			if(skip_ > 0) {
 				skip_--;
 				return;
@@ -216,6 +265,7 @@ namespace libtrace
 		void SetAggressiveFlush(bool b)
 		{
 			aggressive_flushing_ = b;
+			updateBufferLimit();
 		}
 		bool GetAggressiveFlush() const
 		{
@@ -235,16 +285,24 @@ namespace libtrace
 	private:
 		TraceRecord *getNextPacket()
 		{
-			if(packet_buffer_pos_ == packet_buffer_end_ || GetAggressiveFlush()) EmitPackets();
-			return packet_buffer_pos_++;
+			if(*packet_buffer_pos_ == packet_buffer_end_ || GetAggressiveFlush()) EmitPackets();
+			return (*packet_buffer_pos_)++;
 		}
 
+		void updateBufferLimit();
+
 		TraceSink *sink_;
 
 		TraceRecord *packet_buffer_;
-		TraceRecord *packet_buffer_pos_;
 		TraceRecord *packet_buffer_end_;
 
+		// These point at local_pos_ and local_limit_ unless the buffer is
+		// bound
+		TraceRecord **packet_buffer_pos_;
+		TraceRecord **packet_buffer_limit_;
+		TraceRecord *local_pos_;
+		TraceRecord *local_limit_;
+
 		bool is_terminated_;
 		bool aggressive_flushing_;
 
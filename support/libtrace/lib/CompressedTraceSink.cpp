@@ -0,0 +1,178 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * CompressedTraceSink.cpp
+ */
+
+#include "libtrace/CompressedTraceSink.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <sstream>
+
+using namespace libtrace;
+
+const size_t CompressedFileTraceSink::kChunkRecords;
+const size_t CompressedFileTraceSink::kMaxChunksInFlight;
+
+CompressedFileTraceSink::CompressedFileTraceSink(const std::string &pattern) : TraceSink(), pattern_(pattern), allocated_chunks_(0), writer_busy_(false), terminate_(false), stats_()
+{
+	writer_ = std::thread(&CompressedFileTraceSink::WriterThread, this);
+}
+
+CompressedFileTraceSink::~CompressedFileTraceSink()
+{
+	Flush();
+
+	{
+		std::lock_guard<std::mutex> lock(lock_);
+		terminate_ = true;
+	}
+	work_cond_.notify_one();
+	writer_.join();
+
+	for(auto writer : writers_) {
+		delete writer;
+	}
+	for(auto chunk : free_chunks_) {
+		delete chunk;
+	}
+}
+
+int CompressedFileTraceSink::Open()
+{
+	std::lock_guard<std::mutex> lock(lock_);
+
+	int new_id = writers_.size();
+	std::stringstream str;
+	str << pattern_ << new_id;
+	FILE *f = fopen(str.str().c_str(), "w");
+
+	writers_.push_back(new RecordChunkWriter(f));
+	current_chunks_.push_back(nullptr);
+	return new_id;
+}
+
+void CompressedFileTraceSink::SinkPackets(int id, const TraceRecord* start, const TraceRecord* end)
+{
+	std::unique_lock<std::mutex> lock(lock_);
+
+	while(start != end) {
+		// Waiting for a free chunk drops the lock, so look the current
+		// chunk up again every time around
+		if(current_chunks_.at(id) == nullptr) {
+			Chunk *chunk = GetFreeChunk(lock);
+			chunk->id = id;
+			current_chunks_.at(id) = chunk;
+		}
+
+		Chunk *chunk = current_chunks_.at(id);
+		size_t count = std::min<size_t>(end - start, kChunkRecords - chunk->records.size());
+		chunk->records.insert(chunk->records.end(), start, start + count);
+		start += count;
+
+		if(chunk->records.size() == kChunkRecords) {
+			SubmitChunk(id);
+		}
+	}
+}
+
+CompressedFileTraceSink::Chunk *CompressedFileTraceSink::GetFreeChunk(std::unique_lock<std::mutex> &lock)
+{
+	if(free_chunks_.empty() && allocated_chunks_ < kMaxChunksInFlight) {
+		Chunk *chunk = new Chunk();
+		chunk->records.reserve(kChunkRecords);
+		allocated_chunks_++;
+		return chunk;
+	}
+
+	if(free_chunks_.empty()) {
+		auto start = std::chrono::steady_clock::now();
+		free_cond_.wait(lock, [this]() {
+			return !free_chunks_.empty();
+		});
+
+		stats_.stalls++;
+		stats_.stall_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	Chunk *chunk = free_chunks_.back();
+	free_chunks_.pop_back();
+	return chunk;
+}
+
+void CompressedFileTraceSink::SubmitChunk(int id)
+{
+	queued_chunks_.push_back(current_chunks_.at(id));
+	current_chunks_.at(id) = nullptr;
+	work_cond_.notify_one();
+}
+
+void CompressedFileTraceSink::Flush()
+{
+	std::unique_lock<std::mutex> lock(lock_);
+
+	for(size_t id = 0; id < current_chunks_.size(); ++id) {
+		if(current_chunks_[id] != nullptr && !current_chunks_[id]->records.empty()) {
+			SubmitChunk(id);
+		}
+	}
+
+	free_cond_.wait(lock, [this]() {
+		return queued_chunks_.empty() && !writer_busy_;
+	});
+
+	for(auto writer : writers_) {
+		writer->Flush();
+	}
+}
+
+void CompressedFileTraceSink::WriterThread()
+{
+	std::unique_lock<std::mutex> lock(lock_);
+	while(true) {
+		work_cond_.wait(lock, [this]() {
+			return terminate_ || !queued_chunks_.empty();
+		});
+
+		if(queued_chunks_.empty()) {
+			break;
+		}
+
+		Chunk *chunk = queued_chunks_.front();
+		queued_chunks_.pop_front();
+		RecordChunkWriter *writer = writers_.at(chunk->id);
+		writer_busy_ = true;
+
+		lock.unlock();
+		size_t compressed_size = writer->WriteChunk(chunk->records.data(), chunk->records.size());
+		lock.lock();
+
+		stats_.records += chunk->records.size();
+		stats_.chunks++;
+		stats_.uncompressed_bytes += chunk->records.size() * sizeof(TraceRecord);
+		stats_.compressed_bytes += compressed_size;
+
+		chunk->records.clear();
+		free_chunks_.push_back(chunk);
+		writer_busy_ = false;
+		free_cond_.notify_all();
+	}
+}
+
+CompressedFileTraceSink::Statistics CompressedFileTraceSink::GetStatistics()
+{
+	std::lock_guard<std::mutex> lock(lock_);
+	return stats_;
+}
+
+void CompressedFileTraceSink::PrintStatistics(std::ostream &str)
+{
+	auto stats = GetStatistics();
+
+	str << "Trace Statistics" << std::endl;
+	str << "  Records written: " << stats.records << " in " << stats.chunks << " chunks" << std::endl;
+	str << "  Bytes written: " << stats.compressed_bytes << " (" << stats.uncompressed_bytes << " uncompressed)" << std::endl;
+	str << "  Writer stalls: " << stats.stalls << " (" << (stats.stall_ns / 1000000) << " ms)" << std::endl;
+}
@@ -0,0 +1,53 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+#include "libtrace/RecordChunk.h"
+
+#include <cstring>
+
+using namespace libtrace;
+
+const uint64_t CompressedTraceHeader::kMagic;
+const uint32_t CompressedTraceHeader::kVersion;
+const uint64_t CompressedTraceFooter::kMagic;
+
+void ChunkIndexEntry::BeginSummary(const ChunkIndexEntry *prev)
+{
+	first_record = prev ? prev->first_record + prev->record_count : 0;
+	first_instruction = prev ? prev->first_instruction + prev->instruction_count : 0;
+	instruction_count = 0;
+	last_pc = prev ? prev->last_pc : 0;
+	min_pc = 0xffffffff;
+	max_pc = 0;
+	memset(pc_pages, 0, sizeof(pc_pages));
+}
+
+void ChunkIndexEntry::Summarise(const Record &record)
+{
+	const TraceRecord &tr = (const TraceRecord &)record;
+	if(tr.GetType() != InstructionHeader) {
+		return;
+	}
+
+	uint32_t pc = ((const InstructionHeaderRecord &)record).GetPC();
+	instruction_count++;
+	last_pc = pc;
+	if(pc < min_pc) min_pc = pc;
+	if(pc > max_pc) max_pc = pc;
+
+	uint32_t bit = PageBit(pc);
+	pc_pages[bit / 64] |= 1ULL << (bit % 64);
+}
+
+bool ChunkIndexEntry::MayContainPC(uint32_t pc) const
+{
+	if(instruction_count == 0 || pc < min_pc || pc > max_pc) {
+		return false;
+	}
+
+	uint32_t bit = PageBit(pc);
+	return pc_pages[bit / 64] & (1ULL << (bit % 64));
+}
+
+bool ChunkIndexEntry::MayContainPCRange(uint32_t low, uint32_t high) const
+{
+	return instruction_count != 0 && low <= max_pc && high >= min_pc;
+}
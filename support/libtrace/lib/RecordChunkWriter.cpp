@@ -0,0 +1,85 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+#include "libtrace/RecordChunkWriter.h"
+
+#include "lz4/lz4.h"
+
+#include <cstdlib>
+
+using namespace libtrace;
+
+RecordChunkWriter::RecordChunkWriter(FILE *file) : file_(file), offset_(0), lz4_ctx_(nullptr)
+{
+	CompressedTraceHeader header;
+	header.magic = CompressedTraceHeader::kMagic;
+	header.version = CompressedTraceHeader::kVersion;
+	header.record_size = sizeof(Record);
+	fwrite(&header, sizeof(header), 1, file_);
+
+	offset_ = sizeof(header);
+}
+
+RecordChunkWriter::~RecordChunkWriter()
+{
+	Close();
+	free(lz4_ctx_);
+}
+
+size_t RecordChunkWriter::WriteChunk(const Record *records, size_t count)
+{
+	ChunkIndexEntry entry;
+	entry.BeginSummary(index_.empty() ? nullptr : &index_.back());
+	for(size_t i = 0; i < count; ++i) {
+		entry.Summarise(records[i]);
+	}
+
+	int input_size = count * sizeof(Record);
+	buffer_.resize(LZ4_compressBound(input_size));
+
+	CompressedChunkHeader header;
+	header.record_count = count;
+	header.compressed_size = LZ4_compressCtx(&lz4_ctx_, (const char*)records, buffer_.data(), input_size);
+
+	fwrite(&header, sizeof(header), 1, file_);
+	fwrite(buffer_.data(), header.compressed_size, 1, file_);
+
+	entry.file_offset = offset_;
+	entry.compressed_size = header.compressed_size;
+	entry.record_count = header.record_count;
+	index_.push_back(entry);
+
+	size_t written = sizeof(header) + header.compressed_size;
+	offset_ += written;
+	return written;
+}
+
+void RecordChunkWriter::Flush()
+{
+	if(file_) {
+		fflush(file_);
+	}
+}
+
+void RecordChunkWriter::Close()
+{
+	if(!file_) {
+		return;
+	}
+
+	// An empty chunk header marks the end of the chunks, so that readers
+	// which walk the chunk headers do not run into the index
+	CompressedChunkHeader end;
+	end.compressed_size = 0;
+	end.record_count = 0;
+	fwrite(&end, sizeof(end), 1, file_);
+
+	CompressedTraceFooter footer;
+	footer.index_offset = offset_ + sizeof(end);
+	footer.chunk_count = index_.size();
+	footer.magic = CompressedTraceFooter::kMagic;
+
+	fwrite(index_.data(), sizeof(ChunkIndexEntry), index_.size(), file_);
+	fwrite(&footer, sizeof(footer), 1, file_);
+
+	fclose(file_);
+	file_ = nullptr;
+}
@@ -1,8 +1,45 @@
 /* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
 #include "libtrace/RecordFile.h"
 
+#include "lz4/lz4.h"
+
+#include <algorithm>
+
 using namespace libtrace;
 
+const uint64_t RecordFile::kBufferCount;
+
+RecordFile::RecordFile(FILE *f) : _file(f), _count(0), _compressed(false), _indexed(false), _summarised(false), _buffer_start(0), _buffer_count(0), _buffer_capacity(0), _buffer(nullptr)
+{
+	CompressedTraceHeader header;
+	bool is_compressed = fread(&header, sizeof(header), 1, f) == 1 && header.magic == CompressedTraceHeader::kMagic;
+
+	fseek(f, 0, SEEK_END);
+	uint64_t size = ftell(f);
+
+	if(is_compressed) {
+		if(header.version < 1 || header.version > CompressedTraceHeader::kVersion || header.record_size != sizeof(Record)) {
+			fprintf(stderr, "Unsupported compressed trace version\n");
+			abort();
+		}
+
+		_compressed = true;
+		if(header.version >= 2 && loadIndex(size)) {
+			_indexed = true;
+			_summarised = true;
+		} else {
+			scanChunks(size);
+		}
+	} else {
+		_count = size / sizeof(Record);
+	}
+}
+
+RecordFile::~RecordFile()
+{
+	free(_buffer);
+}
+
 RecordIterator RecordFile::begin()
 {
 	return RecordIterator(this, 0);
@@ -11,3 +48,198 @@ RecordIterator RecordFile::end()
 {
 	return RecordIterator(this, _count);
 }
+
+bool RecordFile::loadIndex(uint64_t file_size)
+{
+	CompressedTraceFooter footer;
+	if(file_size < sizeof(CompressedTraceHeader) + sizeof(footer)) {
+		return false;
+	}
+	if(fseek(_file, file_size - sizeof(footer), SEEK_SET) || fread(&footer, sizeof(footer), 1, _file) != 1) {
+		return false;
+	}
+	if(footer.magic != CompressedTraceFooter::kMagic || footer.index_offset + footer.chunk_count * sizeof(ChunkIndexEntry) + sizeof(footer) != file_size) {
+		return false;
+	}
+
+	_chunks.resize(footer.chunk_count);
+	if(fseek(_file, footer.index_offset, SEEK_SET) || fread(_chunks.data(), sizeof(ChunkIndexEntry), _chunks.size(), _file) != _chunks.size()) {
+		_chunks.clear();
+		return false;
+	}
+
+	if(!_chunks.empty()) {
+		_count = _chunks.back().first_record + _chunks.back().record_count;
+	}
+	return true;
+}
+
+void RecordFile::scanChunks(uint64_t file_size)
+{
+	// Build an index of the chunks by walking the chunk headers, for files
+	// without an index (e.g. if the simulator crashed). A chunk which was
+	// only partly written is ignored.
+	uint64_t offset = sizeof(CompressedTraceHeader);
+	CompressedChunkHeader header;
+
+	while(fseek(_file, offset, SEEK_SET) == 0 && fread(&header, sizeof(header), 1, _file) == 1) {
+		// An empty chunk marks the start of the index
+		if(header.record_count == 0) {
+			break;
+		}
+
+		ChunkIndexEntry chunk;
+		chunk.file_offset = offset;
+		chunk.first_record = _count;
+		chunk.compressed_size = header.compressed_size;
+		chunk.record_count = header.record_count;
+
+		offset += sizeof(header) + chunk.compressed_size;
+		if(offset > file_size) {
+			break;
+		}
+
+		_chunks.push_back(chunk);
+		_count += chunk.record_count;
+	}
+}
+
+void RecordFile::summariseChunks()
+{
+	if(_summarised) {
+		return;
+	}
+	_summarised = true;
+
+	// Raw files are split into chunks of the same size as the read buffer
+	if(!_compressed) {
+		for(uint64_t first = 0; first < _count; first += kBufferCount) {
+			ChunkIndexEntry chunk;
+			chunk.file_offset = first * sizeof(Record);
+			chunk.first_record = first;
+			chunk.compressed_size = 0;
+			chunk.record_count = std::min(kBufferCount, _count - first);
+			_chunks.push_back(chunk);
+		}
+	}
+
+	for(size_t i = 0; i < _chunks.size(); ++i) {
+		ChunkIndexEntry &chunk = _chunks[i];
+		chunk.BeginSummary(i ? &_chunks[i-1] : nullptr);
+
+		Record r;
+		for(uint64_t idx = chunk.first_record; idx < chunk.first_record + chunk.record_count; ++idx) {
+			Get(idx, r);
+			chunk.Summarise(r);
+		}
+	}
+}
+
+uint64_t RecordFile::InstructionCount()
+{
+	summariseChunks();
+
+	if(_chunks.empty()) {
+		return 0;
+	}
+	return _chunks.back().first_instruction + _chunks.back().instruction_count;
+}
+
+bool RecordFile::FindInstruction(uint64_t instruction, uint64_t &record_index)
+{
+	summariseChunks();
+
+	// Find the first chunk which ends after the instruction
+	auto chunk = std::upper_bound(_chunks.begin(), _chunks.end(), instruction, [](uint64_t instruction, const ChunkIndexEntry &chunk) {
+		return instruction < chunk.first_instruction + chunk.instruction_count;
+	});
+	if(chunk == _chunks.end()) {
+		return false;
+	}
+
+	uint64_t remaining = instruction - chunk->first_instruction;
+	Record r;
+	for(uint64_t idx = chunk->first_record; idx < chunk->first_record + chunk->record_count; ++idx) {
+		Get(idx, r);
+		if(TraceRecord(r).GetType() == InstructionHeader) {
+			if(remaining == 0) {
+				record_index = idx;
+				return true;
+			}
+			remaining--;
+		}
+	}
+
+	assert(false && "Chunk summary does not match its contents");
+	return false;
+}
+
+size_t RecordFile::ChunkCount()
+{
+	summariseChunks();
+	return _chunks.size();
+}
+
+const ChunkIndexEntry &RecordFile::GetChunk(size_t i)
+{
+	summariseChunks();
+	return _chunks.at(i);
+}
+
+void RecordFile::loadBuffer(uint64_t idx)
+{
+	if(_compressed) {
+		loadChunk(idx);
+	} else {
+		loadRawBuffer(idx);
+	}
+}
+
+void RecordFile::loadRawBuffer(uint64_t idx)
+{
+	if(!_buffer) {
+		_buffer = (Record*)malloc(kBufferSize);
+		_buffer_capacity = kBufferCount;
+	}
+
+	_buffer_start = idx & ~(kBufferCount - 1);
+	_buffer_count = std::min(kBufferCount, _count - _buffer_start);
+
+	if(fseek(_file, _buffer_start * sizeof(Record), SEEK_SET)) {
+		perror("");
+		abort();
+	}
+	if(fread(_buffer, kBufferSize, 1, _file) != 1) {
+		if(ferror(_file)) {
+			perror("");
+			abort();
+		}
+	}
+}
+
+void RecordFile::loadChunk(uint64_t idx)
+{
+	auto chunk = std::upper_bound(_chunks.begin(), _chunks.end(), idx, [](uint64_t idx, const ChunkIndexEntry &chunk) {
+		return idx < chunk.first_record;
+	}) - 1;
+
+	if(chunk->record_count > _buffer_capacity) {
+		_buffer = (Record*)realloc(_buffer, chunk->record_count * sizeof(Record));
+		_buffer_capacity = chunk->record_count;
+	}
+
+	_compressed_buffer.resize(chunk->compressed_size);
+	if(fseek(_file, chunk->file_offset + sizeof(CompressedChunkHeader), SEEK_SET) || fread(_compressed_buffer.data(), chunk->compressed_size, 1, _file) != 1) {
+		perror("");
+		abort();
+	}
+
+	int expected_size = chunk->record_count * sizeof(Record);
+	if(LZ4_uncompress_unknownOutputSize(_compressed_buffer.data(), (char*)_buffer, chunk->compressed_size, expected_size) != expected_size) {
+		fprintf(stderr, "Corrupt trace chunk at offset %lu\n", chunk->file_offset);
+		abort();
+	}
+
+	_buffer_start = chunk->first_record;
+	_buffer_count = chunk->record_count;
+}
@@ -0,0 +1,254 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * TraceAnalysis.cpp
+ */
+
+#include "libtrace/TraceAnalysis.h"
+#include "libtrace/RecordFile.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace libtrace;
+
+const uint64_t TraceAnalysisRunner::kSegmentRecords;
+
+struct TraceAnalysisRunner::Segment {
+	uint64_t first_record;
+	uint64_t end_record;
+	bool visit;
+
+	// Taken from the chunk index for segments which are not visited
+	uint64_t instruction_count;
+	uint32_t last_pc;
+};
+
+namespace
+{
+	struct SegmentResult {
+		SegmentResult() : done(false), visitor(nullptr), instruction_count(0), last_pc(0) {}
+
+		bool done;
+		TraceAnalysisVisitor *visitor;
+		uint64_t instruction_count;
+		uint32_t last_pc;
+	};
+}
+
+TraceAnalysisVisitor::TraceAnalysisVisitor() : instruction_count_(0), record_index_(0)
+{
+
+}
+
+TraceAnalysisVisitor::~TraceAnalysisVisitor()
+{
+
+}
+
+void TraceAnalysisVisitor::AppendPacket(std::vector<Record> &records, const TraceRecordPacket &packet)
+{
+	records.push_back(packet.GetRecord());
+	for(auto &extension : packet.GetExtensions()) {
+		records.push_back(extension);
+	}
+}
+
+TraceAnalysis::~TraceAnalysis()
+{
+
+}
+
+TraceAnalysisRunner::TraceAnalysisRunner(const std::string &filename, unsigned threads) : filename_(filename), threads_(threads)
+{
+	if(threads_ == 0) {
+		threads_ = std::max(1U, std::thread::hardware_concurrency());
+	}
+}
+
+bool TraceAnalysisRunner::Run(TraceAnalysis &analysis)
+{
+	std::vector<Segment> segments;
+
+	FILE *f = fopen(filename_.c_str(), "r");
+	if(!f) {
+		return false;
+	}
+
+	{
+		RecordFile file (f);
+
+		if(file.HasIndex()) {
+			for(size_t i = 0; i < file.ChunkCount(); ++i) {
+				const ChunkIndexEntry &chunk = file.GetChunk(i);
+				segments.push_back({chunk.first_record, chunk.first_record + chunk.record_count, analysis.MayMatch(chunk), chunk.instruction_count, chunk.last_pc});
+			}
+		} else {
+			for(uint64_t first = 0; first < file.Size(); first += kSegmentRecords) {
+				segments.push_back({first, std::min(first + kSegmentRecords, file.Size()), true, 0, 0});
+			}
+		}
+	}
+	fclose(f);
+
+	// Each worker reads the trace through its own file
+	std::vector<FILE*> files;
+	for(unsigned i = 0; i < threads_; ++i) {
+		FILE *worker_file = fopen(filename_.c_str(), "r");
+		if(!worker_file) {
+			for(auto file : files) {
+				fclose(file);
+			}
+			return false;
+		}
+		files.push_back(worker_file);
+	}
+
+	// Only let workers get a limited distance ahead of the merge, so that
+	// the results waiting to be merged do not grow without bound
+	const size_t window = threads_ * 4;
+
+	std::vector<SegmentResult> results (segments.size());
+	std::mutex lock;
+	std::condition_variable cond;
+	size_t next_segment = 0;
+	size_t merged_segments = 0;
+
+	std::vector<std::thread> workers;
+	for(unsigned i = 0; i < threads_; ++i) {
+		workers.emplace_back([&, i]() {
+			RecordFile file (files[i]);
+
+			while(true) {
+				size_t segment;
+				{
+					std::unique_lock<std::mutex> l(lock);
+					cond.wait(l, [&]() {
+						return next_segment >= segments.size() || next_segment < merged_segments + window;
+					});
+					if(next_segment >= segments.size()) {
+						break;
+					}
+					segment = next_segment++;
+				}
+
+				SegmentResult result;
+				if(segments[segment].visit) {
+					result.visitor = analysis.CreateVisitor();
+					VisitSegment(file, segments[segment], result.visitor, result.instruction_count, result.last_pc);
+				} else {
+					result.instruction_count = segments[segment].instruction_count;
+					result.last_pc = segments[segment].last_pc;
+				}
+				result.done = true;
+
+				{
+					std::lock_guard<std::mutex> l(lock);
+					results[segment] = result;
+				}
+				cond.notify_all();
+			}
+		});
+	}
+
+	uint64_t instruction_count = 0;
+	uint32_t prev_pc = 0;
+	for(size_t i = 0; i < segments.size(); ++i) {
+		SegmentResult result;
+		{
+			std::unique_lock<std::mutex> l(lock);
+			cond.wait(l, [&]() {
+				return results[i].done;
+			});
+			result = results[i];
+		}
+
+		if(result.visitor) {
+			TraceSegmentInfo info;
+			info.first_record = segments[i].first_record;
+			info.end_record = segments[i].end_record;
+			info.first_instruction = instruction_count;
+			info.instruction_count = result.instruction_count;
+			info.prev_pc = prev_pc;
+
+			analysis.Merge(result.visitor, info);
+			delete result.visitor;
+		}
+
+		instruction_count += result.instruction_count;
+		if(result.instruction_count) {
+			prev_pc = result.last_pc;
+		}
+
+		{
+			std::lock_guard<std::mutex> l(lock);
+			merged_segments++;
+		}
+		cond.notify_all();
+	}
+
+	for(auto &worker : workers) {
+		worker.join();
+	}
+	for(auto file : files) {
+		fclose(file);
+	}
+
+	return true;
+}
+
+void TraceAnalysisRunner::VisitSegment(RecordFile &file, const Segment &segment, TraceAnalysisVisitor *visitor, uint64_t &instruction_count, uint32_t &last_pc)
+{
+	uint64_t size = file.Size();
+	uint64_t idx = segment.first_record;
+	Record r;
+
+	// Any records before the first instruction header belong to the
+	// previous segment's last instruction
+	if(idx != 0) {
+		while(idx < size && file.Get(idx, r) && TraceRecord(r).GetType() != InstructionHeader) {
+			idx++;
+		}
+	}
+
+	TraceRecordPacket packet ((TraceRecord()));
+	std::vector<DataExtensionRecord> extensions;
+
+	instruction_count = 0;
+
+	while(idx < size) {
+		file.Get(idx, r);
+		TraceRecord record (r);
+
+		// Run past the end of the segment to finish the last instruction
+		if(record.GetType() == InstructionHeader && idx >= segment.end_record) {
+			break;
+		}
+
+		extensions.clear();
+		for(uint64_t ext = idx + 1; ext < size && extensions.size() < record.GetExtensionCount(); ++ext) {
+			file.Get(ext, r);
+			extensions.push_back(*(DataExtensionRecord*)&r);
+		}
+
+		if(record.GetType() == InstructionHeader) {
+			instruction_count++;
+			last_pc = ((InstructionHeaderRecord*)&record)->GetPC();
+		}
+
+		if(record.GetType() >= InstructionHeader && record.GetType() <= MemWriteData) {
+			packet.Assign(record, extensions.data(), extensions.size());
+			visitor->instruction_count_ = instruction_count;
+			visitor->record_index_ = idx;
+			visitor->VisitPacket(packet);
+		}
+
+		idx += 1 + record.GetExtensionCount();
+	}
+
+	visitor->EndSegment();
+}
@@ -35,11 +35,19 @@ TraceSource::TraceSource(uint32_t BufferSize)
 	sink_(nullptr),
 	aggressive_flushing_(true),
 	packet_open_(false),
-	skip_(0)
+	skip_(0),
+	skipping_insn_(false),
+	limited_(false),
+	remaining_(0),
+	stopped_(false)
 {
 	packet_buffer_ = (TraceRecord*)malloc(PacketBufferSize * sizeof(TraceRecord));
 	packet_buffer_end_ = packet_buffer_+PacketBufferSize;
-	packet_buffer_pos_ = packet_buffer_;
+
+	local_pos_ = packet_buffer_;
+	packet_buffer_pos_ = &local_pos_;
+	packet_buffer_limit_ = &local_limit_;
+	updateBufferLimit();
 }
 
 TraceSource::~TraceSource()
@@ -55,8 +63,90 @@ void TraceSource::SetSink(TraceSink* sink)
 
 void TraceSource::EmitPackets()
 {
-	sink_->SinkPackets(id_, packet_buffer_, packet_buffer_pos_);
-	packet_buffer_pos_ = packet_buffer_;
+	TraceRecord *end = *packet_buffer_pos_;
+	bool stopping = false;
+
+	// Instructions are only counted towards the limit as they are emitted,
+	// so that generated code doesn't need to count them
+	if(stopped_) {
+		end = packet_buffer_;
+	} else if(limited_) {
+		for(TraceRecord *record = packet_buffer_; record != end; ++record) {
+			if(record->GetType() != InstructionHeader) {
+				continue;
+			}
+			if(remaining_ == 0) {
+				end = record;
+				stopping = true;
+				break;
+			}
+			remaining_--;
+		}
+	}
+
+	sink_->SinkPackets(id_, packet_buffer_, end);
+	*packet_buffer_pos_ = packet_buffer_;
+
+	if(stopping) {
+		stopped_ = true;
+		packet_open_ = false;
+		updateBufferLimit();
+
+		if(stop_handler_) {
+			stop_handler_();
+		}
+	}
+}
+
+void TraceSource::BindBuffer(TraceRecord** pos, TraceRecord** limit)
+{
+	*pos = *packet_buffer_pos_;
+	packet_buffer_pos_ = pos;
+	packet_buffer_limit_ = limit;
+	updateBufferLimit();
+}
+
+void TraceSource::UnbindBuffer()
+{
+	local_pos_ = *packet_buffer_pos_;
+	packet_buffer_pos_ = &local_pos_;
+	packet_buffer_limit_ = &local_limit_;
+	updateBufferLimit();
+}
+
+bool TraceSource::ReserveRecords(TraceRecordType type, uint32_t count)
+{
+	assert(count <= PacketBufferSize);
+
+	if(stopped_) {
+		return false;
+	}
+
+	if(type == InstructionHeader) {
+		skipping_insn_ = skip_ > 0;
+		if(skipping_insn_) {
+			skip_--;
+		}
+	}
+
+	if(!skipping_insn_ && (*packet_buffer_pos_ + count > packet_buffer_end_ || GetAggressiveFlush())) {
+		EmitPackets();
+	}
+
+	updateBufferLimit();
+	return !skipping_insn_;
+}
+
+void TraceSource::updateBufferLimit()
+{
+	// Send every record written by generated code through ReserveRecords
+	// while instructions are being skipped (or tracing has stopped), or if
+	// each record should be flushed straight away
+	if(skip_ > 0 || skipping_insn_ || stopped_ || aggressive_flushing_) {
+		*packet_buffer_limit_ = packet_buffer_;
+	} else {
+		*packet_buffer_limit_ = packet_buffer_end_;
+	}
 }
 
 void TraceSource::Terminate()
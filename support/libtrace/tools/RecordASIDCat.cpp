@@ -1,67 +1,121 @@
 /* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
-#include "libtrace/RecordFile.h"
-#include "libtrace/InstructionPrinter.h"
+#include "libtrace/RecordTypes.h"
+#include "libtrace/TraceAnalysis.h"
 
 #include <iostream>
 #include <cstdio>
+#include <vector>
 
 using namespace libtrace;
 
-TraceRecord TR(Record r)
+RegWriteRecord RW(const Record &r)
 {
-	return *(TraceRecord*)&r;
+	return *(RegWriteRecord*)&r;
 }
 
-InstructionHeaderRecord IH(Record r)
+// Writes out the instructions which run while the ASID register (slot
+// 0xf0) holds the desired value. An instruction which writes the ASID is
+// still written out under the old ASID.
+//
+// The ASID at the start of a segment is only known when the segment is
+// merged, so the instructions before the segment's first ASID write are
+// kept separately.
+class ASIDCatVisitor : public TraceAnalysisVisitor
 {
-	return *(InstructionHeaderRecord*)&r;
-}
+public:
+	ASIDCatVisitor(uint32_t desired_asid) : asid_known_(false), asid_(0), desired_asid_(desired_asid), pending_write_(false), pending_asid_(0) {}
 
-RegWriteRecord RW(Record r)
-{
-	return *(RegWriteRecord*)&r;
-}
+	void VisitPacket(const TraceRecordPacket &packet) override
+	{
+		if(packet.GetRecord().GetType() == InstructionHeader) {
+			EndInstruction();
+		}
 
-int main(int argc, char **argv)
-{
-	if(argc != 3) {
-		fprintf(stderr, "Usage: %s [record file] [ASID]\n", argv[0]);
-		return 1;
+		AppendPacket(instruction_, packet);
+
+		if(packet.GetRecord().GetType() == RegWrite && RW(packet.GetRecord()).GetRegNum() == 0xf0) {
+			pending_write_ = true;
+			pending_asid_ = RW(packet.GetRecord()).GetData();
+		}
 	}
 
-	FILE *rfile = fopen(argv[1], "r");
-	if(!rfile) {
-		perror("Could not open file");
-		return 1;
+	void EndSegment() override
+	{
+		EndInstruction();
+	}
+
+	// Instructions before the first ASID write in the segment
+	std::vector<Record> prefix_;
+	// Instructions after it which ran with the desired ASID
+	std::vector<Record> records_;
+
+	bool asid_known_;
+	uint32_t asid_;
+
+private:
+	void EndInstruction()
+	{
+		if(!asid_known_) {
+			prefix_.insert(prefix_.end(), instruction_.begin(), instruction_.end());
+		} else if(asid_ == desired_asid_) {
+			records_.insert(records_.end(), instruction_.begin(), instruction_.end());
+		}
+		instruction_.clear();
+
+		if(pending_write_) {
+			asid_known_ = true;
+			asid_ = pending_asid_;
+			pending_write_ = false;
+		}
 	}
 
-	uint32_t desired_asid = strtol(argv[2], NULL, 0);
-	uint32_t current_asid = 0;
+	uint32_t desired_asid_;
+
+	std::vector<Record> instruction_;
+	bool pending_write_;
+	uint32_t pending_asid_;
+};
+
+class ASIDCat : public TraceAnalysis
+{
+public:
+	ASIDCat(uint32_t desired_asid) : desired_asid_(desired_asid), current_asid_(0) {}
+
+	TraceAnalysisVisitor *CreateVisitor() override
+	{
+		return new ASIDCatVisitor(desired_asid_);
+	}
 
-	RecordFile rf (rfile);
+	void Merge(TraceAnalysisVisitor *visitor, const TraceSegmentInfo &segment) override
+	{
+		ASIDCatVisitor *cat = (ASIDCatVisitor*)visitor;
 
-	auto begin = rf.begin();
-	auto end = rf.end();
+		if(current_asid_ == desired_asid_) {
+			fwrite(cat->prefix_.data(), sizeof(Record), cat->prefix_.size(), stdout);
+		}
+		fwrite(cat->records_.data(), sizeof(Record), cat->records_.size(), stdout);
 
-	while(begin != end) {
-		auto inst_it = begin;
+		if(cat->asid_known_) {
+			current_asid_ = cat->asid_;
+		}
+	}
 
-		assert(TR(*begin).GetType() == InstructionHeader);
+private:
+	uint32_t desired_asid_;
+	uint32_t current_asid_;
+};
 
-		do {
-			Record r = *begin;
-			if(current_asid == desired_asid)fwrite(&r, sizeof(Record), 1, stdout);
-			begin++;
-		} while(TR(*begin).GetType() != InstructionHeader && begin != end);
+int main(int argc, char **argv)
+{
+	if(argc != 3) {
+		fprintf(stderr, "Usage: %s [record file] [ASID]\n", argv[0]);
+		return 1;
+	}
 
-		do {
-			if(TR(*inst_it).GetType() == RegWrite) {
-				if(RW(*inst_it).GetRegNum() == 0xf0) {
-					current_asid = RW(*inst_it).GetData();
-				}
-			}
-			inst_it++;
-		} while(TR(*inst_it).GetType() != InstructionHeader && inst_it != end);
+	ASIDCat cat (strtol(argv[2], NULL, 0));
+	if(!TraceAnalysisRunner(argv[1]).Run(cat)) {
+		perror("Could not open file");
+		return 1;
 	}
 
 	return 0;
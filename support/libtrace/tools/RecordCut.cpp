@@ -1,19 +1,15 @@
 /* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
-#include "libtrace/RecordFile.h"
-#include "libtrace/InstructionPrinter.h"
+#include "libtrace/RecordTypes.h"
+#include "libtrace/TraceAnalysis.h"
 
 #include <iostream>
 #include <cstdio>
 #include <set>
+#include <vector>
 
 using namespace libtrace;
 
-TraceRecord TR(const Record &r)
-{
-	return *(TraceRecord*)&r;
-}
-
-InstructionHeaderRecord IH(Record &r)
+InstructionHeaderRecord IH(const Record &r)
 {
 	return *(InstructionHeaderRecord*)&r;
 }
@@ -26,7 +22,7 @@ public:
 		Load(f);
 	}
 
-	bool ShouldCut(uint64_t pc)
+	bool ShouldCut(uint64_t pc) const
 	{
 		if(cut_pcs_.count(pc)) {
 			return true;
@@ -61,6 +57,49 @@ private:
 	std::set<std::pair<uint64_t, uint64_t>> cut_ranges_;
 };
 
+class CutVisitor : public TraceAnalysisVisitor
+{
+public:
+	CutVisitor(const CutDescriptor &cd) : cd_(cd), cut_(false) {}
+
+	void VisitPacket(const TraceRecordPacket &packet) override
+	{
+		if(packet.GetRecord().GetType() == InstructionHeader) {
+			cut_ = cd_.ShouldCut(IH(packet.GetRecord()).GetPC());
+		} else {
+			assert(GetInstructionCount() != 0);
+		}
+
+		if(!cut_) AppendPacket(records_, packet);
+	}
+
+	std::vector<Record> records_;
+
+private:
+	const CutDescriptor &cd_;
+	bool cut_;
+};
+
+class Cut : public TraceAnalysis
+{
+public:
+	Cut(const CutDescriptor &cd) : cd_(cd) {}
+
+	TraceAnalysisVisitor *CreateVisitor() override
+	{
+		return new CutVisitor(cd_);
+	}
+
+	void Merge(TraceAnalysisVisitor *visitor, const TraceSegmentInfo &segment) override
+	{
+		auto &records = ((CutVisitor*)visitor)->records_;
+		fwrite(records.data(), sizeof(Record), records.size(), stdout);
+	}
+
+private:
+	const CutDescriptor &cd_;
+};
+
 int main(int argc, char **argv)
 {
 	if(argc != 3) {
@@ -68,12 +107,6 @@ int main(int argc, char **argv)
 		return 1;
 	}
 
-	FILE *record_file = fopen(argv[1], "r");
-	if(!record_file) {
-		perror("Could not open file");
-		return 1;
-	}
-
 	FILE *cut_file = fopen(argv[2], "r");
 	if(!cut_file) {
 		perror("Could not open file");
@@ -82,28 +115,13 @@ int main(int argc, char **argv)
 
 	CutDescriptor cd(cut_file);
 
-	RecordFile rf (record_file);
-	RecordBufferStreamAdaptor rbsa (&rf);
-
-	while(rbsa.Good()) {
-		auto record = rbsa.Peek();
-
-		assert(IH(record).GetType() == InstructionHeader);
-
-		if(cd.ShouldCut(IH(record).GetPC())) {
-			// skip to next instruction header
-			do {
-				rbsa.Get();
-			} while(rbsa.Good() && TR(rbsa.Peek()).GetType() != InstructionHeader);
-		} else {
-			// write out until next instruction header
-			do {
-				record = rbsa.Get();
-				fwrite((void*)&record, sizeof(record), 1, stdout);
-			} while(rbsa.Good() && TR(rbsa.Peek()).GetType() != InstructionHeader);
-		}
-
+	// The descriptor is only read from here on, so it can be shared by
+	// all of the workers
+	Cut cut (cd);
+	if(!TraceAnalysisRunner(argv[1]).Run(cut)) {
+		perror("Could not open file");
+		return 1;
 	}
 
 	return 0;
-}
\ No newline at end of file
+}
@@ -117,21 +117,19 @@ void UpdateMemoryMap(Memory &mem, libtrace::TraceRecordPacket &addr_record, libt
 
 int main(int argc, char **argv)
 {
-	std::ifstream f1(argv[1]);
-	std::ifstream f2(argv[2]);
-
-	char *buffer1 = (char*)malloc(1024 * 1024);
-	char *buffer2 = (char*)malloc(1024 * 1024);
-
-	f1.rdbuf()->pubsetbuf(buffer1, 1024 * 1024);
-	f2.rdbuf()->pubsetbuf(buffer2, 1024 * 1024);
+	FILE *f1 = fopen(argv[1], "r");
+	FILE *f2 = fopen(argv[2], "r");
 
 	if(!f1 || !f2) {
 		return 1;
 	}
 
-	RecordFileInputStream rf1 (f1);
-	RecordFileInputStream rf2 (f2);
+	// Go through RecordFile so that compressed traces can be read
+	RecordFile file1 (f1);
+	RecordFile file2 (f2);
+
+	RecordBufferStreamAdaptor rf1 (&file1);
+	RecordBufferStreamAdaptor rf2 (&file2);
 
 	TracePacketStreamAdaptor tpsa1(&rf1);
 	TracePacketStreamAdaptor tpsa2(&rf2);
@@ -1,65 +1,68 @@
 /* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
 #include "libtrace/RecordTypes.h"
-#include "libtrace/RecordFile.h"
+#include "libtrace/TraceAnalysis.h"
 
 #include <cstdio>
 #include <cstdlib>
+#include <vector>
 
 using namespace libtrace;
 
-TraceRecord TR(Record r)
+// Collects the data of every read from the given address
+class ExtractMemVisitor : public TraceAnalysisVisitor
 {
-	return *(TraceRecord*)&r;
-}
+public:
+	ExtractMemVisitor(uint32_t address) : address_(address), matched_(false) {}
 
-InstructionHeaderRecord IH(Record r)
-{
-	return *(InstructionHeaderRecord*)&r;
-}
+	void VisitMemReadAddr(const MemReadAddrReader &record) override
+	{
+		matched_ = record.GetAddress().AsU32() == address_;
+	}
+	void VisitMemReadData(const MemReadDataReader &record) override
+	{
+		if(matched_) data_.push_back(record.GetData().AsU32());
+		matched_ = false;
+	}
 
-MemReadAddrRecord MRA(Record r)
-{
-	return *(MemReadAddrRecord*)&r;
-}
+	std::vector<uint32_t> data_;
 
-MemReadDataRecord MRD(Record r)
-{
-	return *(MemReadDataRecord*)&r;
-}
+private:
+	uint32_t address_;
+	bool matched_;
+};
 
-MemWriteAddrRecord MWA(Record r)
+class ExtractMem : public TraceAnalysis
 {
-	return *(MemWriteAddrRecord*)&r;
-}
+public:
+	ExtractMem(uint32_t address) : address_(address) {}
 
-MemWriteDataRecord MWD(Record r)
-{
-	return *(MemWriteDataRecord*)&r;
-}
+	TraceAnalysisVisitor *CreateVisitor() override
+	{
+		return new ExtractMemVisitor(address_);
+	}
 
+	void Merge(TraceAnalysisVisitor *visitor, const TraceSegmentInfo &segment) override
+	{
+		for(auto data : ((ExtractMemVisitor*)visitor)->data_) {
+			printf("%u\n", data);
+		}
+	}
 
+private:
+	uint32_t address_;
+};
 
 int main(int argc, char **argv)
 {
-	FILE *f = fopen(argv[1], "r");
-	RecordFile rf (f);
-
-	uint32_t seek_addr = strtol(argv[2], NULL, 16);
-
-	auto it = rf.begin();
-	auto end = rf.end();
+	if(argc != 3) {
+		fprintf(stderr, "Usage: %s [record file] [address]\n", argv[0]);
+		return 1;
+	}
 
-	while(it != end) {
-		if(TR(*it).GetType() == MemReadAddr) {
-			if(seek_addr == MRA(*it).GetAddress()) {
-				it++;
-				printf("%u\n", MRD(*it).GetData());
-			} else {
-				it++;
-			}
-		} else {
-			it++;
-		}
+	ExtractMem extract (strtol(argv[2], NULL, 16));
+	if(!TraceAnalysisRunner(argv[1]).Run(extract)) {
+		perror("Could not open file");
+		return 1;
 	}
 
 	return 0;
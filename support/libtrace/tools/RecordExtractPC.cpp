@@ -1,27 +1,51 @@
 /* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
 #include "libtrace/RecordTypes.h"
-#include "libtrace/RecordFile.h"
+#include "libtrace/TraceAnalysis.h"
 
 #include <cstdlib>
 #include <cstdio>
+#include <vector>
 
 using namespace libtrace;
 
-int main(int argc, char **argv)
+class ExtractPCVisitor : public TraceAnalysisVisitor
 {
-	FILE *f = fopen(argv[1], "r");
-	RecordFile rf(f);
+public:
+	void VisitInstructionHeader(const InstructionHeaderReader &record) override
+	{
+		pcs_.push_back(record.GetPC().AsU32());
+	}
+
+	std::vector<uint32_t> pcs_;
+};
 
-	auto it = rf.begin();
-	auto end = rf.end();
+class ExtractPC : public TraceAnalysis
+{
+public:
+	TraceAnalysisVisitor *CreateVisitor() override
+	{
+		return new ExtractPCVisitor();
+	}
 
-	while(it != end) {
-		Record r = *it;
-		TraceRecord *tr = (TraceRecord *)&r;
-		if(tr->GetType() == InstructionHeader) {
-			printf("%08x\n", tr->GetData32());
+	void Merge(TraceAnalysisVisitor *visitor, const TraceSegmentInfo &segment) override
+	{
+		for(auto pc : ((ExtractPCVisitor*)visitor)->pcs_) {
+			printf("%08x\n", pc);
 		}
-		it++;
+	}
+};
+
+int main(int argc, char **argv)
+{
+	if(argc != 2) {
+		fprintf(stderr, "Usage: %s [record file]\n", argv[0]);
+		return 1;
+	}
+
+	ExtractPC extract;
+	if(!TraceAnalysisRunner(argv[1]).Run(extract)) {
+		perror("Could not open file");
+		return 1;
 	}
 
 	return 0;
@@ -1,5 +1,6 @@
 /* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
 #include "libtrace/RecordTypes.h"
+#include "libtrace/RecordFile.h"
 #include "libtrace/RecordStream.h"
 
 #include <vector>
@@ -10,18 +11,36 @@
 
 using namespace libtrace;
 
-int main(int argc, char **argv)
+// Files can be seeked through using the chunk summaries, so find the end
+// of the last instruction to be written and copy everything before it
+static int head_file(FILE *f, uint64_t count)
 {
-	FILE *f;
+	RecordFile rf(f);
 
-	if(!strcmp(argv[1], "-")) f = stdin;
-	else f = fopen(argv[1], "r");
+	uint64_t end;
+	if(!rf.FindInstruction(count, end)) {
+		end = rf.Size();
+	}
 
-	if(!f) return 1;
+	std::vector<Record> buffer;
+	Record r;
+	for(uint64_t i = 0; i < end; ++i) {
+		rf.Get(i, r);
 
-	RecordStream rf(f);
+		buffer.push_back(r);
+		if(buffer.size() == 1024) {
+			fwrite(buffer.data(), sizeof(Record), 1024, stdout);
+			buffer.clear();
+		}
+	}
 
-	uint64_t count = strtol(argv[2], NULL, 0);
+	fwrite(buffer.data(), sizeof(Record), buffer.size(), stdout);
+	return 0;
+}
+
+static int head_stream(FILE *f, uint64_t count)
+{
+	RecordStream rf(f);
 
 	std::vector<Record> buffer;
 	while(count > 0 && rf.good()) {
@@ -42,3 +61,22 @@ int main(int argc, char **argv)
 
 	return 0;
 }
+
+int main(int argc, char **argv)
+{
+	if(argc < 3) {
+		printf("Usage: %s [file] [instructions to keep]\n", argv[0]);
+		return 1;
+	}
+
+	uint64_t count = strtol(argv[2], NULL, 0);
+
+	if(!strcmp(argv[1], "-")) {
+		return head_stream(stdin, count);
+	}
+
+	FILE *f = fopen(argv[1], "r");
+	if(!f) return 1;
+
+	return head_file(f, count);
+}
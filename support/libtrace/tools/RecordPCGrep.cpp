@@ -1,44 +1,74 @@
 /* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
 #include "libtrace/RecordTypes.h"
-#include "libtrace/RecordFile.h"
+#include "libtrace/TraceAnalysis.h"
 
 #include <cstdio>
 #include <cstdlib>
+#include <vector>
 
 using namespace libtrace;
 
-TraceRecord TR(Record r)
+class PCGrepVisitor : public TraceAnalysisVisitor
 {
-	return *(TraceRecord*)&r;
-}
+public:
+	PCGrepVisitor(uint32_t pc) : pc_(pc), prev_pc_(0) {}
+
+	void VisitInstructionHeader(const InstructionHeaderReader &record) override
+	{
+		uint32_t pc = record.GetPC().AsU32();
+		if(pc == pc_) {
+			matches_.push_back({GetInstructionCount(), prev_pc_});
+		}
+		prev_pc_ = pc;
+	}
+
+	// Instruction numbers within the segment, and the previous PCs (which
+	// are only known here after the first instruction of the segment)
+	std::vector<std::pair<uint64_t, uint32_t>> matches_;
 
-InstructionHeaderRecord IH(Record r)
+private:
+	uint32_t pc_;
+	uint32_t prev_pc_;
+};
+
+class PCGrep : public TraceAnalysis
 {
-	return *(InstructionHeaderRecord*)&r;
-}
+public:
+	PCGrep(uint32_t pc) : pc_(pc) {}
 
+	TraceAnalysisVisitor *CreateVisitor() override
+	{
+		return new PCGrepVisitor(pc_);
+	}
+
+	void Merge(TraceAnalysisVisitor *visitor, const TraceSegmentInfo &segment) override
+	{
+		for(auto match : ((PCGrepVisitor*)visitor)->matches_) {
+			uint32_t prev_pc = match.first == 1 ? segment.prev_pc : match.second;
+			printf("%llu (%08x)\n", segment.first_instruction + match.first, prev_pc);
+		}
+	}
+
+	bool MayMatch(const ChunkIndexEntry &chunk) override
+	{
+		return chunk.MayContainPC(pc_);
+	}
+
+private:
+	uint32_t pc_;
+};
 
 int main(int argc, char **argv)
 {
-	FILE *f = fopen(argv[1], "r");
-	uint32_t pc = strtol(argv[2], NULL, 16);
-
-	RecordFile rf(f);
-	auto it = rf.begin();
-	auto end = rf.end();
-
-	uint64_t index = 0;
-	uint32_t prev_pc = 0;
-
-	while(it != end) {
-		if(TR(*it).GetType() == InstructionHeader) {
-			index++;
-			if(IH(*it).GetPC() == pc) {
-				printf("%llu (%08x)\n", index, prev_pc);
-			}
-			prev_pc = IH(*it).GetPC();
-		}
-		it++;
+	if(argc != 3) {
+		fprintf(stderr, "Usage: %s [record file] [PC]\n", argv[0]);
+		return 1;
+	}
+
+	PCGrep grep (strtol(argv[2], NULL, 16));
+	if(!TraceAnalysisRunner(argv[1]).Run(grep)) {
+		perror("Could not open file");
+		return 1;
 	}
 
 	return 0;
@@ -0,0 +1,58 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+#include "libtrace/RecordFile.h"
+#include "libtrace/RecordChunkWriter.h"
+
+#include <vector>
+
+#include <cstdio>
+
+using namespace libtrace;
+
+// Convert a trace (raw, or compressed without an index) into an indexed
+// compressed trace
+int main(int argc, char **argv)
+{
+	if(argc != 3) {
+		fprintf(stderr, "Usage: %s [input file] [output file]\n", argv[0]);
+		return 1;
+	}
+
+	FILE *in = fopen(argv[1], "r");
+	if(!in) {
+		perror("Could not open input file");
+		return 1;
+	}
+
+	FILE *out = fopen(argv[2], "w");
+	if(!out) {
+		perror("Could not open output file");
+		return 1;
+	}
+
+	const size_t chunk_records = 64 * 1024;
+
+	RecordFile rf (in);
+	RecordChunkWriter writer (out);
+
+	std::vector<Record> chunk;
+	chunk.reserve(chunk_records);
+
+	Record r;
+	for(uint64_t i = 0; i < rf.Size(); ++i) {
+		rf.Get(i, r);
+		chunk.push_back(r);
+
+		if(chunk.size() == chunk_records) {
+			writer.WriteChunk(chunk.data(), chunk.size());
+			chunk.clear();
+		}
+	}
+	if(!chunk.empty()) {
+		writer.WriteChunk(chunk.data(), chunk.size());
+	}
+
+	writer.Close();
+	fclose(in);
+
+	return 0;
+}
@@ -1,57 +1,76 @@
 /* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
 #include "libtrace/RecordTypes.h"
-#include "libtrace/RecordFile.h"
+#include "libtrace/TraceAnalysis.h"
 
 #include <cstdio>
 #include <cstdlib>
+#include <vector>
 
 using namespace libtrace;
 
-TraceRecord TR(Record r)
-{
-	return *(TraceRecord*)&r;
-}
-InstructionHeaderRecord IH(Record r)
-{
-	return *(InstructionHeaderRecord*)&r;
-}
+struct RegAccess {
+	bool write;
+	uint64_t instruction;
+	uint32_t pc;
+};
 
-RegWriteRecord RW(Record r)
-{
-	return *(RegWriteRecord*)&r;
-}
-RegReadRecord RR(Record r)
+class RegGrepVisitor : public TraceAnalysisVisitor
 {
-	return *(RegReadRecord*)&r;
-}
+public:
+	RegGrepVisitor(uint32_t reg) : reg_(reg), pc_(0) {}
 
+	void VisitInstructionHeader(const InstructionHeaderReader &record) override
+	{
+		pc_ = record.GetPC().AsU32();
+	}
+	void VisitRegRead(const RegReadReader &record) override
+	{
+		if(record.GetIndex() == reg_) accesses_.push_back({false, GetInstructionCount(), pc_});
+	}
+	void VisitRegWrite(const RegWriteReader &record) override
+	{
+		if(record.GetIndex() == reg_) accesses_.push_back({true, GetInstructionCount(), pc_});
+	}
 
-int main(int argc, char **argv)
-{
-	FILE *f = fopen(argv[1], "r");
-	uint32_t pc = strtol(argv[2], NULL, 10);
+	std::vector<RegAccess> accesses_;
 
-	RecordFile rf(f);
-	auto it = rf.begin();
-	auto end = rf.end();
+private:
+	uint32_t reg_;
+	uint32_t pc_;
+};
 
-	uint64_t index = 0;
-	uint32_t prev_pc = 0;
+class RegGrep : public TraceAnalysis
+{
+public:
+	RegGrep(uint32_t reg) : reg_(reg) {}
 
-	while(it != end) {
-		if(TR(*it).GetType() == InstructionHeader) {
-			index++;
-			prev_pc = IH(*it).GetPC();
-		}
+	TraceAnalysisVisitor *CreateVisitor() override
+	{
+		return new RegGrepVisitor(reg_);
+	}
 
-		if(TR(*it).GetType() == RegRead) {
-			if(RR(*it).GetRegNum() == pc) printf("=> %u 0x%08x\n", index, prev_pc);
-		}
-		if(TR(*it).GetType() == RegWrite) {
-			if(RW(*it).GetRegNum() == pc) printf("<= %u 0x%08x\n", index, prev_pc);
+	void Merge(TraceAnalysisVisitor *visitor, const TraceSegmentInfo &segment) override
+	{
+		for(auto access : ((RegGrepVisitor*)visitor)->accesses_) {
+			printf("%s %lu 0x%08x\n", access.write ? "<=" : "=>", segment.first_instruction + access.instruction, access.pc);
 		}
+	}
+
+private:
+	uint32_t reg_;
+};
+
+int main(int argc, char **argv)
+{
+	if(argc != 3) {
+		fprintf(stderr, "Usage: %s [record file] [register slot]\n", argv[0]);
+		return 1;
+	}
 
-		it++;
+	RegGrep grep (strtol(argv[2], NULL, 10));
+	if(!TraceAnalysisRunner(argv[1]).Run(grep)) {
+		perror("Could not open file");
+		return 1;
 	}
 
 	return 0;
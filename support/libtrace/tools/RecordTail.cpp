@@ -1,5 +1,6 @@
 /* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
 #include "libtrace/RecordTypes.h"
+#include "libtrace/RecordFile.h"
 #include "libtrace/RecordStream.h"
 
 #include <vector>
@@ -10,24 +11,39 @@
 
 using namespace libtrace;
 
-int main(int argc, char **argv)
+// Files can be seeked through using the chunk summaries
+static int tail_file(FILE *f, uint64_t count)
 {
-	FILE *f;
+	RecordFile rf(f);
 
-	if(argc < 3) {
-		printf("Usage: %s [file] [instructions to skip]\n", argv[0]);
+	uint64_t start;
+	if(!rf.FindInstruction(count, start)) {
+		fprintf(stderr, "Reached end of stream before reaching instruction count\n");
 		return 1;
 	}
 
-	if(!strcmp(argv[1], "-")) f = stdin;
-	else f = fopen(argv[1], "r");
+	std::vector<Record> buffer;
+	Record r;
+	for(uint64_t i = start; i < rf.Size(); ++i) {
+		rf.Get(i, r);
 
-	if(!f) return 1;
+		buffer.push_back(r);
+		if(buffer.size() == 1024) {
+			fwrite(buffer.data(), sizeof(Record), 1024, stdout);
+			buffer.clear();
+		}
+	}
 
-	RecordStream rf(f);
+	fprintf(stderr, "Reached end of stream.\n");
 
-	uint64_t count = strtol(argv[2], NULL, 0);
-	fprintf(stderr, "Skipping %lu instructions\n", count);
+	fwrite(buffer.data(), sizeof(Record), buffer.size(), stdout);
+	return 0;
+}
+
+// Streams have to be read from the start
+static int tail_stream(FILE *f, uint64_t count)
+{
+	RecordStream rf(f);
 
 	while(count && rf.good()) {
 		Record r = rf.next();
@@ -77,3 +93,23 @@ int main(int argc, char **argv)
 
 	return 0;
 }
+
+int main(int argc, char **argv)
+{
+	if(argc < 3) {
+		printf("Usage: %s [file] [instructions to skip]\n", argv[0]);
+		return 1;
+	}
+
+	uint64_t count = strtol(argv[2], NULL, 0);
+	fprintf(stderr, "Skipping %lu instructions\n", count);
+
+	if(!strcmp(argv[1], "-")) {
+		return tail_stream(stdin, count);
+	}
+
+	FILE *f = fopen(argv[1], "r");
+	if(!f) return 1;
+
+	return tail_file(f, count);
+}
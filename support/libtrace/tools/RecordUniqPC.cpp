@@ -1,10 +1,12 @@
 /* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
 #include "libtrace/RecordTypes.h"
 #include "libtrace/RecordStream.h"
+#include "libtrace/TraceAnalysis.h"
 
 #include <cstdlib>
 #include <cstdio>
 #include <cstring>
+#include <vector>
 
 using namespace libtrace;
 
@@ -17,17 +19,89 @@ InstructionHeaderRecord IHR(Record r)
 	return *(InstructionHeaderRecord*)&r;
 }
 
-int main(int argc, char **argv)
+// Drops the header and code records of instructions which have the same
+// PC as the previous instruction. Whether that applies to the first
+// instruction of a segment is only known when the segment is merged, so
+// its header and code records are kept separately.
+class UniqPCVisitor : public TraceAnalysisVisitor
 {
-	FILE *f;
-	if(!strcmp(argv[1], "-")) f = stdin;
-	else f = fopen(argv[1], "r");
+public:
+	UniqPCVisitor() : first_pc_(0), print_(true), prev_pc_(0) {}
 
-	if(!f) {
-		fprintf(stderr, "Could not open file\n");
-		return 1;
+	void VisitPacket(const TraceRecordPacket &packet) override
+	{
+		TraceRecordType type = packet.GetRecord().GetType();
+
+		if(type == InstructionHeader) {
+			uint32_t pc = IHR(packet.GetRecord()).GetPC();
+			if(GetInstructionCount() == 1) {
+				first_pc_ = pc;
+			} else {
+				print_ = pc != prev_pc_;
+			}
+			prev_pc_ = pc;
+		}
+
+		if(type == InstructionHeader || type == InstructionCode) {
+			if(GetInstructionCount() == 1) {
+				first_.push_back(records_.size());
+				AppendPacket(records_, packet);
+				first_.push_back(records_.size());
+			} else if(print_) {
+				AppendPacket(records_, packet);
+			}
+		} else {
+			AppendPacket(records_, packet);
+		}
+	}
+
+	std::vector<Record> records_;
+	// Start and end indices in records_ of the first instruction's header
+	// and code packets
+	std::vector<size_t> first_;
+	uint32_t first_pc_;
+
+private:
+	bool print_;
+	uint32_t prev_pc_;
+};
+
+class UniqPC : public TraceAnalysis
+{
+public:
+	UniqPC() : count_(0) {}
+
+	TraceAnalysisVisitor *CreateVisitor() override
+	{
+		return new UniqPCVisitor();
 	}
 
+	void Merge(TraceAnalysisVisitor *visitor, const TraceSegmentInfo &segment) override
+	{
+		UniqPCVisitor *uniq = (UniqPCVisitor*)visitor;
+		bool drop_first = segment.first_instruction != 0 && segment.instruction_count != 0 && uniq->first_pc_ == segment.prev_pc;
+
+		size_t start = 0;
+		if(drop_first) {
+			for(size_t i = 0; i < uniq->first_.size(); i += 2) {
+				fwrite(uniq->records_.data() + start, sizeof(Record), uniq->first_[i] - start, stdout);
+				start = uniq->first_[i+1];
+			}
+		}
+		fwrite(uniq->records_.data() + start, sizeof(Record), uniq->records_.size() - start, stdout);
+
+		uint64_t prev_count = count_;
+		count_ += segment.instruction_count;
+		if(count_ / 10000000 != prev_count / 10000000) fprintf(stderr, "Uniq'd %lu instructions\n", count_);
+	}
+
+private:
+	uint64_t count_;
+};
+
+// Streams can only be read from the start, on one thread
+static int uniq_stream(FILE *f)
+{
 	RecordStream rf(f);
 
 	uint32_t prev_pc = 0xffffffff;
@@ -57,3 +131,23 @@ int main(int argc, char **argv)
 
 	return 0;
 }
+
+int main(int argc, char **argv)
+{
+	if(argc != 2) {
+		fprintf(stderr, "Usage: %s [record file]\n", argv[0]);
+		return 1;
+	}
+
+	if(!strcmp(argv[1], "-")) {
+		return uniq_stream(stdin);
+	}
+
+	UniqPC uniq;
+	if(!TraceAnalysisRunner(argv[1]).Run(uniq)) {
+		fprintf(stderr, "Could not open file\n");
+		return 1;
+	}
+
+	return 0;
+}
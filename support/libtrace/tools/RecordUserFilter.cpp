@@ -1,66 +1,62 @@
 /* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
 #include "libtrace/RecordTypes.h"
-#include "libtrace/RecordFile.h"
-#include "libtrace/InstructionPrinter.h"
+#include "libtrace/TraceAnalysis.h"
 
 #include <cstdio>
 #include <cstdlib>
 
-#include <iostream>
 #include <vector>
 
 using namespace libtrace;
 
-int main(int argc, char **argv)
+// Drops every instruction with a kernel-mode PC (0xcxxxxxxx or 0xfxxxxxxx)
+class UserFilterVisitor : public TraceAnalysisVisitor
 {
-	if(argc != 2) {
-		fprintf(stderr, "Usage: %s [input file]\n", argv[0]);
-		return 1;
-	}
+public:
+	UserFilterVisitor() : print_(true) {}
+
+	void VisitPacket(const TraceRecordPacket &packet) override
+	{
+		if(packet.GetRecord().GetType() == InstructionHeader) {
+			uint32_t pc = ((InstructionHeaderRecord*)&packet.GetRecord())->GetPC();
+			print_ = !(((pc & 0xf0000000) == 0xc0000000) || ((pc & 0xf0000000) == 0xf0000000));
+		}
 
-	FILE *f = fopen(argv[1], "r");
-	if(!f) {
-		perror("Could not open input file");
-		return 1;
+		if(print_) AppendPacket(records_, packet);
 	}
-	RecordFile rf (f);
-
-	auto it = rf.begin();
-	auto end = rf.end();
-
-	std::vector<Record> outdata;
-	InstructionPrinter ip;
 
-	while(it != end) {
-		// if we have an instruction with a kernel-mode PC (0xcxxxxxxx), skip it
-		Record record = *it;
-		TraceRecord *tr = (TraceRecord*)&record;
-
-		bool print = true;
-
-		if(tr->GetType() == InstructionHeader) {
-			InstructionHeaderRecord *ihr = (InstructionHeaderRecord*)tr;
-			if(((ihr->GetPC() & 0xf0000000) == 0xc0000000) || ((ihr->GetPC() & 0xf0000000) == 0xf0000000)) {
-				print = false;
-			}
-		}
+	std::vector<Record> records_;
 
-//		auto c = it;
-//		std::cerr << ip(it) << std::endl;
+private:
+	bool print_;
+};
 
-		do {
-			if(print) outdata.push_back(*tr);
+class UserFilter : public TraceAnalysis
+{
+public:
+	TraceAnalysisVisitor *CreateVisitor() override
+	{
+		return new UserFilterVisitor();
+	}
 
-			it++;
-			record = *it;
-			tr = (TraceRecord*)&record;
+	void Merge(TraceAnalysisVisitor *visitor, const TraceSegmentInfo &segment) override
+	{
+		auto &records = ((UserFilterVisitor*)visitor)->records_;
+		fwrite(records.data(), sizeof(Record), records.size(), stdout);
+	}
+};
 
-		} while(tr->GetType() != InstructionHeader && it != end);
+int main(int argc, char **argv)
+{
+	if(argc != 2) {
+		fprintf(stderr, "Usage: %s [input file]\n", argv[0]);
+		return 1;
+	}
 
-		if(print) {
-			fwrite(outdata.data(), sizeof(Record), outdata.size(), stdout);
-			outdata.clear();
-		}
+	UserFilter filter;
+	if(!TraceAnalysisRunner(argv[1]).Run(filter)) {
+		perror("Could not open input file");
+		return 1;
 	}
 
 	return 0;